@@ -34,6 +34,7 @@ static int num_include_dirs = 0;
 static char **using_seen = 0;
 static int num_using_seen = 0;
 static int dont_fold = 0;
+static int nfloat_as_float64 = 0;
 
 /*
  * Forward declarations.
@@ -88,6 +89,10 @@ int main(int argc, char **argv)
 		{
 			dont_fold = 1;
 		}
+		else if(!jit_strcmp(argv[1], "--nfloat-as-float64"))
+		{
+			nfloat_as_float64 = 1;
+		}
 		else
 		{
 			usage();
@@ -289,4 +294,9 @@ static void initialize(void)
 		jit_context_set_meta_numeric
 			(dpas_current_context(), JIT_OPTION_DONT_FOLD, 1);
 	}
+	if(nfloat_as_float64)
+	{
+		jit_context_set_meta_numeric
+			(dpas_current_context(), JIT_OPTION_NFLOAT_AS_FLOAT64, 1);
+	}
 }
@@ -45,6 +45,8 @@ void jit_block_free_meta(jit_block_t block, int type) JIT_NOTHROW;
 int jit_block_is_reachable(jit_block_t block) JIT_NOTHROW;
 int jit_block_ends_in_dead(jit_block_t block) JIT_NOTHROW;
 int jit_block_current_is_dead(jit_function_t func) JIT_NOTHROW;
+void jit_block_set_cold(jit_block_t block, int flag) JIT_NOTHROW;
+int jit_block_is_cold(jit_block_t block) JIT_NOTHROW;
 
 #ifdef	__cplusplus
 };
@@ -51,6 +51,7 @@ void *jit_context_get_meta(jit_context_t context, int type) JIT_NOTHROW;
 jit_nuint jit_context_get_meta_numeric
 	(jit_context_t context, int type) JIT_NOTHROW;
 void jit_context_free_meta(jit_context_t context, int type) JIT_NOTHROW;
+jit_ulong jit_context_get_stat(jit_context_t context, int stat) JIT_NOTHROW;
 
 /*
  * Standard meta values for builtin configurable options.
@@ -61,6 +62,20 @@ void jit_context_free_meta(jit_context_t context, int type) JIT_NOTHROW;
 #define	JIT_OPTION_DONT_FOLD		10003
 #define JIT_OPTION_POSITION_INDEPENDENT	10004
 #define JIT_OPTION_CACHE_MAX_PAGE_FACTOR	10005
+#define JIT_OPTION_WORKSPACE_LIMIT	10006
+#define JIT_OPTION_OPTIMIZE_SIZE_LIMIT	10007
+#define JIT_OPTION_COMPILE_BUDGET	10008
+#define JIT_OPTION_NO_PEEPHOLE		10009
+#define JIT_OPTION_NFLOAT_AS_FLOAT64	10010
+#define JIT_OPTION_TARGET_FEATURE_LEVEL	10011
+
+/*
+ * Code generation statistics.
+ */
+#define	JIT_STAT_FUNCTIONS		1
+#define	JIT_STAT_CODE_BYTES		2
+#define	JIT_STAT_PEEPHOLE_INSNS		3
+#define	JIT_STAT_PEEPHOLE_BYTES		4
 
 #ifdef	__cplusplus
 };
@@ -57,6 +57,15 @@ typedef struct
 #define	JIT_CALL_NORETURN		(1 << 1)
 #define	JIT_CALL_TAIL			(1 << 2)
 
+/*
+ * Memory orders for the atomic loads, stores and fences.
+ */
+#define	JIT_MEMORY_ORDER_RELAXED	0
+#define	JIT_MEMORY_ORDER_ACQUIRE	1
+#define	JIT_MEMORY_ORDER_RELEASE	2
+#define	JIT_MEMORY_ORDER_ACQ_REL	3
+#define	JIT_MEMORY_ORDER_SEQ_CST	4
+
 int jit_insn_get_opcode(jit_insn_t insn) JIT_NOTHROW;
 jit_value_t jit_insn_get_dest(jit_insn_t insn) JIT_NOTHROW;
 jit_value_t jit_insn_get_value1(jit_insn_t insn) JIT_NOTHROW;
@@ -95,6 +104,8 @@ int jit_insn_store_elem
 	(jit_function_t func, jit_value_t base_addr,
 	 jit_value_t index, jit_value_t value) JIT_NOTHROW;
 int jit_insn_check_null(jit_function_t func, jit_value_t value) JIT_NOTHROW;
+int jit_insn_check_bounds
+	(jit_function_t func, jit_value_t index, jit_value_t length) JIT_NOTHROW;
 int jit_insn_nop(jit_function_t func) JIT_NOTHROW;
 
 jit_value_t jit_insn_add
@@ -133,6 +144,18 @@ jit_value_t jit_insn_ushr
 	(jit_function_t func, jit_value_t value1, jit_value_t value2) JIT_NOTHROW;
 jit_value_t jit_insn_sshr
 	(jit_function_t func, jit_value_t value1, jit_value_t value2) JIT_NOTHROW;
+jit_value_t jit_insn_popcount
+	(jit_function_t func, jit_value_t value1) JIT_NOTHROW;
+jit_value_t jit_insn_clz
+	(jit_function_t func, jit_value_t value1) JIT_NOTHROW;
+jit_value_t jit_insn_ctz
+	(jit_function_t func, jit_value_t value1) JIT_NOTHROW;
+jit_value_t jit_insn_bswap
+	(jit_function_t func, jit_value_t value1) JIT_NOTHROW;
+jit_value_t jit_insn_rol
+	(jit_function_t func, jit_value_t value1, jit_value_t value2) JIT_NOTHROW;
+jit_value_t jit_insn_ror
+	(jit_function_t func, jit_value_t value1, jit_value_t value2) JIT_NOTHROW;
 jit_value_t jit_insn_eq
 	(jit_function_t func, jit_value_t value1, jit_value_t value2) JIT_NOTHROW;
 jit_value_t jit_insn_ne
@@ -171,6 +194,9 @@ jit_value_t jit_insn_exp
 	(jit_function_t func, jit_value_t value1) JIT_NOTHROW;
 jit_value_t jit_insn_floor
 	(jit_function_t func, jit_value_t value1) JIT_NOTHROW;
+jit_value_t jit_insn_fma
+	(jit_function_t func, jit_value_t value1, jit_value_t value2,
+	 jit_value_t value3) JIT_NOTHROW;
 jit_value_t jit_insn_log
 	(jit_function_t func, jit_value_t value1) JIT_NOTHROW;
 jit_value_t jit_insn_log10
@@ -216,6 +242,9 @@ int jit_insn_branch_if_not
 int jit_insn_jump_table
 	(jit_function_t func, jit_value_t value,
 	 jit_label_t *labels, unsigned int num_labels) JIT_NOTHROW;
+int jit_insn_switch
+	(jit_function_t func, jit_value_t value, const jit_long *values,
+	 jit_label_t *labels, unsigned int num_cases) JIT_NOTHROW;
 jit_value_t jit_insn_address_of
 	(jit_function_t func, jit_value_t value1) JIT_NOTHROW;
 jit_value_t jit_insn_address_of_label
@@ -317,6 +346,27 @@ int jit_insn_memset
 jit_value_t jit_insn_alloca
 	(jit_function_t func, jit_value_t size) JIT_NOTHROW;
 
+jit_value_t jit_insn_atomic_load
+	(jit_function_t func, jit_value_t ptr,
+	 jit_type_t type, int order) JIT_NOTHROW;
+int jit_insn_atomic_store
+	(jit_function_t func, jit_value_t ptr,
+	 jit_value_t value, int order) JIT_NOTHROW;
+jit_value_t jit_insn_atomic_exchange
+	(jit_function_t func, jit_value_t ptr, jit_value_t value) JIT_NOTHROW;
+jit_value_t jit_insn_atomic_compare_exchange
+	(jit_function_t func, jit_value_t ptr,
+	 jit_value_t expected, jit_value_t desired) JIT_NOTHROW;
+jit_value_t jit_insn_atomic_fetch_add
+	(jit_function_t func, jit_value_t ptr, jit_value_t value) JIT_NOTHROW;
+jit_value_t jit_insn_atomic_fetch_and
+	(jit_function_t func, jit_value_t ptr, jit_value_t value) JIT_NOTHROW;
+jit_value_t jit_insn_atomic_fetch_or
+	(jit_function_t func, jit_value_t ptr, jit_value_t value) JIT_NOTHROW;
+jit_value_t jit_insn_atomic_fetch_xor
+	(jit_function_t func, jit_value_t ptr, jit_value_t value) JIT_NOTHROW;
+int jit_insn_fence(jit_function_t func, int order) JIT_NOTHROW;
+
 int jit_insn_move_blocks_to_end
 	(jit_function_t func, jit_label_t from_label, jit_label_t to_label)
 		JIT_NOTHROW;
@@ -142,6 +142,22 @@ jit_long jit_long_min(jit_long value1, jit_long value2) JIT_NOTHROW;
 jit_long jit_long_max(jit_long value1, jit_long value2) JIT_NOTHROW;
 jit_int jit_long_sign(jit_long value1) JIT_NOTHROW;
 
+/*
+ * Bit manipulation on 32-bit and 64-bit integers.
+ */
+jit_int jit_int_popcount(jit_int value1) JIT_NOTHROW;
+jit_int jit_long_popcount(jit_long value1) JIT_NOTHROW;
+jit_int jit_int_clz(jit_int value1) JIT_NOTHROW;
+jit_int jit_long_clz(jit_long value1) JIT_NOTHROW;
+jit_int jit_int_ctz(jit_int value1) JIT_NOTHROW;
+jit_int jit_long_ctz(jit_long value1) JIT_NOTHROW;
+jit_int jit_int_bswap(jit_int value1) JIT_NOTHROW;
+jit_long jit_long_bswap(jit_long value1) JIT_NOTHROW;
+jit_int jit_int_rol(jit_int value1, jit_uint value2) JIT_NOTHROW;
+jit_int jit_int_ror(jit_int value1, jit_uint value2) JIT_NOTHROW;
+jit_long jit_long_rol(jit_long value1, jit_uint value2) JIT_NOTHROW;
+jit_long jit_long_ror(jit_long value1, jit_uint value2) JIT_NOTHROW;
+
 /*
  * Perform operations on unsigned 64-bit integers.
  */
@@ -213,6 +229,8 @@ jit_float32 jit_float32_cos(jit_float32 value1) JIT_NOTHROW;
 jit_float32 jit_float32_cosh(jit_float32 value1) JIT_NOTHROW;
 jit_float32 jit_float32_exp(jit_float32 value1) JIT_NOTHROW;
 jit_float32 jit_float32_floor(jit_float32 value1) JIT_NOTHROW;
+jit_float32 jit_float32_fma
+	(jit_float32 value1, jit_float32 value2, jit_float32 value3) JIT_NOTHROW;
 jit_float32 jit_float32_log(jit_float32 value1) JIT_NOTHROW;
 jit_float32 jit_float32_log10(jit_float32 value1) JIT_NOTHROW;
 jit_float32 jit_float32_pow
@@ -269,6 +287,8 @@ jit_float64 jit_float64_cos(jit_float64 value1) JIT_NOTHROW;
 jit_float64 jit_float64_cosh(jit_float64 value1) JIT_NOTHROW;
 jit_float64 jit_float64_exp(jit_float64 value1) JIT_NOTHROW;
 jit_float64 jit_float64_floor(jit_float64 value1) JIT_NOTHROW;
+jit_float64 jit_float64_fma
+	(jit_float64 value1, jit_float64 value2, jit_float64 value3) JIT_NOTHROW;
 jit_float64 jit_float64_log(jit_float64 value1) JIT_NOTHROW;
 jit_float64 jit_float64_log10(jit_float64 value1) JIT_NOTHROW;
 jit_float64 jit_float64_pow
@@ -319,6 +339,8 @@ jit_nfloat jit_nfloat_cos(jit_nfloat value1) JIT_NOTHROW;
 jit_nfloat jit_nfloat_cosh(jit_nfloat value1) JIT_NOTHROW;
 jit_nfloat jit_nfloat_exp(jit_nfloat value1) JIT_NOTHROW;
 jit_nfloat jit_nfloat_floor(jit_nfloat value1) JIT_NOTHROW;
+jit_nfloat jit_nfloat_fma
+	(jit_nfloat value1, jit_nfloat value2, jit_nfloat value3) JIT_NOTHROW;
 jit_nfloat jit_nfloat_log(jit_nfloat value1) JIT_NOTHROW;
 jit_nfloat jit_nfloat_log10(jit_nfloat value1) JIT_NOTHROW;
 jit_nfloat jit_nfloat_pow(jit_nfloat value1, jit_nfloat value2) JIT_NOTHROW;
@@ -466,6 +488,29 @@ jit_nfloat jit_float64_to_nfloat(jit_float64 value) JIT_NOTHROW;
 jit_float32 jit_nfloat_to_float32(jit_nfloat value) JIT_NOTHROW;
 jit_float64 jit_nfloat_to_float64(jit_nfloat value) JIT_NOTHROW;
 
+/*
+ * Atomic memory operations.
+ */
+jit_int jit_int_atomic_load(jit_int *ptr) JIT_NOTHROW;
+void jit_int_atomic_store(jit_int *ptr, jit_int value) JIT_NOTHROW;
+jit_int jit_int_atomic_exchange(jit_int *ptr, jit_int value) JIT_NOTHROW;
+jit_int jit_int_atomic_compare_exchange
+	(jit_int *ptr, jit_int expected, jit_int desired) JIT_NOTHROW;
+jit_int jit_int_atomic_fetch_add(jit_int *ptr, jit_int value) JIT_NOTHROW;
+jit_int jit_int_atomic_fetch_and(jit_int *ptr, jit_int value) JIT_NOTHROW;
+jit_int jit_int_atomic_fetch_or(jit_int *ptr, jit_int value) JIT_NOTHROW;
+jit_int jit_int_atomic_fetch_xor(jit_int *ptr, jit_int value) JIT_NOTHROW;
+jit_long jit_long_atomic_load(jit_long *ptr) JIT_NOTHROW;
+void jit_long_atomic_store(jit_long *ptr, jit_long value) JIT_NOTHROW;
+jit_long jit_long_atomic_exchange(jit_long *ptr, jit_long value) JIT_NOTHROW;
+jit_long jit_long_atomic_compare_exchange
+	(jit_long *ptr, jit_long expected, jit_long desired) JIT_NOTHROW;
+jit_long jit_long_atomic_fetch_add(jit_long *ptr, jit_long value) JIT_NOTHROW;
+jit_long jit_long_atomic_fetch_and(jit_long *ptr, jit_long value) JIT_NOTHROW;
+jit_long jit_long_atomic_fetch_or(jit_long *ptr, jit_long value) JIT_NOTHROW;
+jit_long jit_long_atomic_fetch_xor(jit_long *ptr, jit_long value) JIT_NOTHROW;
+void jit_atomic_fence(void) JIT_NOTHROW;
+
 #ifdef	__cplusplus
 };
 #endif
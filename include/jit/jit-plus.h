@@ -128,14 +128,18 @@ class jit_jump_table
 
 	int size() { return num_labels; }
 	jit_label_t *raw() { return labels; }
+	const jit_long *raw_values() { return values; }
 
 	jit_label get(int index);
+	jit_long get_value(int index);
 
 	void set(int index, jit_label label);
+	void set(int index, jit_long value, jit_label label);
 
  private:
 
 	jit_label_t *labels;
+	jit_long *values;
 	int num_labels;
 
 	// forbid copying
@@ -264,6 +268,7 @@ public:
 		(const jit_value& base_addr, const jit_value& index,
 		 const jit_value& value);
 	void insn_check_null(const jit_value& value);
+	void insn_check_bounds(const jit_value& index, const jit_value& length);
 	jit_value insn_add(const jit_value& value1, const jit_value& value2);
 	jit_value insn_add_ovf(const jit_value& value1, const jit_value& value2);
 	jit_value insn_sub(const jit_value& value1, const jit_value& value2);
@@ -282,6 +287,12 @@ public:
 	jit_value insn_shr(const jit_value& value1, const jit_value& value2);
 	jit_value insn_ushr(const jit_value& value1, const jit_value& value2);
 	jit_value insn_sshr(const jit_value& value1, const jit_value& value2);
+	jit_value insn_popcount(const jit_value& value1);
+	jit_value insn_clz(const jit_value& value1);
+	jit_value insn_ctz(const jit_value& value1);
+	jit_value insn_bswap(const jit_value& value1);
+	jit_value insn_rol(const jit_value& value1, const jit_value& value2);
+	jit_value insn_ror(const jit_value& value1, const jit_value& value2);
 	jit_value insn_eq(const jit_value& value1, const jit_value& value2);
 	jit_value insn_ne(const jit_value& value1, const jit_value& value2);
 	jit_value insn_lt(const jit_value& value1, const jit_value& value2);
@@ -301,6 +312,9 @@ public:
 	jit_value insn_cosh(const jit_value& value1);
 	jit_value insn_exp(const jit_value& value1);
 	jit_value insn_floor(const jit_value& value1);
+	jit_value insn_fma
+		(const jit_value& value1, const jit_value& value2,
+		 const jit_value& value3);
 	jit_value insn_log(const jit_value& value1);
 	jit_value insn_log10(const jit_value& value1);
 	jit_value insn_pow(const jit_value& value1, const jit_value& value2);
@@ -323,6 +337,7 @@ public:
 	void insn_branch_if(const jit_value& value, jit_label& label);
 	void insn_branch_if_not(const jit_value& value, jit_label& label);
 	void insn_jump_table(const jit_value& value, jit_jump_table& jump_table);
+	void insn_switch(const jit_value& value, jit_jump_table& jump_table);
 	jit_value insn_address_of(const jit_value& value1);
 	jit_value insn_address_of_label(jit_label& label);
 	jit_value insn_convert
@@ -385,6 +400,24 @@ public:
 	void insn_memset
 		(const jit_value& dest, const jit_value& value, const jit_value& size);
 	jit_value insn_alloca(const jit_value& size);
+	jit_value insn_atomic_load
+		(const jit_value& ptr, jit_type_t type, int order);
+	void insn_atomic_store
+		(const jit_value& ptr, const jit_value& value, int order);
+	jit_value insn_atomic_exchange
+		(const jit_value& ptr, const jit_value& value);
+	jit_value insn_atomic_compare_exchange
+		(const jit_value& ptr, const jit_value& expected,
+		 const jit_value& desired);
+	jit_value insn_atomic_fetch_add
+		(const jit_value& ptr, const jit_value& value);
+	jit_value insn_atomic_fetch_and
+		(const jit_value& ptr, const jit_value& value);
+	jit_value insn_atomic_fetch_or
+		(const jit_value& ptr, const jit_value& value);
+	jit_value insn_atomic_fetch_xor
+		(const jit_value& ptr, const jit_value& value);
+	void insn_fence(int order);
 	void insn_move_blocks_to_end
 		(const jit_label& from_label, const jit_label& to_label);
 	void insn_move_blocks_to_start
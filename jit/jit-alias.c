@@ -0,0 +1,1345 @@
+/*
+ * jit-alias.c - Scalar replacement, redundant load and dead store
+ *                elimination.
+ *
+ * Copyright (C) 2026  Free Software Foundation, Inc.
+ *
+ * This file is part of the libjit library.
+ *
+ * The libjit library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * The libjit library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the libjit library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "jit-internal.h"
+#include "jit-rules.h"
+
+/*
+ * The memory locations are described by a base and a constant offset
+ * and size.  The base is either the pointer value the location is
+ * relative to, or the local variable if the pointer is the address of
+ * that variable.  The locations with the same base overlap only if
+ * their ranges do.  The locations in different local variables never
+ * overlap.  Any other pair of the locations may overlap.
+ *
+ * There is no type based disambiguation as the memory has no type in
+ * libjit.  The type of the access only tells if a value stored in a
+ * location may be used in place of loading it.
+ *
+ * The facts about the memory contents flow forward from a block to
+ * the successors that have no other predecessor, and the locations
+ * that are going to be overwritten flow backward from a block to its
+ * only predecessor if that block has no other successor.  So a fact
+ * is never merged from several paths.
+ *
+ * Before that the local variables that have their address taken only
+ * to load and store their fields are split into a scalar variable for
+ * every field.  These are not addressable, so the register allocator
+ * may keep them in registers.  A variable that has its address passed
+ * anywhere else, or that is used by a nested function, stays in the
+ * memory.
+ */
+
+/*
+ * The memory effects of the instructions.
+ */
+#define ALIAS_NONE		0	/* No memory access */
+#define ALIAS_THROW		1	/* No memory access but may throw */
+#define ALIAS_LOAD		2	/* Loads a value from the location */
+#define ALIAS_STORE		3	/* Stores a value to the location */
+#define ALIAS_FILL		4	/* Writes the location */
+#define ALIAS_COPY		5	/* Writes the location, reads any memory */
+#define ALIAS_READ		6	/* Reads any memory */
+#define ALIAS_ANY		7	/* Reads and writes any memory, may throw */
+
+/*
+ * The kinds of the values in the memory.
+ */
+#define ALIAS_KIND_NONE		0
+#define ALIAS_KIND_BYTE		1
+#define ALIAS_KIND_SHORT	2
+#define ALIAS_KIND_INT		3
+#define ALIAS_KIND_LONG		4
+#define ALIAS_KIND_FLOAT32	5
+#define ALIAS_KIND_FLOAT64	6
+#define ALIAS_KIND_NFLOAT	7
+
+/*
+ * The number of the locations tracked at once.
+ */
+#define MAX_LOCATIONS		32
+
+/*
+ * A memory location and the value known to be in it.
+ */
+typedef struct
+{
+	jit_value_t		base;
+	int			is_frame;
+	jit_nint		offset;
+	jit_nint		size;
+	int			kind;
+	jit_value_t		value;
+	jit_block_t		block;
+
+} _jit_alias_loc_t;
+
+/*
+ * The number of the parts of a variable split into scalars.
+ */
+#define MAX_PARTS		8
+
+/*
+ * A part of a variable and the scalar variable that replaces it.
+ */
+typedef struct
+{
+	jit_nint		offset;
+	int			kind;
+	jit_value_t		value;
+
+} _jit_alias_part_t;
+
+/*
+ * A local variable that has its address taken and may be split.
+ */
+typedef struct
+{
+	jit_value_t		local;
+	int			is_valid;
+	int			is_scalar;
+	int			num_refs;
+	_jit_alias_part_t	parts[MAX_PARTS];
+	int			num_parts;
+
+} _jit_alias_split_t;
+
+typedef struct
+{
+	jit_function_t		func;
+
+	/* The locations known at the current position */
+	_jit_alias_loc_t	locs[MAX_LOCATIONS];
+	int			num_locs;
+
+	/* The locations known at the end or at the start of the blocks
+	   by the postorder index */
+	_jit_alias_loc_t	**block_locs;
+	int			*block_num_locs;
+
+} _jit_alias_info_t;
+
+/*
+ * Check if accessing the value is a memory access that is not seen
+ * as such.  The variables that have their address taken may be
+ * accessed through pointers, and the volatile ones may change at
+ * any time.
+ */
+static int
+is_memory_value(jit_value_t value)
+{
+	return value->is_addressable || value->is_volatile;
+}
+
+/*
+ * Check if the instruction refers to a value in memory.
+ */
+static int
+has_memory_value(jit_insn_t insn)
+{
+	if((insn->flags & JIT_INSN_DEST_OTHER_FLAGS) == 0
+	   && insn->dest && is_memory_value(insn->dest))
+	{
+		return 1;
+	}
+	if((insn->flags & JIT_INSN_VALUE1_OTHER_FLAGS) == 0
+	   && insn->value1 && is_memory_value(insn->value1))
+	{
+		return 1;
+	}
+	if((insn->flags & JIT_INSN_VALUE2_OTHER_FLAGS) == 0
+	   && insn->value2 && is_memory_value(insn->value2))
+	{
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * Turn a temporary value into a local variable that may be used in
+ * any block.
+ */
+static void
+make_local(jit_value_t value)
+{
+	value->is_temporary = 0;
+	value->is_local = 1;
+	if(_jit_gen_is_global_candidate(value->type))
+	{
+		value->global_candidate = 1;
+	}
+}
+
+/*
+ * Check if an instruction that does not access the memory may throw
+ * an exception.
+ */
+static int
+may_throw(int opcode)
+{
+	switch(opcode)
+	{
+	case JIT_OP_CHECK_SBYTE:
+	case JIT_OP_CHECK_UBYTE:
+	case JIT_OP_CHECK_SHORT:
+	case JIT_OP_CHECK_USHORT:
+	case JIT_OP_CHECK_INT:
+	case JIT_OP_CHECK_UINT:
+	case JIT_OP_CHECK_LOW_WORD:
+	case JIT_OP_CHECK_SIGNED_LOW_WORD:
+	case JIT_OP_CHECK_LONG:
+	case JIT_OP_CHECK_ULONG:
+	case JIT_OP_CHECK_FLOAT32_TO_INT:
+	case JIT_OP_CHECK_FLOAT32_TO_UINT:
+	case JIT_OP_CHECK_FLOAT32_TO_LONG:
+	case JIT_OP_CHECK_FLOAT32_TO_ULONG:
+	case JIT_OP_CHECK_FLOAT64_TO_INT:
+	case JIT_OP_CHECK_FLOAT64_TO_UINT:
+	case JIT_OP_CHECK_FLOAT64_TO_LONG:
+	case JIT_OP_CHECK_FLOAT64_TO_ULONG:
+	case JIT_OP_CHECK_NFLOAT_TO_INT:
+	case JIT_OP_CHECK_NFLOAT_TO_UINT:
+	case JIT_OP_CHECK_NFLOAT_TO_LONG:
+	case JIT_OP_CHECK_NFLOAT_TO_ULONG:
+	case JIT_OP_IADD_OVF:
+	case JIT_OP_IADD_OVF_UN:
+	case JIT_OP_ISUB_OVF:
+	case JIT_OP_ISUB_OVF_UN:
+	case JIT_OP_IMUL_OVF:
+	case JIT_OP_IMUL_OVF_UN:
+	case JIT_OP_IDIV:
+	case JIT_OP_IDIV_UN:
+	case JIT_OP_IREM:
+	case JIT_OP_IREM_UN:
+	case JIT_OP_LADD_OVF:
+	case JIT_OP_LADD_OVF_UN:
+	case JIT_OP_LSUB_OVF:
+	case JIT_OP_LSUB_OVF_UN:
+	case JIT_OP_LMUL_OVF:
+	case JIT_OP_LMUL_OVF_UN:
+	case JIT_OP_LDIV:
+	case JIT_OP_LDIV_UN:
+	case JIT_OP_LREM:
+	case JIT_OP_LREM_UN:
+	case JIT_OP_CHECK_NULL:
+	case JIT_OP_CHECK_BOUNDS:
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * Get the kind of the value a relative load or store accesses.
+ */
+static int
+get_kind(int opcode)
+{
+	switch(opcode)
+	{
+	case JIT_OP_LOAD_RELATIVE_SBYTE:
+	case JIT_OP_LOAD_RELATIVE_UBYTE:
+	case JIT_OP_STORE_RELATIVE_BYTE:
+		return ALIAS_KIND_BYTE;
+
+	case JIT_OP_LOAD_RELATIVE_SHORT:
+	case JIT_OP_LOAD_RELATIVE_USHORT:
+	case JIT_OP_STORE_RELATIVE_SHORT:
+		return ALIAS_KIND_SHORT;
+
+	case JIT_OP_LOAD_RELATIVE_INT:
+	case JIT_OP_STORE_RELATIVE_INT:
+		return ALIAS_KIND_INT;
+
+	case JIT_OP_LOAD_RELATIVE_LONG:
+	case JIT_OP_STORE_RELATIVE_LONG:
+		return ALIAS_KIND_LONG;
+
+	case JIT_OP_LOAD_RELATIVE_FLOAT32:
+	case JIT_OP_STORE_RELATIVE_FLOAT32:
+		return ALIAS_KIND_FLOAT32;
+
+	case JIT_OP_LOAD_RELATIVE_FLOAT64:
+	case JIT_OP_STORE_RELATIVE_FLOAT64:
+		return ALIAS_KIND_FLOAT64;
+
+	case JIT_OP_LOAD_RELATIVE_NFLOAT:
+	case JIT_OP_STORE_RELATIVE_NFLOAT:
+		return ALIAS_KIND_NFLOAT;
+	}
+	return ALIAS_KIND_NONE;
+}
+
+/*
+ * Get the size of a kind of the values.
+ */
+static jit_nint
+get_kind_size(int kind)
+{
+	switch(kind)
+	{
+	case ALIAS_KIND_BYTE:		return 1;
+	case ALIAS_KIND_SHORT:		return 2;
+	case ALIAS_KIND_INT:		return 4;
+	case ALIAS_KIND_LONG:		return 8;
+	case ALIAS_KIND_FLOAT32:	return 4;
+	case ALIAS_KIND_FLOAT64:	return 8;
+	}
+	return sizeof(jit_nfloat);
+}
+
+/*
+ * Set the base of the location the pointer points to.  The position
+ * of the last definition of every temporary value in the block is
+ * kept in its index field, so the address of a local variable is
+ * recognized without looking back.
+ */
+static void
+set_base(jit_block_t block, int position, jit_value_t pointer,
+	 _jit_alias_loc_t *loc)
+{
+	jit_insn_t insn;
+	int def;
+
+	loc->base = pointer;
+	loc->is_frame = 0;
+	if(!pointer->is_temporary)
+	{
+		return;
+	}
+	def = pointer->index;
+	if(def < 0 || def >= position)
+	{
+		return;
+	}
+	insn = &block->insns[def];
+	if(insn->opcode == JIT_OP_ADDRESS_OF && insn->dest == pointer
+	   && insn->flags == 0)
+	{
+		loc->base = insn->value1;
+		loc->is_frame = 1;
+	}
+}
+
+/*
+ * Find out the memory effect of the instruction at the position and
+ * the location it accesses.
+ */
+static int
+get_effect(jit_block_t block, int position, _jit_alias_loc_t *loc)
+{
+	jit_insn_t insn = &block->insns[position];
+	int opcode = insn->opcode;
+
+	if(opcode == JIT_OP_NOP || opcode == JIT_OP_ADDRESS_OF)
+	{
+		return ALIAS_NONE;
+	}
+	if(has_memory_value(insn))
+	{
+		return ALIAS_ANY;
+	}
+
+	loc->kind = get_kind(opcode);
+	if(loc->kind != ALIAS_KIND_NONE)
+	{
+		loc->offset = jit_value_get_nint_constant(insn->value2);
+		loc->size = get_kind_size(loc->kind);
+		if(opcode >= JIT_OP_LOAD_RELATIVE_SBYTE
+		   && opcode <= JIT_OP_LOAD_RELATIVE_NFLOAT)
+		{
+			set_base(block, position, insn->value1, loc);
+			return ALIAS_LOAD;
+		}
+		set_base(block, position, insn->dest, loc);
+		return ALIAS_STORE;
+	}
+
+	switch(opcode)
+	{
+	case JIT_OP_STORE_RELATIVE_STRUCT:
+		loc->offset = jit_value_get_nint_constant(insn->value2);
+		loc->size = (jit_nint) jit_type_get_size(jit_value_get_type(insn->value1));
+		set_base(block, position, insn->dest, loc);
+		return ALIAS_FILL;
+
+	case JIT_OP_MEMSET:
+	case JIT_OP_MEMCPY:
+	case JIT_OP_MEMMOVE:
+		if(!insn->value2->is_constant
+		   || jit_value_get_nint_constant(insn->value2) < 0)
+		{
+			return ALIAS_ANY;
+		}
+		loc->offset = 0;
+		loc->size = jit_value_get_nint_constant(insn->value2);
+		set_base(block, position, insn->dest, loc);
+		return (opcode == JIT_OP_MEMSET ? ALIAS_FILL : ALIAS_COPY);
+
+	case JIT_OP_LOAD_RELATIVE_STRUCT:
+	case JIT_OP_LOAD_ELEMENT_SBYTE:
+	case JIT_OP_LOAD_ELEMENT_UBYTE:
+	case JIT_OP_LOAD_ELEMENT_SHORT:
+	case JIT_OP_LOAD_ELEMENT_USHORT:
+	case JIT_OP_LOAD_ELEMENT_INT:
+	case JIT_OP_LOAD_ELEMENT_LONG:
+	case JIT_OP_LOAD_ELEMENT_FLOAT32:
+	case JIT_OP_LOAD_ELEMENT_FLOAT64:
+	case JIT_OP_LOAD_ELEMENT_NFLOAT:
+		return ALIAS_READ;
+
+	case JIT_OP_COPY_LOAD_SBYTE:
+	case JIT_OP_COPY_LOAD_UBYTE:
+	case JIT_OP_COPY_LOAD_SHORT:
+	case JIT_OP_COPY_LOAD_USHORT:
+	case JIT_OP_COPY_INT:
+	case JIT_OP_COPY_LONG:
+	case JIT_OP_COPY_FLOAT32:
+	case JIT_OP_COPY_FLOAT64:
+	case JIT_OP_COPY_NFLOAT:
+	case JIT_OP_COPY_STRUCT:
+	case JIT_OP_COPY_STORE_BYTE:
+	case JIT_OP_COPY_STORE_SHORT:
+	case JIT_OP_ADD_RELATIVE:
+		return ALIAS_NONE;
+	}
+
+	/* The arithmetic, the conversions, the comparisons and the
+	   branches are all together in the opcode list, the opcodes
+	   added later are at its end */
+	if((opcode >= JIT_OP_TRUNC_SBYTE && opcode <= JIT_OP_CHECK_NULL)
+	   || opcode == JIT_OP_CHECK_BOUNDS
+	   || (opcode >= JIT_OP_IPOPCOUNT && opcode <= JIT_OP_LROR))
+	{
+		return may_throw(opcode) ? ALIAS_THROW : ALIAS_NONE;
+	}
+	return ALIAS_ANY;
+}
+
+/*
+ * Check if the locations may overlap.
+ */
+static int
+may_alias(_jit_alias_loc_t *loc1, _jit_alias_loc_t *loc2)
+{
+	if(loc1->base == loc2->base && loc1->is_frame == loc2->is_frame)
+	{
+		return (loc1->offset < loc2->offset + loc2->size
+			&& loc2->offset < loc1->offset + loc1->size);
+	}
+	return !(loc1->is_frame && loc2->is_frame);
+}
+
+/*
+ * Forget the locations that may overlap with the given one.
+ */
+static void
+kill_aliases(_jit_alias_info_t *info, _jit_alias_loc_t *loc)
+{
+	int index, num;
+
+	num = 0;
+	for(index = 0; index < info->num_locs; index++)
+	{
+		if(!may_alias(&info->locs[index], loc))
+		{
+			info->locs[num++] = info->locs[index];
+		}
+	}
+	info->num_locs = num;
+}
+
+/*
+ * Forget the locations that depend on the value that is about to
+ * change.
+ */
+static void
+kill_value(_jit_alias_info_t *info, jit_value_t value)
+{
+	_jit_alias_loc_t *loc;
+	int index, num;
+
+	num = 0;
+	for(index = 0; index < info->num_locs; index++)
+	{
+		loc = &info->locs[index];
+		if(loc->value != value && (loc->base != value || loc->is_frame))
+		{
+			info->locs[num++] = *loc;
+		}
+	}
+	info->num_locs = num;
+}
+
+/*
+ * Remember the location.
+ */
+static void
+add_location(_jit_alias_info_t *info, jit_block_t block, _jit_alias_loc_t *loc,
+	     jit_value_t value)
+{
+	if(info->num_locs == MAX_LOCATIONS)
+	{
+		return;
+	}
+	info->locs[info->num_locs] = *loc;
+	info->locs[info->num_locs].value = value;
+	info->locs[info->num_locs].block = block;
+	++(info->num_locs);
+}
+
+/*
+ * Find the value known to be in the location.
+ */
+static _jit_alias_loc_t *
+find_value(_jit_alias_info_t *info, _jit_alias_loc_t *loc)
+{
+	_jit_alias_loc_t *known;
+	int index;
+
+	for(index = info->num_locs - 1; index >= 0; index--)
+	{
+		known = &info->locs[index];
+		if(known->base == loc->base && known->is_frame == loc->is_frame
+		   && known->offset == loc->offset && known->kind == loc->kind)
+		{
+			return known;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Check if the location is going to be overwritten.
+ */
+static int
+is_overwritten(_jit_alias_info_t *info, _jit_alias_loc_t *loc)
+{
+	_jit_alias_loc_t *later;
+	int index;
+
+	for(index = 0; index < info->num_locs; index++)
+	{
+		later = &info->locs[index];
+		if(later->base == loc->base && later->is_frame == loc->is_frame
+		   && later->offset <= loc->offset
+		   && loc->offset + loc->size <= later->offset + later->size)
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Save the current locations for the block.
+ */
+static void
+save_locations(_jit_alias_info_t *info, jit_block_t block)
+{
+	_jit_alias_loc_t *locs;
+
+	info->block_num_locs[block->index] = 0;
+	if(info->num_locs == 0)
+	{
+		return;
+	}
+	locs = (_jit_alias_loc_t *) _jit_memory_arena_alloc(
+		&info->func->builder->cfg_arena,
+		info->num_locs * sizeof(_jit_alias_loc_t));
+	if(!locs)
+	{
+		jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+	}
+	jit_memcpy(locs, info->locs, info->num_locs * sizeof(_jit_alias_loc_t));
+	info->block_locs[block->index] = locs;
+	info->block_num_locs[block->index] = info->num_locs;
+}
+
+/*
+ * Restore the locations saved for the block.
+ */
+static void
+restore_locations(_jit_alias_info_t *info, jit_block_t block)
+{
+	info->num_locs = info->block_num_locs[block->index];
+	if(info->num_locs > 0)
+	{
+		jit_memcpy(info->locs, info->block_locs[block->index],
+			   info->num_locs * sizeof(_jit_alias_loc_t));
+	}
+}
+
+/*
+ * Turn the load into a copy of the value.  The bytes and the shorts are
+ * truncated the same way the load does.
+ */
+static void
+set_load_value(jit_function_t func, jit_insn_t insn, jit_value_t value)
+{
+	jit_type_t type = jit_value_get_type(insn->dest);
+	int opcode, copy_opcode;
+
+	copy_opcode = _jit_store_opcode(JIT_OP_COPY_INT, JIT_OP_COPY_STORE_BYTE, type);
+	switch(insn->opcode)
+	{
+	case JIT_OP_LOAD_RELATIVE_SBYTE:	opcode = JIT_OP_TRUNC_SBYTE; break;
+	case JIT_OP_LOAD_RELATIVE_UBYTE:	opcode = JIT_OP_TRUNC_UBYTE; break;
+	case JIT_OP_LOAD_RELATIVE_SHORT:	opcode = JIT_OP_TRUNC_SHORT; break;
+	case JIT_OP_LOAD_RELATIVE_USHORT:	opcode = JIT_OP_TRUNC_USHORT; break;
+	default:				opcode = copy_opcode; break;
+	}
+
+	if(value->is_constant && opcode != copy_opcode)
+	{
+		/* Convert the constant now rather than leave it to the code
+		   generator that does not expect it */
+		value = jit_value_create_nint_constant(
+			func, type,
+			opcode == JIT_OP_TRUNC_SBYTE
+			? (jit_nint) (jit_sbyte) jit_value_get_nint_constant(value)
+			: opcode == JIT_OP_TRUNC_UBYTE
+			? (jit_nint) (jit_ubyte) jit_value_get_nint_constant(value)
+			: opcode == JIT_OP_TRUNC_SHORT
+			? (jit_nint) (jit_short) jit_value_get_nint_constant(value)
+			: (jit_nint) (jit_ushort) jit_value_get_nint_constant(value));
+		if(!value)
+		{
+			jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+		}
+		opcode = copy_opcode;
+	}
+
+	insn->opcode = (short) opcode;
+	insn->value1 = value;
+	insn->value2 = 0;
+	value->usage_count++;
+}
+
+/*
+ * Replace the load with the value known to be in the location.
+ */
+static void
+replace_load(_jit_alias_info_t *info, jit_block_t block, jit_insn_t insn,
+	     _jit_alias_loc_t *known)
+{
+	jit_value_t value = known->value;
+
+	if(known->block != block && value->is_temporary)
+	{
+		/* The value is used in another block now */
+		make_local(value);
+	}
+	set_load_value(info->func, insn, value);
+}
+
+/*
+ * Replace the loads in the block with the values known to be in the
+ * memory.
+ */
+static void
+forward_block(_jit_alias_info_t *info, jit_block_t block)
+{
+	_jit_alias_loc_t loc, *known;
+	jit_block_t pred;
+	jit_insn_t insn;
+	jit_value_t def;
+	int position, effect;
+
+	/* The locations known at the end of the only predecessor are
+	   known at the start of the block */
+	info->num_locs = 0;
+	if(block->num_preds == 1)
+	{
+		pred = block->preds[0]->src;
+		if(pred != block && pred->index > block->index)
+		{
+			restore_locations(info, pred);
+		}
+	}
+
+	for(position = 0; position < block->num_insns; position++)
+	{
+		insn = &block->insns[position];
+		effect = get_effect(block, position, &loc);
+		switch(effect)
+		{
+		case ALIAS_LOAD:
+			known = find_value(info, &loc);
+			if(known)
+			{
+				replace_load(info, block, insn, known);
+			}
+			kill_value(info, insn->dest);
+			if(insn->dest != loc.base || loc.is_frame)
+			{
+				add_location(info, block, &loc, insn->dest);
+			}
+			break;
+
+		case ALIAS_STORE:
+			kill_aliases(info, &loc);
+			add_location(info, block, &loc, insn->value1);
+			break;
+
+		case ALIAS_FILL:
+		case ALIAS_COPY:
+			kill_aliases(info, &loc);
+			break;
+
+		case ALIAS_ANY:
+			info->num_locs = 0;
+			break;
+		}
+
+		def = _jit_insn_get_def(insn);
+		if(def)
+		{
+			if(effect != ALIAS_LOAD)
+			{
+				kill_value(info, def);
+			}
+			if(def->is_temporary)
+			{
+				def->index = position;
+			}
+		}
+	}
+
+	save_locations(info, block);
+}
+
+/*
+ * Remove the stores in the block that are overwritten before anything
+ * may read them.
+ */
+static void
+remove_dead_stores(_jit_alias_info_t *info, jit_block_t block)
+{
+	_jit_alias_loc_t loc;
+	jit_block_t succ;
+	jit_insn_t insn;
+	jit_value_t def;
+	int position, effect;
+
+	/* Find the addresses of the local variables.  A pointer defined
+	   again later in the block is not taken for the address */
+	for(position = 0; position < block->num_insns; position++)
+	{
+		def = _jit_insn_get_def(&block->insns[position]);
+		if(def && def->is_temporary)
+		{
+			def->index = position;
+		}
+	}
+
+	/* The locations overwritten in the only successor are overwritten
+	   at the end of the block if the block is its only predecessor */
+	info->num_locs = 0;
+	if(block->num_succs == 1)
+	{
+		succ = block->succs[0]->dst;
+		if(succ != block && succ->num_preds == 1
+		   && succ->index >= 0 && succ->index < block->index)
+		{
+			restore_locations(info, succ);
+		}
+	}
+
+	for(position = block->num_insns - 1; position >= 0; position--)
+	{
+		insn = &block->insns[position];
+
+		/* The locations above refer to the value after it changes */
+		def = _jit_insn_get_def(insn);
+		if(def)
+		{
+			kill_value(info, def);
+		}
+
+		effect = get_effect(block, position, &loc);
+		switch(effect)
+		{
+		case ALIAS_STORE:
+		case ALIAS_FILL:
+			if(is_overwritten(info, &loc))
+			{
+				insn->opcode = JIT_OP_NOP;
+				break;
+			}
+			if(loc.kind != ALIAS_KIND_NFLOAT)
+			{
+				add_location(info, block, &loc, 0);
+			}
+			break;
+
+		case ALIAS_LOAD:
+			kill_aliases(info, &loc);
+			break;
+
+		case ALIAS_COPY:
+		case ALIAS_READ:
+		case ALIAS_THROW:
+		case ALIAS_ANY:
+			info->num_locs = 0;
+			break;
+		}
+	}
+
+	save_locations(info, block);
+}
+
+/*
+ * Get the kind of the values of the type.
+ */
+static int
+get_type_kind(jit_type_t type)
+{
+	type = jit_type_normalize(type);
+	switch(type->kind)
+	{
+	case JIT_TYPE_INT:
+	case JIT_TYPE_UINT:
+		return ALIAS_KIND_INT;
+
+	case JIT_TYPE_LONG:
+	case JIT_TYPE_ULONG:
+		return ALIAS_KIND_LONG;
+
+	case JIT_TYPE_FLOAT32:
+		return ALIAS_KIND_FLOAT32;
+
+	case JIT_TYPE_FLOAT64:
+		return ALIAS_KIND_FLOAT64;
+
+	case JIT_TYPE_NFLOAT:
+		return ALIAS_KIND_NFLOAT;
+	}
+	return ALIAS_KIND_NONE;
+}
+
+/*
+ * Get the type of the variable that holds the values of the kind.  The
+ * bytes and the shorts are kept in ints and truncated when loaded.
+ */
+static jit_type_t
+get_kind_type(int kind)
+{
+	switch(kind)
+	{
+	case ALIAS_KIND_LONG:		return jit_type_long;
+	case ALIAS_KIND_FLOAT32:	return jit_type_float32;
+	case ALIAS_KIND_FLOAT64:	return jit_type_float64;
+	case ALIAS_KIND_NFLOAT:		return jit_type_nfloat;
+	}
+	return jit_type_int;
+}
+
+/*
+ * Get the opcode that copies the values of the kind.
+ */
+static int
+get_kind_copy(int kind)
+{
+	switch(kind)
+	{
+	case ALIAS_KIND_LONG:		return JIT_OP_COPY_LONG;
+	case ALIAS_KIND_FLOAT32:	return JIT_OP_COPY_FLOAT32;
+	case ALIAS_KIND_FLOAT64:	return JIT_OP_COPY_FLOAT64;
+	case ALIAS_KIND_NFLOAT:		return JIT_OP_COPY_NFLOAT;
+	}
+	return JIT_OP_COPY_INT;
+}
+
+/*
+ * Check if the local variable may be split into scalar variables.
+ */
+static int
+is_split_candidate(jit_value_t value)
+{
+	return (value->is_local && !value->is_temporary && !value->is_parameter
+		&& !value->is_volatile && !value->is_constant);
+}
+
+/*
+ * Find the candidate the value belongs to, either as the variable
+ * itself or as a temporary holding its address.
+ */
+static _jit_alias_split_t *
+get_split(_jit_alias_split_t *splits, jit_value_t value)
+{
+	if(!value || value->index < 0)
+	{
+		return 0;
+	}
+	return &splits[value->index];
+}
+
+/*
+ * Record an access to a part of the variable.  The parts accessed must
+ * not overlap and every part must be accessed the same way.
+ */
+static void
+add_part(_jit_alias_split_t *split, jit_nint offset, int kind)
+{
+	jit_nint size = get_kind_size(kind);
+	int index;
+
+	if(split->is_scalar)
+	{
+		/* The scalars are accessed as a whole */
+		if(offset != 0 || kind != get_type_kind(split->local->type))
+		{
+			split->is_valid = 0;
+		}
+		return;
+	}
+	if(offset < 0
+	   || offset + size > (jit_nint) jit_type_get_size(split->local->type))
+	{
+		split->is_valid = 0;
+		return;
+	}
+	for(index = 0; index < split->num_parts; index++)
+	{
+		if(split->parts[index].offset == offset && split->parts[index].kind == kind)
+		{
+			return;
+		}
+		if(split->parts[index].offset < offset + size
+		   && offset < split->parts[index].offset
+		   + get_kind_size(split->parts[index].kind))
+		{
+			split->is_valid = 0;
+			return;
+		}
+	}
+	if(split->num_parts == MAX_PARTS)
+	{
+		split->is_valid = 0;
+		return;
+	}
+	split->parts[split->num_parts].offset = offset;
+	split->parts[split->num_parts].kind = kind;
+	split->parts[split->num_parts].value = 0;
+	++(split->num_parts);
+}
+
+/*
+ * Check how the instruction uses a candidate value.  The variable
+ * may only have its address taken, and the address may only be the
+ * base of the relative loads and stores.  The scalar variables may be
+ * used directly too.
+ */
+static void
+check_use(_jit_alias_split_t *splits, jit_insn_t insn, jit_value_t value,
+	  int is_base)
+{
+	_jit_alias_split_t *split = get_split(splits, value);
+	int kind;
+
+	if(!split)
+	{
+		return;
+	}
+	if(value == split->local)
+	{
+		++(split->num_refs);
+		if(!split->is_scalar && insn->opcode != JIT_OP_ADDRESS_OF)
+		{
+			split->is_valid = 0;
+		}
+		return;
+	}
+	kind = get_kind(insn->opcode);
+	if(!is_base || kind == ALIAS_KIND_NONE)
+	{
+		split->is_valid = 0;
+		return;
+	}
+	add_part(split, jit_value_get_nint_constant(insn->value2), kind);
+}
+
+/*
+ * Find the local variables that have their address taken only to load
+ * and store their parts at constant offsets.  The address must not be
+ * used in any other way, and no other function may refer to the
+ * variable, which is the case if all the references to it counted
+ * by jit_value_ref() are here.
+ */
+static int
+find_splits(jit_function_t func, _jit_alias_split_t *splits)
+{
+	jit_block_t block;
+	jit_insn_t insn;
+	jit_value_t def;
+	_jit_alias_split_t *split;
+	int position, num_splits, index, is_load, is_store;
+
+	num_splits = 0;
+	for(block = func->builder->entry_block; block; block = block->next)
+	{
+		for(position = 0; position < block->num_insns; position++)
+		{
+			insn = &block->insns[position];
+			if(insn->opcode == JIT_OP_NOP)
+			{
+				continue;
+			}
+
+			is_load = (insn->opcode >= JIT_OP_LOAD_RELATIVE_SBYTE
+				   && insn->opcode <= JIT_OP_LOAD_RELATIVE_NFLOAT);
+			is_store = (insn->opcode >= JIT_OP_STORE_RELATIVE_BYTE
+				    && insn->opcode <= JIT_OP_STORE_RELATIVE_NFLOAT);
+			if((insn->flags & JIT_INSN_DEST_OTHER_FLAGS) == 0)
+			{
+				check_use(splits, insn, insn->dest, is_store);
+			}
+			if((insn->flags & JIT_INSN_VALUE1_OTHER_FLAGS) == 0)
+			{
+				check_use(splits, insn, insn->value1, is_load);
+			}
+			if((insn->flags & JIT_INSN_VALUE2_OTHER_FLAGS) == 0)
+			{
+				check_use(splits, insn, insn->value2, 0);
+			}
+
+			if(insn->opcode == JIT_OP_ADDRESS_OF
+			   && is_split_candidate(insn->value1))
+			{
+				split = get_split(splits, insn->value1);
+				if(!split)
+				{
+					/* The first time the address is taken */
+					split = &splits[num_splits];
+					split->local = insn->value1;
+					split->is_valid = 1;
+					split->is_scalar = (get_type_kind(insn->value1->type)
+							    != ALIAS_KIND_NONE);
+					split->num_refs = 1;
+					split->num_parts = 0;
+					insn->value1->index = num_splits++;
+				}
+				if(!insn->dest->is_temporary || insn->dest->index >= 0)
+				{
+					split->is_valid = 0;
+				}
+				else
+				{
+					insn->dest->index = split - splits;
+				}
+			}
+		}
+	}
+
+	/* A temporary holding the address may not be set to anything else,
+	   even before the address is taken */
+	for(block = func->builder->entry_block; block; block = block->next)
+	{
+		for(position = 0; position < block->num_insns; position++)
+		{
+			insn = &block->insns[position];
+			def = _jit_insn_get_def(insn);
+			if(def && insn->opcode != JIT_OP_ADDRESS_OF)
+			{
+				split = get_split(splits, def);
+				if(split && def != split->local)
+				{
+					split->is_valid = 0;
+				}
+			}
+		}
+	}
+
+	for(index = 0; index < num_splits; index++)
+	{
+		if(splits[index].num_refs != (int) splits[index].local->usage_count)
+		{
+			splits[index].is_valid = 0;
+		}
+	}
+	return num_splits;
+}
+
+/*
+ * Rewrite the loads and stores of the parts of the variables that are
+ * split.
+ */
+static void
+split_locals(jit_function_t func, _jit_alias_split_t *splits)
+{
+	jit_block_t block;
+	jit_insn_t insn;
+	_jit_alias_split_t *split;
+	jit_value_t part;
+	jit_nint offset;
+	int position, index, kind;
+
+	for(block = func->builder->entry_block; block; block = block->next)
+	{
+		for(position = 0; position < block->num_insns; position++)
+		{
+			insn = &block->insns[position];
+			if(insn->opcode == JIT_OP_NOP)
+			{
+				continue;
+			}
+			if(insn->opcode == JIT_OP_ADDRESS_OF)
+			{
+				split = get_split(splits, insn->value1);
+				if(split && split->is_valid)
+				{
+					insn->opcode = JIT_OP_NOP;
+				}
+				continue;
+			}
+
+			kind = get_kind(insn->opcode);
+			if(kind == ALIAS_KIND_NONE)
+			{
+				continue;
+			}
+			if(insn->opcode >= JIT_OP_LOAD_RELATIVE_SBYTE
+			   && insn->opcode <= JIT_OP_LOAD_RELATIVE_NFLOAT)
+			{
+				split = get_split(splits, insn->value1);
+			}
+			else
+			{
+				split = get_split(splits, insn->dest);
+			}
+			if(!split || !split->is_valid)
+			{
+				continue;
+			}
+
+			/* Find the variable that holds the part */
+			part = split->local;
+			if(!split->is_scalar)
+			{
+				offset = jit_value_get_nint_constant(insn->value2);
+				for(index = 0; split->parts[index].offset != offset; index++)
+				{
+				}
+				part = split->parts[index].value;
+				if(!part)
+				{
+					part = jit_value_create(func, get_kind_type(kind));
+					if(!part)
+					{
+						jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+					}
+					make_local(part);
+					split->parts[index].value = part;
+				}
+			}
+
+			if(insn->opcode >= JIT_OP_LOAD_RELATIVE_SBYTE
+			   && insn->opcode <= JIT_OP_LOAD_RELATIVE_NFLOAT)
+			{
+				set_load_value(func, insn, part);
+			}
+			else
+			{
+				insn->opcode = (short) get_kind_copy(kind);
+				insn->flags = 0;
+				insn->dest = part;
+				insn->value2 = 0;
+				part->usage_count++;
+			}
+		}
+	}
+}
+
+/*
+ * Clear the index fields of the values used by the instructions,
+ * including the instructions that were removed.
+ */
+static void
+clear_indexes(jit_function_t func)
+{
+	jit_block_t block;
+	jit_insn_t insn;
+	int position;
+
+	for(block = func->builder->entry_block; block; block = block->next)
+	{
+		for(position = 0; position < block->num_insns; position++)
+		{
+			insn = &block->insns[position];
+			if(insn->dest && (insn->flags & JIT_INSN_DEST_OTHER_FLAGS) == 0)
+			{
+				insn->dest->index = -1;
+			}
+			if(insn->value1 && (insn->flags & JIT_INSN_VALUE1_OTHER_FLAGS) == 0)
+			{
+				insn->value1->index = -1;
+			}
+			if(insn->value2 && (insn->flags & JIT_INSN_VALUE2_OTHER_FLAGS) == 0)
+			{
+				insn->value2->index = -1;
+			}
+		}
+	}
+}
+
+/*
+ * Replace the local variables that have their address taken only to
+ * access their parts with a scalar variable for every part, so the
+ * parts may live in registers.
+ */
+static void
+split_addressable_locals(jit_function_t func)
+{
+	jit_block_t block;
+	_jit_alias_split_t *splits;
+	int position, num_splits, index;
+
+	/* Count the candidates */
+	num_splits = 0;
+	for(block = func->builder->entry_block; block; block = block->next)
+	{
+		for(position = 0; position < block->num_insns; position++)
+		{
+			if(block->insns[position].opcode == JIT_OP_ADDRESS_OF)
+			{
+				++num_splits;
+			}
+		}
+	}
+	if(num_splits == 0)
+	{
+		return;
+	}
+
+	splits = (_jit_alias_split_t *) _jit_memory_arena_alloc(
+		&func->builder->cfg_arena, num_splits * sizeof(_jit_alias_split_t));
+	if(!splits)
+	{
+		jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+	}
+
+	clear_indexes(func);
+	num_splits = find_splits(func, splits);
+	split_locals(func, splits);
+
+	for(index = 0; index < num_splits; index++)
+	{
+		if(splits[index].is_valid)
+		{
+			/* The address is never taken now */
+			splits[index].local->is_addressable = 0;
+		}
+	}
+	clear_indexes(func);
+}
+
+/*
+ * Forget the positions left in the index field of the values.
+ */
+static void
+clear_positions(jit_function_t func)
+{
+	jit_block_t block;
+	jit_value_t def;
+	int position;
+
+	for(block = func->builder->entry_block; block; block = block->next)
+	{
+		for(position = 0; position < block->num_insns; position++)
+		{
+			def = _jit_insn_get_def(&block->insns[position]);
+			if(def && def->is_temporary)
+			{
+				def->index = -1;
+			}
+		}
+	}
+}
+
+void
+_jit_alias_optimize(jit_function_t func)
+{
+	jit_builder_t builder = func->builder;
+	_jit_alias_info_t info;
+	jit_block_t block;
+	int index, num_blocks;
+
+	/* The exception handling and the jumps to the blocks taken address
+	   of are not represented by the control flow graph edges */
+	if(func->has_try)
+	{
+		return;
+	}
+	for(block = builder->entry_block; block; block = block->next)
+	{
+		if(block->address_of)
+		{
+			return;
+		}
+	}
+
+	/* Keep the parts of the variables in registers if possible */
+	split_addressable_locals(func);
+
+	/* Order the blocks */
+	for(block = builder->entry_block; block; block = block->next)
+	{
+		block->visited = 0;
+		block->index = -1;
+	}
+	if(!_jit_block_compute_postorder(func))
+	{
+		jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+	}
+	for(block = builder->entry_block; block; block = block->next)
+	{
+		block->visited = 0;
+	}
+
+	num_blocks = builder->num_block_order;
+	info.func = func;
+	info.block_locs = (_jit_alias_loc_t **) _jit_memory_arena_alloc(
+		&builder->cfg_arena, num_blocks * sizeof(_jit_alias_loc_t *));
+	info.block_num_locs = (int *) _jit_memory_arena_alloc(
+		&builder->cfg_arena, num_blocks * sizeof(int));
+	if(!info.block_locs || !info.block_num_locs)
+	{
+		jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+	}
+
+	/* Replace the loads going through the blocks in the reverse
+	   postorder, so the predecessors come first */
+	for(index = num_blocks - 1; index >= 0; index--)
+	{
+		forward_block(&info, builder->block_order[index]);
+	}
+
+	/* Remove the stores going through the blocks in the postorder,
+	   so the successors come first */
+	for(index = 0; index < num_blocks; index++)
+	{
+		remove_dead_stores(&info, builder->block_order[index]);
+	}
+
+	clear_positions(func);
+}
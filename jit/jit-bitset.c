@@ -30,17 +30,19 @@ _jit_bitset_init(_jit_bitset_t *bs)
 	bs->bits = 0;
 }
 
+/*
+ * Allocate a bitset that can hold "size" bits.
+ */
 int
 _jit_bitset_allocate(_jit_bitset_t *bs, int size)
 {
-	bs->size = size;
-	if(size > 0)
+	bs->size = _JIT_BITSET_WORDS(size);
+	if(bs->size > 0)
 	{
-		size = (size + _JIT_BITSET_WORD_BITS - 1) / _JIT_BITSET_WORD_BITS;
-		bs->bits = jit_calloc(size, sizeof(_jit_bitset_word_t));
+		bs->bits = jit_calloc(bs->size, sizeof(_jit_bitset_word_t));
 		if(!bs->bits)
 		{
-			jit_free(bs);
+			bs->size = 0;
 			return 0;
 		}
 	}
@@ -51,8 +53,20 @@ _jit_bitset_allocate(_jit_bitset_t *bs, int size)
 	return 1;
 }
 
+/*
+ * Make a bitset of "size" bits use the memory provided by the caller.
+ * The memory must be big enough and is not freed by _jit_bitset_free.
+ */
+void
+_jit_bitset_attach(_jit_bitset_t *bs, _jit_bitset_word_t *bits, int size)
+{
+	bs->size = _JIT_BITSET_WORDS(size);
+	bs->bits = bits;
+	_jit_bitset_clear(bs);
+}
+
 int
- _jit_bitset_is_allocated(_jit_bitset_t *bs)
+_jit_bitset_is_allocated(_jit_bitset_t *bs)
 {
 	return (bs->bits != 0);
 }
@@ -74,7 +88,7 @@ _jit_bitset_set_bit(_jit_bitset_t *bs, int bit)
 	int word;
 	word = bit / _JIT_BITSET_WORD_BITS;
 	bit = bit % _JIT_BITSET_WORD_BITS;
-	bs->bits[word] |= bit;
+	bs->bits[word] |= ((_jit_bitset_word_t) 1) << bit;
 }
 
 void
@@ -83,7 +97,7 @@ _jit_bitset_clear_bit(_jit_bitset_t *bs, int bit)
 	int word;
 	word = bit / _JIT_BITSET_WORD_BITS;
 	bit = bit % _JIT_BITSET_WORD_BITS;
-	bs->bits[word] &= ~bit;
+	bs->bits[word] &= ~(((_jit_bitset_word_t) 1) << bit);
 }
 
 int
@@ -92,7 +106,7 @@ _jit_bitset_test_bit(_jit_bitset_t *bs, int bit)
 	int word;
 	word = bit / _JIT_BITSET_WORD_BITS;
 	bit = bit % _JIT_BITSET_WORD_BITS;
-	return (bs->bits[word] & bit) != 0;
+	return (bs->bits[word] & (((_jit_bitset_word_t) 1) << bit)) != 0;
 }
 
 void
@@ -108,65 +122,93 @@ _jit_bitset_clear(_jit_bitset_t *bs)
 int
 _jit_bitset_empty(_jit_bitset_t *bs)
 {
+	_jit_bitset_word_t acc;
 	int i;
+
+	acc = 0;
 	for(i = 0; i < bs->size; i++)
 	{
-		if(bs->bits[i])
-		{
-			return 0;
-		}
+		acc |= bs->bits[i];
 	}
-	return 1;
+	return acc == 0;
 }
 
 void
 _jit_bitset_add(_jit_bitset_t *dest, _jit_bitset_t *src)
 {
+	_jit_bitset_word_t *d = dest->bits;
+	_jit_bitset_word_t *s = src->bits;
 	int i;
 	for(i = 0; i < dest->size; i++)
 	{
-		dest->bits[i] |= src->bits[i];
+		d[i] |= s[i];
 	}
 }
 
 void
 _jit_bitset_sub(_jit_bitset_t *dest, _jit_bitset_t *src)
 {
+	_jit_bitset_word_t *d = dest->bits;
+	_jit_bitset_word_t *s = src->bits;
 	int i;
 	for(i = 0; i < dest->size; i++)
 	{
-		dest->bits[i] &= ~src->bits[i];
+		d[i] &= ~s[i];
 	}
 }
 
 int
 _jit_bitset_copy(_jit_bitset_t *dest, _jit_bitset_t *src)
 {
+	_jit_bitset_word_t *d = dest->bits;
+	_jit_bitset_word_t *s = src->bits;
+	_jit_bitset_word_t diff;
 	int i;
-	int changed;
 
-	changed = 0;
+	diff = 0;
 	for(i = 0; i < dest->size; i++)
 	{
-		if(dest->bits[i] != src->bits[i])
-		{
-			dest->bits[i] = src->bits[i];
-			changed = 1;
-		}
+		diff |= d[i] ^ s[i];
+		d[i] = s[i];
 	}
-	return changed;
+	return diff != 0;
 }
 
 int
 _jit_bitset_equal(_jit_bitset_t *bs1, _jit_bitset_t *bs2)
 {
+	_jit_bitset_word_t diff;
 	int i;
+
+	diff = 0;
 	for(i = 0; i < bs1->size; i++)
 	{
-		if(bs1->bits[i] != bs2->bits[i])
-		{
-			return 0;
-		}
+		diff |= bs1->bits[i] ^ bs2->bits[i];
 	}
-	return 1;
+	return diff == 0;
+}
+
+/*
+ * Compute the dataflow transfer function "dest = gen | (src & ~kill)".
+ * Returns non-zero if the destination set has changed.
+ */
+int
+_jit_bitset_transfer(_jit_bitset_t *dest, _jit_bitset_t *gen,
+		     _jit_bitset_t *src, _jit_bitset_t *kill)
+{
+	_jit_bitset_word_t *d = dest->bits;
+	_jit_bitset_word_t *g = gen->bits;
+	_jit_bitset_word_t *s = src->bits;
+	_jit_bitset_word_t *k = kill->bits;
+	_jit_bitset_word_t word, diff;
+	int i;
+
+	diff = 0;
+	for(i = 0; i < dest->size; i++)
+	{
+		word = g[i] | (s[i] & ~k[i]);
+		diff |= d[i] ^ word;
+		d[i] = word;
+	}
+	return diff != 0;
 }
@@ -25,10 +25,21 @@
 
 #define _JIT_BITSET_WORD_BITS (8 * sizeof(_jit_bitset_word_t))
 
+/*
+ * Number of words required for a bitset of the given size.
+ */
+#define _JIT_BITSET_WORDS(size) \
+	(((size) + _JIT_BITSET_WORD_BITS - 1) / _JIT_BITSET_WORD_BITS)
+
 typedef unsigned long _jit_bitset_word_t;
 typedef struct _jit_bitset _jit_bitset_t;
 
-/* TODO: Use less space. Perhaps borrow bitmap from gcc. */
+/*
+ * Dense bitset.  The size is measured in words.  Bitsets are kept small
+ * by numbering only the values that actually need a bit, e.g. the local
+ * variables that live across basic blocks.  The set operations work on
+ * whole words in simple loops that the C compiler is able to vectorize.
+ */
 struct _jit_bitset
 {
 	int size;
@@ -37,6 +48,7 @@ struct _jit_bitset
 
 void _jit_bitset_init(_jit_bitset_t *bs);
 int _jit_bitset_allocate(_jit_bitset_t *bs, int size);
+void _jit_bitset_attach(_jit_bitset_t *bs, _jit_bitset_word_t *bits, int size);
 int _jit_bitset_is_allocated(_jit_bitset_t *bs);
 void _jit_bitset_free(_jit_bitset_t *bs);
 void _jit_bitset_set_bit(_jit_bitset_t *bs, int bit);
@@ -48,5 +60,7 @@ void _jit_bitset_add(_jit_bitset_t *dest, _jit_bitset_t *src);
 void _jit_bitset_sub(_jit_bitset_t *dest, _jit_bitset_t *src);
 int _jit_bitset_copy(_jit_bitset_t *dest, _jit_bitset_t *src);
 int _jit_bitset_equal(_jit_bitset_t *bs1, _jit_bitset_t *bs2);
+int _jit_bitset_transfer(_jit_bitset_t *dest, _jit_bitset_t *gen,
+			 _jit_bitset_t *src, _jit_bitset_t *kill);
 
 #endif
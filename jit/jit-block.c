@@ -170,6 +170,14 @@ build_edges(jit_function_t func, int create)
 	}
 }
 
+/* Allocate an array of edge pointers */
+static _jit_edge_t *
+alloc_edge_array(jit_function_t func, int count)
+{
+	return (_jit_edge_t *) _jit_memory_arena_alloc(&func->builder->cfg_arena,
+						       count * sizeof(_jit_edge_t));
+}
+
 static void
 alloc_edges(jit_function_t func)
 {
@@ -178,13 +186,14 @@ alloc_edges(jit_function_t func)
 	for(block = func->builder->entry_block; block; block = block->next)
 	{
 		/* Allocate edges to successor nodes */
+		block->max_succs = block->num_succs;
 		if(block->num_succs == 0)
 		{
 			block->succs = 0;
 		}
 		else
 		{
-			block->succs = jit_calloc(block->num_succs, sizeof(_jit_edge_t));
+			block->succs = alloc_edge_array(func, block->num_succs);
 			if(!block->succs)
 			{
 				jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
@@ -194,13 +203,14 @@ alloc_edges(jit_function_t func)
 		}
 
 		/* Allocate edges to predecessor nodes */
+		block->max_preds = block->num_preds;
 		if(block->num_preds == 0)
 		{
 			block->preds = 0;
 		}
 		else
 		{
-			block->preds = jit_calloc(block->num_preds, sizeof(_jit_edge_t));
+			block->preds = alloc_edge_array(func, block->num_preds);
 			if(!block->preds)
 			{
 				jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
@@ -226,7 +236,6 @@ detach_edge_src(_jit_edge_t edge)
 			{
 				block->succs[index] = block->succs[index + 1];
 			}
-			block->succs = jit_realloc(block->succs, block->num_succs * sizeof(_jit_edge_t));
 			return;
 		}
 	}
@@ -247,26 +256,47 @@ detach_edge_dst(_jit_edge_t edge)
 			{
 				block->preds[index] = block->preds[index + 1];
 			}
-			block->preds = jit_realloc(block->preds,
-						   block->num_preds * sizeof(_jit_edge_t));
 			return;
 		}
 	}
 }
 
-static void
-attach_edge_dst(_jit_edge_t edge, jit_block_t block)
+/* Make room for one more edge in an array of edge pointers */
+static _jit_edge_t *
+grow_edge_array(jit_function_t func, _jit_edge_t *edges, int num_edges,
+		int *max_edges)
 {
-	_jit_edge_t *preds;
+	_jit_edge_t *new_edges;
+	int new_max;
+
+	if(num_edges < *max_edges)
+	{
+		return edges;
+	}
 
-	preds = jit_realloc(block->preds, (block->num_preds + 1) * sizeof(_jit_edge_t));
-	if(!preds)
+	/* The edge arrays are allocated from the arena and are never
+	   reallocated in place, so copy them to a twice larger array to
+	   keep the cost of the repeated growth linear */
+	new_max = *max_edges < 2 ? 4 : *max_edges * 2;
+	new_edges = alloc_edge_array(func, new_max);
+	if(!new_edges)
 	{
 		jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
 	}
+	if(num_edges > 0)
+	{
+		jit_memcpy(new_edges, edges, num_edges * sizeof(_jit_edge_t));
+	}
+	*max_edges = new_max;
+	return new_edges;
+}
 
-	preds[block->num_preds++] = edge;
-	block->preds = preds;
+static void
+attach_edge_dst(_jit_edge_t edge, jit_block_t block)
+{
+	block->preds = grow_edge_array(block->func, block->preds, block->num_preds,
+				       &block->max_preds);
+	block->preds[block->num_preds++] = edge;
 	edge->dst = block;
 }
 
@@ -285,10 +315,10 @@ delete_edge(jit_function_t func, _jit_edge_t edge)
 static void
 delete_block(jit_block_t block)
 {
-	jit_free(block->succs);
 	block->succs = 0;
-	jit_free(block->preds);
+	block->max_succs = 0;
 	block->preds = 0;
+	block->max_preds = 0;
 	jit_free(block->insns);
 	block->insns = 0;
 
@@ -428,7 +458,6 @@ merge_empty(jit_function_t func, jit_block_t block, int *changed)
 		if(block->num_preds > 1)
 		{
 			block->num_preds = 1;
-			block->preds = jit_realloc(block->preds, sizeof(_jit_edge_t));
 			block->preds[0] = fallthru_edge;
 		}
 	}
@@ -437,7 +466,7 @@ merge_empty(jit_function_t func, jit_block_t block, int *changed)
 		if(block->num_preds > 0)
 		{
 			block->num_preds = 0;
-			jit_free(block->preds);
+			block->max_preds = 0;
 			block->preds = 0;
 		}
 	}
@@ -528,6 +557,121 @@ combine_block(jit_function_t func, jit_block_t block, int *changed)
 	merge_empty(func, block, changed);
 }
 
+/* Check if the block may be combined with its successor */
+static int
+is_combinable_block(jit_block_t block)
+{
+	return (block->num_succs == 1
+		&& (block->succs[0]->flags == _JIT_EDGE_BRANCH
+		    || block->succs[0]->flags == _JIT_EDGE_FALLTHRU)
+		&& block->succs[0]->dst->num_preds == 1
+		&& block->succs[0]->dst->address_of == 0
+		&& !is_empty_block(block));
+}
+
+/* Combine a straight-line chain of blocks that starts with the given block
+   into the last block of the chain.  This is equivalent to applying
+   combine_block() to each block of the chain, but the instructions and
+   the labels are moved only once, so the cost is linear in the length
+   of the chain rather than quadratic. */
+static void
+combine_chain(jit_function_t func, jit_block_t head, int *changed)
+{
+	jit_block_t block, prev, tail;
+	jit_insn_t insns;
+	int num_insns, branch;
+
+	/* Find the last block of the chain and the combined size */
+	num_insns = 0;
+	block = head;
+	do
+	{
+		block->visited = 1;
+		num_insns += block->num_insns;
+		block = block->succs[0]->dst;
+	}
+	while(block != head && !block->visited && is_combinable_block(block));
+	tail = block;
+	if(tail->visited)
+	{
+		/* An unreachable cycle, leave it alone */
+		return;
+	}
+	num_insns += tail->num_insns;
+
+	insns = (jit_insn_t) jit_malloc(num_insns * sizeof(struct _jit_insn));
+	if(!insns)
+	{
+		jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+	}
+
+	/* Copy the instructions of the chain to the combined array leaving
+	   in each block but the last only its trailing branch if any, just
+	   like combine_block() does */
+	num_insns = 0;
+	for(block = head; block != tail; block = block->succs[0]->dst)
+	{
+		jit_memcpy(insns + num_insns, block->insns,
+			   block->num_insns * sizeof(struct _jit_insn));
+		num_insns += block->num_insns;
+
+		branch = (block->succs[0]->flags == _JIT_EDGE_BRANCH);
+		if(branch)
+		{
+			block->insns[0] = block->insns[block->num_insns - 1];
+			insns[num_insns - 1].opcode = JIT_OP_NOP;
+		}
+		block->num_insns = branch;
+	}
+	if(tail->num_insns)
+	{
+		jit_memcpy(insns + num_insns, tail->insns,
+			   tail->num_insns * sizeof(struct _jit_insn));
+		num_insns += tail->num_insns;
+	}
+	jit_free(tail->insns);
+	tail->insns = insns;
+	tail->max_insns = num_insns;
+	tail->num_insns = num_insns;
+
+	/* Merge the emptied blocks starting from the end of the chain, so that
+	   the labels and the incoming edges of each one go directly to the
+	   last block */
+	block = tail->preds[0]->src;
+	for(;;)
+	{
+		prev = (block == head) ? 0 : block->preds[0]->src;
+		merge_empty(func, block, changed);
+		if(!prev)
+		{
+			break;
+		}
+		block = prev;
+	}
+}
+
+/* Combine straight-line chains of blocks.  Done in the main loop of
+   _jit_block_clean_cfg() the blocks of a long chain would be combined
+   one by one in postorder copying the tail of the chain again on each
+   step. */
+static int
+combine_chains(jit_function_t func)
+{
+	int index, changed;
+	jit_block_t block;
+
+	changed = 0;
+	for(index = func->builder->num_block_order - 2; index > 0; index--)
+	{
+		block = func->builder->block_order[index];
+		if(!block->visited && is_combinable_block(block))
+		{
+			combine_chain(func, block, &changed);
+		}
+	}
+	return changed;
+}
+
 /* Allow branch optimization by splitting the label that is both a branch target
    and an address-of opcode source into two separate labels with single role.
    TODO: handle jump tables. */
@@ -689,20 +833,12 @@ count_blocks(jit_function_t func)
 	count = 0;
 	for(block = func->builder->entry_block; block; block = block->next)
 	{
+		block->index = -1;
 		++count;
 	}
 	return count;
 }
 
-/* Release block order memory */
-static void
-free_order(jit_function_t func)
-{
-	jit_free(func->builder->block_order);
-	func->builder->block_order = NULL;
-	func->builder->num_block_order = 0;
-}
-
 int
 _jit_block_init(jit_function_t func)
 {
@@ -728,8 +864,6 @@ _jit_block_free(jit_function_t func)
 {
 	jit_block_t block, next;
 
-	free_order(func);
-
 	block = func->builder->entry_block;
 	while(block)
 	{
@@ -780,6 +914,8 @@ _jit_invert_condition (int opcode)
 	case JIT_OP_BR_IGT_UN:	opcode = JIT_OP_BR_ILE_UN;   break;
 	case JIT_OP_BR_IGE:	opcode = JIT_OP_BR_ILT;      break;
 	case JIT_OP_BR_IGE_UN:	opcode = JIT_OP_BR_ILT_UN;   break;
+	case JIT_OP_BR_LFALSE:	opcode = JIT_OP_BR_LTRUE;   break;
+	case JIT_OP_BR_LTRUE:	opcode = JIT_OP_BR_LFALSE;   break;
 	case JIT_OP_BR_LEQ:	opcode = JIT_OP_BR_LNE;      break;
 	case JIT_OP_BR_LNE:	opcode = JIT_OP_BR_LEQ;      break;
 	case JIT_OP_BR_LLT:	opcode = JIT_OP_BR_LGE;      break;
@@ -851,6 +987,17 @@ _jit_block_clean_cfg(jit_function_t func)
 	set_address_of(func);
 	eliminate_unreachable(func);
 
+	changed = combine_chains(func);
+	clear_visited(func);
+	if(changed)
+	{
+		if(!_jit_block_compute_postorder(func))
+		{
+			jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+		}
+		clear_visited(func);
+	}
+
  loop:
 	changed = 0;
 
@@ -976,8 +1123,7 @@ _jit_block_clean_cfg(jit_function_t func)
 #endif
 				merge_empty(func, block, &changed);
 			}
-			else if(block->succs[0]->dst->num_preds == 1
-				&& block->succs[0]->dst->address_of == 0)
+			else if(is_combinable_block(block))
 			{
 				/* Combine with the successor block if it has
 				   only one predecessor */
@@ -1005,6 +1151,267 @@ _jit_block_clean_cfg(jit_function_t func)
 	}
 }
 
+/* Get the label of the block creating a new one if necessary */
+static jit_label_t
+get_block_label(jit_function_t func, jit_block_t block)
+{
+	jit_label_t label;
+
+	/* Skip the labels used for taking address, these are not allowed
+	   to be branch targets, see split_address_of() */
+	for(label = block->label;
+	    label != jit_label_undefined;
+	    label = func->builder->label_info[label].alias)
+	{
+		if((func->builder->label_info[label].flags & JIT_LABEL_ADDRESS_OF) == 0)
+		{
+			return label;
+		}
+	}
+
+	label = func->builder->next_label++;
+	if(!_jit_block_record_label(block, label))
+	{
+		jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+	}
+	return label;
+}
+
+/* Turn the fallthrough at the end of the block into an explicit branch */
+static void
+append_branch(jit_function_t func, jit_block_t block)
+{
+	jit_label_t label;
+	jit_insn_t insn;
+
+	label = get_block_label(func, block->succs[0]->dst);
+	insn = _jit_block_add_insn(block);
+	if(!insn)
+	{
+		jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+	}
+	insn->opcode = (short) JIT_OP_BR;
+	insn->flags = JIT_INSN_DEST_IS_LABEL;
+	insn->dest = (jit_value_t) label;
+	block->ends_in_dead = 1;
+	block->succs[0]->flags = _JIT_EDGE_BRANCH;
+}
+
+/* Check if the block ends with a fallthrough that could be turned into
+   an explicit branch */
+static int
+is_plain_fallthru(jit_block_t block)
+{
+	return (block->num_succs == 1
+		&& block->succs[0]->flags == _JIT_EDGE_FALLTHRU);
+}
+
+/* Check if the block ends with a conditional branch to the block "dst"
+   that falls through otherwise */
+static int
+is_cond_branch_to(jit_block_t block, jit_block_t dst)
+{
+	jit_insn_t insn;
+
+	if(block->num_succs != 2
+	   || block->succs[0]->flags != _JIT_EDGE_BRANCH
+	   || block->succs[0]->dst != dst
+	   || block->succs[1]->flags != _JIT_EDGE_FALLTHRU)
+	{
+		return 0;
+	}
+	insn = _jit_block_get_last(block);
+	return (insn->opcode > JIT_OP_BR && insn->opcode <= JIT_OP_BR_NFGE_INV);
+}
+
+/* Find the blocks that are unlikely to be executed */
+static void
+mark_cold_blocks(jit_function_t func)
+{
+	jit_block_t block;
+	int index, edge, cold;
+
+	/* Blocks that only throw or call a function that does not return
+	   are cold, and so are the blocks that unconditionally lead to cold
+	   blocks.  Visit the blocks in postorder to see the successors
+	   before their predecessors. */
+	for(index = 0; index < func->builder->num_block_order; index++)
+	{
+		block = func->builder->block_order[index];
+		if(block == func->builder->entry_block
+		   || block == func->builder->exit_block
+		   || block->is_cold)
+		{
+			continue;
+		}
+
+		cold = 1;
+		for(edge = 0; edge < block->num_succs; edge++)
+		{
+			if(block->succs[edge]->flags != _JIT_EDGE_EXCEPT
+			   && !block->succs[edge]->dst->is_cold)
+			{
+				cold = 0;
+				break;
+			}
+		}
+		block->is_cold = cold;
+	}
+
+	/* The blocks that can only be reached from cold blocks are cold */
+	for(index = func->builder->num_block_order - 1; index >= 0; index--)
+	{
+		block = func->builder->block_order[index];
+		if(block == func->builder->entry_block
+		   || block == func->builder->exit_block
+		   || block->is_cold
+		   || block->address_of
+		   || block->num_preds == 0)
+		{
+			continue;
+		}
+
+		cold = 1;
+		for(edge = 0; edge < block->num_preds; edge++)
+		{
+			if(!block->preds[edge]->src->is_cold)
+			{
+				cold = 0;
+				break;
+			}
+		}
+		block->is_cold = cold;
+	}
+}
+
+void
+_jit_block_layout(jit_function_t func)
+{
+	jit_block_t block, first, last, next, prev;
+	jit_block_t cold_first, cold_last;
+	_jit_edge_t edge;
+	jit_insn_t insn;
+
+	/* The code that follows a "call_finally" instruction must stay where
+	   it is because the "finally" clause returns there */
+	if(func->has_try)
+	{
+		return;
+	}
+
+	if(!_jit_block_compute_postorder(func))
+	{
+		jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+	}
+	clear_visited(func);
+	mark_cold_blocks(func);
+
+	/* The cold blocks are moved right before the exit block, so the block
+	   that precedes it must not fall through to the exit block */
+	block = func->builder->exit_block->prev;
+	if(!block->ends_in_dead)
+	{
+		if(!is_plain_fallthru(block))
+		{
+			return;
+		}
+		append_branch(func, block);
+	}
+
+	/* Find the runs of consecutive cold blocks and move them out */
+	cold_first = 0;
+	cold_last = 0;
+	block = func->builder->entry_block->next;
+	while(block != func->builder->exit_block)
+	{
+		if(!block->is_cold)
+		{
+			block = block->next;
+			continue;
+		}
+
+		first = block;
+		last = block;
+		while(last->next->is_cold && last->next != func->builder->exit_block)
+		{
+			last = last->next;
+		}
+		next = last->next;
+		prev = first->prev;
+		block = next;
+
+		/* The run is at the end already */
+		if(next == func->builder->exit_block)
+		{
+			break;
+		}
+
+		/* Check the control flow in and out of the run */
+		if(!last->ends_in_dead && !is_plain_fallthru(last))
+		{
+			continue;
+		}
+		if(!prev->ends_in_dead && !is_cond_branch_to(prev, next))
+		{
+			continue;
+		}
+
+		/* Branch from the end of the run to the block that was next */
+		if(!last->ends_in_dead)
+		{
+			append_branch(func, last);
+		}
+
+		/* Invert the branch that used to jump over the run so that it
+		   now jumps to the run and falls through to the next block */
+		if(!prev->ends_in_dead)
+		{
+			insn = _jit_block_get_last(prev);
+			insn->opcode = _jit_invert_condition(insn->opcode);
+			insn->dest = (jit_value_t) get_block_label(func, first);
+			edge = prev->succs[0];
+			prev->succs[0] = prev->succs[1];
+			prev->succs[1] = edge;
+			prev->succs[0]->flags = _JIT_EDGE_BRANCH;
+			prev->succs[1]->flags = _JIT_EDGE_FALLTHRU;
+		}
+
+		_jit_block_detach(first, last);
+		if(cold_last)
+		{
+			cold_last->next = first;
+			first->prev = cold_last;
+		}
+		else
+		{
+			cold_first = first;
+		}
+		cold_last = last;
+	}
+
+	if(cold_first)
+	{
+		_jit_block_attach_before(func->builder->exit_block, cold_first, cold_last);
+	}
+
+	/* Remove the branches to the next block that may have appeared */
+	for(block = func->builder->entry_block; block; block = block->next)
+	{
+		if(block->num_succs == 1
+		   && block->succs[0]->flags == _JIT_EDGE_BRANCH
+		   && block->succs[0]->dst == block->next)
+		{
+			insn = _jit_block_get_last(block);
+			if(insn && insn->opcode == JIT_OP_BR)
+			{
+				insn->opcode = JIT_OP_NOP;
+				block->ends_in_dead = 0;
+				block->succs[0]->flags = _JIT_EDGE_FALLTHRU;
+			}
+		}
+	}
+}
+
 int
 _jit_block_compute_postorder(jit_function_t func)
 {
@@ -1012,24 +1419,34 @@ _jit_block_compute_postorder(jit_function_t func)
 	jit_block_t *blocks, block, succ;
 	_jit_block_stack_entry_t *stack;
 
-	if(func->builder->block_order)
-	{
-		free_order(func);
-	}
-
 	num_blocks = count_blocks(func);
 
-	blocks = (jit_block_t *) jit_malloc(num_blocks * sizeof(jit_block_t));
-	if(!blocks)
+	/* Reuse the order and stack arrays from the previous run unless
+	   there are more blocks now.  The arrays live in the CFG arena
+	   and are released together with the builder. */
+	if(num_blocks > func->builder->max_block_order)
 	{
-		return 0;
+		blocks = (jit_block_t *) _jit_memory_arena_alloc(
+			&func->builder->cfg_arena, num_blocks * sizeof(jit_block_t));
+		if(!blocks)
+		{
+			return 0;
+		}
+		stack = (_jit_block_stack_entry_t *) _jit_memory_arena_alloc(
+			&func->builder->cfg_arena,
+			num_blocks * sizeof(_jit_block_stack_entry_t));
+		if(!stack)
+		{
+			return 0;
+		}
+		func->builder->block_order = blocks;
+		func->builder->block_stack = stack;
+		func->builder->max_block_order = num_blocks;
 	}
-
-	stack = (_jit_block_stack_entry_t *) jit_malloc(num_blocks * sizeof(_jit_block_stack_entry_t));
-	if(!stack)
+	else
 	{
-		jit_free(blocks);
-		return 0;
+		blocks = func->builder->block_order;
+		stack = (_jit_block_stack_entry_t *) func->builder->block_stack;
 	}
 
 	func->builder->entry_block->visited = 1;
@@ -1044,6 +1461,7 @@ _jit_block_compute_postorder(jit_function_t func)
 
 		if(index == block->num_succs)
 		{
+			block->index = num;
 			blocks[num++] = block;
 			--top;
 		}
@@ -1065,13 +1483,6 @@ _jit_block_compute_postorder(jit_function_t func)
 	}
 	while(top);
 
-	jit_free(stack);
-	if(num < num_blocks)
-	{
-		blocks = jit_realloc(blocks, num * sizeof(jit_block_t));
-	}
-
-	func->builder->block_order = blocks;
 	func->builder->num_block_order = num;
 	return 1;
 }
@@ -1091,6 +1502,7 @@ _jit_block_create(jit_function_t func)
 	/* Initialize the block */
 	block->func = func;
 	block->label = jit_label_undefined;
+	block->index = -1;
 
 	return block;
 }
@@ -1102,11 +1514,9 @@ _jit_block_destroy(jit_block_t block)
 	   because each edge is shared between two blocks so the ownership
 	   of the edge is ambiguous. Sometimes an edge may be redirected to
 	   another block rather than freed. Therefore edges are freed (or
-	   not freed) separately. However succs and preds arrays are freed,
-	   these contain pointers to edges, not edges themselves. */
+	   not freed) separately. The succs and preds arrays belong to the
+	   builder's CFG arena and are released along with it. */
 	jit_meta_destroy(&block->meta);
-	jit_free(block->succs);
-	jit_free(block->preds);
 	jit_free(block->insns);
 	jit_free(block);
 }
@@ -1481,6 +1891,40 @@ jit_block_is_reachable(jit_block_t block)
 	return 1;
 }
 
+/*@
+ * @deftypefun void jit_block_set_cold (jit_block_t @var{block}, int @var{flag})
+ * Mark @var{block} as unlikely to be executed if @var{flag} is non-zero.
+ * When a function is optimized, the cold blocks are moved out of the way
+ * of the hot code to the end of the function, so that the hot code is
+ * laid out densely and falls through from block to block where possible.
+ * The blocks that only throw exceptions or call functions marked with
+ * @code{JIT_CALL_NORETURN} are considered cold automatically.
+ *
+ * A likely or unlikely branch can be indicated by marking the block
+ * at the branch target or the fallthrough block, which can be found
+ * with @code{jit_block_from_label} and @code{jit_function_get_current}.
+ * @end deftypefun
+@*/
+void
+jit_block_set_cold(jit_block_t block, int flag)
+{
+	if(block)
+	{
+		block->is_cold = (flag != 0);
+	}
+}
+
+/*@
+ * @deftypefun int jit_block_is_cold (jit_block_t @var{block})
+ * Determine if @var{block} is marked as unlikely to be executed.
+ * @end deftypefun
+@*/
+int
+jit_block_is_cold(jit_block_t block)
+{
+	return block ? block->is_cold : 0;
+}
+
 /*@
  * @deftypefun int jit_block_ends_in_dead (jit_block_t @var{block})
  * Determine if a block ends in a "dead" marker.  That is, control
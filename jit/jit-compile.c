@@ -25,6 +25,16 @@
 #include "jit-rules.h"
 #include "jit-reg-alloc.h"
 #include "jit-setjmp.h"
+#if TIME_WITH_SYS_TIME
+# include <sys/time.h>
+# include <time.h>
+#else
+# if HAVE_SYS_TIME_H
+#  include <sys/time.h>
+# else
+#  include <time.h>
+# endif
+#endif
 #ifdef _JIT_COMPILE_DEBUG
 # include <jit/jit-dump.h>
 # include <stdio.h>
@@ -42,11 +52,24 @@ typedef struct
 
 	int			restart;
 	int			page_factor;
+	jit_nuint		code_size;
+
+	jit_nuint		num_insns;
+	jit_ulong		start_time;
+	jit_ulong		budget;
+	int			all_passes;
 
 	struct jit_gencode	gen;
 
 } _jit_compile_t;
 
+/*
+ * A lower estimate of the average code size per instruction.  It is used
+ * to reserve enough code space for huge functions up front instead of
+ * restarting the code generation over and over while doubling the space.
+ */
+#define JIT_CODE_SIZE_PER_INSN		4
+
 #define _JIT_RESULT_TO_OBJECT(x)	((void *) ((jit_nint) (x) - JIT_RESULT_OK))
 #define _JIT_RESULT_FROM_OBJECT(x)	((jit_nint) ((void *) (x)) + JIT_RESULT_OK)
 
@@ -59,13 +82,128 @@ internal_exception_handler(int exception_type)
 	return _JIT_RESULT_TO_OBJECT(exception_type);
 }
 
+/*
+ * Get the current time in microseconds.
+ */
+static jit_ulong
+get_time(void)
+{
+#ifdef HAVE_GETTIMEOFDAY
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return (jit_ulong) tv.tv_sec * 1000000 + tv.tv_usec;
+#else
+	return 0;
+#endif
+}
+
+/*
+ * Turn off the optional compilation passes.
+ */
+static void
+skip_passes(_jit_compile_t *state)
+{
+	jit_builder_t builder = state->func->builder;
+
+	builder->no_cfg_optimization = 1;
+	builder->no_propagation = 1;
+	builder->no_global_liveness = 1;
+	builder->no_global_registers = 1;
+	state->all_passes = 0;
+}
+
+/*
+ * Check if the compilation time budget is over.
+ */
+static int
+budget_exceeded(_jit_compile_t *state)
+{
+	return state->budget && (get_time() - state->start_time) > state->budget;
+}
+
+/*
+ * Choose the compilation passes according to the function size and the
+ * time budget.
+ */
+static void
+choose_passes(_jit_compile_t *state)
+{
+	jit_function_t func = state->func;
+	jit_context_t context = func->context;
+	jit_block_t block;
+	jit_nuint size_limit;
+	jit_ulong time, insns;
+
+	state->start_time = get_time();
+	state->all_passes = (func->optimization_level != JIT_OPTLEVEL_NONE);
+
+	state->num_insns = 0;
+	for(block = func->builder->entry_block; block; block = block->next)
+	{
+		state->num_insns += block->num_insns;
+	}
+
+	/* Skip the expensive passes for functions that are too large */
+	size_limit = jit_context_get_meta_numeric(context, JIT_OPTION_OPTIMIZE_SIZE_LIMIT);
+	if(size_limit && state->num_insns > size_limit)
+	{
+		skip_passes(state);
+		return;
+	}
+
+	state->budget = func->compile_budget;
+	if(!state->budget)
+	{
+		state->budget = jit_context_get_meta_numeric(context, JIT_OPTION_COMPILE_BUDGET);
+	}
+	if(!state->budget)
+	{
+		return;
+	}
+
+	/* Predict the compilation time from the previously compiled functions
+	   and skip the expensive passes if it is likely to exceed the budget */
+	_jit_memory_lock(context);
+	time = context->compile_time;
+	insns = context->compile_insns;
+	_jit_memory_unlock(context);
+	if(insns && (double) time * state->num_insns / insns > (double) state->budget)
+	{
+		skip_passes(state);
+	}
+}
+
+/*
+ * Record the time taken to compile the function with all the passes
+ * to predict the compilation time of the next functions, and update
+ * the code generation statistics.
+ */
+static void
+record_stats(_jit_compile_t *state)
+{
+	jit_context_t context = state->func->context;
+
+	if(state->all_passes && state->num_insns)
+	{
+		context->compile_time += get_time() - state->start_time;
+		context->compile_insns += state->num_insns;
+	}
+
+	++(context->num_functions);
+	context->code_bytes += state->gen.code_end - state->gen.code_start;
+	context->peephole_insns += state->gen.peephole_insns;
+	context->peephole_bytes += state->gen.peephole_bytes;
+}
+
 /*
  * Optimize a function.
  */
 static void
 optimize(jit_function_t func)
 {
-	if(func->is_optimized || func->optimization_level == JIT_OPTLEVEL_NONE)
+	if(func->is_optimized
+	   || func->optimization_level == JIT_OPTLEVEL_NONE
+	   || func->builder->no_cfg_optimization)
 	{
 		/* The function is already optimized or does not need optimization */
 		return;
@@ -77,6 +215,19 @@ optimize(jit_function_t func)
 	/* Eliminate useless control flow */
 	_jit_block_clean_cfg(func);
 
+	/* Split the locals accessed by fields, forward stored values to
+	   loads and remove dead stores */
+	_jit_alias_optimize(func);
+
+	/* Move loop invariants out of loops and reduce induction variables */
+	_jit_loop_optimize(func);
+
+	/* Fold address computations into loads and stores */
+	_jit_select_addresses(func);
+
+	/* Move cold blocks out of the way */
+	_jit_block_layout(func);
+
 	/* Optimization is done */
 	func->is_optimized = 1;
 }
@@ -438,7 +589,7 @@ memory_align(_jit_compile_t *state, int align, int diff, int nop)
 	/* Determine the location of the next alignment boundary */
 	p = (jit_nuint) state->gen.ptr;
 	n = (p + (jit_nuint) align - 1) & ~((jit_nuint) align - 1);
-	if(p == n || (p - n) >= (jit_nuint) diff)
+	if(p == n || (n - p) >= (jit_nuint) diff)
 	{
 		return;
 	}
@@ -454,8 +605,8 @@ memory_align(_jit_compile_t *state, int align, int diff, int nop)
 	_jit_pad_buffer(state->gen.ptr, align);
 #else
 	jit_memset(state->gen.ptr, nop, align);
-	state->gen.ptr += align;
 #endif
+	state->gen.ptr += align;
 }
 
 /*
@@ -489,6 +640,21 @@ memory_alloc(_jit_compile_t *state)
 
 	/* Try to allocate within the current memory limit */
 	result = _jit_memory_start_function(state->gen.context, state->func);
+	while(result == JIT_MEMORY_OK
+	      && state->code_size > (jit_nuint)
+			((unsigned char *) _jit_memory_get_limit(state->gen.context)
+			 - (unsigned char *) _jit_memory_get_break(state->gen.context)))
+	{
+		/* The function is not going to fit, extend the limit now */
+		_jit_memory_end_function(state->gen.context, JIT_MEMORY_RESTART);
+		if(_jit_memory_extend_limit(state->gen.context, state->page_factor++)
+		   != JIT_MEMORY_OK)
+		{
+			result = JIT_MEMORY_TOO_BIG;
+			break;
+		}
+		result = _jit_memory_start_function(state->gen.context, state->func);
+	}
 	if(result == JIT_MEMORY_RESTART)
 	{
 		/* Not enough space. Request to extend the limit and retry */
@@ -613,12 +779,30 @@ codegen_prepare(_jit_compile_t *state)
 		state->func->no_return = 1;
 	}
 
+	/* Estimate the size of the function code */
+	state->code_size = state->num_insns * JIT_CODE_SIZE_PER_INSN;
+
+#ifndef JIT_BACKEND_INTERP
+	/* Reorder the instructions to hide their latencies */
+	if(state->func->schedule_insns && !state->func->builder->no_cfg_optimization)
+	{
+		_jit_schedule_insns(state->func);
+	}
+#endif
+
 	/* Compute liveness and "next use" information for this function */
 	_jit_function_compute_liveness(state->func);
 
 	/* Allocate global registers to variables within the function */
 #ifndef JIT_BACKEND_INTERP
-	_jit_regs_alloc_global(&state->gen, state->func);
+	if(budget_exceeded(state))
+	{
+		skip_passes(state);
+	}
+	if(!state->func->builder->no_global_registers)
+	{
+		_jit_regs_alloc_global(&state->gen, state->func);
+	}
 #endif
 }
 
@@ -732,8 +916,15 @@ compile(_jit_compile_t *state, jit_function_t func)
 	{
 		/* Start compilation */
 
+		/* Choose the passes that fit the time budget */
+		choose_passes(state);
+
 		/* Perform machine-independent optimizations */
 		optimize(state->func);
+		if(budget_exceeded(state))
+		{
+			skip_passes(state);
+		}
 
 		/* Prepare data needed for code generation */
 		codegen_prepare(state);
@@ -766,6 +957,12 @@ compile(_jit_compile_t *state, jit_function_t func)
 	state->func->builder->insn_count = 0;
 #endif
 
+	/* Reset the peephole optimization state */
+	state->gen.no_peephole = (jit_context_get_meta_numeric
+				  (state->func->context, JIT_OPTION_NO_PEEPHOLE) != 0);
+	state->gen.peephole_insns = 0;
+	state->gen.peephole_bytes = 0;
+
 #ifdef jit_extra_gen_init
 	/* Initialize information that may need to be reset both
 	   on start and restart */
@@ -783,6 +980,9 @@ compile(_jit_compile_t *state, jit_function_t func)
 	/* End the function's output process */
 	memory_flush(state);
 
+	/* Update the compilation statistics */
+	record_stats(state);
+
 	/* Compilation done, no exceptions occurred */
 	result = JIT_RESULT_OK;
 
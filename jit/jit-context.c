@@ -88,6 +88,7 @@ jit_context_create(void)
 	/* Initialize the context and return it */
 	jit_mutex_create(&context->memory_lock);
 	jit_mutex_create(&context->builder_lock);
+	jit_mutex_create(&context->workspace_lock);
 	context->functions = 0;
 	context->last_function = 0;
 	context->on_demand_driver = _jit_function_compile_on_demand;
@@ -124,9 +125,13 @@ jit_context_destroy(jit_context_t context)
 	}
 
 	_jit_memory_destroy(context);
+	_jit_workspace_destroy(context);
+
+	jit_meta_destroy(&context->meta);
 
 	jit_mutex_destroy(&context->memory_lock);
 	jit_mutex_destroy(&context->builder_lock);
+	jit_mutex_destroy(&context->workspace_lock);
 
 	jit_free(context);
 }
@@ -299,6 +304,68 @@ jit_context_set_meta(jit_context_t context, int type, void *data, jit_meta_free_
  * A numeric option that forces generation of position-independent code (PIC)
  * if it is set to a non-zero value. This may be mainly useful for pre-compiled
  * contexts.
+ *
+ * @vindex JIT_OPTION_WORKSPACE_LIMIT
+ * @item JIT_OPTION_WORKSPACE_LIMIT
+ * A numeric option that indicates the maximum size in bytes of the memory
+ * that the context keeps between function builds.  The memory used for
+ * values, control flow graph edges and other compilation data is retained
+ * when a function is compiled and is reused for the next function.  If set
+ * to zero (the default), the limit is set to an internally-determined value
+ * (usually 1M).  A value smaller than 4k effectively disables the reuse.
+ *
+ * @vindex JIT_OPTION_OPTIMIZE_SIZE_LIMIT
+ * @item JIT_OPTION_OPTIMIZE_SIZE_LIMIT
+ * A numeric option that indicates the maximum number of instructions in
+ * a function that is compiled with all the optimization passes.  Larger
+ * functions are compiled skipping the control flow optimization, copy
+ * propagation, global liveness analysis and global register allocation
+ * regardless of their optimization level.  If set to zero (the default),
+ * the size of functions is not limited.
+ *
+ * @vindex JIT_OPTION_COMPILE_BUDGET
+ * @item JIT_OPTION_COMPILE_BUDGET
+ * A numeric option that indicates the default time in microseconds that
+ * the compilation of a function may take.  It is used for functions with
+ * no budget set by @code{jit_function_set_compile_budget}.  If the
+ * compilation of a function is predicted to exceed the budget from the
+ * time taken to compile the previous functions in the context, then the
+ * expensive passes are skipped as if the function were too large.  If the
+ * budget runs out during the compilation, the remaining passes are skipped.
+ * If set to zero (the default), the compilation time is not limited.
+ *
+ * @vindex JIT_OPTION_NO_PEEPHOLE
+ * @item JIT_OPTION_NO_PEEPHOLE
+ * A numeric option that disables the peephole optimization of the
+ * generated machine code if it is set to a non-zero value.  This is
+ * useful for debugging and for measuring the effect of the optimization
+ * with @code{jit_context_get_stat}.
+ *
+ * @vindex JIT_OPTION_NFLOAT_AS_FLOAT64
+ * @item JIT_OPTION_NFLOAT_AS_FLOAT64
+ * A numeric option that makes the functions of the context compute
+ * in @code{jit_type_float64} where they would otherwise compute in
+ * @code{jit_type_nfloat}, if it is set to a non-zero value.  On platforms
+ * where @code{jit_nfloat} is wider than @code{jit_float64}, such as the
+ * x87 long double of x86-64, this avoids the much slower code for the
+ * wider type.  Arithmetic, comparisons and math functions on
+ * @code{jit_type_nfloat} operands convert them to @code{jit_float64} and
+ * produce @code{jit_float64} results.  The values keep the type they are
+ * created with, so a @code{jit_type_nfloat} local still has the layout
+ * of @code{jit_nfloat} and its address may be passed to native code.
+ * The results are converted back where they are stored to such values,
+ * and they are only as precise as @code{jit_float64} values.
+ *
+ * @vindex JIT_OPTION_TARGET_FEATURE_LEVEL
+ * @item JIT_OPTION_TARGET_FEATURE_LEVEL
+ * A numeric option that limits the optional instruction set extensions
+ * that the generated code may use, so that the code also runs on other
+ * machines of the same level.  If set to zero (the default), the code
+ * may use all the extensions of the CPU it is compiled on.  On x86-64
+ * the levels are those of the psABI: 1 is the baseline SSE2 instruction
+ * set, 2 is x86-64-v2 with SSE4.1 and POPCNT, and 3 is x86-64-v3 with
+ * AVX, AVX2, BMI1, BMI2, LZCNT, MOVBE and FMA.  The extensions that the
+ * CPU lacks are never used, whatever the level.
  * @end table
  *
  * Metadata type values of 10000 or greater are reserved for internal use.
@@ -346,3 +413,58 @@ jit_context_free_meta(jit_context_t context, int type)
 {
 	jit_meta_free(&(context->meta), type);
 }
+
+/*@
+ * @deftypefun jit_ulong jit_context_get_stat (jit_context_t @var{context}, int @var{stat})
+ * Get the code generation statistics of all functions compiled in
+ * @var{context}.  The @var{stat} argument is one of the following:
+ *
+ * @table @code
+ * @vindex JIT_STAT_FUNCTIONS
+ * @item JIT_STAT_FUNCTIONS
+ * The number of compiled functions.
+ *
+ * @vindex JIT_STAT_CODE_BYTES
+ * @item JIT_STAT_CODE_BYTES
+ * The total size in bytes of the machine code of the compiled functions.
+ *
+ * @vindex JIT_STAT_PEEPHOLE_INSNS
+ * @item JIT_STAT_PEEPHOLE_INSNS
+ * The number of machine instructions removed or replaced with shorter
+ * ones by the peephole optimization.
+ *
+ * @vindex JIT_STAT_PEEPHOLE_BYTES
+ * @item JIT_STAT_PEEPHOLE_BYTES
+ * The number of bytes of machine code saved by the peephole optimization.
+ * @end table
+ *
+ * Returns zero for unknown @var{stat} values.
+ * @end deftypefun
+@*/
+jit_ulong
+jit_context_get_stat(jit_context_t context, int stat)
+{
+	jit_ulong value;
+
+	_jit_memory_lock(context);
+	switch(stat)
+	{
+	case JIT_STAT_FUNCTIONS:
+		value = context->num_functions;
+		break;
+	case JIT_STAT_CODE_BYTES:
+		value = context->code_bytes;
+		break;
+	case JIT_STAT_PEEPHOLE_INSNS:
+		value = context->peephole_insns;
+		break;
+	case JIT_STAT_PEEPHOLE_BYTES:
+		value = context->peephole_bytes;
+		break;
+	default:
+		value = 0;
+		break;
+	}
+	_jit_memory_unlock(context);
+	return value;
+}
@@ -22,7 +22,39 @@
 
 #include "jit-cpuid-x86.h"
 
-#if defined(__i386) || defined(__i386__) || defined(_M_IX86)
+#if defined(__i386) || defined(__i386__) || defined(_M_IX86) || \
+	defined(__x86_64) || defined(__x86_64__) || defined(_M_X64)
+
+#if defined(__x86_64) || defined(__x86_64__) || defined(_M_X64)
+
+/*
+ * The "cpuid" instruction is always present on x86-64.
+ */
+static int cpuid_present(void)
+{
+	return 1;
+}
+
+/*
+ * Issue a "cpuid" query and get the result.
+ */
+static void cpuid_query(unsigned int index, jit_cpuid_x86_t *info)
+{
+#if defined(__GNUC__)
+	__asm__ __volatile__ (
+		"cpuid"
+		: "=a"(info->eax), "=b"(info->ebx), "=c"(info->ecx), "=d"(info->edx)
+		: "a"(index), "c"(0)
+	);
+#else
+	info->eax = 0;
+	info->ebx = 0;
+	info->ecx = 0;
+	info->edx = 0;
+#endif
+}
+
+#else /* i386 */
 
 /*
  * Determine if the "cpuid" instruction is present by twiddling
@@ -77,6 +109,8 @@ static void cpuid_query(unsigned int index, jit_cpuid_x86_t *info)
 #endif
 }
 
+#endif /* x86_64 */
+
 int _jit_cpuid_x86_get(unsigned int index, jit_cpuid_x86_t *info)
 {
 	/* Determine if this cpu has the "cpuid" instruction */
@@ -128,4 +162,29 @@ unsigned int _jit_cpuid_x86_line_size(void)
 	return ((info.ebx & 0x0000FF00) >> 5);
 }
 
-#endif /* i386 */
+unsigned int _jit_cpuid_x86_xcr0(void)
+{
+#if defined(__GNUC__)
+	jit_cpuid_x86_t info;
+	unsigned int eax, edx;
+	if(!_jit_cpuid_x86_get(JIT_X86CPUID_FEATURES, &info))
+	{
+		return 0;
+	}
+	if((info.ecx & JIT_X86FEATURE_OSXSAVE) == 0)
+	{
+		return 0;
+	}
+	/* xgetbv, which older assemblers do not know */
+	__asm__ __volatile__ (
+		".byte 0x0f, 0x01, 0xd0"
+		: "=a"(eax), "=d"(edx)
+		: "c"(0)
+	);
+	return eax;
+#else
+	return 0;
+#endif
+}
+
+#endif /* i386 || x86_64 */
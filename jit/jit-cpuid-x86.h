@@ -45,6 +45,8 @@ typedef struct
 #define	JIT_X86CPUID_FEATURES			1
 #define	JIT_X86CPUID_CACHE_TLB			2
 #define	JIT_X86CPUID_SERIAL_NUMBER		3
+#define	JIT_X86CPUID_EXT_FEATURES		7
+#define	JIT_X86CPUID_AMD_FEATURES		0x80000001
 
 /*
  * Feature information.
@@ -82,6 +84,35 @@ typedef struct
 #define	JIT_X86FEATURE_RESERVED_4		0x40000000
 #define	JIT_X86FEATURE_RESERVED_5		0x80000000
 
+/*
+ * Feature information that is returned in "ecx" by the
+ * JIT_X86CPUID_FEATURES query.
+ */
+#define	JIT_X86FEATURE_SSE3				0x00000001
+#define	JIT_X86FEATURE_SSSE3			0x00000200
+#define	JIT_X86FEATURE_FMA				0x00001000
+#define	JIT_X86FEATURE_CX16				0x00002000
+#define	JIT_X86FEATURE_SSE41			0x00080000
+#define	JIT_X86FEATURE_SSE42			0x00100000
+#define	JIT_X86FEATURE_MOVBE			0x00400000
+#define	JIT_X86FEATURE_POPCNT			0x00800000
+#define	JIT_X86FEATURE_OSXSAVE			0x08000000
+#define	JIT_X86FEATURE_AVX				0x10000000
+
+/*
+ * Feature information that is returned in "ebx" by the
+ * JIT_X86CPUID_EXT_FEATURES query.
+ */
+#define	JIT_X86FEATURE_BMI1				0x00000008
+#define	JIT_X86FEATURE_AVX2				0x00000020
+#define	JIT_X86FEATURE_BMI2				0x00000100
+
+/*
+ * Feature information that is returned in "ecx" by the
+ * JIT_X86CPUID_AMD_FEATURES query.
+ */
+#define	JIT_X86FEATURE_LZCNT			0x00000020
+
 /*
  * Get CPU identification information.  Returns zero if the requested
  * information is not available.
@@ -98,6 +129,13 @@ int _jit_cpuid_x86_has_feature(unsigned int feature);
  */
 unsigned int _jit_cpuid_x86_line_size(void);
 
+/*
+ * Get the low word of the extended control register XCR0, which tells
+ * the register states that the operating system saves on context
+ * switches.  Returns zero if the register cannot be read.
+ */
+unsigned int _jit_cpuid_x86_xcr0(void);
+
 #ifdef	__cplusplus
 };
 #endif
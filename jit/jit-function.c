@@ -172,9 +172,13 @@ int _jit_function_ensure_builder(jit_function_t func)
 			func->context, JIT_OPTION_POSITION_INDEPENDENT);
 
 	/* Initialize the function builder */
-	jit_memory_pool_init(&(func->builder->value_pool), struct _jit_value);
-	jit_memory_pool_init(&(func->builder->edge_pool), struct _jit_edge);
-	jit_memory_pool_init(&(func->builder->meta_pool), struct _jit_meta);
+	jit_memory_pool_init(&(func->builder->value_pool), struct _jit_value,
+			     func->context);
+	jit_memory_pool_init(&(func->builder->edge_pool), struct _jit_edge,
+			     func->context);
+	jit_memory_pool_init(&(func->builder->meta_pool), struct _jit_meta,
+			     func->context);
+	_jit_memory_arena_init(&(func->builder->cfg_arena), func->context);
 
 	/* Create the entry block */
 	if(!_jit_block_init(func))
@@ -214,6 +218,7 @@ void _jit_function_free_builder(jit_function_t func)
 		jit_memory_pool_free(&(func->builder->edge_pool), 0);
 		jit_memory_pool_free(&(func->builder->value_pool), _jit_value_free);
 		jit_memory_pool_free(&(func->builder->meta_pool), _jit_meta_free_one);
+		_jit_memory_arena_free(&(func->builder->cfg_arena));
 		jit_free(func->builder->param_values);
 		jit_free(func->builder->label_info);
 		jit_free(func->builder);
@@ -1028,6 +1033,85 @@ jit_function_get_max_optimization_level(void)
 	return JIT_OPTLEVEL_NORMAL;
 }
 
+/*@
+ * @deftypefun void jit_function_set_compile_budget (jit_function_t @var{func}, unsigned int @var{usec})
+ * Set the time in microseconds that the compilation of @var{func} may
+ * take.  If the budget is not enough to compile the function with all
+ * the optimization passes then the more expensive passes are skipped.
+ * The budget is not a hard limit, the code still has to be generated
+ * even if the budget is exceeded.  A caller with an absolute deadline
+ * should pass the time that remains until the deadline.
+ *
+ * If the budget is zero, which is the default, then the
+ * @code{JIT_OPTION_COMPILE_BUDGET} option of the function's context
+ * is used instead.
+ * @end deftypefun
+@*/
+void
+jit_function_set_compile_budget(jit_function_t func, unsigned int usec)
+{
+	if(func)
+	{
+		func->compile_budget = usec;
+	}
+}
+
+/*@
+ * @deftypefun {unsigned int} jit_function_get_compile_budget (jit_function_t @var{func})
+ * Get the compilation time budget for @var{func} in microseconds.
+ * @end deftypefun
+@*/
+unsigned int
+jit_function_get_compile_budget(jit_function_t func)
+{
+	if(func)
+	{
+		return func->compile_budget;
+	}
+	else
+	{
+		return 0;
+	}
+}
+
+/*@
+ * @deftypefun void jit_function_set_scheduling (jit_function_t @var{func}, int @var{flag})
+ * Enable or disable the instruction scheduling for @var{func}.  If
+ * @var{flag} is non-zero, then the instructions within each block are
+ * reordered before the register allocation so that the results of the
+ * loads, divisions and other long latency instructions are not used
+ * right after them.  The scheduling may raise the number of the values
+ * live at once, so it is disabled by default.  It has no effect with
+ * the interpreter.
+ * @end deftypefun
+@*/
+void
+jit_function_set_scheduling(jit_function_t func, int flag)
+{
+	if(func)
+	{
+		func->schedule_insns = (flag != 0);
+	}
+}
+
+/*@
+ * @deftypefun int jit_function_get_scheduling (jit_function_t @var{func})
+ * Determine if the instruction scheduling is enabled for @var{func}.
+ * @end deftypefun
+@*/
+int
+jit_function_get_scheduling(jit_function_t func)
+{
+	if(func)
+	{
+		return func->schedule_insns;
+	}
+	else
+	{
+		return 0;
+	}
+}
+
 /*@
  * @deftypefun {jit_label_t} jit_function_reserve_label (jit_function_t @var{func})
  * Allocate a new label for later use within the function @var{func}.  Most
@@ -3487,6 +3487,172 @@ typedef union
 		} \
 	} while(0)
 
+/*
+ * The exchange with memory is always atomic and needs no lock prefix.
+ */
+#define x86_64_xchg_regp_reg_size(inst, regp, sreg, size) \
+	do { \
+		if((size) == 2) \
+		{ \
+			*(inst)++ = (unsigned char)0x66; \
+		} \
+		x86_64_rex_emit((inst), (size), (sreg), 0, (regp)); \
+		*(inst)++ = (unsigned char)(((size) == 1) ? 0x86 : 0x87); \
+		x86_64_regp_emit((inst), (sreg), (regp)); \
+	} while(0)
+
+/*
+ * Bit manipulation instructions
+ */
+
+/*
+ * Helper for the instructions with a mandatory 0xf3 prefix
+ * (popcnt, lzcnt and tzcnt).
+ */
+#define x86_64_f3_alu2_reg_reg_size(inst, opc2, dreg, sreg, size) \
+	do { \
+		if((size) == 2) \
+		{ \
+			*(inst)++ = (unsigned char)0x66; \
+		} \
+		*(inst)++ = (unsigned char)0xf3; \
+		x86_64_rex_emit((inst), (size), (dreg), 0, (sreg)); \
+		*(inst)++ = (unsigned char)0x0f; \
+		*(inst)++ = (unsigned char)(opc2); \
+		x86_64_reg_emit((inst), (dreg), (sreg)); \
+	} while(0)
+
+/*
+ * popcnt: Count the bits set
+ */
+#define x86_64_popcnt_reg_reg_size(inst, dreg, sreg, size) \
+	do { \
+		x86_64_f3_alu2_reg_reg_size((inst), 0xb8, (dreg), (sreg), (size)); \
+	} while(0)
+
+/*
+ * lzcnt: Count the leading zero bits
+ */
+#define x86_64_lzcnt_reg_reg_size(inst, dreg, sreg, size) \
+	do { \
+		x86_64_f3_alu2_reg_reg_size((inst), 0xbd, (dreg), (sreg), (size)); \
+	} while(0)
+
+/*
+ * tzcnt: Count the trailing zero bits
+ */
+#define x86_64_tzcnt_reg_reg_size(inst, dreg, sreg, size) \
+	do { \
+		x86_64_f3_alu2_reg_reg_size((inst), 0xbc, (dreg), (sreg), (size)); \
+	} while(0)
+
+/*
+ * bsf: Bit scan forward (the destination is undefined and ZF is set
+ * if the source is zero)
+ */
+#define x86_64_bsf_reg_reg_size(inst, dreg, sreg, size) \
+	do { \
+		x86_64_alu2_reg_reg_size((inst), 0x0f, 0xbc, (dreg), (sreg), (size)); \
+	} while(0)
+
+/*
+ * bsr: Bit scan reverse (the destination is undefined and ZF is set
+ * if the source is zero)
+ */
+#define x86_64_bsr_reg_reg_size(inst, dreg, sreg, size) \
+	do { \
+		x86_64_alu2_reg_reg_size((inst), 0x0f, 0xbd, (dreg), (sreg), (size)); \
+	} while(0)
+
+/*
+ * bswap: Reverse the byte order of a 32 or 64 bit register
+ */
+#define x86_64_bswap_reg_size(inst, reg, size) \
+	do { \
+		x86_64_rex_emit((inst), (size), 0, 0, (reg)); \
+		*(inst)++ = (unsigned char)0x0f; \
+		*(inst)++ = (unsigned char)0xc8 + ((reg) & 0x7); \
+	} while(0)
+
+/*
+ * rol: Rotate left
+ */
+#define x86_64_rol_reg_imm_size(inst, dreg, imm, size) \
+	do { \
+		x86_64_shift_reg_imm_size((inst), 0, (dreg), (imm), (size)); \
+	} while(0)
+
+#define x86_64_rol_reg_size(inst, dreg, size) \
+	do { \
+		x86_64_shift_reg_size((inst), 0, (dreg), (size)); \
+	} while(0)
+
+/*
+ * ror: Rotate right
+ */
+#define x86_64_ror_reg_imm_size(inst, dreg, imm, size) \
+	do { \
+		x86_64_shift_reg_imm_size((inst), 1, (dreg), (imm), (size)); \
+	} while(0)
+
+#define x86_64_ror_reg_size(inst, dreg, size) \
+	do { \
+		x86_64_shift_reg_size((inst), 1, (dreg), (size)); \
+	} while(0)
+
+/*
+ * Atomic operations
+ */
+
+/*
+ * lock: Make the following read-modify-write instruction atomic
+ */
+#define x86_64_lock(inst) \
+	do { \
+		*(inst)++ = (unsigned char)0xf0; \
+	} while(0)
+
+/*
+ * xadd: Exchange and add
+ */
+#define x86_64_xadd_regp_reg_size(inst, regp, sreg, size) \
+	do { \
+		if((size) == 2) \
+		{ \
+			*(inst)++ = (unsigned char)0x66; \
+		} \
+		x86_64_rex_emit((inst), (size), (sreg), 0, (regp)); \
+		*(inst)++ = (unsigned char)0x0f; \
+		*(inst)++ = (unsigned char)(((size) == 1) ? 0xc0 : 0xc1); \
+		x86_64_regp_emit((inst), (sreg), (regp)); \
+	} while(0)
+
+/*
+ * cmpxchg: Compare the accumulator with the memory and store sreg
+ * there if equal or load the memory to the accumulator otherwise
+ */
+#define x86_64_cmpxchg_regp_reg_size(inst, regp, sreg, size) \
+	do { \
+		if((size) == 2) \
+		{ \
+			*(inst)++ = (unsigned char)0x66; \
+		} \
+		x86_64_rex_emit((inst), (size), (sreg), 0, (regp)); \
+		*(inst)++ = (unsigned char)0x0f; \
+		*(inst)++ = (unsigned char)(((size) == 1) ? 0xb0 : 0xb1); \
+		x86_64_regp_emit((inst), (sreg), (regp)); \
+	} while(0)
+
+/*
+ * mfence: Serialize all the loads and stores
+ */
+#define x86_64_mfence(inst) \
+	do { \
+		*(inst)++ = (unsigned char)0x0f; \
+		*(inst)++ = (unsigned char)0xae; \
+		*(inst)++ = (unsigned char)0xf0; \
+	} while(0)
+
 /*
  * XMM instructions
  */
@@ -5079,6 +5245,156 @@ typedef union
 		x86_64_xorps_reg_reg((inst), (reg), (reg)); \
 	} while(0)
 
+/*
+ * VEX encoded instructions (AVX and BMI2)
+ */
+
+/*
+ * VEX opcode maps
+ */
+#define X86_64_VEX_0F		1
+#define X86_64_VEX_0F38		2
+#define X86_64_VEX_0F3A		3
+
+/*
+ * VEX implied prefixes
+ */
+#define X86_64_VEX_NP		0
+#define X86_64_VEX_66		1
+#define X86_64_VEX_F3		2
+#define X86_64_VEX_F2		3
+
+/*
+ * Emit the VEX prefix for a scalar (L = 0) instruction.  The short two
+ * byte form is used whenever the instruction does not need the X, B and
+ * W bits or an opcode map other than 0x0f.
+ * The register numbers are inverted in the prefix as the encoding
+ * requires.
+ */
+#define x86_64_vex_emit(inst, map, width, pp, modrm_reg, vreg, rm_reg) \
+	do { \
+		if((map) == X86_64_VEX_0F && ((width) & 8) == 0 && \
+		   ((rm_reg) & 8) == 0) \
+		{ \
+			*(inst)++ = (unsigned char)0xc5; \
+			*(inst)++ = (unsigned char)((((modrm_reg) & 8) ? 0 : 0x80) | \
+						    ((~(vreg) & 0xf) << 3) | (pp)); \
+		} \
+		else \
+		{ \
+			*(inst)++ = (unsigned char)0xc4; \
+			*(inst)++ = (unsigned char)((((modrm_reg) & 8) ? 0 : 0x80) | 0x40 | \
+						    (((rm_reg) & 8) ? 0 : 0x20) | (map)); \
+			*(inst)++ = (unsigned char)((((width) & 8) ? 0x80 : 0) | \
+						    ((~(vreg) & 0xf) << 3) | (pp)); \
+		} \
+	} while(0)
+
+/*
+ * Emit a three register VEX instruction
+ */
+#define x86_64_vex_reg_reg_reg(inst, map, width, pp, opc, r, vreg, reg) \
+	do { \
+		x86_64_vex_emit((inst), (map), (width), (pp), (r), (vreg), (reg)); \
+		*(inst)++ = (unsigned char)(opc); \
+		x86_64_reg_emit((inst), (r), (reg)); \
+	} while(0)
+
+/*
+ * Non destructive scalar float arithmetic: dreg = sreg1 op sreg2
+ */
+#define x86_64_vaddss_reg_reg_reg(inst, dreg, sreg1, sreg2) \
+	do { \
+		x86_64_vex_reg_reg_reg((inst), X86_64_VEX_0F, 0, X86_64_VEX_F3, 0x58, (dreg), (sreg1), (sreg2)); \
+	} while(0)
+
+#define x86_64_vaddsd_reg_reg_reg(inst, dreg, sreg1, sreg2) \
+	do { \
+		x86_64_vex_reg_reg_reg((inst), X86_64_VEX_0F, 0, X86_64_VEX_F2, 0x58, (dreg), (sreg1), (sreg2)); \
+	} while(0)
+
+#define x86_64_vsubss_reg_reg_reg(inst, dreg, sreg1, sreg2) \
+	do { \
+		x86_64_vex_reg_reg_reg((inst), X86_64_VEX_0F, 0, X86_64_VEX_F3, 0x5c, (dreg), (sreg1), (sreg2)); \
+	} while(0)
+
+#define x86_64_vsubsd_reg_reg_reg(inst, dreg, sreg1, sreg2) \
+	do { \
+		x86_64_vex_reg_reg_reg((inst), X86_64_VEX_0F, 0, X86_64_VEX_F2, 0x5c, (dreg), (sreg1), (sreg2)); \
+	} while(0)
+
+#define x86_64_vmulss_reg_reg_reg(inst, dreg, sreg1, sreg2) \
+	do { \
+		x86_64_vex_reg_reg_reg((inst), X86_64_VEX_0F, 0, X86_64_VEX_F3, 0x59, (dreg), (sreg1), (sreg2)); \
+	} while(0)
+
+#define x86_64_vmulsd_reg_reg_reg(inst, dreg, sreg1, sreg2) \
+	do { \
+		x86_64_vex_reg_reg_reg((inst), X86_64_VEX_0F, 0, X86_64_VEX_F2, 0x59, (dreg), (sreg1), (sreg2)); \
+	} while(0)
+
+#define x86_64_vdivss_reg_reg_reg(inst, dreg, sreg1, sreg2) \
+	do { \
+		x86_64_vex_reg_reg_reg((inst), X86_64_VEX_0F, 0, X86_64_VEX_F3, 0x5e, (dreg), (sreg1), (sreg2)); \
+	} while(0)
+
+#define x86_64_vdivsd_reg_reg_reg(inst, dreg, sreg1, sreg2) \
+	do { \
+		x86_64_vex_reg_reg_reg((inst), X86_64_VEX_0F, 0, X86_64_VEX_F2, 0x5e, (dreg), (sreg1), (sreg2)); \
+	} while(0)
+
+#define x86_64_vminss_reg_reg_reg(inst, dreg, sreg1, sreg2) \
+	do { \
+		x86_64_vex_reg_reg_reg((inst), X86_64_VEX_0F, 0, X86_64_VEX_F3, 0x5d, (dreg), (sreg1), (sreg2)); \
+	} while(0)
+
+#define x86_64_vminsd_reg_reg_reg(inst, dreg, sreg1, sreg2) \
+	do { \
+		x86_64_vex_reg_reg_reg((inst), X86_64_VEX_0F, 0, X86_64_VEX_F2, 0x5d, (dreg), (sreg1), (sreg2)); \
+	} while(0)
+
+#define x86_64_vmaxss_reg_reg_reg(inst, dreg, sreg1, sreg2) \
+	do { \
+		x86_64_vex_reg_reg_reg((inst), X86_64_VEX_0F, 0, X86_64_VEX_F3, 0x5f, (dreg), (sreg1), (sreg2)); \
+	} while(0)
+
+#define x86_64_vmaxsd_reg_reg_reg(inst, dreg, sreg1, sreg2) \
+	do { \
+		x86_64_vex_reg_reg_reg((inst), X86_64_VEX_0F, 0, X86_64_VEX_F2, 0x5f, (dreg), (sreg1), (sreg2)); \
+	} while(0)
+
+/*
+ * Fused multiply-add with the accumulator in the destination:
+ * dreg = sreg1 * sreg2 + dreg
+ */
+#define x86_64_vfmadd231ss_reg_reg_reg(inst, dreg, sreg1, sreg2) \
+	do { \
+		x86_64_vex_reg_reg_reg((inst), X86_64_VEX_0F38, 0, X86_64_VEX_66, 0xb9, (dreg), (sreg1), (sreg2)); \
+	} while(0)
+
+#define x86_64_vfmadd231sd_reg_reg_reg(inst, dreg, sreg1, sreg2) \
+	do { \
+		x86_64_vex_reg_reg_reg((inst), X86_64_VEX_0F38, 8, X86_64_VEX_66, 0xb9, (dreg), (sreg1), (sreg2)); \
+	} while(0)
+
+/*
+ * BMI2 shifts by a count in any register: dreg = sreg shift creg
+ */
+#define x86_64_shlx_reg_reg_reg_size(inst, dreg, sreg, creg, size) \
+	do { \
+		x86_64_vex_reg_reg_reg((inst), X86_64_VEX_0F38, (size), X86_64_VEX_66, 0xf7, (dreg), (creg), (sreg)); \
+	} while(0)
+
+#define x86_64_sarx_reg_reg_reg_size(inst, dreg, sreg, creg, size) \
+	do { \
+		x86_64_vex_reg_reg_reg((inst), X86_64_VEX_0F38, (size), X86_64_VEX_F3, 0xf7, (dreg), (creg), (sreg)); \
+	} while(0)
+
+#define x86_64_shrx_reg_reg_reg_size(inst, dreg, sreg, creg, size) \
+	do { \
+		x86_64_vex_reg_reg_reg((inst), X86_64_VEX_0F38, (size), X86_64_VEX_F2, 0xf7, (dreg), (creg), (sreg)); \
+	} while(0)
+
 /*
  * fpu instructions
  */
@@ -473,10 +473,13 @@ create_dest_note(jit_function_t func, int oper, jit_type_t type)
 }
 
 /*
- * Get the common type to use for a binary operator.
+ * Get the common type to use for a binary operator.  This is
+ * "jit_type_float64" instead of "jit_type_nfloat" if the function
+ * computes with the former.
  */
 static jit_type_t
-common_binary(jit_type_t type1, jit_type_t type2, int int_only, int float_only)
+common_binary(jit_function_t func, jit_type_t type1, jit_type_t type2,
+	      int int_only, int float_only)
 {
 	type1 = jit_type_promote_int(jit_type_normalize(type1));
 	type2 = jit_type_promote_int(jit_type_normalize(type2));
@@ -527,7 +530,7 @@ common_binary(jit_type_t type1, jit_type_t type2, int int_only, int float_only)
 	}
 	if(type1 == jit_type_nfloat || type2 == jit_type_nfloat)
 	{
-		return jit_type_nfloat;
+		return _jit_nfloat_as_float64(func) ? jit_type_float64 : jit_type_nfloat;
 	}
 	else if(type1 == jit_type_float64 || type2 == jit_type_float64)
 	{
@@ -540,7 +543,7 @@ common_binary(jit_type_t type1, jit_type_t type2, int int_only, int float_only)
 	else
 	{
 		/* Probably integer arguments when "float_only" is set */
-		return jit_type_nfloat;
+		return _jit_nfloat_as_float64(func) ? jit_type_float64 : jit_type_nfloat;
 	}
 }
 
@@ -594,7 +597,8 @@ apply_unary_arith(jit_function_t func, const jit_opcode_descr *descr,
 		  jit_value_t value, int int_only, int float_only,
 		  int overflow_check)
 {
-	jit_type_t type = common_binary(value->type, value->type, int_only, float_only);
+	jit_type_t type = common_binary(func, value->type, value->type,
+					int_only, float_only);
 
 	int oper;
 	const jit_intrinsic_descr_t *desc;
@@ -665,7 +669,8 @@ apply_arith(jit_function_t func, const jit_opcode_descr *descr,
 	    jit_value_t value1, jit_value_t value2,
 	    int int_only, int float_only, int overflow_check)
 {
-	jit_type_t type = common_binary(value1->type, value2->type, int_only, float_only);
+	jit_type_t type = common_binary(func, value1->type, value2->type,
+					int_only, float_only);
 
 	int oper;
 	const jit_intrinsic_descr_t *desc;
@@ -728,6 +733,147 @@ apply_arith(jit_function_t func, const jit_opcode_descr *descr,
 	return apply_binary(func, oper, value1, value2, type);
 }
 
+/*
+ * Replace a 32-bit division by a constant with a multiplication by the
+ * constant's reciprocal that is done in 64 bits.  This takes a few cycles
+ * instead of the tens of cycles of a division instruction.  Returns NULL
+ * if the division should be done as usual.
+ */
+static jit_value_t
+apply_div_by_constant(jit_function_t func, jit_value_t value1, jit_value_t value2,
+		      int is_rem)
+{
+#if defined(JIT_NATIVE_INT64) && !defined(JIT_BACKEND_INTERP)
+	jit_type_t type;
+	jit_value_t temp, wide, quotient;
+	jit_nint divisor;
+	jit_ulong magic;
+	int shift, add;
+
+	if(jit_value_is_constant(value1) || !jit_value_is_constant(value2))
+	{
+		return 0;
+	}
+	type = common_binary(func, value1->type, value2->type, 0, 0);
+	if(type->kind != JIT_TYPE_INT && type->kind != JIT_TYPE_UINT)
+	{
+		return 0;
+	}
+	value2 = jit_insn_convert(func, value2, type, 0);
+	if(!value2)
+	{
+		return 0;
+	}
+	divisor = jit_value_get_nint_constant(value2);
+
+	/* Division by zero must throw and division by a power of two
+	   is better done with shifts by the backend */
+	if(type->kind == JIT_TYPE_INT)
+	{
+		if((divisor > 0 && (divisor & (divisor - 1)) == 0)
+		   || !_jit_div_magic_signed((jit_int) divisor, 32, &magic, &shift))
+		{
+			return 0;
+		}
+	}
+	else
+	{
+		divisor = (jit_uint) divisor;
+		if((divisor & (divisor - 1)) == 0
+		   || !_jit_div_magic_unsigned(divisor, 32, &magic, &shift, &add))
+		{
+			return 0;
+		}
+	}
+
+	value1 = jit_insn_convert(func, value1, type, 0);
+	if(!value1)
+	{
+		return 0;
+	}
+
+	if(type->kind == JIT_TYPE_INT)
+	{
+		/* t = (x * magic) >> (32 + shift), q = t + (t < 0) */
+		temp = jit_insn_convert(func, value1, jit_type_long, 0);
+		if(temp)
+		{
+			temp = jit_insn_mul(func, temp, jit_value_create_long_constant
+					    (func, jit_type_long, (jit_long) magic));
+		}
+		if(temp)
+		{
+			temp = jit_insn_shr(func, temp, jit_value_create_nint_constant
+					    (func, jit_type_int, 32 + shift));
+		}
+		if(temp)
+		{
+			temp = jit_insn_convert(func, temp, jit_type_int, 0);
+		}
+		if(!temp)
+		{
+			return 0;
+		}
+		quotient = jit_insn_ushr(func, temp, jit_value_create_nint_constant
+					 (func, jit_type_int, 31));
+		if(quotient)
+		{
+			quotient = jit_insn_add(func, temp, quotient);
+		}
+	}
+	else
+	{
+		/* q = (x * magic) >> (32 + shift), or if the magic number
+		   needs 33 bits q = (((x * magic) >> 32) + x) >> shift */
+		wide = jit_insn_convert(func, value1, jit_type_ulong, 0);
+		if(!wide)
+		{
+			return 0;
+		}
+		temp = jit_insn_mul(func, wide, jit_value_create_long_constant
+				    (func, jit_type_ulong, (jit_long) magic));
+		if(temp && add)
+		{
+			temp = jit_insn_ushr(func, temp, jit_value_create_nint_constant
+					     (func, jit_type_int, 32));
+			if(temp)
+			{
+				temp = jit_insn_add(func, temp, wide);
+			}
+			if(temp)
+			{
+				temp = jit_insn_ushr(func, temp, jit_value_create_nint_constant
+						     (func, jit_type_int, shift));
+			}
+		}
+		else if(temp)
+		{
+			temp = jit_insn_ushr(func, temp, jit_value_create_nint_constant
+					     (func, jit_type_int, 32 + shift));
+		}
+		if(!temp)
+		{
+			return 0;
+		}
+		quotient = jit_insn_convert(func, temp, jit_type_uint, 0);
+	}
+	if(!quotient || !is_rem)
+	{
+		return quotient;
+	}
+
+	/* r = x - q * d */
+	temp = jit_insn_mul(func, quotient, value2);
+	if(!temp)
+	{
+		return 0;
+	}
+	return jit_insn_sub(func, value1, temp);
+#else
+	return 0;
+#endif
+}
+
 /*
  * Apply a binary shift operator, after coercing both
  * arguments to suitable types.
@@ -736,7 +882,7 @@ static jit_value_t
 apply_shift(jit_function_t func, const jit_opcode_descr *descr,
 	    jit_value_t value1, jit_value_t value2)
 {
-	jit_type_t type = common_binary(value1->type, value1->type, 1, 0);
+	jit_type_t type = common_binary(func, value1->type, value1->type, 1, 0);
 
 	int oper;
 	switch (type->kind)
@@ -784,6 +930,89 @@ apply_shift(jit_function_t func, const jit_opcode_descr *descr,
 	return apply_binary(func, oper, value1, value2, type);
 }
 
+/*
+ * Apply a bit manipulation operator, after coercing the value to
+ * a suitable integer type.  The bit count operators return an int
+ * and the others return the type of the value.  The rotate count in
+ * "value2" is coerced in the same way as the shift count.
+ */
+static jit_value_t
+apply_bit_op(jit_function_t func, const jit_opcode_descr *descr,
+	     jit_value_t value1, jit_value_t value2, int is_count)
+{
+	jit_type_t type = common_binary(func, value1->type, value1->type, 1, 0);
+
+	int oper;
+	switch (type->kind)
+	{
+	case JIT_TYPE_INT:
+		oper = descr->ioper;
+		break;
+	case JIT_TYPE_UINT:
+		oper = descr->iuoper;
+		break;
+	case JIT_TYPE_LONG:
+		oper = descr->loper;
+		break;
+	default: /* Shouldn't happen */
+	case JIT_TYPE_ULONG:
+		oper = descr->luoper;
+		break;
+	}
+	jit_type_t result_type = is_count ? jit_type_int : type;
+
+	value1 = jit_insn_convert(func, value1, type, 0);
+	if(!value1)
+	{
+		return 0;
+	}
+	if(value2)
+	{
+		jit_type_t count_type = jit_type_promote_int(jit_type_normalize(value2->type));
+		if(count_type != jit_type_int)
+		{
+			count_type = jit_type_uint;
+		}
+		value2 = jit_insn_convert(func, value2, count_type, 0);
+		if(!value2)
+		{
+			return 0;
+		}
+	}
+	if(jit_value_is_constant(value1) && (!value2 || jit_value_is_constant(value2)))
+	{
+		jit_value_t result;
+		if(value2)
+		{
+			result = _jit_opcode_apply(func, oper, value1, value2, result_type);
+		}
+		else
+		{
+			result = _jit_opcode_apply_unary(func, oper, value1, result_type);
+		}
+		if(result)
+		{
+			return result;
+		}
+	}
+
+	if(!_jit_opcode_is_supported(oper))
+	{
+		/* The unsigned types share the signed intrinsics */
+		jit_value_t result = apply_intrinsic(func, descr, value1, value2, type);
+		if(!result)
+		{
+			return 0;
+		}
+		return jit_insn_convert(func, result, result_type, 0);
+	}
+	if(value2)
+	{
+		return apply_binary(func, oper, value1, value2, result_type);
+	}
+	return apply_unary(func, oper, value1, result_type);
+}
+
 /*
  * Apply a binary comparison operator, after coercing both
  * arguments to a common type.
@@ -792,7 +1021,7 @@ static jit_value_t
 apply_compare(jit_function_t func, const jit_opcode_descr *descr,
 	      jit_value_t value1, jit_value_t value2, int float_only)
 {
-	jit_type_t type = common_binary(value1->type, value2->type, 0, float_only);
+	jit_type_t type = common_binary(func, value1->type, value2->type, 0, float_only);
 
 	int oper;
 	switch (type->kind)
@@ -1790,6 +2019,55 @@ jit_insn_check_null(jit_function_t func, jit_value_t value)
 	return create_unary_note(func, JIT_OP_CHECK_NULL, value);
 }
 
+/*@
+ * @deftypefun int jit_insn_check_bounds (jit_function_t @var{func}, jit_value_t @var{index}, jit_value_t @var{length})
+ * Check that @var{index} is within the bounds of an array with
+ * @var{length} elements, that is greater than or equal to zero and less
+ * than @var{length}.  If it is not, then throw the built-in
+ * @code{JIT_RESULT_OUT_OF_BOUNDS} exception.  Both values are converted
+ * to @code{jit_type_nint} first.
+ *
+ * The check is a single unsigned comparison of @var{index} with
+ * @var{length}, so @var{length} must not be negative.  A negative
+ * length is treated as a very large unsigned one, and negative indexes
+ * below it pass the check.
+ *
+ * The optimizer removes the checks that are known to succeed because
+ * an earlier check of the same values or a loop condition already
+ * covers them, so front ends for safe languages should emit the check
+ * in front of every array access and leave the rest to the optimizer.
+ * @end deftypefun
+@*/
+int
+jit_insn_check_bounds(jit_function_t func, jit_value_t index, jit_value_t length)
+{
+	/* Ensure that we have a function builder */
+	if(!_jit_function_ensure_builder(func))
+	{
+		return 0;
+	}
+
+	index = jit_insn_convert(func, index, jit_type_nint, 0);
+	if(!index)
+	{
+		return 0;
+	}
+	length = jit_insn_convert(func, length, jit_type_nint, 0);
+	if(!length)
+	{
+		return 0;
+	}
+
+	/* Do the check only if the result is not known already */
+	if(index->is_nint_constant && length->is_nint_constant
+	   && (jit_nuint) index->address < (jit_nuint) length->address)
+	{
+		return 1;
+	}
+	func->builder->may_throw = 1;
+	return create_note(func, JIT_OP_CHECK_BOUNDS, index, length);
+}
+
 int
 _jit_insn_check_is_redundant(const jit_insn_iter_t *iter)
 {
@@ -1836,6 +2114,29 @@ _jit_insn_check_is_redundant(const jit_insn_iter_t *iter)
 	return 0;
 }
 
+jit_value_t
+_jit_insn_get_def(jit_insn_t insn)
+{
+	/* The value returned by a call is set by its "return_reg" note */
+	if(insn->opcode == JIT_OP_RETURN_REG)
+	{
+		return insn->value1;
+	}
+	/* The fused multiply-add replaces its addend with the result */
+	if(insn->opcode == JIT_OP_FFMA || insn->opcode == JIT_OP_DFMA)
+	{
+		return insn->dest;
+	}
+	if(insn->opcode == JIT_OP_NOP || !insn->dest
+	   || (insn->flags & (JIT_INSN_DEST_OTHER_FLAGS
+			      | JIT_INSN_DEST_IS_VALUE)) != 0
+	   || insn->dest->is_constant)
+	{
+		return 0;
+	}
+	return insn->dest;
+}
+
 /*@
  * @deftypefun jit_value_t jit_insn_add (jit_function_t @var{func}, jit_value_t @var{value1}, jit_value_t @var{value2})
  * Add two values together and return the result in a new temporary value.
@@ -2028,6 +2329,13 @@ jit_insn_div(jit_function_t func, jit_value_t value1, jit_value_t value2)
 		jit_intrinsic(jit_float64_div, descr_d_dd),
 		jit_intrinsic(jit_nfloat_div, descr_D_DD)
 	};
+	jit_value_t result;
+
+	result = apply_div_by_constant(func, value1, value2, 0);
+	if(result)
+	{
+		return result;
+	}
 	return apply_arith(func, &div_descr, value1, value2, 0, 0, 0);
 }
 
@@ -2058,6 +2366,13 @@ jit_insn_rem(jit_function_t func, jit_value_t value1, jit_value_t value2)
 		jit_intrinsic(jit_float64_rem, descr_d_dd),
 		jit_intrinsic(jit_nfloat_rem, descr_D_DD)
 	};
+	jit_value_t result;
+
+	result = apply_div_by_constant(func, value1, value2, 1);
+	if(result)
+	{
+		return result;
+	}
 	return apply_arith(func, &rem_descr, value1, value2, 0, 0, 0);
 }
 
@@ -2090,6 +2405,13 @@ jit_insn_rem_ieee(jit_function_t func, jit_value_t value1, jit_value_t value2)
 		jit_intrinsic(jit_float64_ieee_rem, descr_d_dd),
 		jit_intrinsic(jit_nfloat_ieee_rem, descr_D_DD)
 	};
+	jit_value_t result;
+
+	result = apply_div_by_constant(func, value1, value2, 1);
+	if(result)
+	{
+		return result;
+	}
 	return apply_arith(func, &rem_ieee_descr, value1, value2, 0, 0, 0);
 }
 
@@ -2377,6 +2699,160 @@ jit_insn_sshr(jit_function_t func, jit_value_t value1, jit_value_t value2)
 	return apply_shift(func, &sshr_descr, value1, value2);
 }
 
+/*@
+ * @deftypefun jit_value_t jit_insn_popcount (jit_function_t @var{func}, jit_value_t @var{value1})
+ * Count the bits that are set in an integer value and return the
+ * result as a new temporary value of type @code{jit_type_int}.
+ * Values that are smaller than @code{jit_type_int} are promoted
+ * before the bits are counted.
+ * @end deftypefun
+@*/
+jit_value_t
+jit_insn_popcount(jit_function_t func, jit_value_t value1)
+{
+	static jit_opcode_descr const popcount_descr = {
+		JIT_OP_IPOPCOUNT,
+		JIT_OP_IPOPCOUNT,
+		JIT_OP_LPOPCOUNT,
+		JIT_OP_LPOPCOUNT,
+		0, 0, 0,
+		jit_intrinsic(jit_int_popcount, descr_i_i),
+		jit_intrinsic(jit_int_popcount, descr_i_i),
+		jit_intrinsic(jit_long_popcount, descr_i_l),
+		jit_intrinsic(jit_long_popcount, descr_i_l),
+		jit_no_intrinsic,
+		jit_no_intrinsic,
+		jit_no_intrinsic
+	};
+	return apply_bit_op(func, &popcount_descr, value1, 0, 1);
+}
+
+/*@
+ * @deftypefun jit_value_t jit_insn_clz (jit_function_t @var{func}, jit_value_t @var{value1})
+ * @deftypefunx jit_value_t jit_insn_ctz (jit_function_t @var{func}, jit_value_t @var{value1})
+ * Count the leading or trailing zero bits in an integer value and
+ * return the result as a new temporary value of type @code{jit_type_int}.
+ * The result is the width of the value in bits if the value is zero.
+ * Values that are smaller than @code{jit_type_int} are promoted first,
+ * so the width is 32 or 64.
+ * @end deftypefun
+@*/
+jit_value_t
+jit_insn_clz(jit_function_t func, jit_value_t value1)
+{
+	static jit_opcode_descr const clz_descr = {
+		JIT_OP_ICLZ,
+		JIT_OP_ICLZ,
+		JIT_OP_LCLZ,
+		JIT_OP_LCLZ,
+		0, 0, 0,
+		jit_intrinsic(jit_int_clz, descr_i_i),
+		jit_intrinsic(jit_int_clz, descr_i_i),
+		jit_intrinsic(jit_long_clz, descr_i_l),
+		jit_intrinsic(jit_long_clz, descr_i_l),
+		jit_no_intrinsic,
+		jit_no_intrinsic,
+		jit_no_intrinsic
+	};
+	return apply_bit_op(func, &clz_descr, value1, 0, 1);
+}
+
+jit_value_t
+jit_insn_ctz(jit_function_t func, jit_value_t value1)
+{
+	static jit_opcode_descr const ctz_descr = {
+		JIT_OP_ICTZ,
+		JIT_OP_ICTZ,
+		JIT_OP_LCTZ,
+		JIT_OP_LCTZ,
+		0, 0, 0,
+		jit_intrinsic(jit_int_ctz, descr_i_i),
+		jit_intrinsic(jit_int_ctz, descr_i_i),
+		jit_intrinsic(jit_long_ctz, descr_i_l),
+		jit_intrinsic(jit_long_ctz, descr_i_l),
+		jit_no_intrinsic,
+		jit_no_intrinsic,
+		jit_no_intrinsic
+	};
+	return apply_bit_op(func, &ctz_descr, value1, 0, 1);
+}
+
+/*@
+ * @deftypefun jit_value_t jit_insn_bswap (jit_function_t @var{func}, jit_value_t @var{value1})
+ * Reverse the order of the bytes in an integer value and return the
+ * result in a new temporary value.  Values that are smaller than
+ * @code{jit_type_int} are promoted first, so the swapped bytes of
+ * a 16-bit value end up in the upper half of the result.
+ * @end deftypefun
+@*/
+jit_value_t
+jit_insn_bswap(jit_function_t func, jit_value_t value1)
+{
+	static jit_opcode_descr const bswap_descr = {
+		JIT_OP_IBSWAP,
+		JIT_OP_IBSWAP,
+		JIT_OP_LBSWAP,
+		JIT_OP_LBSWAP,
+		0, 0, 0,
+		jit_intrinsic(jit_int_bswap, descr_i_i),
+		jit_intrinsic(jit_int_bswap, descr_i_i),
+		jit_intrinsic(jit_long_bswap, descr_l_l),
+		jit_intrinsic(jit_long_bswap, descr_l_l),
+		jit_no_intrinsic,
+		jit_no_intrinsic,
+		jit_no_intrinsic
+	};
+	return apply_bit_op(func, &bswap_descr, value1, 0, 0);
+}
+
+/*@
+ * @deftypefun jit_value_t jit_insn_rol (jit_function_t @var{func}, jit_value_t @var{value1}, jit_value_t @var{value2})
+ * @deftypefunx jit_value_t jit_insn_ror (jit_function_t @var{func}, jit_value_t @var{value1}, jit_value_t @var{value2})
+ * Rotate @var{value1} left or right by @var{value2} bits and return
+ * the result in a new temporary value.  The rotate count is taken
+ * modulo the width of @var{value1} after promotion, which is 32 or 64.
+ * @end deftypefun
+@*/
+jit_value_t
+jit_insn_rol(jit_function_t func, jit_value_t value1, jit_value_t value2)
+{
+	static jit_opcode_descr const rol_descr = {
+		JIT_OP_IROL,
+		JIT_OP_IROL,
+		JIT_OP_LROL,
+		JIT_OP_LROL,
+		0, 0, 0,
+		jit_intrinsic(jit_int_rol, descr_i_iI),
+		jit_intrinsic(jit_int_rol, descr_i_iI),
+		jit_intrinsic(jit_long_rol, descr_l_lI),
+		jit_intrinsic(jit_long_rol, descr_l_lI),
+		jit_no_intrinsic,
+		jit_no_intrinsic,
+		jit_no_intrinsic
+	};
+	return apply_bit_op(func, &rol_descr, value1, value2, 0);
+}
+
+jit_value_t
+jit_insn_ror(jit_function_t func, jit_value_t value1, jit_value_t value2)
+{
+	static jit_opcode_descr const ror_descr = {
+		JIT_OP_IROR,
+		JIT_OP_IROR,
+		JIT_OP_LROR,
+		JIT_OP_LROR,
+		0, 0, 0,
+		jit_intrinsic(jit_int_ror, descr_i_iI),
+		jit_intrinsic(jit_int_ror, descr_i_iI),
+		jit_intrinsic(jit_long_ror, descr_l_lI),
+		jit_intrinsic(jit_long_ror, descr_l_lI),
+		jit_no_intrinsic,
+		jit_no_intrinsic,
+		jit_no_intrinsic
+	};
+	return apply_bit_op(func, &ror_descr, value1, value2, 0);
+}
+
 /*@
  * @deftypefun jit_value_t jit_insn_eq (jit_function_t @var{func}, jit_value_t @var{value1}, jit_value_t @var{value2})
  * Compare two values for equality and return the result
@@ -2980,7 +3456,131 @@ jit_insn_floor(jit_function_t func, jit_value_t value)
 	return apply_unary_arith(func, &floor_descr, value, 0, 1, 0);
 }
 
-jit_value_t
+/*@
+ * @deftypefun jit_value_t jit_insn_fma (jit_function_t @var{func}, jit_value_t @var{value1}, jit_value_t @var{value2}, jit_value_t @var{value3})
+ * Compute @code{@var{value1} * @var{value2} + @var{value3}} with a single
+ * rounding where the C library provides the fused multiply-add function.
+ * The operands are converted to their common floating point type first.
+ * The x86-64 back end uses the FMA instructions when the target feature
+ * level allows them, otherwise the C library function is called.
+ * @end deftypefun
+@*/
+jit_value_t
+jit_insn_fma(jit_function_t func, jit_value_t value1, jit_value_t value2,
+	     jit_value_t value3)
+{
+	jit_type_t type;
+	jit_type_t params[3];
+	jit_type_t signature;
+	jit_value_t args[3];
+	jit_value_t result;
+	const char *name;
+	void *intrinsic;
+
+	if(!value1 || !value2 || !value3)
+	{
+		return 0;
+	}
+
+	type = common_binary(func, value1->type, value2->type, 0, 1);
+	type = common_binary(func, type, value3->type, 0, 1);
+	value1 = jit_insn_convert(func, value1, type, 0);
+	value2 = jit_insn_convert(func, value2, type, 0);
+	value3 = jit_insn_convert(func, value3, type, 0);
+	if(!value1 || !value2 || !value3)
+	{
+		return 0;
+	}
+
+	/* Fold the constant case */
+	if(jit_value_is_constant(value1) && jit_value_is_constant(value2)
+	   && jit_value_is_constant(value3)
+	   && !jit_context_get_meta_numeric(func->context, JIT_OPTION_DONT_FOLD))
+	{
+		switch(type->kind)
+		{
+		case JIT_TYPE_FLOAT32:
+			return jit_value_create_float32_constant
+				(func, type, jit_float32_fma
+				 (jit_value_get_float32_constant(value1),
+				  jit_value_get_float32_constant(value2),
+				  jit_value_get_float32_constant(value3)));
+
+		case JIT_TYPE_FLOAT64:
+			return jit_value_create_float64_constant
+				(func, type, jit_float64_fma
+				 (jit_value_get_float64_constant(value1),
+				  jit_value_get_float64_constant(value2),
+				  jit_value_get_float64_constant(value3)));
+
+		default:
+			return jit_value_create_nfloat_constant
+				(func, type, jit_nfloat_fma
+				 (jit_value_get_nfloat_constant(value1),
+				  jit_value_get_nfloat_constant(value2),
+				  jit_value_get_nfloat_constant(value3)));
+		}
+	}
+
+#ifdef jit_gen_has_fma
+	/* The instruction has three inputs and only one destination.  So
+	   the destination holds a copy of the addend on input, which the
+	   instruction replaces with the result */
+	if((type->kind == JIT_TYPE_FLOAT32 || type->kind == JIT_TYPE_FLOAT64)
+	   && jit_gen_has_fma(func->context))
+	{
+		result = jit_value_create(func, type);
+		if(!result || !jit_insn_store(func, result, value3))
+		{
+			return 0;
+		}
+		if(!apply_ternary(func, (type->kind == JIT_TYPE_FLOAT32
+					 ? JIT_OP_FFMA : JIT_OP_DFMA),
+				  result, value1, value2))
+		{
+			return 0;
+		}
+		return result;
+	}
+#endif
+
+	/* The back end cannot do it in one instruction, so call the
+	   intrinsic */
+	switch(type->kind)
+	{
+	case JIT_TYPE_FLOAT32:
+		name = "jit_float32_fma";
+		intrinsic = (void *) jit_float32_fma;
+		break;
+
+	case JIT_TYPE_FLOAT64:
+		name = "jit_float64_fma";
+		intrinsic = (void *) jit_float64_fma;
+		break;
+
+	default:
+		name = "jit_nfloat_fma";
+		intrinsic = (void *) jit_nfloat_fma;
+		break;
+	}
+	params[0] = type;
+	params[1] = type;
+	params[2] = type;
+	signature = jit_type_create_signature(jit_abi_cdecl, type, params, 3, 1);
+	if(!signature)
+	{
+		return 0;
+	}
+	args[0] = value1;
+	args[1] = value2;
+	args[2] = value3;
+	result = jit_insn_call_native(func, name, intrinsic, signature,
+				      args, 3, JIT_CALL_NOTHROW);
+	jit_type_free(signature);
+	return result;
+}
+
+jit_value_t
 jit_insn_log(jit_function_t func, jit_value_t value)
 {
 	static jit_opcode_descr const log_descr = {
@@ -4044,6 +4644,578 @@ jit_insn_jump_table(jit_function_t func, jit_value_t value,
 	return jit_insn_new_block(func);
 }
 
+/*
+ * Switch lowering.  The cases are sorted by value and grouped into
+ * clusters.  A run of cases that fills at least SWITCH_MIN_DENSITY
+ * percent of its range becomes a jump table, a short run with only a
+ * few distinct labels becomes a bit test, and the remaining cases are
+ * compared one by one.  The clusters are then dispatched with a
+ * balanced binary search tree.
+ */
+#define SWITCH_MIN_DENSITY	40
+#define SWITCH_MIN_TABLE	4
+#define SWITCH_MAX_TABLE	65536
+#define SWITCH_MIN_BIT_TEST	3
+#define SWITCH_MAX_BIT_LABELS	3
+#define SWITCH_MAX_LINEAR	3
+
+#define SWITCH_SINGLE		0
+#define SWITCH_TABLE		1
+#define SWITCH_BIT_TEST		2
+
+typedef struct
+{
+	jit_ulong		key;
+	jit_label_t		label;
+
+} jit_switch_case;
+
+typedef struct
+{
+	int			kind;
+	unsigned int		first;
+	unsigned int		last;
+
+} jit_switch_cluster;
+
+typedef struct
+{
+	jit_function_t		func;
+	jit_type_t		type;
+	jit_type_t		utype;
+	jit_value_t		value;
+	jit_value_t		uvalue;
+	jit_ulong		flip;
+	int			bits;
+	jit_switch_case		*cases;
+	jit_switch_cluster	*clusters;
+	jit_label_t		end_label;
+
+} jit_switch_state;
+
+/*
+ * Sort the cases by key keeping the original order of equal keys, so
+ * that the first of the duplicate cases wins.
+ */
+static void
+sort_switch_cases(jit_switch_case *cases, jit_switch_case *temp, unsigned int num)
+{
+	unsigned int width, start, middle, end, left, right, index;
+
+	for(width = 1; width < num; width *= 2)
+	{
+		for(start = 0; start < num; start += 2 * width)
+		{
+			middle = (num - start > width) ? start + width : num;
+			end = (num - middle > width) ? middle + width : num;
+			left = start;
+			right = middle;
+			for(index = start; index < end; index++)
+			{
+				if(left < middle
+				   && (right >= end || cases[left].key <= cases[right].key))
+				{
+					temp[index] = cases[left++];
+				}
+				else
+				{
+					temp[index] = cases[right++];
+				}
+			}
+		}
+		for(index = 0; index < num; index++)
+		{
+			cases[index] = temp[index];
+		}
+	}
+}
+
+/*
+ * Create a constant of the given type from a case key.
+ */
+static jit_value_t
+switch_constant(jit_switch_state *state, jit_type_t type, jit_ulong key)
+{
+	if(state->bits == 64)
+	{
+		return jit_value_create_long_constant(state->func, type, (jit_long) key);
+	}
+	if(type == jit_type_int)
+	{
+		return jit_value_create_nint_constant(state->func, type, (jit_int) key);
+	}
+	return jit_value_create_nint_constant(state->func, type, (jit_nint) (jit_uint) key);
+}
+
+/*
+ * Compute the offset of the switch value from the lowest case of the
+ * cluster as an unsigned number.
+ */
+static jit_value_t
+switch_offset(jit_switch_state *state, jit_switch_cluster *cluster)
+{
+	jit_ulong low = state->cases[cluster->first].key ^ state->flip;
+
+	if(low == 0)
+	{
+		return state->uvalue;
+	}
+	return jit_insn_sub(state->func, state->uvalue,
+			    switch_constant(state, state->utype, low));
+}
+
+/*
+ * Dispatch a run of cases through a jump table.  The holes in the table
+ * lead to the end of the switch.
+ */
+static int
+emit_switch_table(jit_switch_state *state, jit_switch_cluster *cluster)
+{
+	jit_switch_case *cases = state->cases;
+	jit_ulong low = cases[cluster->first].key;
+	unsigned int size = (unsigned int) (cases[cluster->last].key - low) + 1;
+	jit_label_t *labels;
+	jit_label_t skip = jit_label_undefined;
+	jit_value_t offset;
+	unsigned int index;
+	int result;
+
+	offset = switch_offset(state, cluster);
+	if(!offset)
+	{
+		return 0;
+	}
+	if(state->bits == 64)
+	{
+		/* The jump table index is a 32-bit integer, so check the range
+		   of a long offset before narrowing it */
+		if(!jit_insn_branch_if_not(state->func,
+					   jit_insn_lt(state->func, offset,
+						       switch_constant(state, state->utype, size)),
+					   &skip))
+		{
+			return 0;
+		}
+		offset = jit_insn_convert(state->func, offset, jit_type_uint, 0);
+		if(!offset)
+		{
+			return 0;
+		}
+	}
+
+	labels = (jit_label_t *) jit_malloc(size * sizeof(jit_label_t));
+	if(!labels)
+	{
+		return 0;
+	}
+	for(index = 0; index < size; index++)
+	{
+		labels[index] = state->end_label;
+	}
+	for(index = cluster->first; index <= cluster->last; index++)
+	{
+		labels[cases[index].key - low] = cases[index].label;
+	}
+	result = jit_insn_jump_table(state->func, offset, labels, size);
+	jit_free(labels);
+	if(!result)
+	{
+		return 0;
+	}
+	if(skip != jit_label_undefined)
+	{
+		return jit_insn_label(state->func, &skip);
+	}
+	return 1;
+}
+
+/*
+ * Dispatch a run of cases that fits into a machine word by testing the
+ * bit that corresponds to the switch value against a mask per label.
+ */
+static int
+emit_switch_bit_test(jit_switch_state *state, jit_switch_cluster *cluster)
+{
+	jit_switch_case *cases = state->cases;
+	jit_ulong low = cases[cluster->first].key;
+	jit_ulong range = cases[cluster->last].key - low;
+	jit_label_t skip = jit_label_undefined;
+	jit_value_t offset, bit, test;
+	jit_ulong mask;
+	unsigned int index, other;
+
+	offset = switch_offset(state, cluster);
+	if(!offset)
+	{
+		return 0;
+	}
+	if(!jit_insn_branch_if(state->func,
+			       jit_insn_gt(state->func, offset,
+					   switch_constant(state, state->utype, range)),
+			       &skip))
+	{
+		return 0;
+	}
+	bit = jit_insn_shl(state->func, switch_constant(state, state->utype, 1), offset);
+	if(!bit)
+	{
+		return 0;
+	}
+
+	for(index = cluster->first; index <= cluster->last; index++)
+	{
+		/* Collect the mask for each label on its first occurrence */
+		for(other = cluster->first; other < index; other++)
+		{
+			if(cases[other].label == cases[index].label)
+			{
+				break;
+			}
+		}
+		if(other < index)
+		{
+			continue;
+		}
+		mask = 0;
+		for(other = index; other <= cluster->last; other++)
+		{
+			if(cases[other].label == cases[index].label)
+			{
+				mask |= ((jit_ulong) 1) << (cases[other].key - low);
+			}
+		}
+		test = jit_insn_and(state->func, bit, switch_constant(state, state->utype, mask));
+		if(!jit_insn_branch_if(state->func, test, &cases[index].label))
+		{
+			return 0;
+		}
+	}
+
+	return jit_insn_label(state->func, &skip);
+}
+
+/*
+ * Dispatch a single cluster.
+ */
+static int
+emit_switch_cluster(jit_switch_state *state, jit_switch_cluster *cluster)
+{
+	jit_switch_case *single;
+
+	switch(cluster->kind)
+	{
+	case SWITCH_TABLE:
+		return emit_switch_table(state, cluster);
+
+	case SWITCH_BIT_TEST:
+		return emit_switch_bit_test(state, cluster);
+	}
+
+	single = &state->cases[cluster->first];
+	return jit_insn_branch_if(state->func,
+				  jit_insn_eq(state->func, state->value,
+					      switch_constant(state, state->type,
+							      single->key ^ state->flip)),
+				  &single->label);
+}
+
+/*
+ * Dispatch the clusters from "first" to "last" with a balanced binary
+ * search tree that ends with a few sequential tests.
+ */
+static int
+emit_switch_tree(jit_switch_state *state, unsigned int first, unsigned int last)
+{
+	jit_label_t upper = jit_label_undefined;
+	unsigned int middle, index;
+
+	if(last - first < SWITCH_MAX_LINEAR)
+	{
+		for(index = first; index <= last; index++)
+		{
+			if(!emit_switch_cluster(state, &state->clusters[index]))
+			{
+				return 0;
+			}
+		}
+		return jit_insn_branch(state->func, &state->end_label);
+	}
+
+	middle = first + (last - first + 1) / 2;
+	index = state->clusters[middle].first;
+	if(!jit_insn_branch_if(state->func,
+			       jit_insn_ge(state->func, state->value,
+					   switch_constant(state, state->type,
+							   state->cases[index].key ^ state->flip)),
+			       &upper))
+	{
+		return 0;
+	}
+	if(!emit_switch_tree(state, first, middle - 1))
+	{
+		return 0;
+	}
+	if(!jit_insn_label(state->func, &upper))
+	{
+		return 0;
+	}
+	return emit_switch_tree(state, middle, last);
+}
+
+/*
+ * Split the sorted cases into clusters and return their number.
+ */
+static unsigned int
+build_switch_clusters(jit_switch_state *state, unsigned int num_cases)
+{
+	jit_switch_case *cases = state->cases;
+	unsigned int num_clusters = 0;
+	unsigned int first, last, index, count, num_labels, other;
+	jit_ulong range;
+
+	for(first = 0; first < num_cases; first = last + 1)
+	{
+		/* Find the longest run that is dense enough for a jump table */
+		last = first;
+		for(index = first + 1; index < num_cases; index++)
+		{
+			range = cases[index].key - cases[first].key;
+			if(range >= SWITCH_MAX_TABLE
+			   || range >= (jit_ulong) num_cases * 100 / SWITCH_MIN_DENSITY)
+			{
+				break;
+			}
+			count = index - first + 1;
+			if(count >= SWITCH_MIN_TABLE
+			   && (jit_ulong) count * 100 >= (range + 1) * SWITCH_MIN_DENSITY)
+			{
+				last = index;
+			}
+		}
+		if(last > first)
+		{
+			state->clusters[num_clusters].kind = SWITCH_TABLE;
+			state->clusters[num_clusters].first = first;
+			state->clusters[num_clusters].last = last;
+			++num_clusters;
+			continue;
+		}
+
+		/* Find the longest run that fits into a word and goes to a
+		   few distinct labels */
+		num_labels = 1;
+		for(index = first + 1; index < num_cases; index++)
+		{
+			if(cases[index].key - cases[first].key >= (jit_ulong) state->bits)
+			{
+				break;
+			}
+			for(other = first; other < index; other++)
+			{
+				if(cases[other].label == cases[index].label)
+				{
+					break;
+				}
+			}
+			if(other == index)
+			{
+				if(num_labels == SWITCH_MAX_BIT_LABELS)
+				{
+					break;
+				}
+				++num_labels;
+			}
+			last = index;
+		}
+		if(last - first + 1 >= SWITCH_MIN_BIT_TEST)
+		{
+			state->clusters[num_clusters].kind = SWITCH_BIT_TEST;
+		}
+		else
+		{
+			last = first;
+			state->clusters[num_clusters].kind = SWITCH_SINGLE;
+		}
+		state->clusters[num_clusters].first = first;
+		state->clusters[num_clusters].last = last;
+		++num_clusters;
+	}
+
+	return num_clusters;
+}
+
+/*@
+ * @deftypefun int jit_insn_switch (jit_function_t @var{func}, jit_value_t @var{value}, const jit_long *@var{values}, jit_label_t *@var{labels}, unsigned int @var{num_cases})
+ * Branch to @code{@var{labels}[i]} if the integer @var{value} is equal to
+ * @code{@var{values}[i]}, or fall through to the next instruction if
+ * none of the case values match.  The value is compared in the type it
+ * promotes to, see @code{jit_type_promote_int}, and the case values are
+ * truncated to that type.  So for a narrower type such as
+ * @code{jit_type_sbyte} a case value outside the range of the type never
+ * matches.  If a value occurs more than once then the first occurrence
+ * wins.  If an entry in @var{labels} has
+ * @code{jit_label_undefined} value then it is replaced with a newly
+ * allocated label.
+ *
+ * Unlike @code{jit_insn_jump_table} the case values need not be dense.
+ * The cases are split into clusters that are dispatched with a balanced
+ * binary search.  Dense runs of values use a jump table, short runs that
+ * lead to a few distinct labels use a bit test, and the rest are compared
+ * one by one.  Returns zero if out of memory or if @var{value} does not
+ * have an integer type.
+ * @end deftypefun
+@*/
+int
+jit_insn_switch(jit_function_t func, jit_value_t value, const jit_long *values,
+		jit_label_t *labels, unsigned int num_cases)
+{
+	jit_switch_state state;
+	jit_switch_case *temp;
+	unsigned int index, num_unique, num_clusters;
+	jit_ulong key;
+	int result;
+
+	/* Ensure that we have a function builder */
+	if(!_jit_function_ensure_builder(func))
+	{
+		return 0;
+	}
+
+	/* Determine the type to compare the value and the cases in */
+	state.func = func;
+	state.value = value;
+	state.uvalue = 0;
+	state.type = jit_type_promote_int(jit_type_normalize(value->type));
+	if(state.type == jit_type_int)
+	{
+		state.utype = jit_type_uint;
+		state.flip = ((jit_ulong) 1) << 31;
+		state.bits = 32;
+	}
+	else if(state.type == jit_type_uint)
+	{
+		state.utype = jit_type_uint;
+		state.flip = 0;
+		state.bits = 32;
+	}
+	else if(state.type == jit_type_long)
+	{
+		state.utype = jit_type_ulong;
+		state.flip = ((jit_ulong) 1) << 63;
+		state.bits = 64;
+	}
+	else if(state.type == jit_type_ulong)
+	{
+		state.utype = jit_type_ulong;
+		state.flip = 0;
+		state.bits = 64;
+	}
+	else
+	{
+		return 0;
+	}
+
+	/* Allocate new label identifiers, if necessary */
+	for(index = 0; index < num_cases; index++)
+	{
+		if(labels[index] == jit_label_undefined)
+		{
+			labels[index] = func->builder->next_label++;
+		}
+	}
+
+	/* Nothing to do but fall through if there are no cases */
+	if(!num_cases)
+	{
+		return 1;
+	}
+
+	/* Map the case values to unsigned keys that keep their order */
+	state.cases = jit_malloc(2 * num_cases * sizeof(jit_switch_case));
+	if(!state.cases)
+	{
+		return 0;
+	}
+	temp = state.cases + num_cases;
+	for(index = 0; index < num_cases; index++)
+	{
+		key = (jit_ulong) values[index];
+		if(state.bits == 32)
+		{
+			key = (jit_uint) key;
+		}
+		state.cases[index].key = key ^ state.flip;
+		state.cases[index].label = labels[index];
+	}
+	sort_switch_cases(state.cases, temp, num_cases);
+	num_unique = 1;
+	for(index = 1; index < num_cases; index++)
+	{
+		if(state.cases[index].key != state.cases[num_unique - 1].key)
+		{
+			state.cases[num_unique++] = state.cases[index];
+		}
+	}
+
+	/* A constant value branches directly to the matching label */
+	if(jit_value_is_constant(value))
+	{
+		if(state.bits == 64)
+		{
+			key = (jit_ulong) jit_value_get_long_constant(value);
+		}
+		else
+		{
+			key = (jit_uint) jit_value_get_nint_constant(value);
+		}
+		key ^= state.flip;
+		result = 1;
+		for(index = 0; index < num_unique; index++)
+		{
+			if(state.cases[index].key == key)
+			{
+				result = jit_insn_branch(func, &state.cases[index].label);
+				break;
+			}
+		}
+		jit_free(state.cases);
+		return result;
+	}
+
+	state.clusters = jit_malloc(num_unique * sizeof(jit_switch_cluster));
+	if(!state.clusters)
+	{
+		jit_free(state.cases);
+		return 0;
+	}
+	num_clusters = build_switch_clusters(&state, num_unique);
+
+	/* The jump tables and bit tests work on the unsigned value, convert
+	   it up front as the clusters are reached on different paths */
+	for(index = 0; index < num_clusters; index++)
+	{
+		if(state.clusters[index].kind != SWITCH_SINGLE)
+		{
+			state.uvalue = jit_insn_convert(func, value, state.utype, 0);
+			if(!state.uvalue)
+			{
+				jit_free(state.clusters);
+				jit_free(state.cases);
+				return 0;
+			}
+			break;
+		}
+	}
+
+	state.end_label = func->builder->next_label++;
+	result = emit_switch_tree(&state, 0, num_clusters - 1)
+		&& jit_insn_label(func, &state.end_label);
+
+	jit_free(state.clusters);
+	jit_free(state.cases);
+	return result;
+}
+
 /*@
  * @deftypefun jit_value_t jit_insn_address_of (jit_function_t @var{func}, jit_value_t @var{value1})
  * Get the address of a value into a new temporary.
@@ -5296,32 +6468,74 @@ signature_identical(jit_type_t type1, jit_type_t type2)
 	/* Signature types must be compared component-by-component */
 	if(type1->kind == JIT_TYPE_SIGNATURE)
 	{
-		if(type1->abi != type2->abi)
-		{
-			return 0;
-		}
-		if(!signature_identical(type1->sub_type, type2->sub_type))
+		if(type1->abi != type2->abi)
+		{
+			return 0;
+		}
+		if(!signature_identical(type1->sub_type, type2->sub_type))
+		{
+			return 0;
+		}
+		if(type1->num_components != type2->num_components)
+		{
+			return 0;
+		}
+
+		unsigned int param;
+		for(param = 0; param < type1->num_components; ++param)
+		{
+			if(!signature_identical(type1->components[param].type,
+						type2->components[param].type))
+			{
+				return 0;
+			}
+		}
+	}
+
+	/* If we get here, then the types are compatible */
+	return 1;
+}
+
+/*
+ * Determine if a call with the given signature can be made as a tail
+ * call from "func".  A tail call to the function itself becomes a branch
+ * to its entry point, so the signatures must be identical.  A tail call
+ * to another function passes the arguments the same way as a regular
+ * call on back ends that define JIT_GENERAL_TAIL_CALLS, so only the
+ * return values need to agree.  Elsewhere the arguments are stored back
+ * into our own parameters and the signatures must be identical again.
+ */
+static int
+tail_call_possible(jit_function_t func, jit_type_t signature, int is_self, int is_nested)
+{
+	/* Cannot use tail calls with nested function calls */
+	if(is_nested || func->nested_parent)
+	{
+		return 0;
+	}
+
+#ifdef JIT_GENERAL_TAIL_CALLS
+	if(!is_self)
+	{
+		jit_type_t return_type;
+
+		if(jit_type_get_abi(signature) != jit_type_get_abi(func->signature)
+		   || jit_type_get_abi(signature) == jit_abi_vararg)
 		{
 			return 0;
 		}
-		if(type1->num_components != type2->num_components)
+		return_type = jit_type_get_return(signature);
+		if(!signature_identical(return_type, jit_type_get_return(func->signature)))
 		{
 			return 0;
 		}
 
-		unsigned int param;
-		for(param = 0; param < type1->num_components; ++param)
-		{
-			if(!signature_identical(type1->components[param].type,
-						type2->components[param].type))
-			{
-				return 0;
-			}
-		}
+		/* The callee would need our own structure return pointer */
+		return !jit_type_return_via_pointer(return_type);
 	}
+#endif
 
-	/* If we get here, then the types are compatible */
-	return 1;
+	return signature_identical(signature, func->signature);
 }
 
 /*
@@ -5337,6 +6551,17 @@ create_call_setup_insns(jit_function_t func, jit_function_t callee,
 	jit_value_t *new_args;
 	unsigned int arg_num;
 
+#ifdef JIT_GENERAL_TAIL_CALLS
+	/* Tail calls to other functions pass the arguments like regular
+	   calls, the back end checks that they fit in our incoming area */
+	if((flags & JIT_CALL_TAIL) != 0 && callee != func)
+	{
+		return _jit_create_call_setup_insns(func, signature, args, num_args,
+						    is_nested, parent_frame,
+						    struct_return, flags);
+	}
+#endif
+
 	/* If we are performing a tail call, then duplicate the argument
 	   values so that we don't accidentally destroy parameters in
 	   situations like func(x, y) -> func(y, x) */
@@ -5461,11 +6686,20 @@ handle_return(jit_function_t func,
  *
  * @vindex JIT_CALL_TAIL
  * @item JIT_CALL_TAIL
- * Apply tail call optimizations, as the result of this function
- * call will be immediately returned from the containing function.
- * Tail calls are only appropriate when the signature of the called
- * function matches the callee, and none of the parameters point
- * to local variables.
+ * Make a tail call, as the result of this function call will be
+ * immediately returned from the containing function.  The call replaces
+ * the frame of the containing function, so a chain of tail calls runs
+ * in constant stack space.  None of the arguments may point to local
+ * variables of the containing function.
+ *
+ * A tail call to the containing function itself requires the same
+ * signature.  On x86-64 and in the interpreter a tail call to another
+ * function only requires the same ABI and the same return type, which
+ * must not be returned via a hidden structure pointer.  On x86-64 all
+ * of its arguments must also be passed in registers.  Elsewhere the
+ * signatures must be identical.  Nested functions cannot be tail called.
+ * If a tail call cannot be made then @code{jit_insn_call} returns NULL
+ * instead of falling back to a regular call.
  * @end table
  *
  * If @var{jit_func} has already been compiled, then @code{jit_insn_call}
@@ -5497,18 +6731,11 @@ jit_insn_call(jit_function_t func, const char *name, jit_function_t jit_func,
 	}
 
 	/* Verify that tail calls are possible to the destination */
-	if((flags & JIT_CALL_TAIL) != 0)
+	if((flags & JIT_CALL_TAIL) != 0
+	   && !tail_call_possible(func, signature, func == jit_func,
+				  jit_func->nested_parent != 0))
 	{
-		if(func->nested_parent || jit_func->nested_parent)
-		{
-			/* Cannot use tail calls with nested function calls */
-			flags &= ~JIT_CALL_TAIL;
-		}
-		else if(!signature_identical(signature, func->signature))
-		{
-			/* The signatures are not the same, so tail calls not allowed */
-			flags &= ~JIT_CALL_TAIL;
-		}
+		return 0;
 	}
 
 	/* Determine the nesting relationship with the current function */
@@ -5638,21 +6865,18 @@ jit_insn_call_nested_indirect(jit_function_t func, jit_value_t value,
 	}
 
 	/* Verify that tail calls are possible to the destination */
-#if defined(JIT_BACKEND_INTERP)
-	flags &= ~JIT_CALL_TAIL;
-#else
 	if((flags & JIT_CALL_TAIL) != 0)
 	{
-		if(is_nested || func->nested_parent)
-		{
-			flags &= ~JIT_CALL_TAIL;
-		}
-		else if(!signature_identical(signature, func->signature))
+#if defined(JIT_BACKEND_INTERP)
+		/* The interpreter calls native functions through jit_apply */
+		return 0;
+#else
+		if(!tail_call_possible(func, signature, 0, is_nested))
 		{
-			flags &= ~JIT_CALL_TAIL;
+			return 0;
 		}
-	}
 #endif
+	}
 
 	/* We are making a native call */
 	flags |= JIT_CALL_NATIVE;
@@ -5755,16 +6979,9 @@ jit_insn_call_indirect_vtable(jit_function_t func, jit_value_t value, jit_type_t
 	}
 
 	/* Verify that tail calls are possible to the destination */
-	if((flags & JIT_CALL_TAIL) != 0)
+	if((flags & JIT_CALL_TAIL) != 0 && !tail_call_possible(func, signature, 0, 0))
 	{
-		if(func->nested_parent)
-		{
-			flags &= ~JIT_CALL_TAIL;
-		}
-		else if(!signature_identical(signature, func->signature))
-		{
-			flags &= ~JIT_CALL_TAIL;
-		}
+		return 0;
 	}
 
 	/* Convert the arguments to the actual parameter types */
@@ -5844,21 +7061,18 @@ jit_insn_call_native(jit_function_t func, const char *name, void *native_func,
 	}
 
 	/* Verify that tail calls are possible to the destination */
-#if defined(JIT_BACKEND_INTERP)
-	flags &= ~JIT_CALL_TAIL;
-#else
 	if((flags & JIT_CALL_TAIL) != 0)
 	{
-		if(func->nested_parent)
-		{
-			flags &= ~JIT_CALL_TAIL;
-		}
-		else if(!signature_identical(signature, func->signature))
+#if defined(JIT_BACKEND_INTERP)
+		/* The interpreter calls native functions through jit_apply */
+		return 0;
+#else
+		if(!tail_call_possible(func, signature, 0, 0))
 		{
-			flags &= ~JIT_CALL_TAIL;
+			return 0;
 		}
-	}
 #endif
+	}
 
 	/* We are making a native call */
 	flags |= JIT_CALL_NATIVE;
@@ -7840,6 +9054,404 @@ jit_insn_alloca(jit_function_t func, jit_value_t size)
 	return apply_unary(func, JIT_OP_ALLOCA, size, jit_type_void_ptr);
 }
 
+/*
+ * Opcodes and intrinsics for an atomic operation.
+ */
+typedef struct jit_atomic_descr
+{
+	short			ioper;		/* Opcode for "int" and "uint" */
+	short			loper;		/* Opcode for "long" and "ulong" */
+
+	void			*ifunc;		/* Function for "int" and "uint" */
+	const char		*iname;		/* Intrinsic name for "int" */
+
+	void			*lfunc;		/* Function for "long" and "ulong" */
+	const char		*lname;		/* Intrinsic name for "long" */
+
+} jit_atomic_descr;
+
+#define	jit_atomic_intrinsic(name)	(void *)name, #name
+
+/*
+ * Get the type of the memory word for an atomic operation on values
+ * of the given type.  Returns NULL if there are no atomic operations
+ * for the type.
+ */
+static jit_type_t
+atomic_type(jit_type_t type)
+{
+	type = jit_type_normalize(type);
+	if(type == jit_type_int || type == jit_type_uint
+	   || type == jit_type_long || type == jit_type_ulong)
+	{
+		return type;
+	}
+	return 0;
+}
+
+/*
+ * Get the opcode of an atomic operation on values of the given type.
+ */
+static int
+atomic_opcode(const jit_atomic_descr *descr, jit_type_t type)
+{
+	if(type == jit_type_long || type == jit_type_ulong)
+	{
+		return descr->loper;
+	}
+	return descr->ioper;
+}
+
+/*
+ * Call the intrinsic that implements an atomic operation if the back end
+ * has no rule for its opcode.  The first argument is the pointer and the
+ * rest are of the given type.
+ */
+static jit_value_t
+call_atomic_intrinsic(jit_function_t func, const jit_atomic_descr *descr,
+		      jit_type_t type, jit_type_t return_type,
+		      jit_value_t *args, unsigned int num_args)
+{
+	jit_type_t param_types[3];
+	jit_type_t signature;
+	jit_value_t value;
+	unsigned int index;
+
+	param_types[0] = jit_type_void_ptr;
+	for(index = 1; index < num_args; index++)
+	{
+		param_types[index] = type;
+	}
+	signature = jit_type_create_signature(jit_abi_cdecl, return_type,
+					      param_types, num_args, 1);
+	if(!signature)
+	{
+		return 0;
+	}
+	if(type == jit_type_long || type == jit_type_ulong)
+	{
+		value = jit_insn_call_native(func, descr->lname, descr->lfunc,
+					     signature, args, num_args,
+					     JIT_CALL_NOTHROW);
+	}
+	else
+	{
+		value = jit_insn_call_native(func, descr->iname, descr->ifunc,
+					     signature, args, num_args,
+					     JIT_CALL_NOTHROW);
+	}
+	jit_type_free(signature);
+	return value;
+}
+
+/*
+ * Apply an atomic read-modify-write operation.
+ */
+static jit_value_t
+apply_atomic(jit_function_t func, const jit_atomic_descr *descr,
+	     jit_value_t ptr, jit_value_t value)
+{
+	jit_type_t type = atomic_type(jit_value_get_type(value));
+	if(!type)
+	{
+		return 0;
+	}
+	ptr = jit_insn_convert(func, ptr, jit_type_void_ptr, 0);
+	value = jit_insn_convert(func, value, type, 0);
+	if(!ptr || !value)
+	{
+		return 0;
+	}
+
+	int oper = atomic_opcode(descr, type);
+	if(!_jit_opcode_is_supported(oper))
+	{
+		jit_value_t args[2];
+		args[0] = ptr;
+		args[1] = value;
+		return call_atomic_intrinsic(func, descr, type, type, args, 2);
+	}
+	return apply_binary(func, oper, ptr, value, type);
+}
+
+/*@
+ * @deftypefun jit_value_t jit_insn_atomic_load (jit_function_t @var{func}, jit_value_t @var{ptr}, jit_type_t @var{type}, int @var{order})
+ * Atomically load a value of the specified @var{type} from the memory
+ * at @var{ptr}.  The @var{type} must be a 32-bit or 64-bit integer or
+ * pointer type.  The @var{order} is one of @code{JIT_MEMORY_ORDER_RELAXED},
+ * @code{JIT_MEMORY_ORDER_ACQUIRE}, or @code{JIT_MEMORY_ORDER_SEQ_CST},
+ * with the same meaning as the corresponding C11 memory orders.
+ * Returns NULL if the type or the memory order is not valid for a load.
+ * @end deftypefun
+@*/
+jit_value_t
+jit_insn_atomic_load(jit_function_t func, jit_value_t ptr, jit_type_t type, int order)
+{
+	static jit_atomic_descr const load_descr = {
+		JIT_OP_ATOMIC_LOAD_INT,
+		JIT_OP_ATOMIC_LOAD_LONG,
+		jit_atomic_intrinsic(jit_int_atomic_load),
+		jit_atomic_intrinsic(jit_long_atomic_load)
+	};
+
+	type = atomic_type(type);
+	if(!type || order < JIT_MEMORY_ORDER_RELAXED || order > JIT_MEMORY_ORDER_SEQ_CST
+	   || order == JIT_MEMORY_ORDER_RELEASE || order == JIT_MEMORY_ORDER_ACQ_REL)
+	{
+		return 0;
+	}
+	ptr = jit_insn_convert(func, ptr, jit_type_void_ptr, 0);
+	if(!ptr)
+	{
+		return 0;
+	}
+
+	int oper = atomic_opcode(&load_descr, type);
+	if(!_jit_opcode_is_supported(oper))
+	{
+		return call_atomic_intrinsic(func, &load_descr, type, type, &ptr, 1);
+	}
+	jit_value_t value = jit_value_create_nint_constant(func, jit_type_int, order);
+	if(!value)
+	{
+		return 0;
+	}
+	return apply_binary(func, oper, ptr, value, type);
+}
+
+/*@
+ * @deftypefun int jit_insn_atomic_store (jit_function_t @var{func}, jit_value_t @var{ptr}, jit_value_t @var{value}, int @var{order})
+ * Atomically store @var{value} to the memory at @var{ptr}.  The type of
+ * @var{value} must be a 32-bit or 64-bit integer or pointer type.
+ * The @var{order} is one of @code{JIT_MEMORY_ORDER_RELAXED},
+ * @code{JIT_MEMORY_ORDER_RELEASE}, or @code{JIT_MEMORY_ORDER_SEQ_CST}.
+ * Returns zero if the type or the memory order is not valid for a store.
+ * @end deftypefun
+@*/
+int
+jit_insn_atomic_store(jit_function_t func, jit_value_t ptr, jit_value_t value, int order)
+{
+	static jit_atomic_descr const store_descr = {
+		JIT_OP_ATOMIC_STORE_INT,
+		JIT_OP_ATOMIC_STORE_LONG,
+		jit_atomic_intrinsic(jit_int_atomic_store),
+		jit_atomic_intrinsic(jit_long_atomic_store)
+	};
+
+	jit_type_t type = atomic_type(jit_value_get_type(value));
+	if(!type || order < JIT_MEMORY_ORDER_RELAXED || order > JIT_MEMORY_ORDER_SEQ_CST
+	   || order == JIT_MEMORY_ORDER_ACQUIRE || order == JIT_MEMORY_ORDER_ACQ_REL)
+	{
+		return 0;
+	}
+	ptr = jit_insn_convert(func, ptr, jit_type_void_ptr, 0);
+	value = jit_insn_convert(func, value, type, 0);
+	if(!ptr || !value)
+	{
+		return 0;
+	}
+
+	int oper = atomic_opcode(&store_descr, type);
+	if(!_jit_opcode_is_supported(oper))
+	{
+		jit_value_t args[2];
+		args[0] = ptr;
+		args[1] = value;
+		return call_atomic_intrinsic(func, &store_descr, type, jit_type_void,
+					     args, 2) != 0;
+	}
+	jit_value_t order_value = jit_value_create_nint_constant(func, jit_type_int, order);
+	if(!order_value)
+	{
+		return 0;
+	}
+	return apply_ternary(func, oper, ptr, value, order_value);
+}
+
+/*@
+ * @deftypefun jit_value_t jit_insn_atomic_exchange (jit_function_t @var{func}, jit_value_t @var{ptr}, jit_value_t @var{value})
+ * Atomically replace the value in the memory at @var{ptr} with
+ * @var{value} and return the previous value.  The type of @var{value}
+ * must be a 32-bit or 64-bit integer or pointer type.
+ *
+ * This and the other atomic read-modify-write instructions are always
+ * sequentially consistent.
+ * @end deftypefun
+@*/
+jit_value_t
+jit_insn_atomic_exchange(jit_function_t func, jit_value_t ptr, jit_value_t value)
+{
+	static jit_atomic_descr const exchange_descr = {
+		JIT_OP_ATOMIC_EXCHANGE_INT,
+		JIT_OP_ATOMIC_EXCHANGE_LONG,
+		jit_atomic_intrinsic(jit_int_atomic_exchange),
+		jit_atomic_intrinsic(jit_long_atomic_exchange)
+	};
+	return apply_atomic(func, &exchange_descr, ptr, value);
+}
+
+/*@
+ * @deftypefun jit_value_t jit_insn_atomic_compare_exchange (jit_function_t @var{func}, jit_value_t @var{ptr}, jit_value_t @var{expected}, jit_value_t @var{desired})
+ * Atomically compare the value in the memory at @var{ptr} with
+ * @var{expected} and replace it with @var{desired} if they are equal.
+ * Returns the value that was in memory before the operation, so the
+ * exchange took place if and only if the result is equal to
+ * @var{expected}.  The type of the operation is the type of
+ * @var{desired}, which must be a 32-bit or 64-bit integer or pointer type.
+ * @end deftypefun
+@*/
+jit_value_t
+jit_insn_atomic_compare_exchange(jit_function_t func, jit_value_t ptr,
+				 jit_value_t expected, jit_value_t desired)
+{
+	static jit_atomic_descr const compare_exchange_descr = {
+		JIT_OP_ATOMIC_COMPARE_EXCHANGE_INT,
+		JIT_OP_ATOMIC_COMPARE_EXCHANGE_LONG,
+		jit_atomic_intrinsic(jit_int_atomic_compare_exchange),
+		jit_atomic_intrinsic(jit_long_atomic_compare_exchange)
+	};
+
+	jit_type_t type = atomic_type(jit_value_get_type(desired));
+	if(!type)
+	{
+		return 0;
+	}
+	ptr = jit_insn_convert(func, ptr, jit_type_void_ptr, 0);
+	expected = jit_insn_convert(func, expected, type, 0);
+	desired = jit_insn_convert(func, desired, type, 0);
+	if(!ptr || !expected || !desired)
+	{
+		return 0;
+	}
+
+	int oper = atomic_opcode(&compare_exchange_descr, type);
+	if(!_jit_opcode_is_supported(oper))
+	{
+		jit_value_t args[3];
+		args[0] = ptr;
+		args[1] = expected;
+		args[2] = desired;
+		return call_atomic_intrinsic(func, &compare_exchange_descr, type, type,
+					     args, 3);
+	}
+
+	/* The instruction has two results, whether the exchange took place
+	   and the old value, and only one destination.  So it is passed the
+	   address of a slot holding the expected value and replaces it with
+	   the old value like the C11 compare_exchange functions do */
+	jit_value_t result = jit_value_create(func, type);
+	if(!result || !jit_insn_store(func, result, expected))
+	{
+		return 0;
+	}
+	jit_value_t addr = jit_insn_address_of(func, result);
+	if(!addr)
+	{
+		return 0;
+	}
+	if(!apply_ternary(func, oper, ptr, addr, desired))
+	{
+		return 0;
+	}
+	return result;
+}
+
+/*@
+ * @deftypefun jit_value_t jit_insn_atomic_fetch_add (jit_function_t @var{func}, jit_value_t @var{ptr}, jit_value_t @var{value})
+ * @deftypefunx jit_value_t jit_insn_atomic_fetch_and (jit_function_t @var{func}, jit_value_t @var{ptr}, jit_value_t @var{value})
+ * @deftypefunx jit_value_t jit_insn_atomic_fetch_or (jit_function_t @var{func}, jit_value_t @var{ptr}, jit_value_t @var{value})
+ * @deftypefunx jit_value_t jit_insn_atomic_fetch_xor (jit_function_t @var{func}, jit_value_t @var{ptr}, jit_value_t @var{value})
+ * Atomically add @var{value} to, or compute the bitwise and, or, or xor
+ * of @var{value} with the value in the memory at @var{ptr}, and return
+ * the previous value.  The type of the operation is the type of
+ * @var{value}, which must be a 32-bit or 64-bit integer or pointer type.
+ * The addition wraps around on overflow.
+ * @end deftypefun
+@*/
+jit_value_t
+jit_insn_atomic_fetch_add(jit_function_t func, jit_value_t ptr, jit_value_t value)
+{
+	static jit_atomic_descr const fetch_add_descr = {
+		JIT_OP_ATOMIC_FETCH_ADD_INT,
+		JIT_OP_ATOMIC_FETCH_ADD_LONG,
+		jit_atomic_intrinsic(jit_int_atomic_fetch_add),
+		jit_atomic_intrinsic(jit_long_atomic_fetch_add)
+	};
+	return apply_atomic(func, &fetch_add_descr, ptr, value);
+}
+
+jit_value_t
+jit_insn_atomic_fetch_and(jit_function_t func, jit_value_t ptr, jit_value_t value)
+{
+	static jit_atomic_descr const fetch_and_descr = {
+		JIT_OP_ATOMIC_FETCH_AND_INT,
+		JIT_OP_ATOMIC_FETCH_AND_LONG,
+		jit_atomic_intrinsic(jit_int_atomic_fetch_and),
+		jit_atomic_intrinsic(jit_long_atomic_fetch_and)
+	};
+	return apply_atomic(func, &fetch_and_descr, ptr, value);
+}
+
+jit_value_t
+jit_insn_atomic_fetch_or(jit_function_t func, jit_value_t ptr, jit_value_t value)
+{
+	static jit_atomic_descr const fetch_or_descr = {
+		JIT_OP_ATOMIC_FETCH_OR_INT,
+		JIT_OP_ATOMIC_FETCH_OR_LONG,
+		jit_atomic_intrinsic(jit_int_atomic_fetch_or),
+		jit_atomic_intrinsic(jit_long_atomic_fetch_or)
+	};
+	return apply_atomic(func, &fetch_or_descr, ptr, value);
+}
+
+jit_value_t
+jit_insn_atomic_fetch_xor(jit_function_t func, jit_value_t ptr, jit_value_t value)
+{
+	static jit_atomic_descr const fetch_xor_descr = {
+		JIT_OP_ATOMIC_FETCH_XOR_INT,
+		JIT_OP_ATOMIC_FETCH_XOR_LONG,
+		jit_atomic_intrinsic(jit_int_atomic_fetch_xor),
+		jit_atomic_intrinsic(jit_long_atomic_fetch_xor)
+	};
+	return apply_atomic(func, &fetch_xor_descr, ptr, value);
+}
+
+/*@
+ * @deftypefun int jit_insn_fence (jit_function_t @var{func}, int @var{order})
+ * Output a memory fence with the specified @var{order}, which is one of
+ * the @code{JIT_MEMORY_ORDER_*} constants.  Memory accesses are not moved
+ * across the fence by the optimizer with any order.
+ * @end deftypefun
+@*/
+int
+jit_insn_fence(jit_function_t func, int order)
+{
+	if(order < JIT_MEMORY_ORDER_RELAXED || order > JIT_MEMORY_ORDER_SEQ_CST)
+	{
+		return 0;
+	}
+	if(!_jit_opcode_is_supported(JIT_OP_FENCE))
+	{
+		jit_type_t signature = jit_type_create_signature(jit_abi_cdecl, jit_type_void,
+								 0, 0, 1);
+		if(!signature)
+		{
+			return 0;
+		}
+		jit_value_t value = jit_insn_call_native(func, "jit_atomic_fence",
+							 (void *) jit_atomic_fence,
+							 signature, 0, 0, JIT_CALL_NOTHROW);
+		jit_type_free(signature);
+		return value != 0;
+	}
+	jit_value_t value = jit_value_create_nint_constant(func, jit_type_int, order);
+	if(!value)
+	{
+		return 0;
+	}
+	return create_unary_note(func, JIT_OP_FENCE, value);
+}
+
 /*@
  * @deftypefun int jit_insn_move_blocks_to_end (jit_function_t @var{func}, jit_label_t @var{from_label}, jit_label_t @var{to_label})
  * Move all of the blocks between @var{from_label} (inclusive) and
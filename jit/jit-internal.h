@@ -160,15 +160,25 @@ typedef struct
 	unsigned int		elems_in_last;
 	jit_pool_block_t	blocks;
 	void			*free_list;
+	jit_context_t		context;
 
 } jit_memory_pool;
 
 /*
- * Initialize a memory pool.
+ * Size of the memory blocks that are used by pools and arenas.  All the
+ * blocks have the same size so that a context is able to recycle them
+ * regardless of the pool they came from.
+ */
+#define	JIT_POOL_BLOCK_SIZE	4096
+
+/*
+ * Initialize a memory pool.  If the context is not NULL then the pool
+ * blocks are obtained from and returned to the context workspace.
  */
-void _jit_memory_pool_init(jit_memory_pool *pool, unsigned int elem_size);
-#define	jit_memory_pool_init(pool,type)	\
-			_jit_memory_pool_init((pool), sizeof(type))
+void _jit_memory_pool_init(jit_memory_pool *pool, unsigned int elem_size,
+			   jit_context_t context);
+#define	jit_memory_pool_init(pool,type,context)	\
+			_jit_memory_pool_init((pool), sizeof(type), (context))
 
 /*
  * Free the contents of a memory pool.
@@ -190,6 +200,52 @@ void _jit_memory_pool_dealloc(jit_memory_pool *pool, void *item);
 #define	jit_memory_pool_dealloc(pool,item)	\
 			(_jit_memory_pool_dealloc((pool), (item)))
 
+/*
+ * Structure of a memory arena.  An arena hands out variable-sized
+ * chunks of memory that are all released at once.
+ */
+typedef struct
+{
+	jit_pool_block_t	blocks;
+	jit_pool_block_t	large_blocks;
+	unsigned int		used;
+	jit_context_t		context;
+
+} jit_memory_arena;
+
+/*
+ * Initialize a memory arena.
+ */
+void _jit_memory_arena_init(jit_memory_arena *arena, jit_context_t context);
+
+/*
+ * Allocate uninitialized memory from an arena.
+ */
+void *_jit_memory_arena_alloc(jit_memory_arena *arena, unsigned int size);
+
+/*
+ * Free all the memory allocated from an arena.
+ */
+void _jit_memory_arena_free(jit_memory_arena *arena);
+
+/*
+ * Get a memory block of JIT_POOL_BLOCK_SIZE bytes from the context
+ * workspace.  Blocks that were released by previously built functions
+ * are reused if possible.
+ */
+void *_jit_workspace_alloc_block(jit_context_t context);
+
+/*
+ * Return a memory block to the context workspace.  The block is kept
+ * for reuse unless this would exceed the JIT_OPTION_WORKSPACE_LIMIT.
+ */
+void _jit_workspace_free_block(jit_context_t context, void *block);
+
+/*
+ * Release all the memory blocks retained by the context workspace.
+ */
+void _jit_workspace_destroy(jit_context_t context);
+
 /*
  * Storage for metadata.
  */
@@ -243,15 +299,22 @@ struct _jit_block
 	/* Edges to successor blocks in control flow graph */
 	_jit_edge_t		*succs;
 	int			num_succs;
+	int			max_succs;
 
 	/* Edges to predecessor blocks in control flow graph */
 	_jit_edge_t		*preds;
 	int			num_preds;
+	int			max_preds;
+
+	/* Position of the block in the current block order, -1 if the
+	   block is not reachable from the entry block */
+	int			index;
 
 	/* Control flow flags */
 	unsigned		visited : 1;
 	unsigned		ends_in_dead : 1;
 	unsigned		address_of : 1;
+	unsigned		is_cold : 1;
 
 	/* Metadata */
 	jit_meta_t		meta;
@@ -308,6 +371,14 @@ void _jit_value_free(void *value);
  */
 void _jit_value_ref_params(jit_function_t func);
 
+/*
+ * Determine if the "jit_type_nfloat" arithmetic of a function is done
+ * in "jit_type_float64" instead.
+ */
+#define _jit_nfloat_as_float64(func)					\
+	(jit_context_get_meta_numeric((func)->context,			\
+				      JIT_OPTION_NFLOAT_AS_FLOAT64) != 0)
+
 /*
  * Internal structure of an instruction.
  */
@@ -389,6 +460,10 @@ struct _jit_builder
 	/* Blocks sorted in order required by an optimization pass */
 	jit_block_t		*block_order;
 	int			num_block_order;
+	int			max_block_order;
+
+	/* Scratch stack for control flow graph traversal */
+	void			*block_stack;
 
 	/* The next block label to be allocated */
 	jit_label_t		next_label;
@@ -419,11 +494,20 @@ struct _jit_builder
 	/* Generate position-independent code */
 	unsigned		position_independent : 1;
 
+	/* Flags that turn off optional compilation passes to save time */
+	unsigned		no_cfg_optimization : 1;
+	unsigned		no_propagation : 1;
+	unsigned		no_global_liveness : 1;
+	unsigned		no_global_registers : 1;
+
 	/* Memory pools that contain values, instructions, and metadata blocks */
 	jit_memory_pool		value_pool;
 	jit_memory_pool		edge_pool;
 	jit_memory_pool		meta_pool;
 
+	/* Memory for control flow graph edge arrays and block orders */
+	jit_memory_arena	cfg_arena;
+
 	/* Common constants that have been cached */
 	jit_value_t		null_constant;
 	jit_value_t		zero_constant;
@@ -493,6 +577,10 @@ struct _jit_function
 	unsigned		no_return : 1;
 	unsigned		has_try : 1;
 	unsigned		optimization_level : 8;
+	unsigned		schedule_insns : 1;
+
+	/* Compilation time budget in microseconds, zero if not limited */
+	jit_uint		compile_budget;
 
 	/* Flag set once the function is compiled */
 	int volatile		is_compiled;
@@ -594,6 +682,22 @@ struct _jit_context
 
 	/* On-demand compilation driver */
 	jit_on_demand_driver_func	on_demand_driver;
+
+	/* Memory blocks retained for reuse by the function builders */
+	jit_mutex_t		workspace_lock;
+	jit_pool_block_t	workspace_blocks;
+	jit_nuint		workspace_size;
+
+	/* Total time in microseconds and number of instructions of the
+	   functions compiled with all passes, guarded by the memory lock */
+	jit_ulong		compile_time;
+	jit_ulong		compile_insns;
+
+	/* Code generation statistics, guarded by the memory lock */
+	jit_ulong		num_functions;
+	jit_ulong		code_bytes;
+	jit_ulong		peephole_insns;
+	jit_ulong		peephole_bytes;
 };
 
 void *_jit_malloc_exec(unsigned int size);
@@ -691,6 +795,36 @@ void _jit_block_clean_cfg(jit_function_t func);
  */
 int _jit_block_compute_postorder(jit_function_t func);
 
+/*
+ * Move rarely executed blocks to the end of a function.
+ */
+void _jit_block_layout(jit_function_t func);
+
+/*
+ * Move loop invariant code out of loops, reduce the strength of the
+ * induction variable computations and remove redundant bounds checks.
+ */
+void _jit_loop_optimize(jit_function_t func);
+
+/*
+ * Split the local variables accessed only by fields into scalars, then
+ * replace the loads of the values known to be in memory with the values
+ * and remove the stores overwritten before they are read.
+ */
+void _jit_alias_optimize(jit_function_t func);
+
+/*
+ * Fold the address computations used only by pointer-relative loads
+ * and stores into their offsets and into array element accesses.
+ */
+void _jit_select_addresses(jit_function_t func);
+
+/*
+ * Reorder the instructions within the blocks so that the results of
+ * the long latency instructions are not used right away.
+ */
+void _jit_schedule_insns(jit_function_t func);
+
 /*
  * Create a new block and associate it with a function.
  */
@@ -754,6 +888,13 @@ void _jit_meta_free_one(void *meta);
  */
 int _jit_insn_check_is_redundant(const jit_insn_iter_t *iter);
 
+/*
+ * Get the value that an instruction defines, or NULL if it does not
+ * define one.  The value returned by a call counts as defined by the
+ * "return_reg" note that follows it.
+ */
+jit_value_t _jit_insn_get_def(jit_insn_t insn);
+
 /*
  * Get the correct opcode to use for a "load" instruction,
  * starting at a particular opcode base.  We assume that the
@@ -205,7 +205,9 @@ straight vanilla ANSI C.
 			} while (0)
 
 /*
- * Perform a tail call to a new function.
+ * Perform a tail call to a new function.  The arguments were pushed
+ * onto the stack as for a regular call, move them into the argument
+ * area, which grows only if the new function needs more space.
  */
 #define	VM_PERFORM_TAIL(newfunc)	\
 			{ \
@@ -214,6 +216,12 @@ straight vanilla ANSI C.
 					_jit_unwind_pop_setjmp(); \
 				} \
 				func = (newfunc); \
+				if(func->args_size > current_args_size) \
+				{ \
+					current_args_size = func->args_size; \
+					args = (jit_item *)alloca(current_args_size); \
+				} \
+				jit_memcpy(args, stacktop, func->args_size); \
 				if(func->frame_size > current_frame_size) \
 				{ \
 					current_frame_size = func->frame_size; \
@@ -317,16 +325,20 @@ void _jit_run_function(jit_function_interp_t func, jit_item *args,
 	void *exception_pc = 0;
 	void *handler;
 	jit_jmp_buf *jbuf;
+	jit_jmp_buf *jbuf_space;
 	jit_nint current_frame_size;
+	jit_nint current_args_size;
 
 	/* Define the label table for computed goto dispatch */
 	#include "jit-interp-labels.h"
 
 	/* Set up the stack frame for this function */
 	current_frame_size = func->frame_size;
+	current_args_size = func->args_size;
 	frame_base = (jit_item *)alloca(current_frame_size);
 	stacktop = frame_base + func->working_area;
 	frame = stacktop;
+	jbuf_space = 0;
 
 	/* Get the initial program counter */
 restart_tail:
@@ -336,7 +348,12 @@ restart_tail:
 	   This is used to catch exceptions on their way up the stack */
 	if(func->func->has_try)
 	{
-		jbuf = (jit_jmp_buf *)alloca(sizeof(jit_jmp_buf));
+		/* Reuse the same buffer across tail calls */
+		if(!jbuf_space)
+		{
+			jbuf_space = (jit_jmp_buf *)alloca(sizeof(jit_jmp_buf));
+		}
+		jbuf = jbuf_space;
 		_jit_unwind_push_setjmp(jbuf);
 		if(setjmp(jbuf->buf))
 		{
@@ -3391,6 +3408,106 @@ restart_tail:
 		}
 		VMBREAK;
 
+		/******************************************************************
+		 * Bit manipulation.
+		 ******************************************************************/
+
+		VMCASE(JIT_OP_IPOPCOUNT):
+		{
+			/* Count the bits set in a 32-bit integer value */
+			VM_R0_INT = jit_int_popcount(VM_R1_INT);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_LPOPCOUNT):
+		{
+			/* Count the bits set in a 64-bit integer value */
+			VM_R0_INT = jit_long_popcount(VM_R1_LONG);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_ICLZ):
+		{
+			/* Count the leading zero bits in a 32-bit integer value */
+			VM_R0_INT = jit_int_clz(VM_R1_INT);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_LCLZ):
+		{
+			/* Count the leading zero bits in a 64-bit integer value */
+			VM_R0_INT = jit_long_clz(VM_R1_LONG);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_ICTZ):
+		{
+			/* Count the trailing zero bits in a 32-bit integer value */
+			VM_R0_INT = jit_int_ctz(VM_R1_INT);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_LCTZ):
+		{
+			/* Count the trailing zero bits in a 64-bit integer value */
+			VM_R0_INT = jit_long_ctz(VM_R1_LONG);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_IBSWAP):
+		{
+			/* Reverse the bytes of a 32-bit integer value */
+			VM_R0_INT = jit_int_bswap(VM_R1_INT);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_LBSWAP):
+		{
+			/* Reverse the bytes of a 64-bit integer value */
+			VM_R0_LONG = jit_long_bswap(VM_R1_LONG);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_IROL):
+		{
+			/* Rotate a 32-bit integer value left */
+			VM_R0_INT = jit_int_rol(VM_R1_INT, VM_R2_UINT);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_IROR):
+		{
+			/* Rotate a 32-bit integer value right */
+			VM_R0_INT = jit_int_ror(VM_R1_INT, VM_R2_UINT);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_LROL):
+		{
+			/* Rotate a 64-bit integer value left */
+			VM_R0_LONG = jit_long_rol(VM_R1_LONG, VM_R2_UINT);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_LROR):
+		{
+			/* Rotate a 64-bit integer value right */
+			VM_R0_LONG = jit_long_ror(VM_R1_LONG, VM_R2_UINT);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
 		/******************************************************************
 		 * Pointer check opcodes.
 		 ******************************************************************/
@@ -3406,6 +3523,17 @@ restart_tail:
 		}
 		VMBREAK;
 
+		VMCASE(JIT_OP_CHECK_BOUNDS):
+		{
+			/* Check the index against the array length */
+			if((jit_nuint) VM_R1_NINT >= (jit_nuint) VM_R2_NINT)
+			{
+				VM_BUILTIN(JIT_RESULT_OUT_OF_BOUNDS);
+			}
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
 		/******************************************************************
 		 * Function calls.
 		 ******************************************************************/
@@ -4083,6 +4211,148 @@ restart_tail:
 		}
 		VMBREAK;
 
+		/******************************************************************
+		 * Atomic memory operations.
+		 ******************************************************************/
+
+		VMCASE(JIT_OP_ATOMIC_LOAD_INT):
+		{
+			/* Atomically load a 32-bit integer */
+			VM_R0_INT = jit_int_atomic_load((jit_int *)VM_R1_PTR);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_ATOMIC_LOAD_LONG):
+		{
+			/* Atomically load a 64-bit integer */
+			VM_R0_LONG = jit_long_atomic_load((jit_long *)VM_R1_PTR);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_ATOMIC_STORE_INT):
+		{
+			/* Atomically store a 32-bit integer */
+			jit_int_atomic_store((jit_int *)VM_R0_PTR, VM_R1_INT);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_ATOMIC_STORE_LONG):
+		{
+			/* Atomically store a 64-bit integer */
+			jit_long_atomic_store((jit_long *)VM_R0_PTR, VM_R1_LONG);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_ATOMIC_EXCHANGE_INT):
+		{
+			/* Atomically exchange a 32-bit integer */
+			VM_R0_INT = jit_int_atomic_exchange((jit_int *)VM_R1_PTR, VM_R2_INT);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_ATOMIC_EXCHANGE_LONG):
+		{
+			/* Atomically exchange a 64-bit integer */
+			VM_R0_LONG = jit_long_atomic_exchange((jit_long *)VM_R1_PTR, VM_R2_LONG);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_ATOMIC_COMPARE_EXCHANGE_INT):
+		{
+			/* Compare and exchange a 32-bit integer */
+			*((jit_int *)VM_R1_PTR) = jit_int_atomic_compare_exchange
+				((jit_int *)VM_R0_PTR, *((jit_int *)VM_R1_PTR), VM_R2_INT);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_ATOMIC_COMPARE_EXCHANGE_LONG):
+		{
+			/* Compare and exchange a 64-bit integer */
+			*((jit_long *)VM_R1_PTR) = jit_long_atomic_compare_exchange
+				((jit_long *)VM_R0_PTR, *((jit_long *)VM_R1_PTR), VM_R2_LONG);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_ATOMIC_FETCH_ADD_INT):
+		{
+			/* Atomically add to a 32-bit integer */
+			VM_R0_INT = jit_int_atomic_fetch_add((jit_int *)VM_R1_PTR, VM_R2_INT);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_ATOMIC_FETCH_ADD_LONG):
+		{
+			/* Atomically add to a 64-bit integer */
+			VM_R0_LONG = jit_long_atomic_fetch_add((jit_long *)VM_R1_PTR, VM_R2_LONG);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_ATOMIC_FETCH_AND_INT):
+		{
+			/* Atomic bitwise and of a 32-bit integer */
+			VM_R0_INT = jit_int_atomic_fetch_and((jit_int *)VM_R1_PTR, VM_R2_INT);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_ATOMIC_FETCH_AND_LONG):
+		{
+			/* Atomic bitwise and of a 64-bit integer */
+			VM_R0_LONG = jit_long_atomic_fetch_and((jit_long *)VM_R1_PTR, VM_R2_LONG);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_ATOMIC_FETCH_OR_INT):
+		{
+			/* Atomic bitwise or of a 32-bit integer */
+			VM_R0_INT = jit_int_atomic_fetch_or((jit_int *)VM_R1_PTR, VM_R2_INT);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_ATOMIC_FETCH_OR_LONG):
+		{
+			/* Atomic bitwise or of a 64-bit integer */
+			VM_R0_LONG = jit_long_atomic_fetch_or((jit_long *)VM_R1_PTR, VM_R2_LONG);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_ATOMIC_FETCH_XOR_INT):
+		{
+			/* Atomic bitwise xor of a 32-bit integer */
+			VM_R0_INT = jit_int_atomic_fetch_xor((jit_int *)VM_R1_PTR, VM_R2_INT);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_ATOMIC_FETCH_XOR_LONG):
+		{
+			/* Atomic bitwise xor of a 64-bit integer */
+			VM_R0_LONG = jit_long_atomic_fetch_xor((jit_long *)VM_R1_PTR, VM_R2_LONG);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_FENCE):
+		{
+			/* Order the memory accesses around the fence */
+			jit_atomic_fence();
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
 		/******************************************************************
 		 * Allocate memory from the stack.
 		 ******************************************************************/
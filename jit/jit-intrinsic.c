@@ -200,41 +200,16 @@ jit_int jit_int_rem(jit_int *result, jit_int value1, jit_int value2)
 
 jit_int jit_int_add_ovf(jit_int *result, jit_int value1, jit_int value2)
 {
-	if(value1 >= 0 && value2 >= 0)
-	{
-		return ((*result = value1 + value2) >= value1);
-	}
-	else if(value1 < 0 && value2 < 0)
-	{
-		return ((*result = value1 + value2) < value1);
-	}
-	else
-	{
-		*result = value1 + value2;
-		return 1;
-	}
+	/* Wrap around in unsigned arithmetic as the signed overflow is
+	   undefined and the compiler may fold the checks away */
+	*result = (jit_int)((jit_uint)value1 + (jit_uint)value2);
+	return ((*result < value1) == (value2 < 0));
 }
 
 jit_int jit_int_sub_ovf(jit_int *result, jit_int value1, jit_int value2)
 {
-	if(value1 >= 0 && value2 >= 0)
-	{
-		*result = value1 - value2;
-		return 1;
-	}
-	else if(value1 < 0 && value2 < 0)
-	{
-		*result = value1 - value2;
-		return 1;
-	}
-	else if(value1 < 0)
-	{
-		return ((*result = value1 - value2) <= value1);
-	}
-	else
-	{
-		return ((*result = value1 - value2) >= value1);
-	}
+	*result = (jit_int)((jit_uint)value1 - (jit_uint)value2);
+	return ((*result > value1) == (value2 < 0));
 }
 
 jit_int jit_int_mul_ovf(jit_int *result, jit_int value1, jit_int value2)
@@ -665,41 +640,14 @@ jit_int jit_long_rem(jit_long *result, jit_long value1, jit_long value2)
 
 jit_int jit_long_add_ovf(jit_long *result, jit_long value1, jit_long value2)
 {
-	if(value1 >= 0 && value2 >= 0)
-	{
-		return ((*result = value1 + value2) >= value1);
-	}
-	else if(value1 < 0 && value2 < 0)
-	{
-		return ((*result = value1 + value2) < value1);
-	}
-	else
-	{
-		*result = value1 + value2;
-		return 1;
-	}
+	*result = (jit_long)((jit_ulong)value1 + (jit_ulong)value2);
+	return ((*result < value1) == (value2 < 0));
 }
 
 jit_int jit_long_sub_ovf(jit_long *result, jit_long value1, jit_long value2)
 {
-	if(value1 >= 0 && value2 >= 0)
-	{
-		*result = value1 - value2;
-		return 1;
-	}
-	else if(value1 < 0 && value2 < 0)
-	{
-		*result = value1 - value2;
-		return 1;
-	}
-	else if(value1 < 0)
-	{
-		return ((*result = value1 - value2) <= value1);
-	}
-	else
-	{
-		return ((*result = value1 - value2) >= value1);
-	}
+	*result = (jit_long)((jit_ulong)value1 - (jit_ulong)value2);
+	return ((*result > value1) == (value2 < 0));
 }
 
 jit_int jit_long_mul_ovf(jit_long *result, jit_long value1, jit_long value2)
@@ -883,6 +831,156 @@ jit_int jit_long_sign(jit_long value1)
 	}
 }
 
+/*@
+ * @deftypefun jit_int jit_int_popcount (jit_int @var{value1})
+ * @deftypefunx jit_int jit_long_popcount (jit_long @var{value1})
+ * Count the bits that are set in @var{value1}.
+ * @end deftypefun
+ *
+ * @deftypefun jit_int jit_int_clz (jit_int @var{value1})
+ * @deftypefunx jit_int jit_long_clz (jit_long @var{value1})
+ * @deftypefunx jit_int jit_int_ctz (jit_int @var{value1})
+ * @deftypefunx jit_int jit_long_ctz (jit_long @var{value1})
+ * Count the leading or trailing zero bits in @var{value1}.  The result
+ * is the width of the type in bits if @var{value1} is zero.
+ * @end deftypefun
+ *
+ * @deftypefun jit_int jit_int_bswap (jit_int @var{value1})
+ * @deftypefunx jit_long jit_long_bswap (jit_long @var{value1})
+ * Reverse the order of the bytes in @var{value1}.
+ * @end deftypefun
+ *
+ * @deftypefun jit_int jit_int_rol (jit_int @var{value1}, jit_uint @var{value2})
+ * @deftypefunx jit_int jit_int_ror (jit_int @var{value1}, jit_uint @var{value2})
+ * @deftypefunx jit_long jit_long_rol (jit_long @var{value1}, jit_uint @var{value2})
+ * @deftypefunx jit_long jit_long_ror (jit_long @var{value1}, jit_uint @var{value2})
+ * Rotate @var{value1} left or right by @var{value2} bits.  The rotate
+ * count is taken modulo the width of the type.
+ * @end deftypefun
+@*/
+jit_int jit_int_popcount(jit_int value1)
+{
+#if defined(__GNUC__)
+	return __builtin_popcount((jit_uint)value1);
+#else
+	jit_uint value = (jit_uint)value1;
+	value = value - ((value >> 1) & 0x55555555);
+	value = (value & 0x33333333) + ((value >> 2) & 0x33333333);
+	value = (value + (value >> 4)) & 0x0F0F0F0F;
+	return (jit_int)((value * 0x01010101) >> 24);
+#endif
+}
+
+jit_int jit_long_popcount(jit_long value1)
+{
+	return jit_int_popcount((jit_int)value1) +
+	       jit_int_popcount((jit_int)(((jit_ulong)value1) >> 32));
+}
+
+jit_int jit_int_clz(jit_int value1)
+{
+	jit_uint value = (jit_uint)value1;
+	jit_int count;
+	if(value == 0)
+	{
+		return 32;
+	}
+#if defined(__GNUC__)
+	count = __builtin_clz(value);
+#else
+	count = 0;
+	while((value & 0x80000000) == 0)
+	{
+		value <<= 1;
+		++count;
+	}
+#endif
+	return count;
+}
+
+jit_int jit_long_clz(jit_long value1)
+{
+	jit_uint high = (jit_uint)(((jit_ulong)value1) >> 32);
+	if(high != 0)
+	{
+		return jit_int_clz((jit_int)high);
+	}
+	return 32 + jit_int_clz((jit_int)value1);
+}
+
+jit_int jit_int_ctz(jit_int value1)
+{
+	jit_uint value = (jit_uint)value1;
+	jit_int count;
+	if(value == 0)
+	{
+		return 32;
+	}
+#if defined(__GNUC__)
+	count = __builtin_ctz(value);
+#else
+	count = 0;
+	while((value & 1) == 0)
+	{
+		value >>= 1;
+		++count;
+	}
+#endif
+	return count;
+}
+
+jit_int jit_long_ctz(jit_long value1)
+{
+	jit_uint low = (jit_uint)value1;
+	if(low != 0)
+	{
+		return jit_int_ctz((jit_int)low);
+	}
+	return 32 + jit_int_ctz((jit_int)(((jit_ulong)value1) >> 32));
+}
+
+jit_int jit_int_bswap(jit_int value1)
+{
+	jit_uint value = (jit_uint)value1;
+	return (jit_int)((value >> 24) | ((value >> 8) & 0x0000FF00) |
+			 ((value << 8) & 0x00FF0000) | (value << 24));
+}
+
+jit_long jit_long_bswap(jit_long value1)
+{
+	jit_ulong low = (jit_uint)jit_int_bswap((jit_int)value1);
+	jit_ulong high = (jit_uint)jit_int_bswap((jit_int)(((jit_ulong)value1) >> 32));
+	return (jit_long)((low << 32) | high);
+}
+
+jit_int jit_int_rol(jit_int value1, jit_uint value2)
+{
+	jit_uint value = (jit_uint)value1;
+	value2 &= 0x1F;
+	return (jit_int)((value << value2) | (value >> ((32 - value2) & 0x1F)));
+}
+
+jit_int jit_int_ror(jit_int value1, jit_uint value2)
+{
+	jit_uint value = (jit_uint)value1;
+	value2 &= 0x1F;
+	return (jit_int)((value >> value2) | (value << ((32 - value2) & 0x1F)));
+}
+
+jit_long jit_long_rol(jit_long value1, jit_uint value2)
+{
+	jit_ulong value = (jit_ulong)value1;
+	value2 &= 0x3F;
+	return (jit_long)((value << value2) | (value >> ((64 - value2) & 0x3F)));
+}
+
+jit_long jit_long_ror(jit_long value1, jit_uint value2)
+{
+	jit_ulong value = (jit_ulong)value1;
+	value2 &= 0x3F;
+	return (jit_long)((value >> value2) | (value << ((64 - value2) & 0x3F)));
+}
+
 /*@
  * @deftypefun jit_ulong jit_ulong_add (jit_ulong @var{value1}, jit_ulong @var{value2})
  * @deftypefunx jit_ulong jit_ulong_sub (jit_ulong @var{value1}, jit_ulong @var{value2})
@@ -1387,7 +1485,12 @@ jit_float32 jit_float32_abs(jit_float32 value1)
 	{
 		return jit_float32_nan;
 	}
-	return ((value1 >= 0) ? value1 : -value1);
+	/* Return +0.0 for -0.0, which compares equal to zero */
+	if(value1 == 0)
+	{
+		return 0;
+	}
+	return ((value1 > 0) ? value1 : -value1);
 }
 
 jit_float32 jit_float32_min(jit_float32 value1, jit_float32 value2)
@@ -1909,7 +2012,12 @@ jit_float64 jit_float64_abs(jit_float64 value1)
 	{
 		return jit_float64_nan;
 	}
-	return ((value1 >= 0) ? value1 : -value1);
+	/* Return +0.0 for -0.0, which compares equal to zero */
+	if(value1 == 0)
+	{
+		return 0;
+	}
+	return ((value1 > 0) ? value1 : -value1);
 }
 
 jit_float64 jit_float64_min(jit_float64 value1, jit_float64 value2)
@@ -2440,7 +2548,12 @@ jit_nfloat jit_nfloat_abs(jit_nfloat value1)
 	{
 		return jit_nfloat_nan;
 	}
-	return ((value1 >= 0) ? value1 : -value1);
+	/* Return +0.0 for -0.0, which compares equal to zero */
+	if(value1 == 0)
+	{
+		return 0;
+	}
+	return ((value1 > 0) ? value1 : -value1);
 }
 
 jit_nfloat jit_nfloat_min(jit_nfloat value1, jit_nfloat value2)
@@ -3103,6 +3216,49 @@ jit_nfloat jit_nfloat_round(jit_nfloat value1)
 #endif
 }
 
+/*@
+ * @deftypefun jit_float32 jit_float32_fma (jit_float32 @var{value1}, jit_float32 @var{value2}, jit_float32 @var{value3})
+ * @deftypefunx jit_float64 jit_float64_fma (jit_float64 @var{value1}, jit_float64 @var{value2}, jit_float64 @var{value3})
+ * @deftypefunx jit_nfloat jit_nfloat_fma (jit_nfloat @var{value1}, jit_nfloat @var{value2}, jit_nfloat @var{value3})
+ * Compute @code{@var{value1} * @var{value2} + @var{value3}} with a single
+ * rounding where the C library provides the fused multiply-add function.
+ * Otherwise the product is rounded before the addition.
+ * @end deftypefun
+@*/
+jit_float32 jit_float32_fma(jit_float32 value1, jit_float32 value2,
+			    jit_float32 value3)
+{
+#if defined(HAVE_FMAF)
+	return (jit_float32)(fmaf(value1, value2, value3));
+#elif defined(HAVE_FMA)
+	return (jit_float32)(fma(value1, value2, value3));
+#else
+	return value1 * value2 + value3;
+#endif
+}
+
+jit_float64 jit_float64_fma(jit_float64 value1, jit_float64 value2,
+			    jit_float64 value3)
+{
+#if defined(HAVE_FMA)
+	return (jit_float64)(fma(value1, value2, value3));
+#else
+	return value1 * value2 + value3;
+#endif
+}
+
+jit_nfloat jit_nfloat_fma(jit_nfloat value1, jit_nfloat value2,
+			  jit_nfloat value3)
+{
+#if defined(HAVE_FMAL) && !defined(JIT_NFLOAT_IS_DOUBLE)
+	return (jit_nfloat)(fmal(value1, value2, value3));
+#elif defined(HAVE_FMA) && defined(JIT_NFLOAT_IS_DOUBLE)
+	return (jit_nfloat)(fma(value1, value2, value3));
+#else
+	return value1 * value2 + value3;
+#endif
+}
+
 /*@
  * @deftypefun jit_int jit_int_to_sbyte (jit_int @var{value})
  * @deftypefunx jit_int jit_int_to_ubyte (jit_int @var{value})
@@ -3952,3 +4108,176 @@ jit_float64 jit_nfloat_to_float64(jit_nfloat value)
 {
 	return (jit_float64)value;
 }
+
+/*
+ * Use the compiler builtins for the atomic operations if there are any
+ * and serialize the operations with the global lock otherwise.  The body
+ * of every atomic intrinsic is one of these macros.
+ */
+#if defined(__ATOMIC_SEQ_CST)
+#define	ATOMIC_LOAD(type, ptr)	\
+	return __atomic_load_n((ptr), __ATOMIC_SEQ_CST)
+#define	ATOMIC_STORE(type, ptr, value)	\
+	__atomic_store_n((ptr), (value), __ATOMIC_SEQ_CST)
+#define	ATOMIC_EXCHANGE(type, ptr, value)	\
+	return __atomic_exchange_n((ptr), (value), __ATOMIC_SEQ_CST)
+#define	ATOMIC_COMPARE_EXCHANGE(type, ptr, expected, desired)	\
+	__atomic_compare_exchange_n((ptr), &(expected), (desired), 0, \
+				    __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST); \
+	return (expected)
+#define	ATOMIC_FETCH(type, ptr, op, value)	\
+	return ATOMIC_FETCH_##op((ptr), (value))
+#define	ATOMIC_FETCH_ADD(ptr, value)	\
+	__atomic_fetch_add((ptr), (value), __ATOMIC_SEQ_CST)
+#define	ATOMIC_FETCH_AND(ptr, value)	\
+	__atomic_fetch_and((ptr), (value), __ATOMIC_SEQ_CST)
+#define	ATOMIC_FETCH_OR(ptr, value)	\
+	__atomic_fetch_or((ptr), (value), __ATOMIC_SEQ_CST)
+#define	ATOMIC_FETCH_XOR(ptr, value)	\
+	__atomic_fetch_xor((ptr), (value), __ATOMIC_SEQ_CST)
+#define	ATOMIC_FENCE()	\
+	__atomic_thread_fence(__ATOMIC_SEQ_CST)
+#else
+#define	ATOMIC_UPDATE(type, ptr, expr)	\
+	type result; \
+	jit_mutex_lock(&_jit_global_lock); \
+	result = *(ptr); \
+	*(ptr) = (expr); \
+	jit_mutex_unlock(&_jit_global_lock); \
+	return result
+#define	ATOMIC_LOAD(type, ptr)	\
+	ATOMIC_UPDATE(type, (ptr), result)
+#define	ATOMIC_STORE(type, ptr, value)	\
+	jit_mutex_lock(&_jit_global_lock); \
+	*(ptr) = (value); \
+	jit_mutex_unlock(&_jit_global_lock)
+#define	ATOMIC_EXCHANGE(type, ptr, value)	\
+	ATOMIC_UPDATE(type, (ptr), (value))
+#define	ATOMIC_COMPARE_EXCHANGE(type, ptr, expected, desired)	\
+	ATOMIC_UPDATE(type, (ptr), (result == (expected) ? (desired) : result))
+#define	ATOMIC_FETCH(type, ptr, op, value)	\
+	ATOMIC_UPDATE(type, (ptr), (type)ATOMIC_FETCH_##op(result, (value)))
+#define	ATOMIC_FETCH_ADD(x, y)	((jit_ulong)(x) + (jit_ulong)(y))
+#define	ATOMIC_FETCH_AND(x, y)	((x) & (y))
+#define	ATOMIC_FETCH_OR(x, y)	((x) | (y))
+#define	ATOMIC_FETCH_XOR(x, y)	((x) ^ (y))
+#define	ATOMIC_FENCE()	\
+	jit_mutex_lock(&_jit_global_lock); \
+	jit_mutex_unlock(&_jit_global_lock)
+#endif
+
+/*@
+ * @deftypefun jit_int jit_int_atomic_load (jit_int *@var{ptr})
+ * @deftypefunx void jit_int_atomic_store (jit_int *@var{ptr}, jit_int @var{value})
+ * @deftypefunx jit_int jit_int_atomic_exchange (jit_int *@var{ptr}, jit_int @var{value})
+ * @deftypefunx jit_int jit_int_atomic_compare_exchange (jit_int *@var{ptr}, jit_int @var{expected}, jit_int @var{desired})
+ * @deftypefunx jit_int jit_int_atomic_fetch_add (jit_int *@var{ptr}, jit_int @var{value})
+ * @deftypefunx jit_int jit_int_atomic_fetch_and (jit_int *@var{ptr}, jit_int @var{value})
+ * @deftypefunx jit_int jit_int_atomic_fetch_or (jit_int *@var{ptr}, jit_int @var{value})
+ * @deftypefunx jit_int jit_int_atomic_fetch_xor (jit_int *@var{ptr}, jit_int @var{value})
+ * Perform a sequentially consistent atomic operation on a 32-bit integer
+ * in memory.  All of them except the store return the value that was in
+ * memory before the operation.  The compare and exchange stores
+ * @var{desired} only if the value in memory is equal to @var{expected}.
+ * @end deftypefun
+ *
+ * @deftypefun jit_long jit_long_atomic_load (jit_long *@var{ptr})
+ * @deftypefunx void jit_long_atomic_store (jit_long *@var{ptr}, jit_long @var{value})
+ * @deftypefunx jit_long jit_long_atomic_exchange (jit_long *@var{ptr}, jit_long @var{value})
+ * @deftypefunx jit_long jit_long_atomic_compare_exchange (jit_long *@var{ptr}, jit_long @var{expected}, jit_long @var{desired})
+ * @deftypefunx jit_long jit_long_atomic_fetch_add (jit_long *@var{ptr}, jit_long @var{value})
+ * @deftypefunx jit_long jit_long_atomic_fetch_and (jit_long *@var{ptr}, jit_long @var{value})
+ * @deftypefunx jit_long jit_long_atomic_fetch_or (jit_long *@var{ptr}, jit_long @var{value})
+ * @deftypefunx jit_long jit_long_atomic_fetch_xor (jit_long *@var{ptr}, jit_long @var{value})
+ * Perform a sequentially consistent atomic operation on a 64-bit integer
+ * in memory.
+ * @end deftypefun
+ *
+ * @deftypefun void jit_atomic_fence (void)
+ * Perform a sequentially consistent memory fence.
+ * @end deftypefun
+@*/
+jit_int jit_int_atomic_load(jit_int *ptr)
+{
+	ATOMIC_LOAD(jit_int, ptr);
+}
+
+void jit_int_atomic_store(jit_int *ptr, jit_int value)
+{
+	ATOMIC_STORE(jit_int, ptr, value);
+}
+
+jit_int jit_int_atomic_exchange(jit_int *ptr, jit_int value)
+{
+	ATOMIC_EXCHANGE(jit_int, ptr, value);
+}
+
+jit_int jit_int_atomic_compare_exchange(jit_int *ptr, jit_int expected, jit_int desired)
+{
+	ATOMIC_COMPARE_EXCHANGE(jit_int, ptr, expected, desired);
+}
+
+jit_int jit_int_atomic_fetch_add(jit_int *ptr, jit_int value)
+{
+	ATOMIC_FETCH(jit_int, ptr, ADD, value);
+}
+
+jit_int jit_int_atomic_fetch_and(jit_int *ptr, jit_int value)
+{
+	ATOMIC_FETCH(jit_int, ptr, AND, value);
+}
+
+jit_int jit_int_atomic_fetch_or(jit_int *ptr, jit_int value)
+{
+	ATOMIC_FETCH(jit_int, ptr, OR, value);
+}
+
+jit_int jit_int_atomic_fetch_xor(jit_int *ptr, jit_int value)
+{
+	ATOMIC_FETCH(jit_int, ptr, XOR, value);
+}
+
+jit_long jit_long_atomic_load(jit_long *ptr)
+{
+	ATOMIC_LOAD(jit_long, ptr);
+}
+
+void jit_long_atomic_store(jit_long *ptr, jit_long value)
+{
+	ATOMIC_STORE(jit_long, ptr, value);
+}
+
+jit_long jit_long_atomic_exchange(jit_long *ptr, jit_long value)
+{
+	ATOMIC_EXCHANGE(jit_long, ptr, value);
+}
+
+jit_long jit_long_atomic_compare_exchange(jit_long *ptr, jit_long expected, jit_long desired)
+{
+	ATOMIC_COMPARE_EXCHANGE(jit_long, ptr, expected, desired);
+}
+
+jit_long jit_long_atomic_fetch_add(jit_long *ptr, jit_long value)
+{
+	ATOMIC_FETCH(jit_long, ptr, ADD, value);
+}
+
+jit_long jit_long_atomic_fetch_and(jit_long *ptr, jit_long value)
+{
+	ATOMIC_FETCH(jit_long, ptr, AND, value);
+}
+
+jit_long jit_long_atomic_fetch_or(jit_long *ptr, jit_long value)
+{
+	ATOMIC_FETCH(jit_long, ptr, OR, value);
+}
+
+jit_long jit_long_atomic_fetch_xor(jit_long *ptr, jit_long value)
+{
+	ATOMIC_FETCH(jit_long, ptr, XOR, value);
+}
+
+void jit_atomic_fence(void)
+{
+	ATOMIC_FENCE();
+}
@@ -21,10 +21,63 @@
  */
 
 #include "jit-internal.h"
+#include "jit-bitset.h"
 #include <jit/jit-dump.h>
 
 #define USE_FORWARD_PROPAGATION 1
 #define USE_BACKWARD_PROPAGATION 1
+#define USE_GLOBAL_LIVENESS 1
+
+/*
+ * The maximum number of instructions scanned by copy propagation for
+ * each copy instruction.  Without a limit the scan may go to the end of
+ * the block each time making the propagation quadratic for huge blocks.
+ */
+#define MAX_PROPAGATION_DISTANCE 256
+
+/*
+ * The maximum number of words in all the bitsets of the global liveness
+ * analysis.  With more blocks and values than that the local variables
+ * are assumed to be live across all blocks as if there were no global
+ * analysis at all.
+ */
+#define MAX_GLOBAL_LIVENESS_WORDS (1024 * 1024)
+
+#ifdef USE_GLOBAL_LIVENESS
+/*
+ * Global liveness data for a basic block.
+ */
+typedef struct _jit_live_block
+{
+	_jit_bitset_t		use;
+	_jit_bitset_t		def;
+	_jit_bitset_t		live_in;
+	_jit_bitset_t		live_out;
+	int			on_list;
+
+} _jit_live_block_t;
+
+/*
+ * Global liveness data for a function.
+ */
+typedef struct _jit_live_info
+{
+	_jit_live_block_t	*blocks;
+	int			num_values;
+
+} _jit_live_info_t;
+#endif
+
+/*
+ * Determine if the instruction accesses memory atomically.  These are
+ * kept even if their result is not used because the memory access is
+ * the point of them.
+ */
+static int
+is_atomic_opcode(int opcode)
+{
+	return opcode >= JIT_OP_ATOMIC_LOAD_INT && opcode <= JIT_OP_FENCE;
+}
 
 /*
  * Compute liveness information for a basic block.
@@ -132,7 +185,8 @@ compute_liveness_for_block(jit_block_t block)
 		{
 			if((flags & JIT_INSN_DEST_IS_VALUE) == 0)
 			{
-				if(!(dest->next_use) && !(dest->live))
+				if(!(dest->next_use) && !(dest->live)
+				   && !is_atomic_opcode(insn->opcode))
 				{
 					/* There is no next use of this value and it is not
 					   live on exit from the block.  So we can discard
@@ -257,7 +311,7 @@ forward_propagation(jit_block_t block)
 	jit_insn_iter_t iter, iter2;
 	jit_insn_t insn, insn2;
 	jit_value_t dest, value;
-	int flags2;
+	int flags2, distance;
 
 	optimized = 0;
 
@@ -302,12 +356,13 @@ forward_propagation(jit_block_t block)
 		}
 
 		iter2 = iter;
-		while((insn2 = jit_insn_iter_next(&iter2)) != 0)
+		distance = MAX_PROPAGATION_DISTANCE;
+		while(--distance >= 0 && (insn2 = jit_insn_iter_next(&iter2)) != 0)
 		{
 			/* Skip NOP instructions, which may have arguments left
 			   over from when the instruction was replaced, but which
 			   are not relevant to our analysis */
-			if(insn->opcode == JIT_OP_NOP)
+			if(insn2->opcode == JIT_OP_NOP)
 			{
 				continue;
 			}
@@ -315,7 +370,8 @@ forward_propagation(jit_block_t block)
 			flags2 = insn2->flags;
 			if((flags2 & JIT_INSN_DEST_OTHER_FLAGS) == 0)
 			{
-				if((flags2 & JIT_INSN_DEST_IS_VALUE) == 0)
+				if((flags2 & JIT_INSN_DEST_IS_VALUE) == 0
+				   || _jit_insn_get_def(insn2) == insn2->dest)
 				{
 					if(insn2->dest == dest || insn2->dest == value)
 					{
@@ -404,7 +460,7 @@ backward_propagation(jit_block_t block)
 	jit_insn_iter_t iter, iter2;
 	jit_insn_t insn, insn2;
 	jit_value_t dest, value;
-	int flags2;
+	int flags2, distance;
 
 	optimized = 0;
 
@@ -448,12 +504,13 @@ backward_propagation(jit_block_t block)
 		}
 
 		iter2 = iter;
-		while((insn2 = jit_insn_iter_previous(&iter2)) != 0)
+		distance = MAX_PROPAGATION_DISTANCE;
+		while(--distance >= 0 && (insn2 = jit_insn_iter_previous(&iter2)) != 0)
 		{
 			/* Skip NOP instructions, which may have arguments left
 			   over from when the instruction was replaced, but which
 			   are not relevant to our analysis */
-			if(insn->opcode == JIT_OP_NOP)
+			if(insn2->opcode == JIT_OP_NOP)
 			{
 				continue;
 			}
@@ -496,7 +553,7 @@ backward_propagation(jit_block_t block)
 			}
 			if((flags2 & JIT_INSN_VALUE2_OTHER_FLAGS) == 0)
 			{
-				if(insn2->value2 == dest || insn2->value1 == value)
+				if(insn2->value2 == dest || insn2->value2 == value)
 				{
 					break;
 				}
@@ -508,15 +565,292 @@ backward_propagation(jit_block_t block)
 }
 #endif
 
+#ifdef USE_GLOBAL_LIVENESS
+/*
+ * Check if the value is a candidate for global liveness analysis.  These
+ * are the local variables of the function that are not accessible by any
+ * means other than the instructions that refer to them explicitly.
+ */
+static int
+is_global_live_candidate(jit_function_t func, jit_value_t value)
+{
+	return (value
+		&& !value->is_constant
+		&& !value->is_temporary
+		&& value->is_local
+		&& !value->is_addressable
+		&& !value->is_volatile
+		&& value->block->func == func);
+}
+
+/*
+ * Assign bit numbers to all the global liveness candidates.
+ */
+static int
+number_values(jit_function_t func)
+{
+	jit_block_t block;
+	jit_insn_iter_t iter;
+	jit_insn_t insn;
+	int num_values;
+
+	/* Forget the numbers assigned by a previous run */
+	for(block = func->builder->entry_block; block; block = block->next)
+	{
+		jit_insn_iter_init(&iter, block);
+		while((insn = jit_insn_iter_next(&iter)) != 0)
+		{
+			if((insn->flags & JIT_INSN_DEST_OTHER_FLAGS) == 0 && insn->dest)
+			{
+				insn->dest->index = -1;
+			}
+			if((insn->flags & JIT_INSN_VALUE1_OTHER_FLAGS) == 0 && insn->value1)
+			{
+				insn->value1->index = -1;
+			}
+			if((insn->flags & JIT_INSN_VALUE2_OTHER_FLAGS) == 0 && insn->value2)
+			{
+				insn->value2->index = -1;
+			}
+		}
+	}
+
+	num_values = 0;
+	for(block = func->builder->entry_block; block; block = block->next)
+	{
+		jit_insn_iter_init(&iter, block);
+		while((insn = jit_insn_iter_next(&iter)) != 0)
+		{
+			if((insn->flags & JIT_INSN_DEST_OTHER_FLAGS) == 0
+			   && is_global_live_candidate(func, insn->dest)
+			   && insn->dest->index < 0)
+			{
+				insn->dest->index = num_values++;
+			}
+			if((insn->flags & JIT_INSN_VALUE1_OTHER_FLAGS) == 0
+			   && is_global_live_candidate(func, insn->value1)
+			   && insn->value1->index < 0)
+			{
+				insn->value1->index = num_values++;
+			}
+			if((insn->flags & JIT_INSN_VALUE2_OTHER_FLAGS) == 0
+			   && is_global_live_candidate(func, insn->value2)
+			   && insn->value2->index < 0)
+			{
+				insn->value2->index = num_values++;
+			}
+		}
+	}
+	return num_values;
+}
+
+/*
+ * Record a use of the value in the block unless it is preceded by a
+ * definition in the same block.
+ */
+static void
+use_value(_jit_live_block_t *live, jit_value_t value)
+{
+	if(value && value->index >= 0
+	   && !_jit_bitset_test_bit(&live->def, value->index))
+	{
+		_jit_bitset_set_bit(&live->use, value->index);
+	}
+}
+
+/*
+ * Compute the sets of values used before any definition in the block
+ * and the sets of values defined in the block.
+ */
+static void
+compute_local_sets(jit_block_t block, _jit_live_block_t *live)
+{
+	jit_insn_iter_t iter;
+	jit_insn_t insn;
+	int flags;
+
+	jit_insn_iter_init(&iter, block);
+	while((insn = jit_insn_iter_next(&iter)) != 0)
+	{
+		if(insn->opcode == JIT_OP_NOP)
+		{
+			continue;
+		}
+
+		flags = insn->flags;
+		if((flags & JIT_INSN_VALUE1_OTHER_FLAGS) == 0)
+		{
+			use_value(live, insn->value1);
+		}
+		if((flags & JIT_INSN_VALUE2_OTHER_FLAGS) == 0)
+		{
+			use_value(live, insn->value2);
+		}
+		if((flags & JIT_INSN_DEST_OTHER_FLAGS) == 0)
+		{
+			if((flags & JIT_INSN_DEST_IS_VALUE) != 0)
+			{
+				use_value(live, insn->dest);
+			}
+			else if(insn->dest && insn->dest->index >= 0)
+			{
+				_jit_bitset_set_bit(&live->def, insn->dest->index);
+			}
+		}
+	}
+}
+
+/*
+ * Compute the sets of values that are live on exit from each block.
+ * This is done with a worklist algorithm that initially visits blocks
+ * in postorder, which is the natural order for a backward problem, and
+ * later revisits only the predecessors of blocks whose live-in set has
+ * changed.  Returns zero if the analysis cannot be done, in this case
+ * all the local variables have to be assumed live across blocks.
+ */
+static int
+compute_global_liveness(jit_function_t func, _jit_live_info_t *info)
+{
+	jit_builder_t builder = func->builder;
+	jit_block_t block, succ;
+	jit_block_t *worklist;
+	_jit_bitset_word_t *bits;
+	_jit_live_block_t *live;
+	int num_blocks, num_words, head, count, index;
+
+	/* The control flow graph is only available for optimized functions.
+	   Exception handling introduces control flow that is not represented
+	   by CFG edges.  So are the jumps to the blocks taken address of. */
+	if(!func->is_optimized || func->has_try || builder->no_global_liveness)
+	{
+		return 0;
+	}
+	for(block = builder->entry_block; block; block = block->next)
+	{
+		if(block->address_of)
+		{
+			return 0;
+		}
+	}
+
+	if(!_jit_block_compute_postorder(func))
+	{
+		jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+	}
+	for(block = builder->entry_block; block; block = block->next)
+	{
+		block->visited = 0;
+	}
+
+	info->num_values = number_values(func);
+	if(info->num_values == 0)
+	{
+		return 0;
+	}
+
+	/* Give up if the bitsets would take too much memory */
+	num_blocks = builder->num_block_order;
+	num_words = _JIT_BITSET_WORDS(info->num_values);
+	if(num_words > MAX_GLOBAL_LIVENESS_WORDS / 4 / num_blocks)
+	{
+		return 0;
+	}
+
+	/* Allocate the per-block data from the CFG arena */
+	info->blocks = (_jit_live_block_t *) _jit_memory_arena_alloc(
+		&builder->cfg_arena, num_blocks * sizeof(_jit_live_block_t));
+	worklist = (jit_block_t *) _jit_memory_arena_alloc(
+		&builder->cfg_arena, num_blocks * sizeof(jit_block_t));
+	if(!info->blocks || !worklist)
+	{
+		jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+	}
+	for(index = 0; index < num_blocks; index++)
+	{
+		bits = (_jit_bitset_word_t *) _jit_memory_arena_alloc(
+			&builder->cfg_arena, 4 * num_words * sizeof(_jit_bitset_word_t));
+		if(!bits)
+		{
+			jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+		}
+		live = &info->blocks[index];
+		_jit_bitset_attach(&live->use, bits, info->num_values);
+		_jit_bitset_attach(&live->def, bits + num_words, info->num_values);
+		_jit_bitset_attach(&live->live_in, bits + 2 * num_words, info->num_values);
+		_jit_bitset_attach(&live->live_out, bits + 3 * num_words, info->num_values);
+		compute_local_sets(builder->block_order[index], live);
+		live->on_list = 1;
+		worklist[index] = builder->block_order[index];
+	}
+
+	/* Iterate until the live sets stop changing */
+	head = 0;
+	count = num_blocks;
+	while(count > 0)
+	{
+		block = worklist[head];
+		head = (head + 1) % num_blocks;
+		--count;
+
+		live = &info->blocks[block->index];
+		live->on_list = 0;
+
+		/* live_out = union of live_in of all successors */
+		_jit_bitset_clear(&live->live_out);
+		for(index = 0; index < block->num_succs; index++)
+		{
+			succ = block->succs[index]->dst;
+			if(succ->index >= 0)
+			{
+				_jit_bitset_add(&live->live_out,
+						&info->blocks[succ->index].live_in);
+			}
+		}
+
+		/* live_in = use | (live_out & ~def) */
+		if(!_jit_bitset_transfer(&live->live_in, &live->use,
+					 &live->live_out, &live->def))
+		{
+			continue;
+		}
+
+		/* Revisit the predecessors */
+		for(index = 0; index < block->num_preds; index++)
+		{
+			succ = block->preds[index]->src;
+			if(succ->index >= 0 && !info->blocks[succ->index].on_list)
+			{
+				info->blocks[succ->index].on_list = 1;
+				worklist[(head + count) % num_blocks] = succ;
+				++count;
+			}
+		}
+	}
+
+	return 1;
+}
+#endif
+
 /* Reset value liveness flags. */
 static void
-reset_value_liveness(jit_value_t value)
+reset_value_liveness(jit_value_t value, _jit_bitset_t *live_out)
 {
 	if(value)
 	{
 		if (!value->is_constant && !value->is_temporary)
 		{
+#ifdef USE_GLOBAL_LIVENESS
+			if(live_out && value->index >= 0)
+			{
+				value->live = _jit_bitset_test_bit(live_out, value->index);
+			}
+			else
+			{
+				value->live = 1;
+			}
+#else
 			value->live = 1;
+#endif
 		}
 		else
 		{
@@ -528,10 +862,12 @@ reset_value_liveness(jit_value_t value)
 
 /*
  * Re-scan the block to reset the liveness flags on all non-temporaries
- * because we need them in the original state for the next block.
+ * because we need them in the original state for the next block.  If
+ * the global liveness information is available then only the values
+ * that are live on exit from the block are marked as live.
  */
 static void
-reset_liveness_flags(jit_block_t block, int reset_all)
+reset_liveness_flags(jit_block_t block, _jit_bitset_t *live_out, int reset_all)
 {
 	jit_insn_iter_t iter;
 	jit_insn_t insn;
@@ -543,15 +879,15 @@ reset_liveness_flags(jit_block_t block, int reset_all)
 		flags = insn->flags;
 		if((flags & JIT_INSN_DEST_OTHER_FLAGS) == 0)
 		{
-			reset_value_liveness(insn->dest);
+			reset_value_liveness(insn->dest, live_out);
 		}
 		if((flags & JIT_INSN_VALUE1_OTHER_FLAGS) == 0)
 		{
-			reset_value_liveness(insn->value1);
+			reset_value_liveness(insn->value1, live_out);
 		}
 		if((flags & JIT_INSN_VALUE2_OTHER_FLAGS) == 0)
 		{
-			reset_value_liveness(insn->value2);
+			reset_value_liveness(insn->value2, live_out);
 		}
 		if(reset_all)
 		{
@@ -564,26 +900,47 @@ reset_liveness_flags(jit_block_t block, int reset_all)
 
 void _jit_function_compute_liveness(jit_function_t func)
 {
-	jit_block_t block = func->builder->entry_block;
+	jit_block_t block;
+	_jit_bitset_t *live_out;
+#ifdef USE_GLOBAL_LIVENESS
+	_jit_live_info_t info;
+	int have_global;
+
+	/* Find out which local variables are live across blocks */
+	have_global = compute_global_liveness(func, &info);
+#endif
+
+	block = func->builder->entry_block;
 	while(block != 0)
 	{
+		live_out = 0;
+#ifdef USE_GLOBAL_LIVENESS
+		if(have_global && block->index >= 0)
+		{
+			live_out = &info.blocks[block->index].live_out;
+		}
+#endif
+
 #ifdef USE_FORWARD_PROPAGATION
 		/* Perform forward copy propagation for the block */
-		forward_propagation(block);
+		if(!func->builder->no_propagation)
+		{
+			forward_propagation(block);
+		}
 #endif
 
 		/* Reset the liveness flags for the next block */
-		reset_liveness_flags(block, 0);
+		reset_liveness_flags(block, live_out, 0);
 
 		/* Compute the liveness flags for the block */
 		compute_liveness_for_block(block);
 
 #ifdef USE_BACKWARD_PROPAGATION
 		/* Perform backward copy propagation for the block */
-		if(backward_propagation(block))
+		if(!func->builder->no_propagation && backward_propagation(block))
 		{
 			/* Reset the liveness flags and compute them again */
-			reset_liveness_flags(block, 1);
+			reset_liveness_flags(block, live_out, 1);
 			compute_liveness_for_block(block);
 		}
 #endif
@@ -0,0 +1,2167 @@
+/*
+ * jit-loop.c - Loop optimizations.
+ *
+ * Copyright (C) 2026  Free Software Foundation, Inc.
+ *
+ * This file is part of the libjit library.
+ *
+ * The libjit library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * The libjit library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the libjit library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "jit-internal.h"
+#include "jit-rules.h"
+
+/*
+ * The loops are found as the natural loops of the back edges in the
+ * control flow graph, that is the edges that go to a block dominating
+ * their source.  All the back edges to the same block form one loop.
+ * Every loop gets a preheader, a block outside of the loop that is its
+ * only entry.  Then the array bounds checks known to succeed are
+ * removed, the instructions computing the same value on every iteration
+ * are moved to the preheader, and the multiplications of the induction
+ * variables by constants are replaced with additions.
+ *
+ * The values defined in the current loop are marked by setting their
+ * index field to an even stamp if they are defined once and to the
+ * odd stamp after it if they are defined more than once.  The index
+ * field belongs to the liveness analysis that runs later and numbers
+ * the values from scratch.
+ */
+
+/*
+ * A fact that the index is within the bounds at the position in the
+ * block and after it.
+ */
+typedef struct
+{
+	jit_block_t		block;
+	int			position;
+	jit_value_t		index;
+	jit_value_t		length;
+
+} _jit_loop_fact_t;
+
+typedef struct
+{
+	jit_function_t		func;
+
+	/* Immediate dominators by the postorder index of the blocks */
+	int			*idom;
+
+	/* The loop each block belongs to by the postorder index */
+	int			*mark;
+
+	/* The blocks of the current loop */
+	jit_block_t		*blocks;
+	int			num_blocks;
+
+	/* The stamp of the values defined in the current loop */
+	int			stamp;
+
+	/* The loop counters known to be non-negative on entry to the
+	   blocks by the postorder index */
+	jit_value_t		*nonneg;
+
+	/* The work list and the marks of the walks over the blocks */
+	jit_block_t		*work;
+	int			*visit;
+	int			visit_mark;
+
+	/* The facts about the bounds known at the current block */
+	_jit_loop_fact_t	*facts;
+	int			num_facts;
+	int			max_facts;
+
+} _jit_loop_info_t;
+
+/*
+ * The location of a definition of an induction variable.
+ */
+typedef struct
+{
+	jit_block_t		block;
+	int			index;
+	jit_long		step;
+
+} _jit_loop_def_t;
+
+/*
+ * The value an induction variable is scaled from, that is the variable
+ * plus or minus an offset and then possibly widened to a long.
+ */
+typedef struct
+{
+	jit_value_t		iv;
+	int			is_long;
+	int			offset_opcode;
+	jit_value_t		offset;
+	int			expand_opcode;
+
+} _jit_loop_source_t;
+
+#define MAX_IV_DEFS	8
+
+/*
+ * The number of blocks a walk looks at before giving up.
+ */
+#define MAX_WALK_BLOCKS	64
+
+/*
+ * Compute the immediate dominators of the blocks with the algorithm
+ * by Cooper, Harvey and Kennedy over the postorder from the last call
+ * to _jit_block_compute_postorder().
+ */
+static void
+compute_dominators(_jit_loop_info_t *info)
+{
+	jit_builder_t builder = info->func->builder;
+	jit_block_t block;
+	int num_blocks, index, edge, pred, dom, finger, changed;
+
+	num_blocks = builder->num_block_order;
+	for(index = 0; index < num_blocks; index++)
+	{
+		info->idom[index] = -1;
+	}
+	info->idom[num_blocks - 1] = num_blocks - 1;
+
+	do
+	{
+		changed = 0;
+		for(index = num_blocks - 2; index >= 0; index--)
+		{
+			block = builder->block_order[index];
+			dom = -1;
+			for(edge = 0; edge < block->num_preds; edge++)
+			{
+				pred = block->preds[edge]->src->index;
+				if(pred < 0 || info->idom[pred] < 0)
+				{
+					continue;
+				}
+				if(dom < 0)
+				{
+					dom = pred;
+					continue;
+				}
+				finger = pred;
+				while(finger != dom)
+				{
+					while(finger < dom)
+					{
+						finger = info->idom[finger];
+					}
+					while(dom < finger)
+					{
+						dom = info->idom[dom];
+					}
+				}
+			}
+			if(info->idom[index] != dom)
+			{
+				info->idom[index] = dom;
+				changed = 1;
+			}
+		}
+	}
+	while(changed);
+}
+
+/*
+ * Check if the block with the postorder index "dom" dominates the
+ * block with the index "index".  A dominator always has a greater
+ * postorder index.
+ */
+static int
+dominates(_jit_loop_info_t *info, int dom, int index)
+{
+	while(index < dom)
+	{
+		if(info->idom[index] == index)
+		{
+			break;
+		}
+		index = info->idom[index];
+	}
+	return index == dom;
+}
+
+/*
+ * Collect the blocks of the natural loop with the given header.  Returns
+ * zero if the block is not a loop header.
+ */
+static int
+find_loop(_jit_loop_info_t *info, jit_block_t header, int id)
+{
+	jit_block_t block, pred;
+	int top, edge;
+
+	/* Look for the back edges */
+	for(edge = 0; edge < header->num_preds; edge++)
+	{
+		pred = header->preds[edge]->src;
+		if(pred->index >= 0 && dominates(info, header->index, pred->index))
+		{
+			break;
+		}
+	}
+	if(edge == header->num_preds)
+	{
+		return 0;
+	}
+
+	info->mark[header->index] = id;
+	info->blocks[0] = header;
+	info->num_blocks = 1;
+
+	/* Walk backwards from the sources of the back edges */
+	for(edge = 0; edge < header->num_preds; edge++)
+	{
+		pred = header->preds[edge]->src;
+		if(pred->index >= 0 && info->mark[pred->index] != id
+		   && dominates(info, header->index, pred->index))
+		{
+			info->mark[pred->index] = id;
+			info->blocks[info->num_blocks++] = pred;
+		}
+	}
+	top = 1;
+	while(top < info->num_blocks)
+	{
+		block = info->blocks[top++];
+		for(edge = 0; edge < block->num_preds; edge++)
+		{
+			pred = block->preds[edge]->src;
+			if(pred->index >= 0 && info->mark[pred->index] != id)
+			{
+				info->mark[pred->index] = id;
+				info->blocks[info->num_blocks++] = pred;
+			}
+		}
+	}
+	return 1;
+}
+
+/*
+ * Stamp the values defined in the current loop.
+ */
+static void
+stamp_defs(_jit_loop_info_t *info)
+{
+	jit_insn_iter_t iter;
+	jit_insn_t insn;
+	jit_value_t value;
+	int index;
+
+	for(index = 0; index < info->num_blocks; index++)
+	{
+		jit_insn_iter_init(&iter, info->blocks[index]);
+		while((insn = jit_insn_iter_next(&iter)) != 0)
+		{
+			value = _jit_insn_get_def(insn);
+			if(!value)
+			{
+				continue;
+			}
+			if(value->index == info->stamp)
+			{
+				value->index = info->stamp + 1;
+			}
+			else if(value->index != info->stamp + 1)
+			{
+				value->index = info->stamp;
+			}
+		}
+	}
+}
+
+/*
+ * Check if the value is the same on every iteration of the loop.
+ */
+static int
+is_invariant(_jit_loop_info_t *info, jit_value_t value)
+{
+	if(value->is_constant)
+	{
+		return 1;
+	}
+	return (!value->is_volatile
+		&& !value->is_addressable
+		&& value->index != info->stamp
+		&& value->index != info->stamp + 1);
+}
+
+/*
+ * Check if the value is a temporary defined once in the loop.
+ */
+static int
+is_single_temporary(_jit_loop_info_t *info, jit_value_t value)
+{
+	return (value->is_temporary
+		&& !value->is_volatile
+		&& value->index == info->stamp);
+}
+
+/*
+ * Check if the opcode computes its result from the operands alone
+ * without side effects or exceptions.
+ */
+static int
+is_pure_opcode(int opcode)
+{
+	switch(opcode)
+	{
+	case JIT_OP_IADD:
+	case JIT_OP_ISUB:
+	case JIT_OP_IMUL:
+	case JIT_OP_INEG:
+	case JIT_OP_IAND:
+	case JIT_OP_IOR:
+	case JIT_OP_IXOR:
+	case JIT_OP_INOT:
+	case JIT_OP_ISHL:
+	case JIT_OP_ISHR:
+	case JIT_OP_ISHR_UN:
+	case JIT_OP_LADD:
+	case JIT_OP_LSUB:
+	case JIT_OP_LMUL:
+	case JIT_OP_LNEG:
+	case JIT_OP_LAND:
+	case JIT_OP_LOR:
+	case JIT_OP_LXOR:
+	case JIT_OP_LNOT:
+	case JIT_OP_LSHL:
+	case JIT_OP_LSHR:
+	case JIT_OP_LSHR_UN:
+	case JIT_OP_IPOPCOUNT:
+	case JIT_OP_LPOPCOUNT:
+	case JIT_OP_ICLZ:
+	case JIT_OP_LCLZ:
+	case JIT_OP_ICTZ:
+	case JIT_OP_LCTZ:
+	case JIT_OP_IBSWAP:
+	case JIT_OP_LBSWAP:
+	case JIT_OP_IROL:
+	case JIT_OP_IROR:
+	case JIT_OP_LROL:
+	case JIT_OP_LROR:
+	case JIT_OP_TRUNC_SBYTE:
+	case JIT_OP_TRUNC_UBYTE:
+	case JIT_OP_TRUNC_SHORT:
+	case JIT_OP_TRUNC_USHORT:
+	case JIT_OP_TRUNC_INT:
+	case JIT_OP_TRUNC_UINT:
+	case JIT_OP_EXPAND_INT:
+	case JIT_OP_EXPAND_UINT:
+	case JIT_OP_LOW_WORD:
+	case JIT_OP_ADD_RELATIVE:
+	case JIT_OP_COPY_INT:
+	case JIT_OP_COPY_LONG:
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * Check if the instruction may be moved out of the loop.
+ */
+static int
+is_hoistable(_jit_loop_info_t *info, jit_insn_t insn)
+{
+	if(!is_pure_opcode(insn->opcode)
+	   || (insn->flags & (JIT_INSN_DEST_OTHER_FLAGS
+			      | JIT_INSN_VALUE1_OTHER_FLAGS
+			      | JIT_INSN_VALUE2_OTHER_FLAGS
+			      | JIT_INSN_DEST_IS_VALUE)) != 0)
+	{
+		return 0;
+	}
+	if(!insn->dest || !is_single_temporary(info, insn->dest))
+	{
+		return 0;
+	}
+	if(!insn->value1 || !is_invariant(info, insn->value1))
+	{
+		return 0;
+	}
+	return !insn->value2 || is_invariant(info, insn->value2);
+}
+
+/*
+ * Check if the loop has anything to move out of it or to strength
+ * reduce.  This is a quick check to avoid creating useless preheaders.
+ */
+static int
+has_candidates(_jit_loop_info_t *info)
+{
+	jit_insn_iter_t iter;
+	jit_insn_t insn;
+	int index;
+
+	for(index = 0; index < info->num_blocks; index++)
+	{
+		jit_insn_iter_init(&iter, info->blocks[index]);
+		while((insn = jit_insn_iter_next(&iter)) != 0)
+		{
+			if(is_hoistable(info, insn) || insn->opcode == JIT_OP_CHECK_BOUNDS)
+			{
+				return 1;
+			}
+			if((insn->opcode == JIT_OP_IMUL || insn->opcode == JIT_OP_LMUL
+			    || insn->opcode == JIT_OP_ISHL || insn->opcode == JIT_OP_LSHL)
+			   && insn->value2 && insn->value2->is_constant)
+			{
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+/*
+ * Make a new label for the block.
+ */
+static jit_label_t
+new_block_label(jit_function_t func, jit_block_t block)
+{
+	jit_label_t label;
+
+	label = func->builder->next_label++;
+	if(!_jit_block_record_label(block, label))
+	{
+		jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+	}
+	return label;
+}
+
+/*
+ * Create a new block that is placed before the given one in the block
+ * list.
+ */
+static jit_block_t
+create_block_before(jit_function_t func, jit_block_t next)
+{
+	jit_block_t block;
+
+	block = _jit_block_create(func);
+	if(!block)
+	{
+		jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+	}
+	block->index = -1;
+	_jit_block_attach_before(next, block, block);
+	return block;
+}
+
+/*
+ * Make sure the loop has a preheader.  Returns non-zero if a new block
+ * was created.  The control flow graph is not updated.
+ */
+static int
+make_preheader(_jit_loop_info_t *info, jit_block_t header)
+{
+	jit_function_t func = info->func;
+	jit_block_t block, pred, after;
+	jit_label_t label;
+	jit_insn_t insn;
+	int edge, num_outside, id;
+
+	id = info->mark[header->index];
+
+	/* Check the edges that enter the loop */
+	num_outside = 0;
+	after = 0;
+	pred = 0;
+	for(edge = 0; edge < header->num_preds; edge++)
+	{
+		pred = header->preds[edge]->src;
+		if(pred->index >= 0 && info->mark[pred->index] == id)
+		{
+			continue;
+		}
+		if(header->preds[edge]->flags == _JIT_EDGE_BRANCH)
+		{
+			insn = _jit_block_get_last(pred);
+			if(!insn || insn->opcode < JIT_OP_BR || insn->opcode > JIT_OP_BR_NFGE_INV)
+			{
+				/* Jump tables are not retargeted */
+				return 0;
+			}
+			if(!after && pred->ends_in_dead && pred != func->builder->exit_block)
+			{
+				after = pred;
+			}
+		}
+		else if(header->preds[edge]->flags != _JIT_EDGE_FALLTHRU)
+		{
+			return 0;
+		}
+		++num_outside;
+	}
+	if(num_outside == 0)
+	{
+		return 0;
+	}
+	if(num_outside == 1 && pred->num_succs == 1)
+	{
+		/* The only predecessor outside of the loop will do */
+		return 0;
+	}
+	if(!has_candidates(info))
+	{
+		return 0;
+	}
+
+	if(header->prev->index < 0 || info->mark[header->prev->index] != id
+	   || header->prev->ends_in_dead)
+	{
+		/* Nothing in the loop falls through into the header, so the
+		   preheader goes right before it and falls through itself */
+		block = create_block_before(func, header);
+	}
+	else
+	{
+		/* Put the preheader after a block that does not fall through
+		   and jump from it to the header */
+		if(!after)
+		{
+			return 0;
+		}
+		block = create_block_before(func, after->next);
+		insn = _jit_block_add_insn(block);
+		if(!insn)
+		{
+			jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+		}
+		insn->opcode = JIT_OP_BR;
+		insn->flags = JIT_INSN_DEST_IS_LABEL;
+		insn->dest = (jit_value_t) new_block_label(func, header);
+		block->ends_in_dead = 1;
+	}
+
+	/* Redirect the branches from outside of the loop to the preheader */
+	label = jit_label_undefined;
+	for(edge = 0; edge < header->num_preds; edge++)
+	{
+		pred = header->preds[edge]->src;
+		if((pred->index >= 0 && info->mark[pred->index] == id)
+		   || header->preds[edge]->flags != _JIT_EDGE_BRANCH)
+		{
+			continue;
+		}
+		if(label == jit_label_undefined)
+		{
+			label = new_block_label(func, block);
+		}
+		insn = _jit_block_get_last(pred);
+		insn->dest = (jit_value_t) label;
+	}
+	return 1;
+}
+
+/*
+ * Find the preheader of the loop.
+ */
+static jit_block_t
+find_preheader(_jit_loop_info_t *info, jit_block_t header)
+{
+	jit_block_t pred, preheader;
+	int edge, id;
+
+	id = info->mark[header->index];
+	preheader = 0;
+	for(edge = 0; edge < header->num_preds; edge++)
+	{
+		pred = header->preds[edge]->src;
+		if(pred->index >= 0 && info->mark[pred->index] == id)
+		{
+			continue;
+		}
+		if(preheader || pred->num_succs != 1)
+		{
+			return 0;
+		}
+		preheader = pred;
+	}
+	return preheader;
+}
+
+/*
+ * Add an instruction to the end of the preheader keeping the branch
+ * to the loop header last.
+ */
+static jit_insn_t
+add_preheader_insn(jit_block_t block)
+{
+	jit_insn_t insn;
+
+	insn = _jit_block_add_insn(block);
+	if(!insn)
+	{
+		jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+	}
+	if(block->succs[0]->flags == _JIT_EDGE_BRANCH)
+	{
+		*insn = insn[-1];
+		--insn;
+		jit_memzero(insn, sizeof(struct _jit_insn));
+	}
+	return insn;
+}
+
+/*
+ * Insert an instruction into the block at the given position.
+ */
+static jit_insn_t
+insert_insn(jit_block_t block, int position)
+{
+	jit_insn_t insn;
+
+	if(!_jit_block_add_insn(block))
+	{
+		jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+	}
+	insn = &block->insns[position];
+	jit_memmove(insn + 1, insn,
+		    (block->num_insns - 1 - position) * sizeof(struct _jit_insn));
+	jit_memzero(insn, sizeof(struct _jit_insn));
+	return insn;
+}
+
+/*
+ * Turn a temporary into a local variable defined in the preheader.
+ */
+static void
+make_local(jit_value_t value, jit_block_t preheader)
+{
+	value->is_temporary = 0;
+	value->is_local = 1;
+	value->block = preheader;
+	if(_jit_gen_is_global_candidate(value->type))
+	{
+		value->global_candidate = 1;
+	}
+}
+
+/*
+ * Create a new local variable defined in the preheader.
+ */
+static jit_value_t
+create_local(jit_function_t func, jit_type_t type, jit_block_t preheader)
+{
+	jit_value_t value;
+
+	value = jit_value_create(func, type);
+	if(!value)
+	{
+		jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+	}
+	make_local(value, preheader);
+	return value;
+}
+
+/*
+ * Move the loop invariant instructions to the preheader.
+ */
+static void
+hoist_invariants(_jit_loop_info_t *info, jit_block_t preheader)
+{
+	jit_insn_iter_t iter;
+	jit_insn_t insn, new_insn;
+	int index, changed;
+
+	do
+	{
+		changed = 0;
+		for(index = 0; index < info->num_blocks; index++)
+		{
+			jit_insn_iter_init(&iter, info->blocks[index]);
+			while((insn = jit_insn_iter_next(&iter)) != 0)
+			{
+				if(!is_hoistable(info, insn))
+				{
+					continue;
+				}
+				new_insn = add_preheader_insn(preheader);
+				*new_insn = *insn;
+				insn->opcode = JIT_OP_NOP;
+				make_local(new_insn->dest, preheader);
+				new_insn->dest->index = -1;
+				changed = 1;
+			}
+		}
+	}
+	while(changed);
+}
+
+/*
+ * Get the value of an integer constant.
+ */
+static jit_long
+get_constant(jit_value_t value, int is_long)
+{
+	if(is_long)
+	{
+		return jit_value_get_long_constant(value);
+	}
+	return (jit_int) jit_value_get_nint_constant(value);
+}
+
+/*
+ * Create an integer constant for the instructions of the given size.
+ */
+static jit_value_t
+create_constant(jit_function_t func, jit_long value, int is_long)
+{
+	jit_value_t constant;
+
+	if(is_long)
+	{
+		constant = jit_value_create_long_constant(func, jit_type_long, value);
+	}
+	else
+	{
+		constant = jit_value_create_nint_constant(func, jit_type_int, (jit_int) value);
+	}
+	if(!constant)
+	{
+		jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+	}
+	return constant;
+}
+
+/*
+ * Check if the type of the value is an integer type that the opcodes
+ * of the given size operate on.
+ */
+static int
+is_int_value(jit_value_t value, int is_long)
+{
+	jit_type_t type = jit_type_normalize(jit_value_get_type(value));
+
+	if(is_long)
+	{
+		return type->kind == JIT_TYPE_LONG || type->kind == JIT_TYPE_ULONG;
+	}
+	return type->kind == JIT_TYPE_INT || type->kind == JIT_TYPE_UINT;
+}
+
+/*
+ * Check if the instruction adds or subtracts a constant to the value.
+ * Returns the constant in "step".
+ */
+static int
+is_increment(jit_insn_t insn, jit_value_t value, int is_long, jit_long *step)
+{
+	if(insn->flags != 0)
+	{
+		return 0;
+	}
+	if(insn->opcode == (is_long ? JIT_OP_LADD : JIT_OP_IADD))
+	{
+		if(insn->value1 == value && insn->value2->is_constant)
+		{
+			*step = get_constant(insn->value2, is_long);
+			return 1;
+		}
+		if(insn->value2 == value && insn->value1->is_constant)
+		{
+			*step = get_constant(insn->value1, is_long);
+			return 1;
+		}
+	}
+	else if(insn->opcode == (is_long ? JIT_OP_LSUB : JIT_OP_ISUB))
+	{
+		if(insn->value1 == value && insn->value2->is_constant)
+		{
+			*step = -get_constant(insn->value2, is_long);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Find the definition of the value that precedes the position in the
+ * block.  Returns -1 if there is none.
+ */
+static int
+find_def(jit_block_t block, int position, jit_value_t value)
+{
+	while(--position >= 0)
+	{
+		if(_jit_insn_get_def(&block->insns[position]) == value)
+		{
+			return position;
+		}
+	}
+	return -1;
+}
+
+/*
+ * Check if the value is a basic induction variable of the loop, that
+ * is a variable changed only by adding constants to it, and find all
+ * of its definitions.  Returns the number of definitions or zero.
+ */
+static int
+find_iv_defs(_jit_loop_info_t *info, jit_value_t value, int is_long,
+	     _jit_loop_def_t *defs)
+{
+	jit_block_t block;
+	jit_insn_t insn;
+	jit_long step;
+	int index, position, def, num_defs;
+
+	if(value->is_temporary || value->is_volatile || value->is_addressable
+	   || value->is_constant || !is_int_value(value, is_long))
+	{
+		return 0;
+	}
+
+	num_defs = 0;
+	for(index = 0; index < info->num_blocks; index++)
+	{
+		block = info->blocks[index];
+		for(position = 0; position < block->num_insns; position++)
+		{
+			insn = &block->insns[position];
+			if(_jit_insn_get_def(insn) != value)
+			{
+				continue;
+			}
+			if(num_defs == MAX_IV_DEFS)
+			{
+				return 0;
+			}
+			if(is_increment(insn, value, is_long, &step))
+			{
+				/* v = v + c */
+			}
+			else if(insn->opcode == (is_long ? JIT_OP_COPY_LONG : JIT_OP_COPY_INT)
+				&& insn->flags == 0 && insn->value1->is_temporary)
+			{
+				/* t = v + c; v = t */
+				def = find_def(block, position, insn->value1);
+				if(def < 0
+				   || !is_increment(&block->insns[def], value, is_long, &step)
+				   || find_def(block, position, value) > def)
+				{
+					return 0;
+				}
+			}
+			else
+			{
+				return 0;
+			}
+			defs[num_defs].block = block;
+			defs[num_defs].index = position;
+			defs[num_defs].step = step;
+			++num_defs;
+		}
+	}
+	return num_defs;
+}
+
+/*
+ * Find the induction variable candidate the operand of a multiplication
+ * at the position is computed from.  The operand may be the variable
+ * itself, the variable plus or minus a loop invariant value, and for
+ * the long multiplications either of these widened from an int, as the
+ * array indexes are.  The widened value goes by the steps of the
+ * variable only as long as the variable does not wrap around, which
+ * reduce_strength() checks with is_bounded_iv().
+ */
+static int
+find_iv_source(_jit_loop_info_t *info, jit_block_t block, int position,
+	       jit_value_t value, int is_long, _jit_loop_source_t *source)
+{
+	jit_insn_t insn;
+	int def, expand_def;
+
+	source->expand_opcode = 0;
+	source->offset_opcode = 0;
+	source->offset = 0;
+	source->is_long = is_long;
+
+	/* Look through the widening */
+	expand_def = -1;
+	if(value->is_temporary && is_long)
+	{
+		def = find_def(block, position, value);
+		if(def < 0)
+		{
+			return 0;
+		}
+		insn = &block->insns[def];
+		if(insn->opcode == JIT_OP_EXPAND_INT || insn->opcode == JIT_OP_EXPAND_UINT)
+		{
+			if(insn->flags != 0)
+			{
+				return 0;
+			}
+			source->expand_opcode = insn->opcode;
+			source->is_long = 0;
+			value = insn->value1;
+			expand_def = def;
+		}
+	}
+
+	/* Look through the addition of an invariant value */
+	if(value->is_temporary)
+	{
+		def = find_def(block, position, value);
+		if(def < 0)
+		{
+			return 0;
+		}
+		insn = &block->insns[def];
+		if(insn->flags != 0)
+		{
+			return 0;
+		}
+		if(insn->opcode == (source->is_long ? JIT_OP_LADD : JIT_OP_IADD))
+		{
+			if(!insn->value1->is_temporary && is_invariant(info, insn->value2))
+			{
+				value = insn->value1;
+				source->offset = insn->value2;
+			}
+			else if(!insn->value2->is_temporary && is_invariant(info, insn->value1))
+			{
+				value = insn->value2;
+				source->offset = insn->value1;
+			}
+			else
+			{
+				return 0;
+			}
+		}
+		else if(insn->opcode == (source->is_long ? JIT_OP_LSUB : JIT_OP_ISUB))
+		{
+			if(insn->value1->is_temporary || !is_invariant(info, insn->value2))
+			{
+				return 0;
+			}
+			value = insn->value1;
+			source->offset = insn->value2;
+		}
+		else
+		{
+			return 0;
+		}
+		source->offset_opcode = insn->opcode;
+
+		/* The variable must not change before the multiplication */
+		if(find_def(block, position, value) > def)
+		{
+			return 0;
+		}
+	}
+	else if(expand_def >= 0 && find_def(block, position, value) > expand_def)
+	{
+		return 0;
+	}
+
+	source->iv = value;
+	return !value->is_constant;
+}
+
+/*
+ * Check if the instruction at the position multiplies an induction
+ * variable candidate by a constant or shifts it left by a constant.
+ * Returns the variable and the factor.
+ */
+static int
+get_scaled_iv(_jit_loop_info_t *info, jit_block_t block, int position,
+	      int is_long, jit_long *factor, _jit_loop_source_t *source)
+{
+	jit_insn_t insn = &block->insns[position];
+	jit_long shift;
+
+	if(insn->flags != 0)
+	{
+		return 0;
+	}
+	if(insn->opcode == (is_long ? JIT_OP_LMUL : JIT_OP_IMUL))
+	{
+		if(insn->value2->is_constant && !insn->value1->is_constant)
+		{
+			*factor = get_constant(insn->value2, is_long);
+			return find_iv_source(info, block, position, insn->value1,
+					      is_long, source);
+		}
+		if(insn->value1->is_constant && !insn->value2->is_constant)
+		{
+			*factor = get_constant(insn->value1, is_long);
+			return find_iv_source(info, block, position, insn->value2,
+					      is_long, source);
+		}
+	}
+	else if(insn->opcode == (is_long ? JIT_OP_LSHL : JIT_OP_ISHL))
+	{
+		if(insn->value2->is_constant && !insn->value1->is_constant)
+		{
+			shift = jit_value_get_nint_constant(insn->value2);
+			if(shift >= 0 && shift < (is_long ? 64 : 32))
+			{
+				*factor = (jit_long) ((jit_ulong) 1 << shift);
+				return find_iv_source(info, block, position, insn->value1,
+						      is_long, source);
+			}
+		}
+	}
+	return 0;
+}
+
+/*
+ * Add an instruction to the preheader.
+ */
+static void
+add_preheader_op(jit_block_t preheader, int opcode, jit_value_t dest,
+		 jit_value_t value1, jit_value_t value2)
+{
+	jit_insn_t insn;
+
+	insn = add_preheader_insn(preheader);
+	insn->opcode = (short) opcode;
+	insn->dest = dest;
+	insn->value1 = value1;
+	insn->value2 = value2;
+	dest->usage_count++;
+	value1->usage_count++;
+	if(value2)
+	{
+		value2->usage_count++;
+	}
+}
+
+/*
+ * Replace the value computed by the instruction at the position with
+ * a new variable that is initialized in the preheader as
+ * "source * factor + base" and incremented by "step * factor" after
+ * each definition of the induction variable.
+ */
+static void
+reduce(_jit_loop_info_t *info, jit_block_t preheader, jit_block_t block,
+       int position, _jit_loop_source_t *source, jit_long factor,
+       jit_value_t base, int is_long, _jit_loop_def_t *defs, int num_defs)
+{
+	jit_function_t func = info->func;
+	jit_value_t var, temp;
+	jit_insn_t insn;
+	int index;
+
+	var = create_local(func, jit_value_get_type(block->insns[position].dest),
+			   preheader);
+	var->index = info->stamp + 1;
+
+	/* var = (iv + offset) * factor + base */
+	temp = source->iv;
+	if(source->offset)
+	{
+		if(source->expand_opcode)
+		{
+			temp = create_local(func, jit_value_get_type(source->iv), preheader);
+		}
+		else
+		{
+			temp = var;
+		}
+		add_preheader_op(preheader, source->offset_opcode, temp,
+				 source->iv, source->offset);
+	}
+	if(source->expand_opcode)
+	{
+		add_preheader_op(preheader, source->expand_opcode, var, temp, 0);
+		temp = var;
+	}
+	add_preheader_op(preheader, is_long ? JIT_OP_LMUL : JIT_OP_IMUL, var, temp,
+			 create_constant(func, factor, is_long));
+	if(base)
+	{
+		add_preheader_op(preheader, is_long ? JIT_OP_LADD : JIT_OP_IADD,
+				 var, var, base);
+	}
+
+	/* Replace the computation with a copy of the variable */
+	insn = &block->insns[position];
+	insn->opcode = is_long ? JIT_OP_COPY_LONG : JIT_OP_COPY_INT;
+	insn->value1 = var;
+	insn->value2 = 0;
+	var->usage_count++;
+
+	/* var = var + step * factor, the definitions are in the block order
+	   so going backwards keeps the positions of the earlier ones valid */
+	for(index = num_defs - 1; index >= 0; index--)
+	{
+		insn = insert_insn(defs[index].block, defs[index].index + 1);
+		insn->opcode = is_long ? JIT_OP_LADD : JIT_OP_IADD;
+		insn->dest = var;
+		insn->value1 = var;
+		insn->value2 = create_constant(func,
+					       (jit_long) ((jit_ulong) defs[index].step
+							   * (jit_ulong) factor),
+					       is_long);
+		var->usage_count += 2;
+	}
+}
+
+/*
+ * Check if the value is used by any instruction in the block other
+ * than the one at the given position.
+ */
+static int
+is_used(jit_block_t block, jit_value_t value, int skip)
+{
+	jit_insn_t insn;
+	int position;
+
+	for(position = 0; position < block->num_insns; position++)
+	{
+		insn = &block->insns[position];
+		if(position == skip || insn->opcode == JIT_OP_NOP)
+		{
+			continue;
+		}
+		if(((insn->flags & JIT_INSN_VALUE1_OTHER_FLAGS) == 0 && insn->value1 == value)
+		   || ((insn->flags & JIT_INSN_VALUE2_OTHER_FLAGS) == 0 && insn->value2 == value)
+		   || ((insn->flags & JIT_INSN_DEST_IS_VALUE) != 0 && insn->dest == value))
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int get_branch_relation(jit_block_t block, jit_block_t succ,
+			       jit_value_t *index, jit_value_t *length,
+			       int *is_signed);
+static jit_block_t find_loop_body(_jit_loop_info_t *info, jit_block_t header);
+static int is_in_inner_loop(_jit_loop_info_t *info, jit_block_t start,
+			    jit_block_t header);
+
+/*
+ * Check if the widened induction variable cannot wrap around, so that
+ * the widened value goes by the same steps.  That is the case if the
+ * loop is left as soon as the variable reaches some limit in the
+ * direction it goes, the comparison has the signedness of the widening,
+ * and the variable goes by one once per iteration after the comparison.
+ * The variable plus an offset may wrap around even then.
+ */
+static int
+is_bounded_iv(_jit_loop_info_t *info, jit_block_t header,
+	      _jit_loop_source_t *source, _jit_loop_def_t *defs, int num_defs)
+{
+	jit_block_t body;
+	jit_value_t index, length;
+	int is_signed;
+
+	if(source->offset || num_defs != 1
+	   || (defs[0].step != 1 && defs[0].step != -1))
+	{
+		return 0;
+	}
+	body = find_loop_body(info, header);
+	if(!body || !get_branch_relation(header, body, &index, &length, &is_signed)
+	   || is_signed != (source->expand_opcode == JIT_OP_EXPAND_INT))
+	{
+		return 0;
+	}
+
+	/* "iv < limit" before going up or "limit < iv" before going down */
+	if(defs[0].step == 1)
+	{
+		if(index != source->iv || !is_invariant(info, length))
+		{
+			return 0;
+		}
+	}
+	else if(length != source->iv || !is_invariant(info, index))
+	{
+		return 0;
+	}
+
+	/* The comparison is done before every step */
+	return (defs[0].block->index >= 0
+		&& dominates(info, body->index, defs[0].block->index)
+		&& !is_in_inner_loop(info, defs[0].block, header));
+}
+
+/*
+ * Reduce the strength of the computations derived from the induction
+ * variables.  The address computations "base + iv * size" become
+ * pointers that are incremented along with the variable, and the
+ * other multiplications of the variables by constants become
+ * additions.
+ */
+static void
+reduce_strength(_jit_loop_info_t *info, jit_block_t header, jit_block_t preheader)
+{
+	_jit_loop_def_t defs[MAX_IV_DEFS];
+	_jit_loop_source_t source;
+	jit_block_t block;
+	jit_insn_t insn;
+	jit_value_t scaled, base;
+	jit_long factor;
+	int index, position, def, scaled_def, num_defs, is_long, pass;
+
+	for(pass = 0; pass < 2; pass++)
+	{
+		for(index = 0; index < info->num_blocks; index++)
+		{
+			block = info->blocks[index];
+			for(position = 0; position < block->num_insns; position++)
+			{
+				insn = &block->insns[position];
+				if(insn->opcode == JIT_OP_IADD || insn->opcode == JIT_OP_IMUL)
+				{
+					is_long = 0;
+				}
+				else if(insn->opcode == JIT_OP_LADD || insn->opcode == JIT_OP_LMUL)
+				{
+					is_long = 1;
+				}
+				else
+				{
+					continue;
+				}
+				if(insn->flags != 0 || !is_single_temporary(info, insn->dest))
+				{
+					continue;
+				}
+
+				if(pass == 0)
+				{
+					/* e = base + iv * factor */
+					if(insn->opcode != (is_long ? JIT_OP_LADD : JIT_OP_IADD))
+					{
+						continue;
+					}
+					if(is_invariant(info, insn->value1)
+					   && is_single_temporary(info, insn->value2))
+					{
+						base = insn->value1;
+						scaled = insn->value2;
+					}
+					else if(is_invariant(info, insn->value2)
+						&& is_single_temporary(info, insn->value1))
+					{
+						base = insn->value2;
+						scaled = insn->value1;
+					}
+					else
+					{
+						continue;
+					}
+					def = find_def(block, position, scaled);
+					if(def < 0
+					   || !get_scaled_iv(info, block, def, is_long, &factor, &source)
+					   || find_def(block, position, source.iv) > def)
+					{
+						continue;
+					}
+					scaled_def = def;
+				}
+				else
+				{
+					/* e = iv * factor, the shifts are cheap enough */
+					if(insn->opcode != (is_long ? JIT_OP_LMUL : JIT_OP_IMUL)
+					   || !is_used(block, insn->dest, -1)
+					   || !get_scaled_iv(info, block, position, is_long, &factor,
+							     &source))
+					{
+						continue;
+					}
+					base = 0;
+					scaled = 0;
+					scaled_def = -1;
+				}
+
+				num_defs = find_iv_defs(info, source.iv, source.is_long, defs);
+				if(num_defs == 0
+				   || (source.expand_opcode
+				       && !is_bounded_iv(info, header, &source, defs, num_defs)))
+				{
+					continue;
+				}
+				if(scaled_def >= 0 && !is_used(block, scaled, position))
+				{
+					/* The multiplication is not needed any more */
+					block->insns[scaled_def].opcode = JIT_OP_NOP;
+				}
+				reduce(info, preheader, block, position, &source, factor, base,
+				       is_long, defs, num_defs);
+			}
+		}
+	}
+}
+
+/*
+ * Check if the value is a non-negative constant.
+ */
+static int
+is_nonneg_constant(jit_value_t value)
+{
+	jit_type_t type;
+
+	if(!value->is_constant)
+	{
+		return 0;
+	}
+	type = jit_type_normalize(jit_value_get_type(value));
+	if(type->kind == JIT_TYPE_LONG || type->kind == JIT_TYPE_ULONG)
+	{
+		return jit_value_get_long_constant(value) >= 0;
+	}
+	if(type->kind == JIT_TYPE_INT || type->kind == JIT_TYPE_UINT)
+	{
+		return (jit_int) jit_value_get_nint_constant(value) >= 0;
+	}
+	return 0;
+}
+
+/*
+ * Get the value an unsigned branch operand is converted from.  The
+ * conversions between int and uint do not change the bits, and the
+ * widening of both operands of a comparison keeps the unsigned order.
+ */
+static jit_value_t
+get_unsigned_operand(jit_block_t block, jit_value_t value)
+{
+	jit_insn_t insn;
+	int last, def;
+
+	if(!value->is_temporary)
+	{
+		return value;
+	}
+	last = block->num_insns - 1;
+	def = find_def(block, last, value);
+	if(def < 0)
+	{
+		return value;
+	}
+	insn = &block->insns[def];
+	if((insn->opcode != JIT_OP_TRUNC_INT && insn->opcode != JIT_OP_TRUNC_UINT)
+	   || insn->flags != 0 || find_def(block, last, insn->value1) > def)
+	{
+		return value;
+	}
+	return insn->value1;
+}
+
+/*
+ * Find out what the conditional branch at the end of the block tells
+ * about its operands on the edge to the given successor.  Returns
+ * non-zero if "*index < *length" holds there.
+ */
+static int
+get_branch_relation(jit_block_t block, jit_block_t succ,
+		    jit_value_t *index, jit_value_t *length, int *is_signed)
+{
+	jit_insn_t insn;
+	int taken;
+
+	if(block->num_succs != 2 || block->succs[0]->dst == block->succs[1]->dst)
+	{
+		return 0;
+	}
+	insn = _jit_block_get_last(block);
+	if(!insn || (insn->flags & (JIT_INSN_VALUE1_OTHER_FLAGS
+				    | JIT_INSN_VALUE2_OTHER_FLAGS)) != 0)
+	{
+		return 0;
+	}
+	taken = (block->succs[0]->dst == succ);
+
+	switch(insn->opcode)
+	{
+	case JIT_OP_BR_ILT:
+	case JIT_OP_BR_LLT:
+	case JIT_OP_BR_ILT_UN:
+	case JIT_OP_BR_LLT_UN:
+	case JIT_OP_BR_IGE:
+	case JIT_OP_BR_LGE:
+	case JIT_OP_BR_IGE_UN:
+	case JIT_OP_BR_LGE_UN:
+		/* "value1 < value2" if a less than branch is taken or
+		   a greater or equal branch is not */
+		if(taken != (insn->opcode == JIT_OP_BR_ILT || insn->opcode == JIT_OP_BR_LLT
+			     || insn->opcode == JIT_OP_BR_ILT_UN
+			     || insn->opcode == JIT_OP_BR_LLT_UN))
+		{
+			return 0;
+		}
+		*index = insn->value1;
+		*length = insn->value2;
+		break;
+
+	case JIT_OP_BR_IGT:
+	case JIT_OP_BR_LGT:
+	case JIT_OP_BR_IGT_UN:
+	case JIT_OP_BR_LGT_UN:
+	case JIT_OP_BR_ILE:
+	case JIT_OP_BR_LLE:
+	case JIT_OP_BR_ILE_UN:
+	case JIT_OP_BR_LLE_UN:
+		/* "value2 < value1" if a greater than branch is taken or
+		   a less or equal branch is not */
+		if(taken != (insn->opcode == JIT_OP_BR_IGT || insn->opcode == JIT_OP_BR_LGT
+			     || insn->opcode == JIT_OP_BR_IGT_UN
+			     || insn->opcode == JIT_OP_BR_LGT_UN))
+		{
+			return 0;
+		}
+		*index = insn->value2;
+		*length = insn->value1;
+		break;
+
+	default:
+		return 0;
+	}
+
+	switch(insn->opcode)
+	{
+	case JIT_OP_BR_ILT_UN:
+	case JIT_OP_BR_LLT_UN:
+	case JIT_OP_BR_IGE_UN:
+	case JIT_OP_BR_LGE_UN:
+	case JIT_OP_BR_IGT_UN:
+	case JIT_OP_BR_LGT_UN:
+	case JIT_OP_BR_ILE_UN:
+	case JIT_OP_BR_LLE_UN:
+		*is_signed = 0;
+		*index = get_unsigned_operand(block, *index);
+		*length = get_unsigned_operand(block, *length);
+		break;
+
+	default:
+		*is_signed = 1;
+		break;
+	}
+	return 1;
+}
+
+/*
+ * Start a new walk over the blocks.
+ */
+static void
+start_walk(_jit_loop_info_t *info)
+{
+	int index;
+
+	if(++info->visit_mark == 0)
+	{
+		for(index = 0; index < info->func->builder->num_block_order; index++)
+		{
+			info->visit[index] = 0;
+		}
+		info->visit_mark = 1;
+	}
+}
+
+/*
+ * Check if the block can reach itself without going through the loop
+ * header, that is if it belongs to an inner loop.
+ */
+static int
+is_in_inner_loop(_jit_loop_info_t *info, jit_block_t start, jit_block_t header)
+{
+	jit_block_t block, pred;
+	int top, edge, count;
+
+	start_walk(info);
+	top = 0;
+	count = 0;
+	info->work[top++] = start;
+	while(top > 0)
+	{
+		block = info->work[--top];
+		for(edge = 0; edge < block->num_preds; edge++)
+		{
+			pred = block->preds[edge]->src;
+			if(pred == start)
+			{
+				return 1;
+			}
+			if(pred == header || pred->index < 0
+			   || info->visit[pred->index] == info->visit_mark)
+			{
+				continue;
+			}
+			if(++count > MAX_WALK_BLOCKS)
+			{
+				return 1;
+			}
+			info->visit[pred->index] = info->visit_mark;
+			info->work[top++] = pred;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Find the block entered from the loop header if the loop goes on.  The
+ * header must be its only predecessor.
+ */
+static jit_block_t
+find_loop_body(_jit_loop_info_t *info, jit_block_t header)
+{
+	jit_block_t body;
+
+	if(header->num_succs != 2)
+	{
+		return 0;
+	}
+	body = header->succs[0]->dst;
+	if(body->index < 0 || info->mark[body->index] != info->mark[header->index])
+	{
+		body = header->succs[1]->dst;
+		if(body->index < 0 || info->mark[body->index] != info->mark[header->index])
+		{
+			return 0;
+		}
+	}
+	if(body == header || body->num_preds != 1)
+	{
+		return 0;
+	}
+	return body;
+}
+
+/*
+ * Find out if the loop condition keeps the loop counter within the
+ * bounds.  That is the case if the loop is left as soon as the counter
+ * reaches some limit, the counter starts at a non-negative constant and
+ * goes up by one once per iteration.  Then the counter is non-negative
+ * at the start of the block entered if the loop goes on, and it is
+ * less than the limit there.
+ */
+static void
+find_nonneg_counter(_jit_loop_info_t *info, jit_block_t header,
+		    jit_block_t preheader)
+{
+	_jit_loop_def_t defs[MAX_IV_DEFS];
+	jit_block_t body, block;
+	jit_insn_t insn;
+	jit_value_t index, length;
+	int is_signed, is_long, def, count;
+
+	/* Find the block entered if the loop goes on */
+	body = find_loop_body(info, header);
+	if(!body || !get_branch_relation(header, body, &index, &length, &is_signed)
+	   || !is_signed || index->is_constant || !is_invariant(info, length))
+	{
+		return;
+	}
+
+	/* The counter goes up by one once per iteration */
+	is_long = is_int_value(index, 1);
+	if(find_iv_defs(info, index, is_long, defs) != 1 || defs[0].step != 1
+	   || is_in_inner_loop(info, defs[0].block, header))
+	{
+		return;
+	}
+
+	/* The counter starts at a non-negative constant */
+	block = preheader;
+	count = 0;
+	while((def = find_def(block, block->num_insns, index)) < 0)
+	{
+		if(block->num_preds != 1 || ++count > MAX_WALK_BLOCKS)
+		{
+			return;
+		}
+		block = block->preds[0]->src;
+	}
+	insn = &block->insns[def];
+	if(insn->opcode != (is_long ? JIT_OP_COPY_LONG : JIT_OP_COPY_INT)
+	   || insn->flags != 0 || !is_nonneg_constant(insn->value1))
+	{
+		return;
+	}
+
+	info->nonneg[body->index] = index;
+}
+
+/*
+ * Move the bounds checks of the loop invariant values at the start of
+ * the loop header to the preheader.  The header runs at least once
+ * every time the loop is entered, so the check is done anyway, and
+ * nothing before it has any side effect.
+ */
+static void
+hoist_bounds_checks(_jit_loop_info_t *info, jit_block_t header,
+		    jit_block_t preheader)
+{
+	jit_insn_t insn, new_insn;
+	int position;
+
+	for(position = 0; position < header->num_insns; position++)
+	{
+		insn = &header->insns[position];
+		if(insn->opcode == JIT_OP_CHECK_BOUNDS)
+		{
+			if(is_invariant(info, insn->value1) && is_invariant(info, insn->value2))
+			{
+				new_insn = add_preheader_insn(preheader);
+				*new_insn = *insn;
+				insn = &header->insns[position];
+				insn->opcode = JIT_OP_NOP;
+			}
+		}
+		else if(insn->opcode != JIT_OP_NOP
+			&& (!is_pure_opcode(insn->opcode) || insn->flags != 0))
+		{
+			break;
+		}
+	}
+}
+
+/*
+ * Check if the instructions of the block in the given range define the
+ * value.
+ */
+static int
+has_def(jit_block_t block, int start, int end, jit_value_t value)
+{
+	jit_insn_t insn;
+
+	for(; start < end; start++)
+	{
+		insn = &block->insns[start];
+		if(_jit_insn_get_def(insn) == value)
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Check if the value stays the same on every path from the position
+ * in the origin block to the position in the given block.  The origin
+ * block dominates the block.  A path from the last time the origin
+ * position is passed never enters the origin block again, so the walk
+ * backwards from the block stops there.
+ */
+static int
+is_unchanged(_jit_loop_info_t *info, jit_block_t origin, int origin_position,
+	     jit_block_t block, int position, jit_value_t value)
+{
+	jit_block_t pred;
+	int top, edge, count;
+
+	if(value->is_constant)
+	{
+		return 1;
+	}
+	if(value->is_volatile || value->is_addressable)
+	{
+		return 0;
+	}
+	if(origin == block && origin_position < position)
+	{
+		return !has_def(block, origin_position + 1, position, value);
+	}
+	if(has_def(block, 0, position, value))
+	{
+		return 0;
+	}
+
+	start_walk(info);
+	top = 0;
+	count = 0;
+	info->work[top++] = block;
+	while(top > 0)
+	{
+		block = info->work[--top];
+		for(edge = 0; edge < block->num_preds; edge++)
+		{
+			pred = block->preds[edge]->src;
+			if(pred->index < 0 || info->visit[pred->index] == info->visit_mark)
+			{
+				continue;
+			}
+			info->visit[pred->index] = info->visit_mark;
+			if(pred == origin)
+			{
+				if(has_def(pred, origin_position + 1, pred->num_insns, value))
+				{
+					return 0;
+				}
+				continue;
+			}
+			if(has_def(pred, 0, pred->num_insns, value) || ++count > MAX_WALK_BLOCKS)
+			{
+				return 0;
+			}
+			info->work[top++] = pred;
+		}
+	}
+	return 1;
+}
+
+/*
+ * Get the value the operand of a bounds check is widened from.
+ */
+static jit_value_t
+get_check_operand(jit_block_t block, int position, jit_value_t value)
+{
+	jit_insn_t insn;
+	int def;
+
+	if(!value->is_temporary)
+	{
+		return value;
+	}
+	def = find_def(block, position, value);
+	if(def < 0)
+	{
+		return value;
+	}
+	insn = &block->insns[def];
+	if(insn->opcode != JIT_OP_EXPAND_INT || insn->flags != 0
+	   || has_def(block, def + 1, position, insn->value1))
+	{
+		return value;
+	}
+	return insn->value1;
+}
+
+/*
+ * Check if two values are the same.
+ */
+static int
+is_same_value(jit_value_t value1, jit_value_t value2)
+{
+	if(value1 == value2)
+	{
+		return 1;
+	}
+	if(value1->is_constant && value2->is_constant
+	   && is_int_value(value1, 1) == is_int_value(value2, 1))
+	{
+		if(is_int_value(value1, 1))
+		{
+			return jit_value_get_long_constant(value1)
+				== jit_value_get_long_constant(value2);
+		}
+		return jit_value_get_nint_constant(value1) == jit_value_get_nint_constant(value2);
+	}
+	return 0;
+}
+
+/*
+ * Check if an index that is known to be within the bounds implies that
+ * another one is.
+ */
+static int
+is_covered_index(jit_value_t known, jit_value_t index)
+{
+	if(is_same_value(known, index))
+	{
+		return 1;
+	}
+
+	/* A smaller non-negative constant is within the bounds as well */
+	return (is_nonneg_constant(known) && is_nonneg_constant(index)
+		&& is_int_value(known, 1) == is_int_value(index, 1)
+		&& (is_int_value(index, 1)
+		    ? jit_value_get_long_constant(index) <= jit_value_get_long_constant(known)
+		    : (jit_int) jit_value_get_nint_constant(index)
+		    <= (jit_int) jit_value_get_nint_constant(known)));
+}
+
+/*
+ * Add a fact that the index is within the bounds after the position
+ * in the block.
+ */
+static void
+add_fact(_jit_loop_info_t *info, jit_block_t block, int position,
+	 jit_value_t index, jit_value_t length)
+{
+	_jit_loop_fact_t *fact;
+
+	if(info->num_facts == info->max_facts)
+	{
+		return;
+	}
+	fact = &info->facts[info->num_facts++];
+	fact->block = block;
+	fact->position = position;
+	fact->index = index;
+	fact->length = length;
+}
+
+/*
+ * Check if the facts established so far make the bounds check at the
+ * position in the block redundant.
+ */
+static int
+is_redundant_check(_jit_loop_info_t *info, jit_block_t block, int position,
+		   jit_value_t index, jit_value_t length)
+{
+	_jit_loop_fact_t *fact;
+	int num;
+
+	for(num = info->num_facts - 1; num >= 0; num--)
+	{
+		fact = &info->facts[num];
+		if(!is_covered_index(fact->index, index)
+		   || !is_same_value(fact->length, length))
+		{
+			continue;
+		}
+		if(is_unchanged(info, fact->block, fact->position, block, position, index)
+		   && is_unchanged(info, fact->block, fact->position, block, position, length))
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Remove the bounds checks in the block that are covered by the facts
+ * known on entry to it, and add the facts the block establishes.
+ */
+static void
+check_block_bounds(_jit_loop_info_t *info, jit_block_t block)
+{
+	jit_block_t pred;
+	jit_insn_t insn;
+	jit_value_t index, length;
+	int position, is_signed;
+
+	/* The branch into the block may tell something about its operands */
+	if(block->num_preds == 1)
+	{
+		pred = block->preds[0]->src;
+		if(get_branch_relation(pred, block, &index, &length, &is_signed)
+		   && (!is_signed || is_nonneg_constant(index)
+		       || info->nonneg[block->index] == index))
+		{
+			add_fact(info, block, -1, index, length);
+		}
+	}
+
+	for(position = 0; position < block->num_insns; position++)
+	{
+		insn = &block->insns[position];
+		if(insn->opcode != JIT_OP_CHECK_BOUNDS)
+		{
+			continue;
+		}
+		index = get_check_operand(block, position, insn->value1);
+		length = get_check_operand(block, position, insn->value2);
+		if(is_redundant_check(info, block, position, index, length))
+		{
+			insn->opcode = JIT_OP_NOP;
+			continue;
+		}
+		add_fact(info, block, position, index, length);
+	}
+}
+
+/*
+ * Check if the function has any bounds checks.
+ */
+static int
+has_bounds_checks(jit_function_t func)
+{
+	jit_block_t block;
+	int position;
+
+	for(block = func->builder->entry_block; block; block = block->next)
+	{
+		for(position = 0; position < block->num_insns; position++)
+		{
+			if(block->insns[position].opcode == JIT_OP_CHECK_BOUNDS)
+			{
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+/*
+ * Remove the bounds checks that are known to succeed.  This is a simple
+ * form of the ABCD algorithm that walks the dominator tree and keeps
+ * the facts "0 <= index < length" established by the checks and the
+ * branches dominating the current block.  A fact applies to a later
+ * check as long as neither value may change in between.
+ */
+static void
+eliminate_bounds_checks(_jit_loop_info_t *info)
+{
+	jit_builder_t builder = info->func->builder;
+	jit_block_t block;
+	int *first_child, *next_sibling, *cursor, *saved_facts;
+	int num_blocks, index, top, num_checks, position;
+
+	/* Count the bounds checks */
+	num_checks = 0;
+	for(block = builder->entry_block; block; block = block->next)
+	{
+		for(position = 0; position < block->num_insns; position++)
+		{
+			if(block->insns[position].opcode == JIT_OP_CHECK_BOUNDS)
+			{
+				++num_checks;
+			}
+		}
+	}
+
+	num_blocks = builder->num_block_order;
+	info->max_facts = num_checks + num_blocks;
+	info->num_facts = 0;
+	info->facts = (_jit_loop_fact_t *) _jit_memory_arena_alloc(
+		&builder->cfg_arena, info->max_facts * sizeof(_jit_loop_fact_t));
+	first_child = (int *) _jit_memory_arena_alloc(&builder->cfg_arena,
+						      4 * num_blocks * sizeof(int));
+	if(!info->facts || !first_child)
+	{
+		jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+	}
+	next_sibling = first_child + num_blocks;
+	cursor = next_sibling + num_blocks;
+	saved_facts = cursor + num_blocks;
+
+	/* Build the dominator tree, the entry block is the last one */
+	for(index = 0; index < num_blocks; index++)
+	{
+		first_child[index] = -1;
+	}
+	for(index = 0; index < num_blocks - 1; index++)
+	{
+		next_sibling[index] = first_child[info->idom[index]];
+		first_child[info->idom[index]] = index;
+	}
+
+	/* Walk the tree depth first and drop the facts of every subtree
+	   when leaving it */
+	saved_facts[0] = 0;
+	check_block_bounds(info, builder->block_order[num_blocks - 1]);
+	cursor[0] = first_child[num_blocks - 1];
+	top = 1;
+	while(top > 0)
+	{
+		index = cursor[top - 1];
+		if(index < 0)
+		{
+			info->num_facts = saved_facts[--top];
+			continue;
+		}
+		cursor[top - 1] = next_sibling[index];
+		saved_facts[top] = info->num_facts;
+		check_block_bounds(info, builder->block_order[index]);
+		cursor[top] = first_child[index];
+		++top;
+	}
+}
+
+/*
+ * Forget the stamps left in the index field of the values.
+ */
+static void
+clear_stamps(jit_function_t func)
+{
+	jit_block_t block;
+	jit_insn_iter_t iter;
+	jit_insn_t insn;
+
+	for(block = func->builder->entry_block; block; block = block->next)
+	{
+		jit_insn_iter_init(&iter, block);
+		while((insn = jit_insn_iter_next(&iter)) != 0)
+		{
+			if((insn->flags & JIT_INSN_DEST_OTHER_FLAGS) == 0 && insn->dest)
+			{
+				insn->dest->index = -1;
+			}
+			if((insn->flags & JIT_INSN_VALUE1_OTHER_FLAGS) == 0 && insn->value1)
+			{
+				insn->value1->index = -1;
+			}
+			if((insn->flags & JIT_INSN_VALUE2_OTHER_FLAGS) == 0 && insn->value2)
+			{
+				insn->value2->index = -1;
+			}
+		}
+	}
+}
+
+/*
+ * Compute the block order and the dominators and allocate the arrays
+ * used to find the loops.
+ */
+static void
+prepare_loops(_jit_loop_info_t *info)
+{
+	jit_builder_t builder = info->func->builder;
+	jit_block_t block;
+	int num_blocks, index;
+
+	for(block = builder->entry_block; block; block = block->next)
+	{
+		block->visited = 0;
+		block->index = -1;
+	}
+	if(!_jit_block_compute_postorder(info->func))
+	{
+		jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+	}
+	for(block = builder->entry_block; block; block = block->next)
+	{
+		block->visited = 0;
+	}
+
+	num_blocks = builder->num_block_order;
+	info->idom = (int *) _jit_memory_arena_alloc(&builder->cfg_arena,
+						     3 * num_blocks * sizeof(int));
+	info->blocks = (jit_block_t *) _jit_memory_arena_alloc(
+		&builder->cfg_arena, 2 * num_blocks * sizeof(jit_block_t));
+	info->nonneg = (jit_value_t *) _jit_memory_arena_alloc(
+		&builder->cfg_arena, num_blocks * sizeof(jit_value_t));
+	if(!info->idom || !info->blocks || !info->nonneg)
+	{
+		jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+	}
+	info->mark = info->idom + num_blocks;
+	info->visit = info->mark + num_blocks;
+	info->work = info->blocks + num_blocks;
+	info->visit_mark = 0;
+	for(index = 0; index < num_blocks; index++)
+	{
+		info->mark[index] = -1;
+		info->visit[index] = 0;
+		info->nonneg[index] = 0;
+	}
+	compute_dominators(info);
+}
+
+/*
+ * Rebuild the control flow graph after adding blocks.
+ */
+static void
+rebuild_cfg(jit_function_t func)
+{
+	jit_block_t block;
+
+	for(block = func->builder->entry_block; block; block = block->next)
+	{
+		block->num_succs = 0;
+		block->num_preds = 0;
+	}
+	_jit_block_build_cfg(func);
+}
+
+void
+_jit_loop_optimize(jit_function_t func)
+{
+	_jit_loop_info_t info;
+	jit_block_t header, preheader;
+	int index, id, changed;
+
+	/* The exception handling and the jumps to the blocks taken address
+	   of are not represented by the control flow graph edges */
+	if(func->has_try || !func->builder->entry_block->next)
+	{
+		return;
+	}
+	for(header = func->builder->entry_block; header; header = header->next)
+	{
+		if(header->address_of)
+		{
+			return;
+		}
+	}
+
+	info.func = func;
+	info.stamp = 0;
+
+	/* Give every loop a preheader */
+	prepare_loops(&info);
+	changed = 0;
+	id = 0;
+	for(index = 0; index < func->builder->num_block_order; index++)
+	{
+		header = func->builder->block_order[index];
+		if(header == func->builder->entry_block || !find_loop(&info, header, id))
+		{
+			continue;
+		}
+		stamp_defs(&info);
+		changed |= make_preheader(&info, header);
+		++id;
+		info.stamp += 2;
+	}
+	if(changed)
+	{
+		rebuild_cfg(func);
+		prepare_loops(&info);
+	}
+
+	/* Remove the bounds checks known to succeed.  This is done before
+	   anything is moved out of the loops as the widened operands of the
+	   checks are still next to them.  The loop numbers go on from the
+	   first pass so the old marks do not get in the way */
+	if(has_bounds_checks(func))
+	{
+		for(index = 0; index < func->builder->num_block_order; index++)
+		{
+			header = func->builder->block_order[index];
+			if(header == func->builder->entry_block
+			   || !find_loop(&info, header, id))
+			{
+				continue;
+			}
+			preheader = find_preheader(&info, header);
+			if(preheader)
+			{
+				stamp_defs(&info);
+				find_nonneg_counter(&info, header, preheader);
+			}
+			++id;
+			info.stamp += 2;
+		}
+		clear_stamps(func);
+		eliminate_bounds_checks(&info);
+	}
+
+	/* Optimize the loops from the innermost ones, the headers of the
+	   inner loops come first in the postorder */
+	for(index = 0; index < func->builder->num_block_order; index++)
+	{
+		header = func->builder->block_order[index];
+		if(header == func->builder->entry_block || !find_loop(&info, header, id))
+		{
+			continue;
+		}
+		preheader = find_preheader(&info, header);
+		if(preheader)
+		{
+			stamp_defs(&info);
+			hoist_invariants(&info, preheader);
+			hoist_bounds_checks(&info, header, preheader);
+			reduce_strength(&info, header, preheader);
+		}
+		++id;
+		info.stamp += 2;
+	}
+	clear_stamps(func);
+}
@@ -22,13 +22,106 @@
 
 #include "jit-internal.h"
 
-void _jit_memory_pool_init(jit_memory_pool *pool, unsigned int elem_size)
+/*
+ * Default limit for the amount of memory retained by a context workspace.
+ */
+#define	JIT_WORKSPACE_DEFAULT_LIMIT	(1024 * 1024)
+
+void *_jit_workspace_alloc_block(jit_context_t context)
+{
+	jit_pool_block_t block;
+
+	jit_mutex_lock(&context->workspace_lock);
+	block = context->workspace_blocks;
+	if(block)
+	{
+		context->workspace_blocks = block->next;
+		context->workspace_size -= JIT_POOL_BLOCK_SIZE;
+	}
+	jit_mutex_unlock(&context->workspace_lock);
+
+	if(!block)
+	{
+		block = (jit_pool_block_t)jit_malloc(JIT_POOL_BLOCK_SIZE);
+	}
+	return block;
+}
+
+void _jit_workspace_free_block(jit_context_t context, void *block)
+{
+	jit_nuint limit;
+
+	limit = jit_context_get_meta_numeric(context, JIT_OPTION_WORKSPACE_LIMIT);
+	if(limit == 0)
+	{
+		limit = JIT_WORKSPACE_DEFAULT_LIMIT;
+	}
+
+	jit_mutex_lock(&context->workspace_lock);
+	if((context->workspace_size + JIT_POOL_BLOCK_SIZE) <= limit)
+	{
+		((jit_pool_block_t)block)->next = context->workspace_blocks;
+		context->workspace_blocks = (jit_pool_block_t)block;
+		context->workspace_size += JIT_POOL_BLOCK_SIZE;
+		block = 0;
+	}
+	jit_mutex_unlock(&context->workspace_lock);
+
+	if(block)
+	{
+		jit_free(block);
+	}
+}
+
+void _jit_workspace_destroy(jit_context_t context)
+{
+	jit_pool_block_t block;
+	while(context->workspace_blocks != 0)
+	{
+		block = context->workspace_blocks;
+		context->workspace_blocks = block->next;
+		jit_free(block);
+	}
+	context->workspace_size = 0;
+}
+
+/*
+ * Get a memory block for a pool or an arena.
+ */
+static jit_pool_block_t alloc_block(jit_context_t context)
+{
+	if(context)
+	{
+		return (jit_pool_block_t)_jit_workspace_alloc_block(context);
+	}
+	return (jit_pool_block_t)jit_malloc(JIT_POOL_BLOCK_SIZE);
+}
+
+/*
+ * Release a memory block of a pool or an arena.
+ */
+static void free_block(jit_context_t context, jit_pool_block_t block)
+{
+	if(context)
+	{
+		_jit_workspace_free_block(context, block);
+	}
+	else
+	{
+		jit_free(block);
+	}
+}
+
+void _jit_memory_pool_init(jit_memory_pool *pool, unsigned int elem_size,
+			   jit_context_t context)
 {
 	pool->elem_size = elem_size;
-	pool->elems_per_block = 4000 / elem_size;
+	pool->elems_per_block =
+		(JIT_POOL_BLOCK_SIZE - sizeof(struct jit_pool_block) + 1) / elem_size;
 	pool->elems_in_last = pool->elems_per_block;
 	pool->blocks = 0;
 	pool->free_list = 0;
+	pool->context = context;
 }
 
 void _jit_memory_pool_free(jit_memory_pool *pool, jit_meta_free_func func)
@@ -46,7 +139,7 @@ void _jit_memory_pool_free(jit_memory_pool *pool, jit_meta_free_func func)
 				(*func)(block->data + pool->elems_in_last * pool->elem_size);
 			}
 		}
-		jit_free(block);
+		free_block(pool->context, block);
 		pool->elems_in_last = pool->elems_per_block;
 	}
 	pool->free_list = 0;
@@ -65,8 +158,7 @@ void *_jit_memory_pool_alloc(jit_memory_pool *pool)
 	}
 	if(pool->elems_in_last >= pool->elems_per_block)
 	{
-		data = (void *)jit_calloc(1, sizeof(struct jit_pool_block) +
-								  pool->elem_size * pool->elems_per_block - 1);
+		data = (void *)alloc_block(pool->context);
 		if(!data)
 		{
 			return 0;
@@ -78,6 +170,7 @@ void *_jit_memory_pool_alloc(jit_memory_pool *pool)
 	data = (void *)(pool->blocks->data +
 					pool->elems_in_last * pool->elem_size);
 	++(pool->elems_in_last);
+	jit_memzero(data, pool->elem_size);
 	return data;
 }
 
@@ -86,3 +179,76 @@ void _jit_memory_pool_dealloc(jit_memory_pool *pool, void *item)
 	*((void **)item) = pool->free_list;
 	pool->free_list = item;
 }
+
+/*
+ * Round an arena allocation size up to the best alignment.
+ */
+#define	ARENA_ROUND(size)	\
+		(((size) + JIT_BEST_ALIGNMENT - 1) & ~(JIT_BEST_ALIGNMENT - 1))
+
+/*
+ * Offset of the first usable byte within an arena block.
+ */
+#define	ARENA_START		ARENA_ROUND(sizeof(struct jit_pool_block) - 1)
+
+void _jit_memory_arena_init(jit_memory_arena *arena, jit_context_t context)
+{
+	arena->blocks = 0;
+	arena->large_blocks = 0;
+	arena->used = JIT_POOL_BLOCK_SIZE;
+	arena->context = context;
+}
+
+void *_jit_memory_arena_alloc(jit_memory_arena *arena, unsigned int size)
+{
+	jit_pool_block_t block;
+	void *data;
+
+	size = ARENA_ROUND(size);
+	if(size > (JIT_POOL_BLOCK_SIZE - ARENA_START))
+	{
+		/* The request does not fit into a regular block */
+		block = (jit_pool_block_t)jit_malloc(ARENA_START + size);
+		if(!block)
+		{
+			return 0;
+		}
+		block->next = arena->large_blocks;
+		arena->large_blocks = block;
+		return (char *)block + ARENA_START;
+	}
+
+	if((arena->used + size) > JIT_POOL_BLOCK_SIZE)
+	{
+		block = alloc_block(arena->context);
+		if(!block)
+		{
+			return 0;
+		}
+		block->next = arena->blocks;
+		arena->blocks = block;
+		arena->used = ARENA_START;
+	}
+
+	data = (char *)arena->blocks + arena->used;
+	arena->used += size;
+	return data;
+}
+
+void _jit_memory_arena_free(jit_memory_arena *arena)
+{
+	jit_pool_block_t block;
+	while(arena->blocks != 0)
+	{
+		block = arena->blocks;
+		arena->blocks = block->next;
+		free_block(arena->context, block);
+	}
+	while(arena->large_blocks != 0)
+	{
+		block = arena->large_blocks;
+		arena->large_blocks = block->next;
+		jit_free(block);
+	}
+	arena->used = JIT_POOL_BLOCK_SIZE;
+}
@@ -237,7 +237,13 @@ value_usage(_jit_regs_t *regs, jit_value_t value)
 	}
 	if(value == regs->descs[0].value)
 	{
-		if(regs->ternary)
+		if(regs->ternary && regs->update_dest)
+		{
+			/* The instruction replaces the input value with the
+			   output one so the input is not needed after it. */
+			flags |= VALUE_INPUT | VALUE_DEAD;
+		}
+		else if(regs->ternary)
 		{
 			flags |= VALUE_INPUT;
 			if(regs->descs[0].used)
@@ -310,7 +316,7 @@ is_register_alive(jit_gencode_t gen, _jit_regs_t *regs, int reg)
 	   computed right away. */
 	if(jit_reg_is_used(gen->permanent, reg))
 	{
-		if(!regs->ternary
+		if((!regs->ternary || regs->update_dest)
 		   && regs->descs[0].value
 		   && regs->descs[0].value->has_global_register
 		   && regs->descs[0].value->global_reg == reg)
@@ -408,7 +414,7 @@ clobbers_register(jit_gencode_t gen, _jit_regs_t *regs, int index, int reg, int
 	if(regs->ternary || !regs->descs[0].value)
 	{
 		/* this is either a ternary or binary or unary note */
-		if(regs->descs[index].clobber)
+		if(regs->descs[index].clobber || (index == 0 && regs->update_dest))
 		{
 			flags = CLOBBER_INPUT_VALUE;
 		}
@@ -636,7 +642,12 @@ set_regdesc_flags(jit_gencode_t gen, _jit_regs_t *regs, int index)
 #endif
 
 	/* See if this is an input value and whether it is alive. */
-	if(regs->ternary)
+	if(regs->ternary && regs->update_dest && index == 0)
+	{
+		is_input = 1;
+		is_live_input = is_used_input = 0;
+	}
+	else if(regs->ternary)
 	{
 		is_input = 1;
 		is_live_input = desc->live;
@@ -749,7 +760,11 @@ set_regdesc_flags(jit_gencode_t gen, _jit_regs_t *regs, int index)
 
 		/* See if the input value needs to be stored before the
 		   instruction and if it stays in the register after it. */
-		if(desc->value->is_constant)
+		if(regs->ternary && regs->update_dest && index == 0)
+		{
+			/* The register is rebound to the output value. */
+		}
+		else if(desc->value->is_constant)
 		{
 			desc->kill = 1;
 		}
@@ -2263,7 +2278,10 @@ spill_clobbered_register(jit_gencode_t gen, _jit_regs_t *regs, int reg)
 			usage = value_usage(regs, value);
 			if((usage & VALUE_DEAD) == 0)
 			{
-				if((usage & VALUE_INPUT) == 0)
+				/* An input value that has a global register is read
+				   from there once saved, so the clobbered register
+				   must not keep it */
+				if((usage & VALUE_INPUT) == 0 || value->has_global_register)
 				{
 					save_value(gen, value, reg, other_reg, 1);
 				}
@@ -2546,10 +2564,37 @@ commit_input_value(jit_gencode_t gen, _jit_regs_t *regs, int index, int killed)
 #endif
 
 	desc = &regs->descs[index];
-	if(!desc->value || desc->duplicate)
+	if(!desc->value)
 	{
 		return;
 	}
+	if(desc->duplicate)
+	{
+		/* A duplicate may be a different value that is only known to
+		   be equal because it is in the same register.  The input it
+		   duplicates does not free it, so drop it here if it is the
+		   output value or if its register is clobbered.  In the latter
+		   case it was saved when the register was spilled */
+		if(desc->value->in_register
+#ifdef JIT_REG_STACK
+		   && !IS_STACK_REG(desc->value->reg)
+#endif
+		   && ((!regs->ternary && desc->value == regs->descs[0].value)
+		       || jit_reg_is_used(regs->clobber, desc->value->reg)))
+		{
+			reg = desc->value->reg;
+			if(gen->contents[reg].is_long_start)
+			{
+				other_reg = jit_reg_other_reg(reg);
+			}
+			else
+			{
+				other_reg = -1;
+			}
+			free_value(gen, desc->value, reg, other_reg, 0);
+		}
+		return;
+	}
 
 #ifdef JIT_REG_STACK
 	if(!IS_STACK_REG(desc->reg))
@@ -2657,6 +2702,49 @@ commit_output_value(jit_gencode_t gen, _jit_regs_t *regs, int push_stack_top)
 #endif
 }
 
+static void
+commit_update_value(jit_gencode_t gen, _jit_regs_t *regs)
+{
+	_jit_regdesc_t *desc;
+	int reg, other_reg;
+
+#ifdef JIT_REG_DEBUG
+	printf("commit_update_value()\n");
+#endif
+
+	desc = &regs->descs[0];
+	if(!desc->value)
+	{
+		return;
+	}
+
+	/* The register now holds the output value.  Drop the input value
+	   wherever it was and bind the output value to the register. */
+	if(desc->copy)
+	{
+		gen->contents[desc->reg].used_for_temp = 0;
+		if(desc->other_reg >= 0)
+		{
+			gen->contents[desc->other_reg].used_for_temp = 0;
+		}
+	}
+	if(desc->value->in_register)
+	{
+		reg = desc->value->reg;
+		if(gen->contents[reg].is_long_start)
+		{
+			other_reg = jit_reg_other_reg(reg);
+		}
+		else
+		{
+			other_reg = -1;
+		}
+		free_value(gen, desc->value, reg, other_reg, 0);
+	}
+
+	commit_output_value(gen, regs, 0);
+}
+
 /*@
  * @deftypefun void _jit_regs_lookup (char *name)
  * Get the pseudo register by its name.
@@ -2719,15 +2807,14 @@ void _jit_regs_alloc_global(jit_gencode_t gen, jit_function_t func)
 	}
 
 	/* Scan all values within the function, looking for the most used.
-	   We will replace this with a better allocation strategy later */
+	   We will replace this with a better allocation strategy later.
+	   New pool blocks are pushed at the head of the list, so only the
+	   first block is partially used.  The rest of it is not cleared
+	   when the block is recycled and must not be scanned */
 	block = func->builder->value_pool.blocks;
-	num = (int)(func->builder->value_pool.elems_per_block);
+	num = (int)(func->builder->value_pool.elems_in_last);
 	while(block != 0)
 	{
-		if(!(block->next))
-		{
-			num = (int)(func->builder->value_pool.elems_in_last);
-		}
 		for(posn = 0; posn < num; ++posn)
 		{
 			value = (jit_value_t)(block->data + posn * sizeof(struct _jit_value));
@@ -2755,6 +2842,7 @@ void _jit_regs_alloc_global(jit_gencode_t gen, jit_function_t func)
 			}
 		}
 		block = block->next;
+		num = (int)(func->builder->value_pool.elems_per_block);
 	}
 
 	/* Allocate registers to the candidates.  We allocate from the top-most
@@ -2772,8 +2860,10 @@ void _jit_regs_alloc_global(jit_gencode_t gen, jit_function_t func)
 		candidates[index]->global_reg = (short)reg;
 		jit_reg_set_used(gen->touched, reg);
 		jit_reg_set_used(gen->permanent, reg);
+		gen->global_values[index] = candidates[index];
 		--reg;
 	}
+	gen->num_global_values = num_candidates;
 
 #endif
 }
@@ -2787,6 +2877,18 @@ void
 _jit_regs_init_for_block(jit_gencode_t gen)
 {
 	int reg;
+#if JIT_NUM_GLOBAL_REGS != 0
+	int index;
+
+	/* Every predecessor leaves the values that are live on its exit in
+	   their global registers.  A value that died in the block before was
+	   dropped from a local register without being stored, so its state
+	   has to be reset before it is used again here */
+	for(index = 0; index < gen->num_global_values; ++index)
+	{
+		gen->global_values[index]->in_global_register = 1;
+	}
+#endif
 	gen->current_age = 1;
 	for(reg = 0; reg < JIT_NUM_REGS; ++reg)
 	{
@@ -3165,6 +3267,7 @@ _jit_regs_init(jit_gencode_t gen, _jit_regs_t *regs, int flags)
 	regs->copy = (flags & _JIT_REGS_COPY) != 0;
 	regs->commutative = (flags & _JIT_REGS_COMMUTATIVE) != 0;
 	regs->free_dest = (flags & _JIT_REGS_FREE_DEST) != 0;
+	regs->update_dest = (flags & _JIT_REGS_UPDATE_DEST) != 0;
 #ifdef JIT_REG_STACK
 	regs->on_stack = (flags & _JIT_REGS_STACK) != 0;
 	regs->x87_arith = (flags & _JIT_REGS_X87_ARITH) != 0;
@@ -3659,9 +3762,18 @@ _jit_regs_commit(jit_gencode_t gen, _jit_regs_t *regs)
 			pop_input_value(gen, regs, 2);
 		}
 #endif
-		commit_input_value(gen, regs, 0, 1);
-		commit_input_value(gen, regs, 1, 1);
-		commit_input_value(gen, regs, 2, 1);
+		if(regs->update_dest)
+		{
+			commit_input_value(gen, regs, 1, 1);
+			commit_input_value(gen, regs, 2, 1);
+			commit_update_value(gen, regs);
+		}
+		else
+		{
+			commit_input_value(gen, regs, 0, 1);
+			commit_input_value(gen, regs, 1, 1);
+			commit_input_value(gen, regs, 2, 1);
+		}
 	}
 	else if(!regs->descs[0].value)
 	{
@@ -51,6 +51,7 @@ extern	"C" {
 #define _JIT_REGS_STACK			0x0020
 #define _JIT_REGS_X87_ARITH		0x0040
 #define _JIT_REGS_REVERSIBLE		0X0080
+#define _JIT_REGS_UPDATE_DEST		0x0100
 
 /*
  * Flags for _jit_regs_init_dest(), _jit_regs_init_value1(), and
@@ -113,6 +114,7 @@ typedef struct
 	unsigned	copy : 1;
 	unsigned	commutative : 1;
 	unsigned	free_dest : 1;
+	unsigned	update_dest : 1;
 
 #ifdef JIT_REG_STACK
 	unsigned	on_stack : 1;
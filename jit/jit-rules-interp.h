@@ -64,6 +64,12 @@ extern	"C" {
  */
 #define	JIT_ALIGN_OVERRIDES		0
 
+/*
+ * Tail calls to other functions push the arguments the same way as
+ * regular calls and the interpreter moves them into its argument area.
+ */
+#define	JIT_GENERAL_TAIL_CALLS		1
+
 /*
  * Extra state information that is added to the "jit_gencode" structure.
  */
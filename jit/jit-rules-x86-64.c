@@ -29,6 +29,7 @@
 #include "jit-gen-x86-64.h"
 #include "jit-reg-alloc.h"
 #include "jit-setjmp.h"
+#include "jit-cpuid-x86.h"
 #include <stdio.h>
 
 /*
@@ -108,7 +109,6 @@
  * if generating code for the current cpu.
  */
 /*
-#define HAVE_X86_SSE_4_1 0
 #define HAVE_X86_SSE_4 0
 #define HAVE_X86_SSE_3 0
 #define HAVE_X86_FISTTP 0
@@ -195,9 +195,44 @@ static _jit_regclass_t *x86_64_sreg;	/* general purpose registers that can*/
 static _jit_regclass_t *x86_64_freg;	/* X86_64 fpu registers */
 static _jit_regclass_t *x86_64_xreg;	/* X86_64 xmm registers */
 
+/*
+ * Optional instruction set extensions.
+ */
+#define X86_64_FEATURE_SSE41	0x0001	/* roundss and roundsd */
+#define X86_64_FEATURE_POPCNT	0x0002	/* popcnt */
+#define X86_64_FEATURE_AVX	0x0004	/* vex encoded sse instructions */
+#define X86_64_FEATURE_AVX2	0x0008
+#define X86_64_FEATURE_BMI1	0x0010	/* tzcnt */
+#define X86_64_FEATURE_BMI2	0x0020	/* shlx, sarx and shrx */
+#define X86_64_FEATURE_LZCNT	0x0040	/* lzcnt */
+#define X86_64_FEATURE_MOVBE	0x0080
+#define X86_64_FEATURE_FMA	0x0100
+
+/*
+ * The extensions of the x86-64-v2 and x86-64-v3 levels of the psABI.
+ */
+#define X86_64_LEVEL_2_FEATURES	\
+	(X86_64_FEATURE_SSE41 | X86_64_FEATURE_POPCNT)
+#define X86_64_LEVEL_3_FEATURES	\
+	(X86_64_LEVEL_2_FEATURES | X86_64_FEATURE_AVX | X86_64_FEATURE_AVX2 | \
+	 X86_64_FEATURE_BMI1 | X86_64_FEATURE_BMI2 | X86_64_FEATURE_LZCNT | \
+	 X86_64_FEATURE_MOVBE | X86_64_FEATURE_FMA)
+
+/*
+ * Check if the code may use an extension.
+ */
+#define x86_64_has(gen, feature)	(((gen)->features & (feature)) != 0)
+
+/*
+ * Extensions that are supported by the cpu we are running on.
+ */
+static int x86_64_cpu_features;
+
 void
 _jit_init_backend(void)
 {
+	jit_cpuid_x86_t info;
+
 	x86_64_reg = _jit_regclass_create(
 		"reg", JIT_REG_WORD | JIT_REG_LONG, 14,
 		X86_64_REG_RAX, X86_64_REG_RCX,
@@ -265,6 +300,86 @@ _jit_init_backend(void)
 		X86_64_REG_XMM10, X86_64_REG_XMM11,
 		X86_64_REG_XMM12, X86_64_REG_XMM13,
 		X86_64_REG_XMM14, X86_64_REG_XMM15);
+
+	/* query the cpu for the optional instructions */
+	if(_jit_cpuid_x86_get(JIT_X86CPUID_FEATURES, &info))
+	{
+		if(info.ecx & JIT_X86FEATURE_SSE41)
+		{
+			x86_64_cpu_features |= X86_64_FEATURE_SSE41;
+		}
+		if(info.ecx & JIT_X86FEATURE_POPCNT)
+		{
+			x86_64_cpu_features |= X86_64_FEATURE_POPCNT;
+		}
+		if(info.ecx & JIT_X86FEATURE_MOVBE)
+		{
+			x86_64_cpu_features |= X86_64_FEATURE_MOVBE;
+		}
+		/* The avx instructions also need the os to save the
+		   xmm and ymm registers */
+		if((info.ecx & JIT_X86FEATURE_AVX)
+		   && (_jit_cpuid_x86_xcr0() & 0x6) == 0x6)
+		{
+			x86_64_cpu_features |= X86_64_FEATURE_AVX;
+			if(info.ecx & JIT_X86FEATURE_FMA)
+			{
+				x86_64_cpu_features |= X86_64_FEATURE_FMA;
+			}
+		}
+	}
+	if(_jit_cpuid_x86_get(JIT_X86CPUID_EXT_FEATURES, &info))
+	{
+		if(info.ebx & JIT_X86FEATURE_BMI1)
+		{
+			x86_64_cpu_features |= X86_64_FEATURE_BMI1;
+		}
+		if(info.ebx & JIT_X86FEATURE_BMI2)
+		{
+			x86_64_cpu_features |= X86_64_FEATURE_BMI2;
+		}
+		if((info.ebx & JIT_X86FEATURE_AVX2)
+		   && (x86_64_cpu_features & X86_64_FEATURE_AVX))
+		{
+			x86_64_cpu_features |= X86_64_FEATURE_AVX2;
+		}
+	}
+	if(_jit_cpuid_x86_get(JIT_X86CPUID_AMD_FEATURES, &info))
+	{
+		if(info.ecx & JIT_X86FEATURE_LZCNT)
+		{
+			x86_64_cpu_features |= X86_64_FEATURE_LZCNT;
+		}
+	}
+}
+
+/*
+ * Get the extensions that the code of a context may use.  This is
+ * limited by the JIT_OPTION_TARGET_FEATURE_LEVEL option.
+ */
+int
+_jit_x86_64_features(jit_context_t context)
+{
+	switch(jit_context_get_meta_numeric(context, JIT_OPTION_TARGET_FEATURE_LEVEL))
+	{
+	case 0:
+		return x86_64_cpu_features;
+
+	case 1:
+		return 0;
+
+	case 2:
+		return x86_64_cpu_features & X86_64_LEVEL_2_FEATURES;
+
+	default:
+		return x86_64_cpu_features & X86_64_LEVEL_3_FEATURES;
+	}
+}
+
+int
+_jit_x86_64_has_fma(jit_context_t context)
+{
+	return (_jit_x86_64_features(context) & X86_64_FEATURE_FMA) != 0;
 }
 
 int
@@ -547,16 +662,19 @@ _x86_64_restore_mxcsr(unsigned char *inst, int sp_offset)
 
 /*
  * perform rounding of scalar single precision values.
- * We have to use the fpu where see4.1 is not supported.
+ * We have to use the fpu where sse4.1 is not supported.
  */
 static unsigned char *
-x86_64_rounds_reg_reg(unsigned char *inst, int dreg, int sreg,
-					  int scratch_reg, X86_64_ROUNDMODE mode)
+x86_64_rounds_reg_reg(jit_gencode_t gen, unsigned char *inst, int dreg,
+					  int sreg, int scratch_reg, X86_64_ROUNDMODE mode)
 {
+	if(x86_64_has(gen, X86_64_FEATURE_SSE41))
+	{
+		x86_64_roundss_reg_reg(inst, dreg, sreg, mode);
+		return inst;
+	}
+
 #ifdef HAVE_RED_ZONE
-#ifdef HAVE_X86_SSE_4_1
-	x86_64_roundss_reg_reg(inst, dreg, sreg, mode);
-#else
 	/* Copy the xmm register to the stack */
 	x86_64_movss_membase_reg(inst, X86_64_RSP, -16, sreg);
 	/* Set the fpu round mode */
@@ -570,10 +688,6 @@ x86_64_rounds_reg_reg(unsigned char *inst, int dreg, int sreg,
 	/* and move st(0) to the destination register */
 	x86_64_fstp_membase_size(inst, X86_64_RSP, -16, 4);
 	x86_64_movss_reg_membase(inst, dreg, X86_64_RSP, -16);
-#endif
-#else
-#ifdef HAVE_X86_SSE_4_1
-	x86_64_roundss_reg_reg(inst, dreg, sreg, mode);
 #else
 	/* allocate space on the stack for two ints and one long value */
 	x86_64_sub_reg_imm_size(inst, X86_64_RSP, 16, 8);
@@ -592,19 +706,21 @@ x86_64_rounds_reg_reg(unsigned char *inst, int dreg, int sreg,
 	x86_64_movss_reg_regp(inst, dreg, X86_64_RSP);
 	/* restore the stack pointer */
 	x86_64_add_reg_imm_size(inst, X86_64_RSP, 16, 8);
-#endif
 #endif
 	return inst;
 }
 
 static unsigned char *
-x86_64_rounds_reg_membase(unsigned char *inst, int dreg, int offset,
-						  int scratch_reg, X86_64_ROUNDMODE mode)
+x86_64_rounds_reg_membase(jit_gencode_t gen, unsigned char *inst, int dreg,
+						  int offset, int scratch_reg, X86_64_ROUNDMODE mode)
 {
+	if(x86_64_has(gen, X86_64_FEATURE_SSE41))
+	{
+		x86_64_roundss_reg_membase(inst, dreg, X86_64_RBP, offset, mode);
+		return inst;
+	}
+
 #ifdef HAVE_RED_ZONE
-#ifdef HAVE_X86_SSE_4_1
-	x86_64_roundss_reg_membase(inst, dreg, X86_64_RBP, offset, mode);
-#else
 	/* Load the value to the fpu */
 	x86_64_fld_membase_size(inst, X86_64_RBP, offset, 4);
 	/* Set the fpu round mode */
@@ -616,10 +732,6 @@ x86_64_rounds_reg_membase(unsigned char *inst, int dreg, int offset,
 	/* and move st(0) to the destination register */
 	x86_64_fstp_membase_size(inst, X86_64_RSP, -16, 4);
 	x86_64_movss_reg_membase(inst, dreg, X86_64_RSP, -16);
-#endif
-#else
-#ifdef HAVE_X86_SSE_4_1
-	x86_64_roundss_reg_membase(inst, dreg, X86_64_RBP, offset, mode);
 #else
 	/* allocate space on the stack for two ints and one long value */
 	x86_64_sub_reg_imm_size(inst, X86_64_RSP, 16, 8);
@@ -636,23 +748,25 @@ x86_64_rounds_reg_membase(unsigned char *inst, int dreg, int offset,
 	x86_64_movss_reg_regp(inst, dreg, X86_64_RSP);
 	/* restore the stack pointer */
 	x86_64_add_reg_imm_size(inst, X86_64_RSP, 16, 8);
-#endif
 #endif
 	return inst;
 }
 
 /*
  * perform rounding of scalar double precision values.
- * We have to use the fpu where see4.1 is not supported.
+ * We have to use the fpu where sse4.1 is not supported.
  */
 static unsigned char *
-x86_64_roundd_reg_reg(unsigned char *inst, int dreg, int sreg,
-					  int scratch_reg, X86_64_ROUNDMODE mode)
+x86_64_roundd_reg_reg(jit_gencode_t gen, unsigned char *inst, int dreg,
+					  int sreg, int scratch_reg, X86_64_ROUNDMODE mode)
 {
+	if(x86_64_has(gen, X86_64_FEATURE_SSE41))
+	{
+		x86_64_roundsd_reg_reg(inst, dreg, sreg, mode);
+		return inst;
+	}
+
 #ifdef HAVE_RED_ZONE
-#ifdef HAVE_X86_SSE_4_1
-	x86_64_roundsd_reg_reg(inst, dreg, sreg, mode);
-#else
 	/* Copy the xmm register to the stack */
 	x86_64_movsd_membase_reg(inst, X86_64_RSP, -16, sreg);
 	/* Set the fpu round mode */
@@ -666,10 +780,6 @@ x86_64_roundd_reg_reg(unsigned char *inst, int dreg, int sreg,
 	/* and move st(0) to the destination register */
 	x86_64_fstp_membase_size(inst, X86_64_RSP, -16, 8);
 	x86_64_movsd_reg_membase(inst, dreg, X86_64_RSP, -16);
-#endif
-#else
-#ifdef HAVE_X86_SSE_4_1
-	x86_64_roundsd_reg_reg(inst, dreg, sreg, mode);
 #else
 	/* allocate space on the stack for two ints and one long value */
 	x86_64_sub_reg_imm_size(inst, X86_64_RSP, 16, 8);
@@ -688,19 +798,21 @@ x86_64_roundd_reg_reg(unsigned char *inst, int dreg, int sreg,
 	x86_64_movsd_reg_regp(inst, dreg, X86_64_RSP);
 	/* restore the stack pointer */
 	x86_64_add_reg_imm_size(inst, X86_64_RSP, 16, 8);
-#endif
 #endif
 	return inst;
 }
 
 static unsigned char *
-x86_64_roundd_reg_membase(unsigned char *inst, int dreg, int offset,
-						  int scratch_reg, X86_64_ROUNDMODE mode)
+x86_64_roundd_reg_membase(jit_gencode_t gen, unsigned char *inst, int dreg,
+						  int offset, int scratch_reg, X86_64_ROUNDMODE mode)
 {
+	if(x86_64_has(gen, X86_64_FEATURE_SSE41))
+	{
+		x86_64_roundsd_reg_membase(inst, dreg, X86_64_RBP, offset, mode);
+		return inst;
+	}
+
 #ifdef HAVE_RED_ZONE
-#ifdef HAVE_X86_SSE_4_1
-	x86_64_roundsd_reg_membase(inst, dreg, X86_64_RBP, offset, mode);
-#else
 	/* Load the value to the fpu */
 	x86_64_fld_membase_size(inst, X86_64_RBP, offset, 8);
 	/* Set the fpu round mode */
@@ -712,10 +824,6 @@ x86_64_roundd_reg_membase(unsigned char *inst, int dreg, int offset,
 	/* and move st(0) to the destination register */
 	x86_64_fstp_membase_size(inst, X86_64_RSP, -16, 8);
 	x86_64_movsd_reg_membase(inst, dreg, X86_64_RSP, -16);
-#endif
-#else
-#ifdef HAVE_X86_SSE_4_1
-	x86_64_roundsd_reg_membase(inst, dreg, X86_64_RBP, offset, mode);
 #else
 	/* allocate space on the stack for two ints and one long value */
 	x86_64_sub_reg_imm_size(inst, X86_64_RSP, 16, 8);
@@ -732,7 +840,6 @@ x86_64_roundd_reg_membase(unsigned char *inst, int dreg, int offset,
 	x86_64_movsd_reg_regp(inst, dreg, X86_64_RSP);
 	/* restore the stack pointer */
 	x86_64_add_reg_imm_size(inst, X86_64_RSP, 16, 8);
-#endif
 #endif
 	return inst;
 }
@@ -766,6 +873,46 @@ x86_64_roundnf(unsigned char *inst, int scratch_reg, X86_64_ROUNDMODE mode)
 	return inst;
 }
 
+/*
+ * Round the scalar single precision value in sreg to the nearest
+ * integer with halfway cases rounded away from zero like roundf does.
+ * This is done by adding the largest value below 0.5 with the sign
+ * of the source and truncating the sum.
+ */
+static unsigned char *
+x86_64_rounds_away(jit_gencode_t gen, unsigned char *inst, int dreg, int sreg,
+				   int xscratch_reg, int scratch_reg)
+{
+	jit_uint sign[4] = {0x80000000, 0x80000000, 0x80000000, 0x80000000};
+	jit_uint half[4] = {0x3effffff, 0x3effffff, 0x3effffff, 0x3effffff};
+
+	x86_64_movaps_reg_reg(inst, xscratch_reg, sreg);
+	_jit_plops_reg_imm(gen, &inst, XMM_ANDP, xscratch_reg, &(sign[0]));
+	_jit_plops_reg_imm(gen, &inst, XMM_ORP, xscratch_reg, &(half[0]));
+	x86_64_addss_reg_reg(inst, xscratch_reg, sreg);
+	return x86_64_rounds_reg_reg(gen, inst, dreg, xscratch_reg, scratch_reg,
+								 X86_ROUND_ZERO);
+}
+
+/*
+ * Round the scalar double precision value in sreg to the nearest
+ * integer with halfway cases rounded away from zero.
+ */
+static unsigned char *
+x86_64_roundd_away(jit_gencode_t gen, unsigned char *inst, int dreg, int sreg,
+				   int xscratch_reg, int scratch_reg)
+{
+	jit_ulong sign[2] = {0x8000000000000000UL, 0x8000000000000000UL};
+	jit_ulong half[2] = {0x3fdfffffffffffffUL, 0x3fdfffffffffffffUL};
+
+	x86_64_movaps_reg_reg(inst, xscratch_reg, sreg);
+	_jit_plopd_reg_imm(gen, &inst, XMM_ANDP, xscratch_reg, &(sign[0]));
+	_jit_plopd_reg_imm(gen, &inst, XMM_ORP, xscratch_reg, &(half[0]));
+	x86_64_addsd_reg_reg(inst, xscratch_reg, sreg);
+	return x86_64_roundd_reg_reg(gen, inst, dreg, xscratch_reg, scratch_reg,
+								 X86_ROUND_ZERO);
+}
+
 /*
  * Round the value in the fpu register st(0) to integer and
  * store the value in dreg. St(0) is popped from the fpu stack.
@@ -888,6 +1035,101 @@ throw_builtin(unsigned char *inst, jit_function_t func, int type)
 	return x86_64_call_code(inst, (jit_nint)jit_exception_builtin);
 }
 
+/*
+ * Divide RAX by a 64-bit constant.  Leave the quotient in RAX, or the
+ * remainder in RDX if "is_rem" is set.  Clobbers RDX and "reg".  Unless
+ * the constant is not suitable the division is replaced by multiplication
+ * by the constant's reciprocal, see _jit_div_magic_signed() and
+ * _jit_div_magic_unsigned().
+ */
+static unsigned char *
+div_by_constant(unsigned char *inst, int reg, jit_long divisor,
+		int is_signed, int is_rem)
+{
+	jit_ulong magic;
+	int shift, add;
+
+	if(is_signed
+	   ? !_jit_div_magic_signed(divisor, 64, &magic, &shift)
+	   : !_jit_div_magic_unsigned(divisor, 64, &magic, &shift, &add))
+	{
+		x86_64_mov_reg_imm_size(inst, reg, divisor, 8);
+		if(is_signed)
+		{
+			x86_64_cqo(inst);
+			x86_64_idiv_reg_size(inst, reg, 8);
+		}
+		else
+		{
+			x86_64_clear_reg(inst, X86_64_RDX);
+			x86_64_div_reg_size(inst, reg, 8);
+		}
+		return inst;
+	}
+
+	/* Get the high part of the product of the dividend and the magic
+	   number in RDX keeping the dividend in "reg" */
+	x86_64_mov_reg_reg_size(inst, reg, X86_64_RAX, 8);
+	x86_64_mov_reg_imm_size(inst, X86_64_RAX, magic, 8);
+	x86_64_mul_reg_issigned_size(inst, reg, is_signed, 8);
+
+	if(is_signed)
+	{
+		if(divisor > 0 && (jit_long) magic < 0)
+		{
+			x86_64_add_reg_reg_size(inst, X86_64_RDX, reg, 8);
+		}
+		else if(divisor < 0 && (jit_long) magic > 0)
+		{
+			x86_64_sub_reg_reg_size(inst, X86_64_RDX, reg, 8);
+		}
+		if(shift > 0)
+		{
+			x86_64_sar_reg_imm_size(inst, X86_64_RDX, shift, 8);
+		}
+		/* Add one if the quotient is negative */
+		x86_64_mov_reg_reg_size(inst, X86_64_RAX, X86_64_RDX, 8);
+		x86_64_shr_reg_imm_size(inst, X86_64_RAX, 63, 8);
+		x86_64_add_reg_reg_size(inst, X86_64_RAX, X86_64_RDX, 8);
+	}
+	else if(add)
+	{
+		x86_64_mov_reg_reg_size(inst, X86_64_RAX, reg, 8);
+		x86_64_sub_reg_reg_size(inst, X86_64_RAX, X86_64_RDX, 8);
+		x86_64_shr_reg_imm_size(inst, X86_64_RAX, 1, 8);
+		x86_64_add_reg_reg_size(inst, X86_64_RAX, X86_64_RDX, 8);
+		if(shift > 1)
+		{
+			x86_64_shr_reg_imm_size(inst, X86_64_RAX, shift - 1, 8);
+		}
+	}
+	else
+	{
+		x86_64_mov_reg_reg_size(inst, X86_64_RAX, X86_64_RDX, 8);
+		if(shift > 0)
+		{
+			x86_64_shr_reg_imm_size(inst, X86_64_RAX, shift, 8);
+		}
+	}
+
+	if(is_rem)
+	{
+		/* The remainder is the dividend minus quotient * divisor */
+		if(divisor >= jit_min_int && divisor <= jit_max_int)
+		{
+			x86_64_imul_reg_reg_imm_size(inst, X86_64_RAX, X86_64_RAX, divisor, 8);
+		}
+		else
+		{
+			x86_64_mov_reg_imm_size(inst, X86_64_RDX, divisor, 8);
+			x86_64_imul_reg_reg_size(inst, X86_64_RAX, X86_64_RDX, 8);
+		}
+		x86_64_sub_reg_reg_size(inst, reg, X86_64_RAX, 8);
+		x86_64_mov_reg_reg_size(inst, X86_64_RDX, reg, 8);
+	}
+	return inst;
+}
+
 /*
  * spill a register to it's place in the current stack frame.
  * The argument type must be in it's normalized form.
@@ -1057,6 +1299,158 @@ _spill_reg(unsigned char **inst_ptr, jit_type_t type,
 	*inst_ptr = inst;
 }
 
+/*
+ * The peephole optimizer works on the code as it is being emitted.
+ * It remembers the position right after the last instruction that
+ * set the flags and the last store to the frame.  If the next
+ * instruction starts at the same position then nothing else was
+ * emitted in between and the remembered state still holds.
+ * Instructions that do not change the flags may extend the window.
+ */
+
+/*
+ * Record that the zero flag reflects the "size" bytes of the
+ * register "reg" as set by the instruction that ends at "inst".
+ */
+static void
+peephole_set_flags(jit_gencode_t gen, unsigned char *inst, int reg, int size)
+{
+	if(!gen->no_peephole)
+	{
+		gen->flags_end = inst;
+		gen->flags_regs = 1 << reg;
+		gen->flags_size = size;
+	}
+}
+
+/*
+ * Extend the flags window over a register move between "start"
+ * and "inst".
+ */
+static void
+peephole_move(jit_gencode_t gen, unsigned char *start, unsigned char *inst,
+	      int dreg, int sreg, int size)
+{
+	if(gen->flags_end == start)
+	{
+		if((gen->flags_regs & (1 << sreg)) != 0 && size >= gen->flags_size)
+		{
+			gen->flags_regs |= 1 << dreg;
+		}
+		else
+		{
+			gen->flags_regs &= ~(1 << dreg);
+		}
+		gen->flags_end = inst;
+	}
+}
+
+/*
+ * Record a store of the register "reg" to the frame between "start"
+ * and "inst".
+ */
+static void
+peephole_store(jit_gencode_t gen, unsigned char *start, unsigned char *inst,
+	       int reg, int offset, int size)
+{
+	if(gen->flags_end == start)
+	{
+		gen->flags_end = inst;
+	}
+	if(!gen->no_peephole)
+	{
+		gen->store_end = inst;
+		gen->store_reg = reg;
+		gen->store_offset = offset;
+		gen->store_size = size;
+	}
+}
+
+/*
+ * Load the register "reg" from the frame.  If the value has just
+ * been stored from a register, then take it from that register.
+ */
+static unsigned char *
+peephole_load(jit_gencode_t gen, unsigned char *inst, int reg, int offset,
+	      int size)
+{
+	unsigned char *start = inst;
+	int load_size;
+
+	x86_64_mov_reg_membase_size(inst, reg, X86_64_RBP, offset, size);
+	if(gen->store_end != start || gen->store_offset != offset
+	   || gen->store_size != size)
+	{
+		if(gen->flags_end == start)
+		{
+			gen->flags_regs &= ~(1 << reg);
+			gen->flags_end = inst;
+		}
+		return inst;
+	}
+
+	/* The 32-bit move also clears the upper half of the register
+	   just like the load so it is kept even for the same register */
+	load_size = inst - start;
+	inst = start;
+	if(reg != gen->store_reg || size != 8)
+	{
+		x86_64_mov_reg_reg_size(inst, reg, gen->store_reg, size);
+	}
+	peephole_move(gen, start, inst, reg, gen->store_reg, size);
+	gen->peephole_insns++;
+	gen->peephole_bytes += load_size - (inst - start);
+	return inst;
+}
+
+/*
+ * Test if the register "reg" is zero unless the zero flag already
+ * reflects its value.
+ */
+static unsigned char *
+test_reg_zero(jit_gencode_t gen, unsigned char *inst, int reg, int size)
+{
+	if(gen->flags_end == inst && (gen->flags_regs & (1 << reg)) != 0
+	   && gen->flags_size == size)
+	{
+		gen->peephole_insns++;
+		gen->peephole_bytes += (reg > 7 || size == 8) ? 3 : 2;
+		return inst;
+	}
+	x86_64_test_reg_reg_size(inst, reg, reg, size);
+	return inst;
+}
+
+/*
+ * Determine if the unconditional branch "insn" at the end of "block"
+ * goes to the code that immediately follows it.
+ */
+static int
+branch_is_next(jit_function_t func, jit_block_t block, jit_insn_t insn)
+{
+	jit_block_t target;
+	jit_insn_iter_t iter;
+	jit_insn_t next;
+
+	target = jit_block_from_label(func, (jit_label_t)(insn->dest));
+	if(!target || target->address)
+	{
+		return 0;
+	}
+	for(block = block->next; block && block != target; block = block->next)
+	{
+		jit_insn_iter_init(&iter, block);
+		while((next = jit_insn_iter_next(&iter)) != 0)
+		{
+			if(next->opcode != JIT_OP_NOP)
+			{
+				return 0;
+			}
+		}
+	}
+	return block == target;
+}
+
 void
 _jit_gen_fix_value(jit_value_t value)
 {
@@ -1132,6 +1526,7 @@ _jit_gen_spill_reg(jit_gencode_t gen, int reg,
 		reg = _jit_reg_info[reg].cpu_reg;
 		other_reg = _jit_reg_info[value->global_reg].cpu_reg;
 		x86_64_mov_reg_reg_size(inst, other_reg, reg, sizeof(void *));
+		peephole_move(gen, gen->ptr, inst, other_reg, reg, sizeof(void *));
 		jit_cache_end_output();
 		return;
 	}
@@ -1145,6 +1540,25 @@ _jit_gen_spill_reg(jit_gencode_t gen, int reg,
 	/* and spill the register */
 	_spill_reg(&inst, type, reg, value->frame_offset);
 
+	/* Remember the store for the peephole optimizer */
+	if(IS_GENERAL_REG(reg))
+	{
+		switch(type->kind)
+		{
+		case JIT_TYPE_INT:
+		case JIT_TYPE_UINT:
+			peephole_store(gen, gen->ptr, inst, _jit_reg_info[reg].cpu_reg,
+				       value->frame_offset, 4);
+			break;
+
+		case JIT_TYPE_LONG:
+		case JIT_TYPE_ULONG:
+			peephole_store(gen, gen->ptr, inst, _jit_reg_info[reg].cpu_reg,
+				       value->frame_offset, 8);
+			break;
+		}
+	}
+
 	/* End the code output process */
 	jit_cache_end_output();
 }
@@ -1302,6 +1716,60 @@ output_branch(jit_function_t func, unsigned char *inst, int opcode,
 	return inst;
 }
 
+/*
+ * Throw a builtin exception if the condition is true.  Unless the
+ * function has a "try" block the code that throws the exception is
+ * shared by all the checks of the same type and is emitted after the
+ * epilog so that it does not get in the way of the hot code.
+ */
+static unsigned char *
+throw_builtin_if(unsigned char *inst, jit_gencode_t gen, jit_function_t func,
+		 int cond, int is_signed, int type)
+{
+	unsigned char *patch;
+	unsigned char code;
+	jit_int fixup;
+	int index;
+
+	if(is_signed)
+	{
+		code = x86_cc_signed_map[cond];
+	}
+	else
+	{
+		code = x86_cc_unsigned_map[cond];
+	}
+
+	index = JIT_RESULT_OVERFLOW - type;
+	if(func->builder->setjmp_value != 0
+	   || index < 0 || index >= (int) (sizeof(gen->throw_fixup) / sizeof(void *)))
+	{
+		/* The x86 branch opcodes come in pairs that differ in the
+		   lowest bit, so "code ^ 1" branches on the opposite condition */
+		patch = inst;
+		*inst++ = (unsigned char) (code ^ 1);
+		*inst++ = (unsigned char) 0;
+		inst = throw_builtin(inst, func, type);
+		x86_patch(patch, inst);
+		return inst;
+	}
+
+	/* Output a placeholder for the branch and add it to the fixup list */
+	*inst++ = (unsigned char)0x0f;
+	*inst++ = (unsigned char) (code + 0x10);
+	if(gen->throw_fixup[index])
+	{
+		fixup = _JIT_CALC_FIXUP(gen->throw_fixup[index], inst);
+	}
+	else
+	{
+		fixup = 0;
+	}
+	gen->throw_fixup[index] = (void *)inst;
+	x86_imm_emit32(inst, fixup);
+	return inst;
+}
+
 /*
  * Jump to the current function's epilog.
  */
@@ -1784,7 +2252,7 @@ _jit_gen_load_value(jit_gencode_t gen, int reg, int other_reg, jit_value_t value
 				{
 					int xmm_reg = _jit_reg_info[reg].cpu_reg;
 
-					if(float32_value == (jit_float32) 0.0)
+					if(_jit_float32_is_plus_zero(float32_value))
 					{
 						x86_64_clear_xreg(inst, xmm_reg);
 					}
@@ -1796,7 +2264,7 @@ _jit_gen_load_value(jit_gencode_t gen, int reg, int other_reg, jit_value_t value
 				}
 				else
 				{
-					if(float32_value == (jit_float32) 0.0)
+					if(_jit_float32_is_plus_zero(float32_value))
 					{
 						x86_fldz(inst);
 					}
@@ -1853,7 +2321,7 @@ _jit_gen_load_value(jit_gencode_t gen, int reg, int other_reg, jit_value_t value
 				{
 					int xmm_reg = _jit_reg_info[reg].cpu_reg;
 
-					if(float64_value == (jit_float64) 0.0)
+					if(_jit_float64_is_plus_zero(float64_value))
 					{
 						x86_64_clear_xreg(inst, xmm_reg);
 					}
@@ -1865,7 +2333,7 @@ _jit_gen_load_value(jit_gencode_t gen, int reg, int other_reg, jit_value_t value
 				}
 				else
 				{
-					if(float64_value == (jit_float64) 0.0)
+					if(_jit_float64_is_plus_zero(float64_value))
 					{
 						x86_fldz(inst);
 					}
@@ -1946,7 +2414,7 @@ _jit_gen_load_value(jit_gencode_t gen, int reg, int other_reg, jit_value_t value
 				}
 				else
 				{
-					if(nfloat_value == (jit_nfloat) 0.0)
+					if(_jit_nfloat_is_plus_zero(nfloat_value))
 					{
 						x86_fldz(inst);
 					}
@@ -2050,6 +2518,8 @@ _jit_gen_load_value(jit_gencode_t gen, int reg, int other_reg, jit_value_t value
 			{
 				x86_64_mov_reg_reg_size(inst, _jit_reg_info[reg].cpu_reg,
 										_jit_reg_info[src_reg].cpu_reg, 4);
+				peephole_move(gen, gen->ptr, inst, _jit_reg_info[reg].cpu_reg,
+							  _jit_reg_info[src_reg].cpu_reg, 4);
 			}
 			break;
 
@@ -2058,6 +2528,8 @@ _jit_gen_load_value(jit_gencode_t gen, int reg, int other_reg, jit_value_t value
 			{
 				x86_64_mov_reg_reg_size(inst, _jit_reg_info[reg].cpu_reg,
 										_jit_reg_info[src_reg].cpu_reg, 8);
+				peephole_move(gen, gen->ptr, inst, _jit_reg_info[reg].cpu_reg,
+							  _jit_reg_info[src_reg].cpu_reg, 8);
 			}
 			break;
 
@@ -2241,16 +2713,16 @@ _jit_gen_load_value(jit_gencode_t gen, int reg, int other_reg, jit_value_t value
 			case JIT_TYPE_INT:
 			case JIT_TYPE_UINT:
 			{
-				x86_64_mov_reg_membase_size(inst, _jit_reg_info[reg].cpu_reg,
-											X86_64_RBP, offset, 4);
+				inst = peephole_load(gen, inst, _jit_reg_info[reg].cpu_reg,
+									 offset, 4);
 			}
 			break;
 
 			case JIT_TYPE_LONG:
 			case JIT_TYPE_ULONG:
 			{
-				x86_64_mov_reg_membase_size(inst, _jit_reg_info[reg].cpu_reg,
-											X86_64_RBP, offset, 8);
+				inst = peephole_load(gen, inst, _jit_reg_info[reg].cpu_reg,
+									 offset, 8);
 			}
 			break;
 
@@ -2488,7 +2960,7 @@ void
 _jit_gen_epilog(jit_gencode_t gen, jit_function_t func)
 {
 	unsigned char *inst;
-	int reg;
+	int reg, index;
 	int current_offset;
 	jit_int *fixup;
 	jit_int *next;
@@ -2597,6 +3069,27 @@ _jit_gen_epilog(jit_gencode_t gen, jit_function_t func)
 	/* and return */
 	x86_64_ret(inst);
 
+	/* Emit the code that throws the exceptions for the checks */
+	for(index = 0; index < (int) (sizeof(gen->throw_fixup) / sizeof(void *)); index++)
+	{
+		fixup = (jit_int *)(gen->throw_fixup[index]);
+		if(fixup == 0)
+		{
+			continue;
+		}
+
+		gen->ptr = inst;
+		_jit_gen_check_space(gen, 32);
+		while(fixup != 0)
+		{
+			next = (jit_int *)_JIT_CALC_NEXT_FIXUP(fixup, fixup[0]);
+			fixup[0] = (jit_int)(((jit_nint)inst) - ((jit_nint)fixup) - 4);
+			fixup = next;
+		}
+		gen->throw_fixup[index] = 0;
+		inst = throw_builtin(inst, func, JIT_RESULT_OVERFLOW - index);
+	}
+
 	gen->ptr = inst;
 }
 
@@ -2817,6 +3310,305 @@ small_block_set(jit_gencode_t gen, unsigned char *inst,
 	return inst;
 }
 
+/*
+ * Load or store one chunk of a block at "disp" from "basereg", or at
+ * "disp" from the end of the block if "size_reg" holds the block size.
+ */
+static unsigned char *
+block_chunk(unsigned char *inst, int is_load, int reg, int basereg,
+			jit_nint disp, int size_reg, int chunk)
+{
+	if(chunk == 16)
+	{
+		if(size_reg < 0)
+		{
+			if(is_load)
+			{
+				x86_64_movups_reg_membase(inst, reg, basereg, disp);
+			}
+			else
+			{
+				x86_64_movups_membase_reg(inst, basereg, disp, reg);
+			}
+		}
+		else if(is_load)
+		{
+			x86_64_movups_reg_memindex(inst, reg, basereg, disp, size_reg, 0);
+		}
+		else
+		{
+			x86_64_movups_memindex_reg(inst, basereg, disp, size_reg, 0, reg);
+		}
+	}
+	else if(size_reg < 0)
+	{
+		if(is_load)
+		{
+			x86_64_mov_reg_membase_size(inst, reg, basereg, disp, chunk);
+		}
+		else
+		{
+			x86_64_mov_membase_reg_size(inst, basereg, disp, reg, chunk);
+		}
+	}
+	else if(is_load)
+	{
+		x86_64_mov_reg_memindex_size(inst, reg, basereg, disp, size_reg, 0, chunk);
+	}
+	else
+	{
+		x86_64_mov_memindex_reg_size(inst, basereg, disp, size_reg, 0, reg, chunk);
+	}
+	return inst;
+}
+
+/*
+ * Move a block of "size" bytes where width <= size <= 2 * width.  This
+ * moves the first and the last "width" bytes, which overlap unless the
+ * size is exactly 2 * width.  All the loads are done before the stores,
+ * so the source and the destination may overlap.  The widths up to 8 use the
+ * two general registers in "regs", the width 16 uses the first two xmm
+ * registers in "xregs" and the width 32 uses all four of them.
+ */
+static unsigned char *
+block_move_head_tail(unsigned char *inst, int dreg, int sreg,
+					 jit_nint size, int width,
+					 const int *regs, const int *xregs)
+{
+	jit_nint disp[4];
+	int chunk, count, i;
+
+	chunk = (width > 16) ? 16 : width;
+	count = 2 * (width / chunk);
+	for(i = 0; i < count / 2; ++i)
+	{
+		disp[i] = i * chunk;
+		disp[count / 2 + i] = size - width + i * chunk;
+	}
+	for(i = 0; i < count; ++i)
+	{
+		inst = block_chunk(inst, 1, (chunk == 16) ? xregs[i] : regs[i],
+						   sreg, disp[i], -1, chunk);
+	}
+	for(i = 0; i < count; ++i)
+	{
+		inst = block_chunk(inst, 0, (chunk == 16) ? xregs[i] : regs[i],
+						   dreg, disp[i], -1, chunk);
+	}
+	return inst;
+}
+
+/*
+ * Fill a block of "size" bytes where width <= size <= 2 * width with
+ * the byte pattern in "reg" and "xreg" in the same way.
+ */
+static unsigned char *
+block_set_head_tail(unsigned char *inst, int dreg, jit_nint size,
+					int width, int reg, int xreg)
+{
+	jit_nint end;
+	int chunk, i;
+
+	chunk = (width > 16) ? 16 : width;
+	end = size - width;
+	for(i = 0; i < width; i += chunk)
+	{
+		inst = block_chunk(inst, 0, (chunk == 16) ? xreg : reg,
+						   dreg, i, -1, chunk);
+		inst = block_chunk(inst, 0, (chunk == 16) ? xreg : reg,
+						   dreg, end + i, -1, chunk);
+	}
+	return inst;
+}
+
+/*
+ * Get the width for block_move_head_tail for a constant size of 1 to 64.
+ */
+static int
+block_width(jit_nint size)
+{
+	int width = 32;
+
+	while(width > size)
+	{
+		width /= 2;
+	}
+	return width;
+}
+
+/*
+ * The largest constant block size that is copied or filled inline with
+ * a loop of 16 byte moves.  The larger and the variable sizes call the
+ * C library, which is faster there.
+ */
+#define X86_64_MAX_BLOCK_INLINE	256
+
+/*
+ * Load the byte in AL to all the bytes of "reg" and "xreg".  This
+ * clobbers "temp_reg".
+ */
+static unsigned char *
+block_set_pattern(unsigned char *inst, int reg, int temp_reg, int xreg)
+{
+	/* Not a constant expression, so that the 16-bit case of the move
+	   macro does not warn about truncating it */
+	jit_nint ones = (jit_nint)(jit_nuint)0x0101010101010101ULL;
+
+	x86_64_movzx8_reg_reg_size(inst, reg, X86_64_RAX, 4);
+	x86_64_mov_reg_imm_size(inst, temp_reg, ones, 8);
+	x86_64_imul_reg_reg_size(inst, reg, temp_reg, 8);
+	x86_64_movq_xreg_reg(inst, xreg, reg);
+	x86_64_movlhps(inst, xreg, xreg);
+	return inst;
+}
+
+/*
+ * Copy RCX > 32 bytes from RSI to RDI forwards, 32 bytes per iteration.
+ * The last 32 bytes are loaded before the loop and stored after it, so
+ * this also works for a move to a lower address.  This clobbers RCX,
+ * "reg" and the four "xregs".
+ */
+static unsigned char *
+block_copy_loop(unsigned char *inst, int reg, const int *xregs)
+{
+	unsigned char *loop;
+
+	inst = block_chunk(inst, 1, xregs[2], X86_64_RSI, -32, X86_64_RCX, 16);
+	inst = block_chunk(inst, 1, xregs[3], X86_64_RSI, -16, X86_64_RCX, 16);
+	x86_64_sub_reg_imm_size(inst, X86_64_RCX, 32, 8);
+	x86_64_xor_reg_reg_size(inst, reg, reg, 4);
+	loop = inst;
+	inst = block_chunk(inst, 1, xregs[0], X86_64_RSI, 0, reg, 16);
+	inst = block_chunk(inst, 1, xregs[1], X86_64_RSI, 16, reg, 16);
+	inst = block_chunk(inst, 0, xregs[0], X86_64_RDI, 0, reg, 16);
+	inst = block_chunk(inst, 0, xregs[1], X86_64_RDI, 16, reg, 16);
+	x86_64_add_reg_imm_size(inst, reg, 32, 8);
+	x86_64_cmp_reg_reg_size(inst, reg, X86_64_RCX, 8);
+	x86_branch(inst, X86_CC_B, loop, 0);
+	inst = block_chunk(inst, 0, xregs[2], X86_64_RDI, 0, X86_64_RCX, 16);
+	inst = block_chunk(inst, 0, xregs[3], X86_64_RDI, 16, X86_64_RCX, 16);
+	return inst;
+}
+
+/*
+ * Fill RCX > 32 bytes at RDI with the pattern in "xreg".
+ */
+static unsigned char *
+block_set_loop(unsigned char *inst, int reg, int xreg)
+{
+	unsigned char *loop;
+
+	inst = block_chunk(inst, 0, xreg, X86_64_RDI, -32, X86_64_RCX, 16);
+	inst = block_chunk(inst, 0, xreg, X86_64_RDI, -16, X86_64_RCX, 16);
+	x86_64_sub_reg_imm_size(inst, X86_64_RCX, 32, 8);
+	x86_64_xor_reg_reg_size(inst, reg, reg, 4);
+	loop = inst;
+	inst = block_chunk(inst, 0, xreg, X86_64_RDI, 0, reg, 16);
+	inst = block_chunk(inst, 0, xreg, X86_64_RDI, 16, reg, 16);
+	x86_64_add_reg_imm_size(inst, reg, 32, 8);
+	x86_64_cmp_reg_reg_size(inst, reg, X86_64_RCX, 8);
+	x86_branch(inst, X86_CC_B, loop, 0);
+	return inst;
+}
+
+/*
+ * Apply the alu operation "opc" with "value" to the memory at "ptr"
+ * atomically and load the old value to "dreg".  There is no instruction
+ * that both does this and returns the old value for the bitwise
+ * operations so retry the compare and exchange until the memory does
+ * not change between the load and the store.  The "accum" register must
+ * be RAX.
+ */
+static unsigned char *
+atomic_fetch_op(unsigned char *inst, int opc, int dreg, int ptr, int value,
+		int accum, int temp, int size)
+{
+	unsigned char *loop;
+
+	x86_64_mov_reg_regp_size(inst, accum, ptr, size);
+	loop = inst;
+	x86_64_mov_reg_reg_size(inst, temp, accum, size);
+	x86_64_alu_reg_reg_size(inst, opc, temp, value, size);
+	x86_64_lock(inst);
+	x86_64_cmpxchg_regp_reg_size(inst, ptr, temp, size);
+	x86_branch(inst, X86_CC_NE, loop, 0);
+	if(dreg != accum)
+	{
+		x86_64_mov_reg_reg_size(inst, dreg, accum, size);
+	}
+	return inst;
+}
+
+/*
+ * Count the bits set in "reg" in place for the cpus that have no popcnt
+ * instruction.  The bits are added up in parallel in the 2, 4 and 8 bit
+ * fields and the byte counts are summed up with the multiplication.
+ */
+static unsigned char *
+popcount_reg(unsigned char *inst, int reg, int temp1, int temp2, int size)
+{
+	jit_nint mask1 = (size == 8) ? (jit_nint) 0x5555555555555555LL : 0x55555555;
+	jit_nint mask2 = (size == 8) ? (jit_nint) 0x3333333333333333LL : 0x33333333;
+	jit_nint mask4 = (size == 8) ? (jit_nint) 0x0F0F0F0F0F0F0F0FLL : 0x0F0F0F0F;
+	jit_nint ones = (size == 8) ? (jit_nint) 0x0101010101010101LL : 0x01010101;
+
+	/* reg = reg - ((reg >> 1) & mask1) */
+	x86_64_mov_reg_reg_size(inst, temp1, reg, size);
+	x86_64_shr_reg_imm_size(inst, temp1, 1, size);
+	x86_64_mov_reg_imm_size(inst, temp2, mask1, size);
+	x86_64_and_reg_reg_size(inst, temp1, temp2, size);
+	x86_64_sub_reg_reg_size(inst, reg, temp1, size);
+
+	/* reg = (reg & mask2) + ((reg >> 2) & mask2) */
+	x86_64_mov_reg_reg_size(inst, temp1, reg, size);
+	x86_64_shr_reg_imm_size(inst, temp1, 2, size);
+	x86_64_mov_reg_imm_size(inst, temp2, mask2, size);
+	x86_64_and_reg_reg_size(inst, temp1, temp2, size);
+	x86_64_and_reg_reg_size(inst, reg, temp2, size);
+	x86_64_add_reg_reg_size(inst, reg, temp1, size);
+
+	/* reg = (reg + (reg >> 4)) & mask4 */
+	x86_64_mov_reg_reg_size(inst, temp1, reg, size);
+	x86_64_shr_reg_imm_size(inst, temp1, 4, size);
+	x86_64_add_reg_reg_size(inst, reg, temp1, size);
+	x86_64_mov_reg_imm_size(inst, temp2, mask4, size);
+	x86_64_and_reg_reg_size(inst, reg, temp2, size);
+
+	/* Sum up the byte counts in the top byte */
+	x86_64_mov_reg_imm_size(inst, temp2, ones, size);
+	x86_64_imul_reg_reg_size(inst, reg, temp2, size);
+	x86_64_shr_reg_imm_size(inst, reg, size * 8 - 8, size);
+	return inst;
+}
+
+/*
+ * Count the leading zero bits in "reg" in place for the cpus that have
+ * no lzcnt instruction.  The bsr instruction returns the index of the
+ * highest bit set and leaves the zero flag set if there is none.
+ */
+static unsigned char *
+clz_reg(unsigned char *inst, int reg, int temp, int size)
+{
+	x86_64_mov_reg_imm_size(inst, temp, size * 16 - 1, 4);
+	x86_64_bsr_reg_reg_size(inst, reg, reg, size);
+	x86_64_cmov_reg_reg_size(inst, X86_CC_EQ, reg, temp, 0, 4);
+	x86_64_xor_reg_imm_size(inst, reg, size * 8 - 1, 4);
+	return inst;
+}
+
+/*
+ * Count the trailing zero bits in "reg" in place for the cpus that have
+ * no tzcnt instruction.
+ */
+static unsigned char *
+ctz_reg(unsigned char *inst, int reg, int temp, int size)
+{
+	x86_64_mov_reg_imm_size(inst, temp, size * 8, 4);
+	x86_64_bsf_reg_reg_size(inst, reg, reg, size);
+	x86_64_cmov_reg_reg_size(inst, X86_CC_EQ, reg, temp, 0, 4);
+	return inst;
+}
+
 void
 _jit_gen_start_block(jit_gencode_t gen, jit_block_t block)
 {
@@ -2828,6 +3620,18 @@ _jit_gen_start_block(jit_gencode_t gen, jit_block_t block)
 	/* Set the address of this block */
 	block->address = (void *)(gen->ptr);
 
+	/* The peephole state holds only if the block is entered solely
+	   by falling through from the previous block */
+	if(block->num_preds != 1
+	   || block->preds[0]->src != block->prev
+	   || block->preds[0]->flags != _JIT_EDGE_FALLTHRU
+	   || block->fixup_list || block->fixup_absolute_list
+	   || block->address_of)
+	{
+		gen->flags_end = 0;
+		gen->store_end = 0;
+	}
+
 	/* If this block has pending fixups, then apply them now */
 	fixup = (jit_int *)(block->fixup_list);
 	if(DEBUG_FIXUPS && fixup)
@@ -3864,6 +4668,13 @@ int _jit_create_call_setup_insns
 	/* Let the backend do final adjustments to the passing area */
 	_jit_fix_call_stack(&passing);
 
+	/* The stack arguments of a tail call would have to go to the
+	   incoming area of our own caller, which is not supported */
+	if((flags & JIT_CALL_TAIL) != 0 && passing.stack_size > 0)
+	{
+		return 0;
+	}
+
 #ifdef JIT_USE_PARAM_AREA
 	if(passing.stack_size > func->builder->param_area_size)
 	{
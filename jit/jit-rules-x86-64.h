@@ -114,15 +114,47 @@ extern	"C" {
  */
 
 #define jit_extra_gen_state	\
-	void *alloca_fixup
+	void *alloca_fixup;	\
+	void *throw_fixup[10];	\
+	unsigned char *flags_end;	\
+	int flags_regs;	\
+	int flags_size;	\
+	unsigned char *store_end;	\
+	int store_reg;	\
+	int store_offset;	\
+	int store_size;	\
+	int features
 
 #define jit_extra_gen_init(gen)	\
 	do {	\
 		(gen)->alloca_fixup = 0;	\
+		jit_memzero((gen)->throw_fixup, sizeof((gen)->throw_fixup));	\
+		(gen)->flags_end = 0;	\
+		(gen)->flags_regs = 0;	\
+		(gen)->flags_size = 0;	\
+		(gen)->store_end = 0;	\
+		(gen)->store_reg = -1;	\
+		(gen)->store_offset = 0;	\
+		(gen)->store_size = 0;	\
+		(gen)->features = _jit_x86_64_features((gen)->context);	\
 	} while (0)
 
 #define jit_extra_gen_cleanup(gen)	do { ; } while (0)
 
+/*
+ * Get the optional instruction set extensions that the code of
+ * a context may use.
+ */
+int _jit_x86_64_features(jit_context_t context);
+
+/*
+ * Determine if the code of a context may use the fused multiply-add
+ * opcodes.  jit_insn_fma calls the C library where this is not defined
+ * or is false.
+ */
+#define jit_gen_has_fma(context)	_jit_x86_64_has_fma(context)
+int _jit_x86_64_has_fma(jit_context_t context);
+
 /*
  * Parameter passing rules.
  */
@@ -134,6 +166,12 @@ extern	"C" {
  */
 #define JIT_USE_PARAM_AREA
 
+/*
+ * Tail calls to other functions pass the arguments in registers the same
+ * way as regular calls.
+ */
+#define JIT_GENERAL_TAIL_CALLS
+
 #ifdef	__cplusplus
 };
 #endif
@@ -799,7 +799,7 @@ _jit_gen_load_value(jit_gencode_t gen, int reg, int other_reg, jit_value_t value
 				}
 				else
 				{
-					if(float32_value == (jit_float32) 0.0)
+					if(_jit_float32_is_plus_zero(float32_value))
 					{
 						x86_fldz(inst);
 					}
@@ -837,7 +837,7 @@ _jit_gen_load_value(jit_gencode_t gen, int reg, int other_reg, jit_value_t value
 				}
 				else
 				{
-					if(float64_value == (jit_float64) 0.0)
+					if(_jit_float64_is_plus_zero(float64_value))
 					{
 						x86_fldz(inst);
 					}
@@ -875,7 +875,7 @@ _jit_gen_load_value(jit_gencode_t gen, int reg, int other_reg, jit_value_t value
 				}
 				else
 				{
-					if(nfloat_value == (jit_nfloat) 0.0)
+					if(_jit_nfloat_is_plus_zero(nfloat_value))
 					{
 						x86_fldz(inst);
 					}
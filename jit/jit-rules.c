@@ -761,6 +761,184 @@ _jit_gen_alloc(jit_gencode_t gen, unsigned long size)
 	return ptr;
 }
 
+/*
+ * The division by constant algorithms below are taken from "Hacker's
+ * Delight" by Henry S. Warren, Jr., chapter 10 "Integer Division by
+ * Constants".
+ *
+ * For a signed divisor d, 2 <= |d| < 2^(bits-1), the quotient of x by d
+ * is computed as:
+ *
+ *	t = floor(x * M / 2^(bits + shift))
+ *	q = t + (t < 0 ? 1 : 0)
+ *
+ * where M is the "magic" value with the sign of d.  The absolute value
+ * of M is below 2^bits, so if the product is computed at double width
+ * nothing else is needed.  With a "multiply high" instruction M is
+ * truncated to a signed value of the given width and then x has to be
+ * added to the high part of the product if d > 0 and M < 0, or
+ * subtracted from it if d < 0 and M > 0.
+ *
+ * Returns zero if the divisor is not suitable.
+ */
+int
+_jit_div_magic_signed(jit_long divisor, int bits, jit_ulong *magic, int *shift)
+{
+	jit_ulong two, ad, anc, t, delta;
+	jit_ulong q1, r1, q2, r2;
+	int p;
+
+	two = ((jit_ulong) 1) << (bits - 1);
+	ad = divisor < 0 ? -(jit_ulong) divisor : (jit_ulong) divisor;
+	if(ad < 2 || ad >= two)
+	{
+		return 0;
+	}
+
+	t = two + (divisor < 0 ? 1 : 0);
+	anc = t - 1 - t % ad;
+	p = bits - 1;
+	q1 = two / anc;
+	r1 = two - q1 * anc;
+	q2 = two / ad;
+	r2 = two - q2 * ad;
+	do
+	{
+		++p;
+		q1 = 2 * q1;
+		r1 = 2 * r1;
+		if(r1 >= anc)
+		{
+			++q1;
+			r1 -= anc;
+		}
+		q2 = 2 * q2;
+		r2 = 2 * r2;
+		if(r2 >= ad)
+		{
+			++q2;
+			r2 -= ad;
+		}
+		delta = ad - r2;
+	}
+	while(q1 < delta || (q1 == delta && r1 == 0));
+
+	*magic = divisor < 0 ? -(q2 + 1) : (q2 + 1);
+	*shift = p - bits;
+	return 1;
+}
+
+/*
+ * For an unsigned divisor d, d >= 2, the quotient of x by d is computed
+ * as:
+ *
+ *	q = floor(x * M / 2^(bits + shift))
+ *
+ * If "add" is set then M does not fit in "bits" and the actual
+ * multiplier is M + 2^bits.  In this case the quotient is computed as
+ * floor((floor(x * M / 2^bits) + x) / 2^shift) where the sum has to be
+ * computed with one more bit of precision, or, with a "multiply high"
+ * instruction, as:
+ *
+ *	t = floor(x * M / 2^bits)
+ *	q = (((x - t) >> 1) + t) >> (shift - 1)
+ *
+ * Returns zero if the divisor is not suitable.
+ */
+int
+_jit_div_magic_unsigned(jit_ulong divisor, int bits, jit_ulong *magic,
+			int *shift, int *add)
+{
+	jit_ulong mask, two, nc, delta;
+	jit_ulong q1, r1, q2, r2;
+	int p;
+
+	mask = bits < 64 ? (((jit_ulong) 1) << bits) - 1 : ~((jit_ulong) 0);
+	two = ((jit_ulong) 1) << (bits - 1);
+	if(divisor < 2 || divisor > mask)
+	{
+		return 0;
+	}
+
+	*add = 0;
+	nc = (mask - ((mask + 1 - divisor) & mask) % divisor) & mask;
+	p = bits - 1;
+	q1 = two / nc;
+	r1 = two - q1 * nc;
+	q2 = (two - 1) / divisor;
+	r2 = (two - 1) - q2 * divisor;
+	do
+	{
+		++p;
+		if(r1 >= nc - r1)
+		{
+			q1 = (2 * q1 + 1) & mask;
+			r1 = (2 * r1 - nc) & mask;
+		}
+		else
+		{
+			q1 = (2 * q1) & mask;
+			r1 = (2 * r1) & mask;
+		}
+		if(r2 + 1 >= divisor - r2)
+		{
+			if(q2 >= two - 1)
+			{
+				*add = 1;
+			}
+			q2 = (2 * q2 + 1) & mask;
+			r2 = (2 * r2 + 1 - divisor) & mask;
+		}
+		else
+		{
+			if(q2 >= two)
+			{
+				*add = 1;
+			}
+			q2 = (2 * q2) & mask;
+			r2 = (2 * r2 + 1) & mask;
+		}
+		delta = divisor - 1 - r2;
+	}
+	while(p < 2 * bits && (q1 < delta || (q1 == delta && r1 == 0)));
+
+	*magic = (q2 + 1) & mask;
+	*shift = p - bits;
+	return 1;
+}
+
+int
+_jit_float32_is_plus_zero(jit_float32 value)
+{
+	union
+	{
+		jit_float32 float32_value;
+		jit_int int_value;
+	} un;
+	un.float32_value = value;
+	return un.int_value == 0;
+}
+
+int
+_jit_float64_is_plus_zero(jit_float64 value)
+{
+	union
+	{
+		jit_float64 float64_value;
+		jit_long long_value;
+	} un;
+	un.float64_value = value;
+	return un.long_value == 0;
+}
+
+int
+_jit_nfloat_is_plus_zero(jit_nfloat value)
+{
+	/* The padding bits of a long double are not defined, but narrowing
+	   a zero to jit_float64 keeps its sign */
+	return value == (jit_nfloat) 0.0 && _jit_float64_is_plus_zero((jit_float64) value);
+}
+
 int _jit_int_lowest_byte(void)
 {
 	union
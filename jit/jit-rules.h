@@ -169,6 +169,10 @@ struct jit_gencode
 	jit_regused_t		inhibit;	/* Temporarily inhibited registers */
 	jit_regcontents_t	contents[JIT_NUM_REGS]; /* Contents of each register */
 	int			current_age;	/* Current age value for registers */
+#if JIT_NUM_GLOBAL_REGS != 0
+	jit_value_t		global_values[JIT_NUM_GLOBAL_REGS]; /* Values in global regs */
+	int			num_global_values; /* Number of values in global regs */
+#endif
 #ifdef JIT_REG_STACK
 	int			reg_stack_top;	/* Current register stack top */
 #endif
@@ -177,6 +181,9 @@ struct jit_gencode
 #endif
 	void			*epilog_fixup;	/* Fixup list for function epilogs */
 	int			stack_changed;	/* Stack top changed since entry */
+	int			no_peephole;	/* Peephole optimization is disabled */
+	int			peephole_insns;	/* Instructions changed by peephole */
+	int			peephole_bytes;	/* Bytes saved by peephole */
 	jit_varint_encoder_t	offset_encoder;	/* Bytecode offset encoder */
 };
 
@@ -244,6 +251,25 @@ int _jit_gen_is_global_candidate(jit_type_t type);
 int _jit_reg_get_pair(jit_type_t type, int reg);
 #endif
 
+/*
+ * Compute the magic multiplier and shift count that replace division
+ * by a constant with a multiplication by the constant's reciprocal.
+ * The "bits" argument is the operand width, 32 or 64.  See the comments
+ * in jit-rules.c for how to use the result.
+ */
+int _jit_div_magic_signed(jit_long divisor, int bits, jit_ulong *magic, int *shift);
+int _jit_div_magic_unsigned(jit_ulong divisor, int bits, jit_ulong *magic,
+			    int *shift, int *add);
+
+/*
+ * Determine if a floating point constant is +0.0, which is loaded by
+ * clearing the register.  -0.0 compares equal to it but has the sign
+ * bit set.
+ */
+int _jit_float32_is_plus_zero(jit_float32 value);
+int _jit_float64_is_plus_zero(jit_float64 value);
+int _jit_nfloat_is_plus_zero(jit_nfloat value);
+
 /*
  * Determine the byte number within a "jit_int" where the low
  * order byte can be found.
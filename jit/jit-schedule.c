@@ -0,0 +1,451 @@
+/*
+ * jit-schedule.c - Instruction scheduling.
+ *
+ * Copyright (C) 2026  Free Software Foundation, Inc.
+ *
+ * This file is part of the libjit library.
+ *
+ * The libjit library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * The libjit library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the libjit library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "jit-internal.h"
+
+/*
+ * The instructions are reordered within the regions of the blocks
+ * that contain no calls, branches or other instructions with effects
+ * beyond their operands.  Every region is list scheduled on a machine
+ * that issues one instruction per cycle: the instruction that is ready
+ * first is chosen and among the ready ones the instruction with the
+ * longest latency path to the end of the region.  So the loads and the
+ * divisions start as early as their operands allow and the instructions
+ * that do not depend on them fill the time until their results are
+ * needed.
+ *
+ * The loads and the stores keep their order relative to the stores and
+ * to the instructions that may throw exceptions.  Functions with
+ * exception handlers are not scheduled, so a thrown exception leaves
+ * nothing behind that could see the values computed out of order.
+ *
+ * The regions are limited in size to keep the time quadratic in the
+ * region size low and to avoid raising the register pressure too far.
+ */
+
+#define	MAX_REGION	32
+
+/*
+ * The kinds of the instructions that can be moved.
+ */
+#define	KIND_FIXED	0
+#define	KIND_PURE	1
+#define	KIND_THROW	2
+#define	KIND_LOAD	3
+#define	KIND_STORE	4
+
+typedef struct
+{
+	/* The instructions of the region in the original order */
+	struct _jit_insn	insns[MAX_REGION];
+	int			num_insns;
+
+	/* The kind and the latency of the instructions */
+	int			kind[MAX_REGION];
+	int			latency[MAX_REGION];
+
+	/* The instructions each instruction depends on */
+	jit_uint		preds[MAX_REGION];
+
+	/* The longest latency path to the end of the region */
+	int			height[MAX_REGION];
+
+	/* The cycle the operands of the instruction are ready */
+	int			ready[MAX_REGION];
+
+} _jit_schedule_info_t;
+
+/*
+ * Get the kind of the instruction as far as the scheduling goes.
+ */
+static int
+get_kind(jit_insn_t insn)
+{
+	int opcode = insn->opcode;
+
+	if(opcode == JIT_OP_NOP)
+	{
+		return KIND_PURE;
+	}
+	if((insn->flags & (JIT_INSN_DEST_OTHER_FLAGS
+			   | JIT_INSN_VALUE1_OTHER_FLAGS
+			   | JIT_INSN_VALUE2_OTHER_FLAGS)) != 0)
+	{
+		return KIND_FIXED;
+	}
+
+	if((opcode >= JIT_OP_TRUNC_SBYTE && opcode <= JIT_OP_TRUNC_UINT)
+	   || opcode == JIT_OP_LOW_WORD
+	   || opcode == JIT_OP_EXPAND_INT
+	   || opcode == JIT_OP_EXPAND_UINT
+	   || (opcode >= JIT_OP_FLOAT32_TO_INT && opcode <= JIT_OP_FLOAT32_TO_ULONG)
+	   || (opcode >= JIT_OP_INT_TO_FLOAT32 && opcode <= JIT_OP_FLOAT64_TO_ULONG)
+	   || (opcode >= JIT_OP_INT_TO_FLOAT64 && opcode <= JIT_OP_FLOAT64_TO_FLOAT32)
+	   || opcode == JIT_OP_IADD || opcode == JIT_OP_ISUB
+	   || opcode == JIT_OP_IMUL || opcode == JIT_OP_INEG
+	   || opcode == JIT_OP_LADD || opcode == JIT_OP_LSUB
+	   || opcode == JIT_OP_LMUL || opcode == JIT_OP_LNEG
+	   || (opcode >= JIT_OP_FADD && opcode <= JIT_OP_FDIV)
+	   || opcode == JIT_OP_FNEG
+	   || (opcode >= JIT_OP_DADD && opcode <= JIT_OP_DDIV)
+	   || opcode == JIT_OP_DNEG
+	   || (opcode >= JIT_OP_IAND && opcode <= JIT_OP_LSHR_UN)
+	   || (opcode >= JIT_OP_ICMP && opcode <= JIT_OP_LCMP_UN)
+	   || (opcode >= JIT_OP_IEQ && opcode <= JIT_OP_DGE_INV)
+	   || opcode == JIT_OP_FSQRT || opcode == JIT_OP_DSQRT
+	   || (opcode >= JIT_OP_IABS && opcode <= JIT_OP_DABS)
+	   || (opcode >= JIT_OP_IMIN && opcode <= JIT_OP_DMIN)
+	   || (opcode >= JIT_OP_IMAX && opcode <= JIT_OP_DMAX)
+	   || (opcode >= JIT_OP_ISIGN && opcode <= JIT_OP_DSIGN)
+	   || (opcode >= JIT_OP_IPOPCOUNT && opcode <= JIT_OP_LROR)
+	   || (opcode >= JIT_OP_COPY_LOAD_SBYTE && opcode <= JIT_OP_COPY_FLOAT64)
+	   || opcode == JIT_OP_COPY_STORE_BYTE
+	   || opcode == JIT_OP_COPY_STORE_SHORT
+	   || opcode == JIT_OP_ADD_RELATIVE)
+	{
+		return KIND_PURE;
+	}
+
+	if((opcode >= JIT_OP_CHECK_SBYTE && opcode <= JIT_OP_CHECK_UINT)
+	   || (opcode >= JIT_OP_CHECK_LOW_WORD && opcode <= JIT_OP_CHECK_ULONG)
+	   || (opcode >= JIT_OP_CHECK_FLOAT32_TO_INT
+	       && opcode <= JIT_OP_CHECK_FLOAT32_TO_ULONG)
+	   || (opcode >= JIT_OP_CHECK_FLOAT64_TO_INT
+	       && opcode <= JIT_OP_CHECK_FLOAT64_TO_ULONG)
+	   || opcode == JIT_OP_IADD_OVF || opcode == JIT_OP_IADD_OVF_UN
+	   || opcode == JIT_OP_ISUB_OVF || opcode == JIT_OP_ISUB_OVF_UN
+	   || opcode == JIT_OP_IMUL_OVF || opcode == JIT_OP_IMUL_OVF_UN
+	   || (opcode >= JIT_OP_IDIV && opcode <= JIT_OP_IREM_UN)
+	   || opcode == JIT_OP_LADD_OVF || opcode == JIT_OP_LADD_OVF_UN
+	   || opcode == JIT_OP_LSUB_OVF || opcode == JIT_OP_LSUB_OVF_UN
+	   || opcode == JIT_OP_LMUL_OVF || opcode == JIT_OP_LMUL_OVF_UN
+	   || (opcode >= JIT_OP_LDIV && opcode <= JIT_OP_LREM_UN)
+	   || opcode == JIT_OP_CHECK_NULL
+	   || opcode == JIT_OP_CHECK_BOUNDS)
+	{
+		return KIND_THROW;
+	}
+
+	if((opcode >= JIT_OP_LOAD_RELATIVE_SBYTE
+	    && opcode <= JIT_OP_LOAD_RELATIVE_FLOAT64)
+	   || (opcode >= JIT_OP_LOAD_ELEMENT_SBYTE
+	       && opcode <= JIT_OP_LOAD_ELEMENT_FLOAT64))
+	{
+		return KIND_LOAD;
+	}
+
+	if((opcode >= JIT_OP_STORE_RELATIVE_BYTE
+	    && opcode <= JIT_OP_STORE_RELATIVE_FLOAT64)
+	   || (opcode >= JIT_OP_STORE_ELEMENT_BYTE
+	       && opcode <= JIT_OP_STORE_ELEMENT_FLOAT64))
+	{
+		return KIND_STORE;
+	}
+
+	return KIND_FIXED;
+}
+
+/*
+ * Get the number of cycles until the result of the instruction is
+ * available.  The numbers are typical of the current x86-64 cores.
+ */
+static int
+get_latency(jit_insn_t insn, int kind)
+{
+	switch(insn->opcode)
+	{
+	case JIT_OP_IMUL:
+	case JIT_OP_IMUL_OVF:
+	case JIT_OP_IMUL_OVF_UN:
+	case JIT_OP_LMUL:
+	case JIT_OP_LMUL_OVF:
+	case JIT_OP_LMUL_OVF_UN:
+		return 3;
+
+	case JIT_OP_IDIV:
+	case JIT_OP_IDIV_UN:
+	case JIT_OP_IREM:
+	case JIT_OP_IREM_UN:
+		return 26;
+
+	case JIT_OP_LDIV:
+	case JIT_OP_LDIV_UN:
+	case JIT_OP_LREM:
+	case JIT_OP_LREM_UN:
+		return 40;
+
+	case JIT_OP_FADD:
+	case JIT_OP_FSUB:
+	case JIT_OP_FMUL:
+	case JIT_OP_DADD:
+	case JIT_OP_DSUB:
+	case JIT_OP_DMUL:
+		return 4;
+
+	case JIT_OP_FDIV:
+		return 11;
+
+	case JIT_OP_DDIV:
+		return 14;
+
+	case JIT_OP_FSQRT:
+	case JIT_OP_DSQRT:
+		return 16;
+	}
+
+	if(kind == KIND_LOAD)
+	{
+		return 4;
+	}
+	if((insn->opcode >= JIT_OP_FLOAT32_TO_INT
+	    && insn->opcode <= JIT_OP_FLOAT64_TO_FLOAT32)
+	   || (insn->opcode >= JIT_OP_CHECK_FLOAT32_TO_INT
+	       && insn->opcode <= JIT_OP_CHECK_FLOAT64_TO_ULONG))
+	{
+		return 5;
+	}
+	return 1;
+}
+
+/*
+ * Check if the value is accessed in ways the dependencies on the
+ * value itself do not catch.
+ */
+static int
+is_aliased(jit_value_t value)
+{
+	return value && (value->is_volatile || value->is_addressable);
+}
+
+/*
+ * Check if the instruction reads the value.
+ */
+static int
+reads(jit_insn_t insn, jit_value_t value)
+{
+	return (insn->value1 == value || insn->value2 == value
+		|| ((insn->flags & JIT_INSN_DEST_IS_VALUE) != 0
+		    && insn->dest == value));
+}
+
+/*
+ * Check if the second instruction must stay after the first one.
+ */
+static int
+depends(_jit_schedule_info_t *info, int first, int second)
+{
+	jit_insn_t insn1 = &info->insns[first];
+	jit_insn_t insn2 = &info->insns[second];
+	jit_value_t def1 = _jit_insn_get_def(insn1);
+	jit_value_t def2 = _jit_insn_get_def(insn2);
+	int kind1 = info->kind[first];
+	int kind2 = info->kind[second];
+
+	/* The values written by one and used by the other */
+	if(def1 && (reads(insn2, def1) || def2 == def1))
+	{
+		return 1;
+	}
+	if(def2 && reads(insn1, def2))
+	{
+		return 1;
+	}
+
+	/* The memory accesses and the exceptions */
+	if(kind1 == KIND_STORE || kind1 == KIND_THROW)
+	{
+		return kind2 != KIND_PURE;
+	}
+	if(kind2 == KIND_STORE || kind2 == KIND_THROW)
+	{
+		return kind1 != KIND_PURE;
+	}
+	return 0;
+}
+
+/*
+ * Check if the first instruction should be issued before the second
+ * one.  The instructions whose operands are ready go first, then the
+ * ones on the longer path.  The ties keep the original order.
+ */
+static int
+is_better(_jit_schedule_info_t *info, int first, int second, int cycle)
+{
+	int wait1 = info->ready[first] > cycle ? info->ready[first] - cycle : 0;
+	int wait2 = info->ready[second] > cycle ? info->ready[second] - cycle : 0;
+
+	if(wait1 != wait2)
+	{
+		return wait1 < wait2;
+	}
+	return info->height[first] > info->height[second];
+}
+
+/*
+ * Schedule the region and put its instructions back into the block
+ * starting at the position.
+ */
+static void
+schedule_region(_jit_schedule_info_t *info, jit_block_t block, int start)
+{
+	jit_uint done;
+	int index, other, best, cycle;
+
+	/* Build the dependence graph */
+	for(index = 0; index < info->num_insns; index++)
+	{
+		info->preds[index] = 0;
+		for(other = 0; other < index; other++)
+		{
+			if(depends(info, other, index))
+			{
+				info->preds[index] |= ((jit_uint) 1) << other;
+			}
+		}
+	}
+
+	/* Compute the latency path lengths from the end backwards */
+	for(index = info->num_insns - 1; index >= 0; index--)
+	{
+		info->height[index] = info->latency[index];
+		for(other = index + 1; other < info->num_insns; other++)
+		{
+			if((info->preds[other] & (((jit_uint) 1) << index)) != 0
+			   && info->height[index] < info->latency[index] + info->height[other])
+			{
+				info->height[index] = info->latency[index] + info->height[other];
+			}
+		}
+	}
+
+	/* Issue the instructions one per cycle */
+	for(index = 0; index < info->num_insns; index++)
+	{
+		info->ready[index] = 0;
+	}
+	done = 0;
+	cycle = 0;
+	for(index = 0; index < info->num_insns; index++)
+	{
+		best = -1;
+		for(other = 0; other < info->num_insns; other++)
+		{
+			if((done & (((jit_uint) 1) << other)) == 0
+			   && (info->preds[other] & ~done) == 0
+			   && (best < 0 || is_better(info, other, best, cycle)))
+			{
+				best = other;
+			}
+		}
+		if(info->ready[best] > cycle)
+		{
+			cycle = info->ready[best];
+		}
+		block->insns[start + index] = info->insns[best];
+		done |= ((jit_uint) 1) << best;
+		for(other = best + 1; other < info->num_insns; other++)
+		{
+			if((info->preds[other] & (((jit_uint) 1) << best)) != 0
+			   && info->ready[other] < cycle + info->latency[best])
+			{
+				info->ready[other] = cycle + info->latency[best];
+			}
+		}
+		++cycle;
+	}
+}
+
+/*
+ * Schedule the regions of the block.
+ */
+static void
+schedule_block(_jit_schedule_info_t *info, jit_block_t block)
+{
+	jit_insn_t insn;
+	int posn, start, kind;
+
+	info->num_insns = 0;
+	start = 0;
+	for(posn = 0; posn <= block->num_insns; posn++)
+	{
+		kind = KIND_FIXED;
+		if(posn < block->num_insns)
+		{
+			insn = &block->insns[posn];
+			kind = get_kind(insn);
+			if(kind != KIND_FIXED && insn->opcode != JIT_OP_NOP
+			   && (is_aliased(insn->dest) || is_aliased(insn->value1)
+			       || is_aliased(insn->value2)))
+			{
+				kind = KIND_FIXED;
+			}
+		}
+
+		/* Schedule the region ended by the instruction */
+		if(kind == KIND_FIXED || info->num_insns == MAX_REGION)
+		{
+			if(info->num_insns > 1)
+			{
+				schedule_region(info, block, start);
+			}
+			info->num_insns = 0;
+		}
+		if(kind == KIND_FIXED)
+		{
+			continue;
+		}
+
+		/* Add the instruction to the current region */
+		if(info->num_insns == 0)
+		{
+			start = posn;
+		}
+		info->insns[info->num_insns] = *insn;
+		if(insn->opcode == JIT_OP_NOP)
+		{
+			/* The removed instructions may keep their operands */
+			info->insns[info->num_insns].flags = 0;
+			info->insns[info->num_insns].dest = 0;
+			info->insns[info->num_insns].value1 = 0;
+			info->insns[info->num_insns].value2 = 0;
+		}
+		info->kind[info->num_insns] = kind;
+		info->latency[info->num_insns] = get_latency(insn, kind);
+		++(info->num_insns);
+	}
+}
+
+void
+_jit_schedule_insns(jit_function_t func)
+{
+	_jit_schedule_info_t info;
+	jit_block_t block;
+
+	if(func->has_try)
+	{
+		return;
+	}
+	for(block = func->builder->entry_block; block; block = block->next)
+	{
+		schedule_block(&info, block);
+	}
+}
@@ -0,0 +1,519 @@
+/*
+ * jit-select.c - Address mode selection.
+ *
+ * Copyright (C) 2026  Free Software Foundation, Inc.
+ *
+ * This file is part of the libjit library.
+ *
+ * The libjit library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * The libjit library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the libjit library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "jit-internal.h"
+#include "jit-rules.h"
+
+/*
+ * The code generator selects the machine instructions for one IR
+ * instruction at a time, so the address computed by separate
+ * instructions is not folded into the memory operand of the load or
+ * store that uses it.  This pass does the folding on the IR.  The
+ * address of every pointer-relative load and store is matched as a
+ * tree whose inner nodes are the temporary values used only by that
+ * load or store.  A constant added to the base moves to the offset of
+ * the access and a base plus an index scaled by the size of the access
+ * turns it into an array element access, which the code generators
+ * emit with the indexed addressing mode.  The instructions computing
+ * the folded values become dead and are removed.
+ *
+ * The index field of the values records where they are defined in the
+ * current block and how many times they are used after that.  The
+ * positions are numbered through the function so that the marks left
+ * by the previous blocks are below the base of the current one.  The
+ * liveness analysis that runs later numbers the values from scratch.
+ */
+
+/*
+ * The native integer opcodes used to compute addresses.
+ */
+#ifdef JIT_NATIVE_INT32
+#define	NINT_ADD	JIT_OP_IADD
+#define	NINT_SUB	JIT_OP_ISUB
+#define	NINT_MUL	JIT_OP_IMUL
+#define	NINT_SHL	JIT_OP_ISHL
+#else
+#define	NINT_ADD	JIT_OP_LADD
+#define	NINT_SUB	JIT_OP_LSUB
+#define	NINT_MUL	JIT_OP_LMUL
+#define	NINT_SHL	JIT_OP_LSHL
+#endif
+
+/*
+ * The use count stored with the position of a value that is defined
+ * more than once in the block or used before its definition.
+ */
+#define	MULTIPLE_USES	3
+
+/*
+ * The maximum number of instructions between the definition of a value
+ * and the access it is folded into.  It bounds the time spent checking
+ * that the operands of the definition stay the same.
+ */
+#define	MAX_DISTANCE	64
+
+typedef struct
+{
+	jit_block_t		block;
+
+	/* The position of the first instruction of the block */
+	int			base;
+
+} _jit_select_info_t;
+
+/*
+ * Record a use of the value.
+ */
+static void
+mark_use(_jit_select_info_t *info, jit_value_t value, int position)
+{
+	if(value->is_constant)
+	{
+		return;
+	}
+	if(value->index < 4 * info->base)
+	{
+		value->index = 4 * (info->base + position) + MULTIPLE_USES;
+	}
+	else if((value->index & 3) < MULTIPLE_USES - 1)
+	{
+		++(value->index);
+	}
+}
+
+/*
+ * Record the definitions and the uses of the values in the block.
+ */
+static void
+mark_values(_jit_select_info_t *info)
+{
+	jit_insn_iter_t iter;
+	jit_insn_t insn;
+	int position;
+
+	jit_insn_iter_init(&iter, info->block);
+	while((insn = jit_insn_iter_next(&iter)) != 0)
+	{
+		if(insn->opcode == JIT_OP_NOP)
+		{
+			continue;
+		}
+		position = iter.posn - 1;
+		if((insn->flags & JIT_INSN_VALUE1_OTHER_FLAGS) == 0 && insn->value1)
+		{
+			mark_use(info, insn->value1, position);
+		}
+		if((insn->flags & JIT_INSN_VALUE2_OTHER_FLAGS) == 0 && insn->value2)
+		{
+			mark_use(info, insn->value2, position);
+		}
+		if((insn->flags & JIT_INSN_DEST_OTHER_FLAGS) != 0 || !insn->dest)
+		{
+			continue;
+		}
+		if(_jit_insn_get_def(insn) != insn->dest)
+		{
+			mark_use(info, insn->dest, position);
+		}
+		else if(insn->dest->index >= 4 * info->base)
+		{
+			insn->dest->index |= MULTIPLE_USES;
+		}
+		else
+		{
+			insn->dest->index = 4 * (info->base + position);
+		}
+	}
+}
+
+/*
+ * Check if the value keeps its contents between the two positions in
+ * the block.
+ */
+static int
+is_unchanged(_jit_select_info_t *info, jit_value_t value, int start, int end)
+{
+	jit_insn_t insn;
+
+	if(value->is_constant)
+	{
+		return 1;
+	}
+	if(value->is_volatile || value->is_addressable)
+	{
+		return 0;
+	}
+	while(++start < end)
+	{
+		insn = &info->block->insns[start];
+		if(_jit_insn_get_def(insn) == value)
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*
+ * Find the instruction that computes the value used only by the access
+ * at the position.  Returns the position of the instruction or -1.
+ */
+static int
+find_tree_def(_jit_select_info_t *info, jit_value_t value, int position)
+{
+	jit_insn_t insn;
+	int def;
+
+	if(!value->is_temporary || value->is_volatile || value->is_addressable
+	   || value->is_constant
+	   || value->index < 4 * info->base
+	   || (value->index & 3) != 1)
+	{
+		return -1;
+	}
+	def = (value->index >> 2) - info->base;
+	if(def >= position || position - def > MAX_DISTANCE)
+	{
+		return -1;
+	}
+	insn = &info->block->insns[def];
+	if(insn->dest != value || _jit_insn_get_def(insn) != value
+	   || insn->flags != 0
+	   || !is_unchanged(info, insn->value1, def, position)
+	   || (insn->value2 && !is_unchanged(info, insn->value2, def, position)))
+	{
+		return -1;
+	}
+	return def;
+}
+
+/*
+ * Remove the instruction that computed a folded value.
+ */
+static void
+remove_def(_jit_select_info_t *info, int def)
+{
+	jit_insn_t insn = &info->block->insns[def];
+
+	insn->dest->index = -1;
+	insn->opcode = JIT_OP_NOP;
+	insn->flags = 0;
+	insn->dest = 0;
+	insn->value1 = 0;
+	insn->value2 = 0;
+}
+
+/*
+ * Get the constant added to the base address by the instruction and
+ * the base address itself.  Returns zero if the instruction is not
+ * such an addition.
+ */
+static int
+get_base_offset(jit_insn_t insn, jit_value_t *base, jit_nint *offset)
+{
+	switch(insn->opcode)
+	{
+	case JIT_OP_ADD_RELATIVE:
+		*base = insn->value1;
+		*offset = jit_value_get_nint_constant(insn->value2);
+		return 1;
+
+	case NINT_ADD:
+		if(insn->value2->is_constant)
+		{
+			*base = insn->value1;
+			*offset = jit_value_get_nint_constant(insn->value2);
+			return 1;
+		}
+		if(insn->value1->is_constant)
+		{
+			*base = insn->value2;
+			*offset = jit_value_get_nint_constant(insn->value1);
+			return 1;
+		}
+		break;
+
+	case NINT_SUB:
+		if(insn->value2->is_constant)
+		{
+			*base = insn->value1;
+			*offset = -jit_value_get_nint_constant(insn->value2);
+			return 1;
+		}
+		break;
+	}
+	return 0;
+}
+
+/*
+ * Get the size of the memory accessed by the pointer-relative load or
+ * store opcode.  Returns zero for the opcodes without a matching array
+ * element opcode.
+ */
+static int
+get_access_size(int opcode)
+{
+	switch(opcode)
+	{
+	case JIT_OP_LOAD_RELATIVE_SBYTE:
+	case JIT_OP_LOAD_RELATIVE_UBYTE:
+	case JIT_OP_STORE_RELATIVE_BYTE:
+		return 1;
+
+	case JIT_OP_LOAD_RELATIVE_SHORT:
+	case JIT_OP_LOAD_RELATIVE_USHORT:
+	case JIT_OP_STORE_RELATIVE_SHORT:
+		return 2;
+
+	case JIT_OP_LOAD_RELATIVE_INT:
+	case JIT_OP_LOAD_RELATIVE_FLOAT32:
+	case JIT_OP_STORE_RELATIVE_INT:
+	case JIT_OP_STORE_RELATIVE_FLOAT32:
+		return 4;
+
+	case JIT_OP_LOAD_RELATIVE_LONG:
+	case JIT_OP_LOAD_RELATIVE_FLOAT64:
+	case JIT_OP_STORE_RELATIVE_LONG:
+	case JIT_OP_STORE_RELATIVE_FLOAT64:
+		return 8;
+	}
+	return 0;
+}
+
+/*
+ * Get the array element opcode for the pointer-relative load or store.
+ */
+static int
+get_element_opcode(int opcode)
+{
+	if(opcode >= JIT_OP_LOAD_RELATIVE_SBYTE
+	   && opcode <= JIT_OP_LOAD_RELATIVE_FLOAT64)
+	{
+		return opcode - JIT_OP_LOAD_RELATIVE_SBYTE + JIT_OP_LOAD_ELEMENT_SBYTE;
+	}
+	return opcode - JIT_OP_STORE_RELATIVE_BYTE + JIT_OP_STORE_ELEMENT_BYTE;
+}
+
+/*
+ * Find the index scaled by the size of the access in the value used
+ * only by the access at the position.  Returns the index or zero.
+ */
+static jit_value_t
+get_scaled_index(_jit_select_info_t *info, jit_value_t value, int position,
+		 int size, int *pdef)
+{
+	jit_insn_t insn;
+	jit_nint scale;
+	int def;
+
+	*pdef = -1;
+	if(size == 1)
+	{
+		return value->is_constant ? 0 : value;
+	}
+	def = find_tree_def(info, value, position);
+	if(def < 0)
+	{
+		return 0;
+	}
+	insn = &info->block->insns[def];
+	if(insn->value1->is_constant || !insn->value2->is_constant)
+	{
+		return 0;
+	}
+	scale = jit_value_get_nint_constant(insn->value2);
+	if(insn->opcode == NINT_SHL)
+	{
+		if(scale < 0 || scale > 3 || (1 << scale) != size)
+		{
+			return 0;
+		}
+	}
+	else if(insn->opcode != NINT_MUL || scale != size)
+	{
+		return 0;
+	}
+	*pdef = def;
+	return insn->value1;
+}
+
+/*
+ * Fold the address computations into the load or store at the
+ * position.
+ */
+static void
+select_address(_jit_select_info_t *info, jit_function_t func, int position)
+{
+	jit_insn_t insn = &info->block->insns[position];
+	jit_insn_t def_insn;
+	jit_value_t *paddr, base, index;
+	jit_nint offset, delta;
+	int is_store, def, index_def, size, opcode;
+
+	is_store = (insn->opcode >= JIT_OP_STORE_RELATIVE_BYTE
+		    && insn->opcode <= JIT_OP_STORE_RELATIVE_STRUCT);
+	paddr = is_store ? &insn->dest : &insn->value1;
+	offset = jit_value_get_nint_constant(insn->value2);
+
+	/* Move the constants added to the base into the offset */
+	while((def = find_tree_def(info, *paddr, position)) >= 0)
+	{
+		def_insn = &info->block->insns[def];
+		if(!get_base_offset(def_insn, &base, &delta))
+		{
+			break;
+		}
+		delta += offset;
+		if(delta < (jit_nint) jit_min_int || delta > (jit_nint) jit_max_int)
+		{
+			break;
+		}
+		offset = delta;
+		*paddr = base;
+		insn->value2 = jit_value_create_nint_constant(func, jit_type_nint,
+							      offset);
+		if(!insn->value2)
+		{
+			jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+		}
+		remove_def(info, def);
+	}
+
+	/* Turn a base plus a scaled index into an array element access */
+	size = get_access_size(insn->opcode);
+	if(offset != 0 || size == 0)
+	{
+		return;
+	}
+	opcode = get_element_opcode(insn->opcode);
+	if(!_jit_opcode_is_supported(opcode))
+	{
+		return;
+	}
+	def = find_tree_def(info, *paddr, position);
+	if(def < 0 || info->block->insns[def].opcode != NINT_ADD)
+	{
+		return;
+	}
+	def_insn = &info->block->insns[def];
+	base = def_insn->value1;
+	index = get_scaled_index(info, def_insn->value2, position, size,
+				 &index_def);
+	if(!index)
+	{
+		base = def_insn->value2;
+		index = get_scaled_index(info, def_insn->value1, position, size,
+					 &index_def);
+		if(!index)
+		{
+			return;
+		}
+	}
+	if(index_def >= def)
+	{
+		return;
+	}
+
+	insn->opcode = (short) opcode;
+	if(is_store)
+	{
+		insn->value2 = insn->value1;
+		insn->value1 = index;
+		insn->dest = base;
+	}
+	else
+	{
+		insn->value1 = base;
+		insn->value2 = index;
+	}
+	remove_def(info, def);
+	if(index_def >= 0)
+	{
+		remove_def(info, index_def);
+	}
+}
+
+/*
+ * Check if the opcode is a pointer-relative load or store.
+ */
+static int
+is_relative_access(int opcode)
+{
+	return ((opcode >= JIT_OP_LOAD_RELATIVE_SBYTE
+		 && opcode <= JIT_OP_LOAD_RELATIVE_STRUCT)
+		|| (opcode >= JIT_OP_STORE_RELATIVE_BYTE
+		    && opcode <= JIT_OP_STORE_RELATIVE_STRUCT));
+}
+
+/*
+ * Forget the marks left in the index field of the values.
+ */
+static void
+clear_marks(jit_function_t func)
+{
+	jit_block_t block;
+	jit_insn_iter_t iter;
+	jit_insn_t insn;
+
+	for(block = func->builder->entry_block; block; block = block->next)
+	{
+		jit_insn_iter_init(&iter, block);
+		while((insn = jit_insn_iter_next(&iter)) != 0)
+		{
+			if((insn->flags & JIT_INSN_DEST_OTHER_FLAGS) == 0 && insn->dest)
+			{
+				insn->dest->index = -1;
+			}
+			if((insn->flags & JIT_INSN_VALUE1_OTHER_FLAGS) == 0 && insn->value1)
+			{
+				insn->value1->index = -1;
+			}
+			if((insn->flags & JIT_INSN_VALUE2_OTHER_FLAGS) == 0 && insn->value2)
+			{
+				insn->value2->index = -1;
+			}
+		}
+	}
+}
+
+void
+_jit_select_addresses(jit_function_t func)
+{
+	_jit_select_info_t info;
+	int position;
+
+	info.base = 0;
+	for(info.block = func->builder->entry_block; info.block;
+	    info.block = info.block->next)
+	{
+		mark_values(&info);
+		for(position = 0; position < info.block->num_insns; position++)
+		{
+			if(is_relative_access(info.block->insns[position].opcode))
+			{
+				select_address(&info, func, position);
+			}
+		}
+		info.base += info.block->num_insns;
+	}
+	clear_marks(func);
+}
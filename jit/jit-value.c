@@ -279,7 +279,10 @@ jit_value_create_nint_constant(jit_function_t func, jit_type_t type, jit_nint co
 		}
 		else if(stripped->kind == JIT_TYPE_INT)
 		{
-			if(func && func->builder && func->builder->zero_constant)
+			/* The type may carry tags that the caller relies on,
+			   so only reuse a zero constant of the same type */
+			if(func && func->builder && func->builder->zero_constant
+			   && func->builder->zero_constant->type == type)
 			{
 				return func->builder->zero_constant;
 			}
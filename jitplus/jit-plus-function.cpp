@@ -546,6 +546,7 @@ jit_label jit_function::new_label()
  * @deftypemethodx jit_function jit_value insn_load_elem_address (const jit_value& @var{base_addr}, const jit_value& @var{index}, jit_type_t @var{elem_type})
  * @deftypemethodx jit_function void insn_store_elem (const jit_value& @var{base_addr}, const jit_value& @var{index}, const jit_value& @var{value})
  * @deftypemethodx jit_function void insn_check_null (const jit_value& @var{value})
+ * @deftypemethodx jit_function void insn_check_bounds (const jit_value& @var{index}, const jit_value& @var{length})
  * @deftypemethodx jit_function jit_value insn_add (const jit_value& @var{value1}, const jit_value& @var{value2})
  * @deftypemethodx jit_function jit_value insn_add_ovf (const jit_value& @var{value1}, const jit_value& @var{value2})
  * @deftypemethodx jit_function jit_value insn_sub (const jit_value& @var{value1}, const jit_value& @var{value2})
@@ -564,6 +565,12 @@ jit_label jit_function::new_label()
  * @deftypemethodx jit_function jit_value insn_shr (const jit_value& @var{value1}, const jit_value& @var{value2})
  * @deftypemethodx jit_function jit_value insn_ushr (const jit_value& @var{value1}, const jit_value& @var{value2})
  * @deftypemethodx jit_function jit_value insn_sshr (const jit_value& @var{value1}, const jit_value& @var{value2})
+ * @deftypemethodx jit_function jit_value insn_popcount (const jit_value& @var{value1})
+ * @deftypemethodx jit_function jit_value insn_clz (const jit_value& @var{value1})
+ * @deftypemethodx jit_function jit_value insn_ctz (const jit_value& @var{value1})
+ * @deftypemethodx jit_function jit_value insn_bswap (const jit_value& @var{value1})
+ * @deftypemethodx jit_function jit_value insn_rol (const jit_value& @var{value1}, const jit_value& @var{value2})
+ * @deftypemethodx jit_function jit_value insn_ror (const jit_value& @var{value1}, const jit_value& @var{value2})
  * @deftypemethodx jit_function jit_value insn_eq (const jit_value& @var{value1}, const jit_value& @var{value2})
  * @deftypemethodx jit_function jit_value insn_ne (const jit_value& @var{value1}, const jit_value& @var{value2})
  * @deftypemethodx jit_function jit_value insn_lt (const jit_value& @var{value1}, const jit_value& @var{value2})
@@ -583,6 +590,7 @@ jit_label jit_function::new_label()
  * @deftypemethodx jit_function jit_value insn_cosh (const jit_value& @var{value1})
  * @deftypemethodx jit_function jit_value insn_exp (const jit_value& @var{value1})
  * @deftypemethodx jit_function jit_value insn_floor (const jit_value& @var{value1})
+ * @deftypemethodx jit_function jit_value insn_fma (const jit_value& @var{value1}, const jit_value& @var{value2}, const jit_value& @var{value3})
  * @deftypemethodx jit_function jit_value insn_log (const jit_value& @var{value1})
  * @deftypemethodx jit_function jit_value insn_log10 (const jit_value& @var{value1})
  * @deftypemethodx jit_function jit_value insn_pow (const jit_value& @var{value1}, const jit_value& @var{value2})
@@ -604,6 +612,8 @@ jit_label jit_function::new_label()
  * @deftypemethodx jit_function void insn_branch (jit_label& @var{label})
  * @deftypemethodx jit_function void insn_branch_if (const jit_value& @var{value}, jit_label& @var{label})
  * @deftypemethodx jit_function void insn_branch_if_not (const jit_value& value, jit_label& @var{label})
+ * @deftypemethodx jit_function void insn_jump_table (const jit_value& @var{value}, jit_jump_table& @var{jump_table})
+ * @deftypemethodx jit_function void insn_switch (const jit_value& @var{value}, jit_jump_table& @var{jump_table})
  * @deftypemethodx jit_function jit_value insn_address_of (const jit_value& @var{value1})
  * @deftypemethodx jit_function jit_value insn_address_of_label (jit_label& @var{label})
  * @deftypemethodx jit_function jit_value insn_convert (const jit_value& @var{value}, jit_type_t @var{type}, int @var{overflow_check})
@@ -646,6 +656,15 @@ jit_label jit_function::new_label()
  * @deftypemethodx jit_function void insn_memmove (const jit_value& @var{dest}, const jit_value& @var{src}, const jit_value& @var{size})
  * @deftypemethodx jit_function void jit_insn_memset (const jit_value& @var{dest}, const jit_value& @var{value}, const jit_value& @var{size})
  * @deftypemethodx jit_function jit_value jit_insn_alloca (const jit_value& @var{size})
+ * @deftypemethodx jit_function jit_value insn_atomic_load (const jit_value& @var{ptr}, jit_type_t @var{type}, int @var{order})
+ * @deftypemethodx jit_function void insn_atomic_store (const jit_value& @var{ptr}, const jit_value& @var{value}, int @var{order})
+ * @deftypemethodx jit_function jit_value insn_atomic_exchange (const jit_value& @var{ptr}, const jit_value& @var{value})
+ * @deftypemethodx jit_function jit_value insn_atomic_compare_exchange (const jit_value& @var{ptr}, const jit_value& @var{expected}, const jit_value& @var{desired})
+ * @deftypemethodx jit_function jit_value insn_atomic_fetch_add (const jit_value& @var{ptr}, const jit_value& @var{value})
+ * @deftypemethodx jit_function jit_value insn_atomic_fetch_and (const jit_value& @var{ptr}, const jit_value& @var{value})
+ * @deftypemethodx jit_function jit_value insn_atomic_fetch_or (const jit_value& @var{ptr}, const jit_value& @var{value})
+ * @deftypemethodx jit_function jit_value insn_atomic_fetch_xor (const jit_value& @var{ptr}, const jit_value& @var{value})
+ * @deftypemethodx jit_function void insn_fence (int @var{order})
  * @deftypemethodx jit_function void insn_move_blocks_to_end (const jit_label& @var{from_label}, const jit_label& @var{to_label})
  * @deftypemethodx jit_function void insn_move_blocks_to_start (const jit_label& @var{from_label}, const jit_label& @var{to_label})
  * @deftypemethodx jit_function void insn_mark_offset (jit_int @var{offset})
@@ -752,6 +771,15 @@ void jit_function::insn_check_null(const jit_value& value)
 	}
 }
 
+void jit_function::insn_check_bounds
+	(const jit_value& index, const jit_value& length)
+{
+	if(!jit_insn_check_bounds(func, index.raw(), length.raw()))
+	{
+		out_of_memory();
+	}
+}
+
 jit_value jit_function::insn_add
 	(const jit_value& value1, const jit_value& value2)
 {
@@ -858,6 +886,38 @@ jit_value jit_function::insn_sshr
 	value_wrap(jit_insn_sshr(func, value1.raw(), value2.raw()));
 }
 
+jit_value jit_function::insn_popcount(const jit_value& value1)
+{
+	value_wrap(jit_insn_popcount(func, value1.raw()));
+}
+
+jit_value jit_function::insn_clz(const jit_value& value1)
+{
+	value_wrap(jit_insn_clz(func, value1.raw()));
+}
+
+jit_value jit_function::insn_ctz(const jit_value& value1)
+{
+	value_wrap(jit_insn_ctz(func, value1.raw()));
+}
+
+jit_value jit_function::insn_bswap(const jit_value& value1)
+{
+	value_wrap(jit_insn_bswap(func, value1.raw()));
+}
+
+jit_value jit_function::insn_rol
+	(const jit_value& value1, const jit_value& value2)
+{
+	value_wrap(jit_insn_rol(func, value1.raw(), value2.raw()));
+}
+
+jit_value jit_function::insn_ror
+	(const jit_value& value1, const jit_value& value2)
+{
+	value_wrap(jit_insn_ror(func, value1.raw(), value2.raw()));
+}
+
 jit_value jit_function::insn_eq
 	(const jit_value& value1, const jit_value& value2)
 {
@@ -962,6 +1022,13 @@ jit_value jit_function::insn_floor(const jit_value& value1)
 	value_wrap(jit_insn_floor(func, value1.raw()));
 }
 
+jit_value jit_function::insn_fma
+	(const jit_value& value1, const jit_value& value2,
+	 const jit_value& value3)
+{
+	value_wrap(jit_insn_fma(func, value1.raw(), value2.raw(), value3.raw()));
+}
+
 jit_value jit_function::insn_log(const jit_value& value1)
 {
 	value_wrap(jit_insn_log(func, value1.raw()));
@@ -1087,6 +1154,15 @@ void jit_function::insn_jump_table(const jit_value& value, jit_jump_table& jump_
 	}
 }
 
+void jit_function::insn_switch(const jit_value& value, jit_jump_table& jump_table)
+{
+	if(!jit_insn_switch(func, value.raw(), jump_table.raw_values(),
+			    jump_table.raw(), jump_table.size()))
+	{
+		out_of_memory();
+	}
+}
+
 jit_value jit_function::insn_address_of(const jit_value& value1)
 {
 	value_wrap(jit_insn_address_of(func, value1.raw()));
@@ -1402,6 +1478,66 @@ jit_value jit_function::insn_alloca(const jit_value& size)
 	value_wrap(jit_insn_alloca(func, size.raw()));
 }
 
+jit_value jit_function::insn_atomic_load
+	(const jit_value& ptr, jit_type_t type, int order)
+{
+	value_wrap(jit_insn_atomic_load(func, ptr.raw(), type, order));
+}
+
+void jit_function::insn_atomic_store
+	(const jit_value& ptr, const jit_value& value, int order)
+{
+	if(!jit_insn_atomic_store(func, ptr.raw(), value.raw(), order))
+	{
+		out_of_memory();
+	}
+}
+
+jit_value jit_function::insn_atomic_exchange
+	(const jit_value& ptr, const jit_value& value)
+{
+	value_wrap(jit_insn_atomic_exchange(func, ptr.raw(), value.raw()));
+}
+
+jit_value jit_function::insn_atomic_compare_exchange
+	(const jit_value& ptr, const jit_value& expected, const jit_value& desired)
+{
+	value_wrap(jit_insn_atomic_compare_exchange
+		(func, ptr.raw(), expected.raw(), desired.raw()));
+}
+
+jit_value jit_function::insn_atomic_fetch_add
+	(const jit_value& ptr, const jit_value& value)
+{
+	value_wrap(jit_insn_atomic_fetch_add(func, ptr.raw(), value.raw()));
+}
+
+jit_value jit_function::insn_atomic_fetch_and
+	(const jit_value& ptr, const jit_value& value)
+{
+	value_wrap(jit_insn_atomic_fetch_and(func, ptr.raw(), value.raw()));
+}
+
+jit_value jit_function::insn_atomic_fetch_or
+	(const jit_value& ptr, const jit_value& value)
+{
+	value_wrap(jit_insn_atomic_fetch_or(func, ptr.raw(), value.raw()));
+}
+
+jit_value jit_function::insn_atomic_fetch_xor
+	(const jit_value& ptr, const jit_value& value)
+{
+	value_wrap(jit_insn_atomic_fetch_xor(func, ptr.raw(), value.raw()));
+}
+
+void jit_function::insn_fence(int order)
+{
+	if(!jit_insn_fence(func, order))
+	{
+		out_of_memory();
+	}
+}
+
 void jit_function::insn_move_blocks_to_end
 	(const jit_label& from_label, const jit_label& to_label)
 {
@@ -24,17 +24,21 @@
 
 jit_jump_table::jit_jump_table(int size)
 {
+	labels = 0;
 	try
 	{
 		labels = new jit_label_t[size];
+		values = new jit_long[size];
 	}
 	catch(...)
 	{
+		delete [] labels;
 		throw jit_build_exception(JIT_RESULT_OUT_OF_MEMORY);
 	}
 	for (int i = 0; i < size; i++)
 	{
 		labels[i] = jit_label_undefined;
+		values[i] = i;
 	}
 	num_labels = size;
 }
@@ -42,6 +46,7 @@ jit_jump_table::jit_jump_table(int size)
 jit_jump_table::~jit_jump_table()
 {
 	delete [] labels;
+	delete [] values;
 }
 
 jit_label
@@ -63,3 +68,24 @@ jit_jump_table::set(int index, jit_label label)
 	}
 	labels[index] = label.raw();
 }
+
+jit_long
+jit_jump_table::get_value(int index)
+{
+	if (index < 0 || index >= num_labels)
+	{
+		throw jit_build_exception(JIT_RESULT_COMPILE_ERROR);
+	}
+	return values[index];
+}
+
+void
+jit_jump_table::set(int index, jit_long value, jit_label label)
+{
+	if (index < 0 || index >= num_labels)
+	{
+		throw jit_build_exception(JIT_RESULT_COMPILE_ERROR);
+	}
+	values[index] = value;
+	labels[index] = label.raw();
+}
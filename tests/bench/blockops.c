@@ -0,0 +1,466 @@
+/*
+ * blockops.c - Cost of the block copy, move and fill instructions.
+ *
+ * Copyright (C) 2026  Free Software Foundation, Inc.
+ *
+ * This file is part of the libjit library.
+ *
+ * The libjit library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * The libjit library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the libjit library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Usage: blockops [-O level] [-n count] [-r repeat]
+ *
+ * Compile a loop that copies, moves or fills one block per iteration
+ * with the block sizes taken from an array, and print the run time in
+ * nanoseconds per block for a few distributions of the sizes.  The
+ * "insn" version uses the jit_insn_memcpy, jit_insn_memmove and
+ * jit_insn_memset instructions as the back end lowers them and the
+ * "call" version calls the library functions, which is what the
+ * instructions compile to on back ends that have no inline code for
+ * them.  The "split" version dispatches on the size classes up to 64
+ * bytes with the inline code for the constant sizes and calls the
+ * library for the larger blocks.  This is what an inline fast path for
+ * the small variable sizes would do.  The program also checks that all
+ * the versions leave the same memory contents as the C code.
+ */
+
+#include <jit/jit.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#define INSN		0
+#define CALL		1
+#define SPLIT		2
+#define NUM_VERSIONS	3
+
+#define COPY		0
+#define MOVE		1
+#define FILL		2
+#define NUM_OPS		3
+
+#define BUFFER_SIZE	16384
+
+typedef struct
+{
+	const char *name;
+	int min_size;
+	int max_size;
+
+} distribution_entry;
+
+static const char *version_names[NUM_VERSIONS] = {
+	"insn", "call", "split"
+};
+
+static const char *op_names[NUM_OPS] = {
+	"memcpy", "memmove", "memset"
+};
+
+static distribution_entry distributions[] = {
+	{"8", 8, 8},
+	{"1-16", 1, 16},
+	{"1-64", 1, 64},
+	{"16-256", 16, 256},
+	{"1-4096", 1, 4096},
+};
+#define NUM_DISTRIBUTIONS	(sizeof(distributions) / sizeof(distributions[0]))
+
+static double
+now(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+/*
+ * The destination of all the blocks is at DEST_OFFSET.  The source of
+ * the i-th copy is at SOURCE_OFFSET + (i & 63) and the source of the
+ * i-th move overlaps the destination 24 bytes below or above it.
+ */
+#define DEST_OFFSET	64
+#define SOURCE_OFFSET	(BUFFER_SIZE / 2)
+
+/*
+ * Call the library function for the operation.
+ */
+static void
+build_call(jit_function_t func, int op, jit_value_t dest, jit_value_t src,
+	   jit_value_t size)
+{
+	jit_type_t call_params[3];
+	jit_type_t call_signature;
+	jit_value_t args[3];
+
+	call_params[0] = jit_type_void_ptr;
+	call_params[1] = (op == FILL) ? jit_type_int : jit_type_void_ptr;
+	call_params[2] = jit_type_nuint;
+	call_signature = jit_type_create_signature(jit_abi_cdecl, jit_type_void_ptr,
+						   call_params, 3, 1);
+	args[0] = dest;
+	args[1] = src;
+	args[2] = size;
+	jit_insn_call_native(func, op_names[op],
+			     (op == COPY) ? (void *) jit_memcpy
+			     : (op == MOVE) ? (void *) jit_memmove
+			     : (void *) jit_memset,
+			     call_signature, args, 3, JIT_CALL_NOTHROW);
+	jit_type_free(call_signature);
+}
+
+/*
+ * Do the operation on the first and the last "width" bytes of a block
+ * of width to 2 * width bytes.  The move loads all the chunks before
+ * it stores them, because the source and the destination overlap.
+ */
+static void
+build_head_tail(jit_function_t func, int op, jit_value_t dest, jit_value_t src,
+		jit_value_t size, int width)
+{
+	jit_value_t offset, tail_dest, tail_src, values[8];
+	jit_type_t type;
+	int chunk, count, index;
+
+	offset = jit_insn_sub(func, size,
+		jit_value_create_nint_constant(func, jit_type_nint, width));
+	tail_dest = jit_insn_add(func, dest, offset);
+	if(op == FILL)
+	{
+		jit_insn_memset(func, dest, src,
+			jit_value_create_nint_constant(func, jit_type_nint, width));
+		jit_insn_memset(func, tail_dest, src,
+			jit_value_create_nint_constant(func, jit_type_nint, width));
+		return;
+	}
+	tail_src = jit_insn_add(func, src, offset);
+	if(op == COPY)
+	{
+		jit_insn_memcpy(func, dest, src,
+			jit_value_create_nint_constant(func, jit_type_nint, width));
+		jit_insn_memcpy(func, tail_dest, tail_src,
+			jit_value_create_nint_constant(func, jit_type_nint, width));
+		return;
+	}
+
+	chunk = (width > 8) ? 8 : width;
+	type = (chunk == 8) ? jit_type_ulong
+		: (chunk == 4) ? jit_type_uint
+		: (chunk == 2) ? jit_type_ushort : jit_type_ubyte;
+	count = width / chunk;
+	for(index = 0; index < count; index++)
+	{
+		values[index] = jit_insn_load_relative(func, src, index * chunk, type);
+		values[count + index] = jit_insn_load_relative(func, tail_src,
+							       index * chunk, type);
+	}
+	for(index = 0; index < count; index++)
+	{
+		jit_insn_store_relative(func, dest, index * chunk, values[index]);
+		jit_insn_store_relative(func, tail_dest, index * chunk,
+					values[count + index]);
+	}
+}
+
+/*
+ * Dispatch on the size classes up to 64 bytes and call the library
+ * for the larger sizes.
+ */
+static void
+build_split(jit_function_t func, int op, jit_value_t dest, jit_value_t src,
+	    jit_value_t size)
+{
+	static const int widths[] = {32, 16, 8, 4, 2, 1};
+	jit_label_t large = jit_label_undefined;
+	jit_label_t done = jit_label_undefined;
+	jit_label_t next;
+	int index;
+
+	jit_insn_branch_if(func, jit_insn_gt(func, size,
+		jit_value_create_nint_constant(func, jit_type_nint, 64)), &large);
+	for(index = 0; index < (int) (sizeof(widths) / sizeof(widths[0])); index++)
+	{
+		next = jit_label_undefined;
+		jit_insn_branch_if_not(func, jit_insn_ge(func, size,
+			jit_value_create_nint_constant(func, jit_type_nint,
+						       widths[index])), &next);
+		build_head_tail(func, op, dest, src, size, widths[index]);
+		jit_insn_branch(func, &done);
+		jit_insn_label(func, &next);
+	}
+	jit_insn_branch(func, &done);
+	jit_insn_label(func, &large);
+	build_call(func, op, dest, src, size);
+	jit_insn_label(func, &done);
+}
+
+/*
+ * Build the loop that does the operation on the n blocks with the sizes
+ * from the array.  The function returns the sum of the sizes so that a
+ * value stays live across the operation.
+ */
+static jit_function_t
+build_kernel(jit_context_t context, int op, int level, int version)
+{
+	jit_type_t params[3];
+	jit_type_t signature;
+	jit_function_t func;
+	jit_label_t loop = jit_label_undefined;
+	jit_label_t done = jit_label_undefined;
+	jit_value_t buf, sizes, n, i, sum, size, dest, src;
+
+	params[0] = jit_type_void_ptr;
+	params[1] = jit_type_void_ptr;
+	params[2] = jit_type_nint;
+	jit_context_build_start(context);
+	signature = jit_type_create_signature(jit_abi_cdecl, jit_type_nint, params, 3, 1);
+	func = jit_function_create(context, signature);
+	jit_type_free(signature);
+	jit_function_set_optimization_level(func, level);
+
+	buf = jit_value_get_param(func, 0);
+	sizes = jit_value_get_param(func, 1);
+	n = jit_value_get_param(func, 2);
+	i = jit_value_create(func, jit_type_nint);
+	sum = jit_value_create(func, jit_type_nint);
+	jit_insn_store(func, i, jit_value_create_nint_constant(func, jit_type_nint, 0));
+	jit_insn_store(func, sum, jit_value_create_nint_constant(func, jit_type_nint, 0));
+	jit_insn_branch_if_not(func, jit_insn_lt(func, i, n), &done);
+	jit_insn_label(func, &loop);
+	size = jit_insn_load_elem(func, sizes, i, jit_type_nint);
+	dest = jit_insn_add_relative(func, buf, DEST_OFFSET);
+	if(op == MOVE)
+	{
+		/* Alternate the direction of the overlap */
+		src = jit_insn_add(func, dest, jit_insn_sub(func,
+			jit_insn_mul(func, jit_insn_and(func, i,
+				jit_value_create_nint_constant(func, jit_type_nint, 1)),
+				jit_value_create_nint_constant(func, jit_type_nint, 48)),
+			jit_value_create_nint_constant(func, jit_type_nint, 24)));
+	}
+	else if(op == COPY)
+	{
+		src = jit_insn_add(func, jit_insn_add_relative(func, buf, SOURCE_OFFSET),
+			jit_insn_and(func, i, jit_value_create_nint_constant(func, jit_type_nint, 63)));
+	}
+	else
+	{
+		src = jit_insn_convert(func, i, jit_type_int, 0);
+	}
+	if(version == INSN)
+	{
+		switch(op)
+		{
+		case COPY:
+			jit_insn_memcpy(func, dest, src, size);
+			break;
+		case MOVE:
+			jit_insn_memmove(func, dest, src, size);
+			break;
+		default:
+			jit_insn_memset(func, dest, src, size);
+			break;
+		}
+	}
+	else if(version == CALL)
+	{
+		build_call(func, op, dest, src, size);
+	}
+	else
+	{
+		build_split(func, op, dest, src, size);
+	}
+	jit_insn_store(func, sum, jit_insn_add(func, sum, size));
+	jit_insn_store(func, i, jit_insn_add(func, i,
+		jit_value_create_nint_constant(func, jit_type_nint, 1)));
+	jit_insn_branch_if(func, jit_insn_lt(func, i, n), &loop);
+	jit_insn_label(func, &done);
+	jit_insn_return(func, sum);
+
+	if(!jit_function_compile(func))
+	{
+		func = 0;
+	}
+	jit_context_build_end(context);
+	return func;
+}
+
+/*
+ * Do the same as the kernel in C.
+ */
+static jit_nint
+compute(int op, unsigned char *buf, const jit_nint *sizes, jit_nint n)
+{
+	unsigned char *dest = buf + DEST_OFFSET;
+	jit_nint sum = 0;
+	jit_nint i;
+
+	for(i = 0; i < n; i++)
+	{
+		if(op == FILL)
+		{
+			memset(dest, (int) i, sizes[i]);
+		}
+		else if(op == MOVE)
+		{
+			memmove(dest, dest + ((i & 1) ? 24 : -24), sizes[i]);
+		}
+		else
+		{
+			memcpy(dest, buf + SOURCE_OFFSET + (i & 63), sizes[i]);
+		}
+		sum += sizes[i];
+	}
+	return sum;
+}
+
+static void
+fill_buffer(unsigned char *buf)
+{
+	int index;
+
+	for(index = 0; index < BUFFER_SIZE; index++)
+	{
+		buf[index] = (unsigned char) (index * 7 + 3);
+	}
+}
+
+/*
+ * Run the kernel the given number of times and return the time per
+ * block in nanoseconds or a negative value if the result is wrong.
+ */
+static double
+run_kernel(jit_function_t func, int op, unsigned char *buf,
+	   unsigned char *expected, jit_nint *sizes, jit_nint n, int repeat)
+{
+	void *args[3];
+	jit_nint result;
+	jit_nint sum;
+	double start;
+	int index;
+
+	if(!func)
+	{
+		return -1;
+	}
+	fill_buffer(buf);
+	fill_buffer(expected);
+	sum = compute(op, expected, sizes, n);
+	args[0] = &buf;
+	args[1] = &sizes;
+	args[2] = &n;
+	if(!jit_function_apply(func, args, &result) || result != sum
+	   || memcmp(buf, expected, BUFFER_SIZE) != 0)
+	{
+		return -1;
+	}
+	start = now();
+	for(index = 0; index < repeat; index++)
+	{
+		jit_function_apply(func, args, &result);
+	}
+	return (now() - start) * 1e9 / ((double) n * repeat);
+}
+
+int
+main(int argc, char *argv[])
+{
+	jit_context_t context;
+	jit_function_t funcs[NUM_OPS][NUM_VERSIONS];
+	unsigned char *buf, *expected;
+	jit_nint *sizes;
+	distribution_entry *entry;
+	double times[NUM_VERSIONS];
+	int level, count, repeat, index, op, version, wrong, status;
+	unsigned int seed;
+
+	jit_init();
+
+	level = jit_function_get_max_optimization_level();
+	count = 1000;
+	repeat = 2000;
+	for(index = 1; index < argc; index++)
+	{
+		if(!strcmp(argv[index], "-O") && index + 1 < argc)
+		{
+			level = atoi(argv[++index]);
+		}
+		else if(!strcmp(argv[index], "-n") && index + 1 < argc)
+		{
+			count = atoi(argv[++index]);
+		}
+		else if(!strcmp(argv[index], "-r") && index + 1 < argc)
+		{
+			repeat = atoi(argv[++index]);
+		}
+	}
+
+	buf = (unsigned char *) malloc(BUFFER_SIZE);
+	expected = (unsigned char *) malloc(BUFFER_SIZE);
+	sizes = (jit_nint *) malloc(count * sizeof(jit_nint));
+	if(!buf || !expected || !sizes)
+	{
+		return 1;
+	}
+
+	context = jit_context_create();
+	for(op = 0; op < NUM_OPS; op++)
+	{
+		for(version = 0; version < NUM_VERSIONS; version++)
+		{
+			funcs[op][version] = build_kernel(context, op, level, version);
+		}
+	}
+
+	printf("%-8s %-8s %10s %10s %10s\n", "op", "sizes",
+	       version_names[INSN], version_names[CALL], version_names[SPLIT]);
+	status = 0;
+	for(index = 0; index < (int) NUM_DISTRIBUTIONS; index++)
+	{
+		entry = &distributions[index];
+		seed = 12345;
+		for(op = 0; op < count; op++)
+		{
+			seed = seed * 1103515245 + 12345;
+			sizes[op] = entry->min_size + (seed >> 8)
+				% (entry->max_size - entry->min_size + 1);
+		}
+		for(op = 0; op < NUM_OPS; op++)
+		{
+			wrong = 0;
+			for(version = 0; version < NUM_VERSIONS; version++)
+			{
+				times[version] = run_kernel(funcs[op][version], op, buf,
+							    expected, sizes, count, repeat);
+				if(times[version] < 0)
+				{
+					wrong = 1;
+				}
+			}
+			printf("%-8s %-8s %10.3f %10.3f %10.3f  %s\n", op_names[op],
+			       entry->name, times[INSN], times[CALL], times[SPLIT],
+			       wrong ? "WRONG" : "ok");
+			status |= wrong;
+		}
+	}
+
+	jit_context_destroy(context);
+	free(buf);
+	free(expected);
+	free(sizes);
+	return status;
+}
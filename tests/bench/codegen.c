@@ -0,0 +1,676 @@
+/*
+ * codegen.c - Code generation quality and compile speed.
+ *
+ * Copyright (C) 2026  Free Software Foundation, Inc.
+ *
+ * This file is part of the libjit library.
+ *
+ * The libjit library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * The libjit library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the libjit library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Usage: codegen [-O level] [-r repeat] [-k kernel]
+ *
+ * Build each of the kernels below in a fresh context, compile it, check
+ * its result against the same computation done in C and time it.  Print
+ * one line per kernel with space separated "key=value" fields, so that
+ * the output of different builds and releases can be compared by tools:
+ *
+ *   kernel		the kernel name
+ *   backend		"native" or "interp"
+ *   level		the optimization level
+ *   insns		the number of IR instructions of all its functions
+ *   compile_ns_per_insn	the compile time per IR instruction
+ *   code_bytes		the size of the generated code
+ *   run_ns_per_iter	the run time per iteration of the kernel loop
+ *   status		"ok", "FAILED" if it did not compile or "WRONG"
+ *
+ * Every kernel is a function that takes the iteration count and returns
+ * a checksum.  The "make bench" target runs this program.  The back end
+ * is chosen when libjit is configured, so the interpreter is measured in
+ * a build configured with --enable-interpreter.
+ *
+ *   loop	integer arithmetic in a counted loop
+ *   calls	a call to a small function per iteration
+ *   switch	a jump table per iteration
+ *   struct	a copy of a three word structure per iteration
+ *   except	a call to a function with a catcher per iteration, every
+ *		eighth call throws an exception
+ *   float	polynomial evaluation in float64
+ *   large	a loop around a generated function body of 10000 statements
+ */
+
+#include <jit/jit.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#define MAX_FUNCTIONS	4
+
+#define NUM_STRUCTS	16
+
+#define NUM_VARS	32
+#define NUM_STATEMENTS	10000
+
+typedef struct
+{
+	jit_context_t context;
+	int level;
+	jit_function_t functions[MAX_FUNCTIONS];
+	int num_functions;
+
+} bench_t;
+
+typedef struct
+{
+	const char *name;
+	jit_function_t (*build)(bench_t *bench);
+	jit_nuint (*compute)(jit_nuint n);
+	jit_nuint iterations;
+
+} kernel_entry;
+
+typedef struct
+{
+	jit_nuint a;
+	jit_nuint b;
+	jit_nuint c;
+
+} triple_t;
+
+static triple_t struct_source[NUM_STRUCTS];
+static triple_t struct_dest[NUM_STRUCTS];
+static int large_ops[NUM_STATEMENTS][3];
+static int thrown;
+
+static double
+now(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static jit_value_t
+constant(jit_function_t func, jit_nint value)
+{
+	return jit_value_create_nint_constant(func, jit_type_nuint, value);
+}
+
+/*
+ * Create a function of the kernel that takes and returns a jit_nuint.
+ * The functions are compiled in the order they are created.
+ */
+static jit_function_t
+create_function(bench_t *bench)
+{
+	jit_type_t params[1];
+	jit_type_t signature;
+	jit_function_t func;
+
+	params[0] = jit_type_nuint;
+	signature = jit_type_create_signature(jit_abi_cdecl, jit_type_nuint, params, 1, 1);
+	func = jit_function_create(bench->context, signature);
+	jit_type_free(signature);
+	jit_function_set_optimization_level(func, bench->level);
+	bench->functions[bench->num_functions++] = func;
+	return func;
+}
+
+/*
+ * Start the kernel loop: "sum = 0; for(i = 0; i < n; i++)".
+ */
+static void
+loop_start(jit_function_t func, jit_value_t *i, jit_value_t *sum,
+	   jit_label_t *loop, jit_label_t *done)
+{
+	*i = jit_value_create(func, jit_type_nuint);
+	*sum = jit_value_create(func, jit_type_nuint);
+	jit_insn_store(func, *i, constant(func, 0));
+	jit_insn_store(func, *sum, constant(func, 0));
+	jit_insn_branch_if_not(func, jit_insn_lt(func, *i, jit_value_get_param(func, 0)), done);
+	jit_insn_label(func, loop);
+}
+
+/*
+ * End the kernel loop and return the sum.
+ */
+static void
+loop_end(jit_function_t func, jit_value_t i, jit_value_t sum,
+	 jit_label_t *loop, jit_label_t *done)
+{
+	jit_insn_store(func, i, jit_insn_add(func, i, constant(func, 1)));
+	jit_insn_branch_if(func, jit_insn_lt(func, i, jit_value_get_param(func, 0)), loop);
+	jit_insn_label(func, done);
+	jit_insn_return(func, sum);
+}
+
+static jit_function_t
+build_loop(bench_t *bench)
+{
+	jit_label_t loop = jit_label_undefined;
+	jit_label_t done = jit_label_undefined;
+	jit_function_t func;
+	jit_value_t i, sum, temp;
+
+	func = create_function(bench);
+	loop_start(func, &i, &sum, &loop, &done);
+	temp = jit_insn_xor(func, i, jit_insn_shr(func, i, constant(func, 3)));
+	jit_insn_store(func, sum, jit_insn_add(func, jit_insn_mul(func, sum, constant(func, 31)), temp));
+	loop_end(func, i, sum, &loop, &done);
+	return func;
+}
+
+static jit_nuint
+compute_loop(jit_nuint n)
+{
+	jit_nuint sum = 0;
+	jit_nuint i;
+
+	for(i = 0; i < n; i++)
+	{
+		sum = sum * 31 + (i ^ (i >> 3));
+	}
+	return sum;
+}
+
+static jit_function_t
+build_calls(bench_t *bench)
+{
+	jit_label_t loop = jit_label_undefined;
+	jit_label_t done = jit_label_undefined;
+	jit_function_t callee, func;
+	jit_value_t i, sum, x, args[1];
+
+	callee = create_function(bench);
+	x = jit_value_get_param(callee, 0);
+	jit_insn_return(callee, jit_insn_add(callee, jit_insn_mul(callee, x, constant(callee, 3)),
+					     jit_insn_shr(callee, x, constant(callee, 2))));
+
+	func = create_function(bench);
+	loop_start(func, &i, &sum, &loop, &done);
+	args[0] = jit_insn_add(func, sum, i);
+	jit_insn_store(func, sum, jit_insn_call(func, "callee", callee, 0, args, 1,
+						JIT_CALL_NOTHROW));
+	loop_end(func, i, sum, &loop, &done);
+	return func;
+}
+
+static jit_nuint
+compute_calls(jit_nuint n)
+{
+	jit_nuint sum = 0;
+	jit_nuint i, x;
+
+	for(i = 0; i < n; i++)
+	{
+		x = sum + i;
+		sum = x * 3 + (x >> 2);
+	}
+	return sum;
+}
+
+static jit_function_t
+build_switch(bench_t *bench)
+{
+	jit_label_t loop = jit_label_undefined;
+	jit_label_t done = jit_label_undefined;
+	jit_label_t next = jit_label_undefined;
+	jit_label_t labels[8];
+	jit_function_t func;
+	jit_value_t i, sum, value;
+	int index;
+
+	func = create_function(bench);
+	loop_start(func, &i, &sum, &loop, &done);
+	for(index = 0; index < 8; index++)
+	{
+		labels[index] = jit_label_undefined;
+	}
+	jit_insn_jump_table(func, jit_insn_and(func, i, constant(func, 7)), labels, 8);
+	jit_insn_branch(func, &next);
+	for(index = 0; index < 8; index++)
+	{
+		jit_insn_label(func, &labels[index]);
+		switch(index)
+		{
+		case 0:
+			value = jit_insn_add(func, sum, i);
+			break;
+		case 1:
+			value = jit_insn_xor(func, sum, i);
+			break;
+		case 2:
+			value = jit_insn_mul(func, sum, constant(func, 3));
+			break;
+		case 3:
+			value = jit_insn_sub(func, sum, i);
+			break;
+		case 4:
+			value = jit_insn_add(func, sum, constant(func, 7));
+			break;
+		case 5:
+			value = jit_insn_shr(func, sum, constant(func, 1));
+			break;
+		case 6:
+			value = jit_insn_or(func, sum, i);
+			break;
+		default:
+			value = jit_insn_add(func, sum, jit_insn_shl(func, sum, constant(func, 2)));
+			break;
+		}
+		jit_insn_store(func, sum, value);
+		jit_insn_branch(func, &next);
+	}
+	jit_insn_label(func, &next);
+	loop_end(func, i, sum, &loop, &done);
+	return func;
+}
+
+static jit_nuint
+compute_switch(jit_nuint n)
+{
+	jit_nuint sum = 0;
+	jit_nuint i;
+
+	for(i = 0; i < n; i++)
+	{
+		switch(i & 7)
+		{
+		case 0:
+			sum = sum + i;
+			break;
+		case 1:
+			sum = sum ^ i;
+			break;
+		case 2:
+			sum = sum * 3;
+			break;
+		case 3:
+			sum = sum - i;
+			break;
+		case 4:
+			sum = sum + 7;
+			break;
+		case 5:
+			sum = sum >> 1;
+			break;
+		case 6:
+			sum = sum | i;
+			break;
+		default:
+			sum = sum + (sum << 2);
+			break;
+		}
+	}
+	return sum;
+}
+
+static jit_function_t
+build_struct(bench_t *bench)
+{
+	jit_label_t loop = jit_label_undefined;
+	jit_label_t done = jit_label_undefined;
+	jit_type_t fields[3];
+	jit_type_t type;
+	jit_function_t func;
+	jit_value_t i, sum, src, dest, value;
+
+	fields[0] = jit_type_nuint;
+	fields[1] = jit_type_nuint;
+	fields[2] = jit_type_nuint;
+	type = jit_type_create_struct(fields, 3, 1);
+
+	func = create_function(bench);
+	loop_start(func, &i, &sum, &loop, &done);
+	src = jit_insn_mul(func, jit_insn_and(func, jit_insn_mul(func, i, constant(func, 7)),
+					     constant(func, NUM_STRUCTS - 1)),
+			   constant(func, sizeof(triple_t)));
+	src = jit_insn_add(func, constant(func, (jit_nint) struct_source), src);
+	dest = jit_insn_mul(func, jit_insn_and(func, i, constant(func, NUM_STRUCTS - 1)),
+			    constant(func, sizeof(triple_t)));
+	dest = jit_insn_add(func, constant(func, (jit_nint) struct_dest), dest);
+	value = jit_insn_load_relative(func, src, 0, type);
+	jit_insn_store_relative(func, dest, 0, value);
+	value = jit_insn_load_relative(func, dest, offsetof(triple_t, b), jit_type_nuint);
+	jit_insn_store(func, sum, jit_insn_add(func, sum, jit_insn_add(func, value, i)));
+	loop_end(func, i, sum, &loop, &done);
+
+	jit_type_free(type);
+	return func;
+}
+
+static jit_nuint
+compute_struct(jit_nuint n)
+{
+	jit_nuint sum = 0;
+	jit_nuint i;
+
+	for(i = 0; i < n; i++)
+	{
+		struct_dest[i & (NUM_STRUCTS - 1)] = struct_source[(i * 7) & (NUM_STRUCTS - 1)];
+		sum += struct_dest[i & (NUM_STRUCTS - 1)].b + i;
+	}
+	return sum;
+}
+
+static jit_function_t
+build_except(bench_t *bench)
+{
+	jit_label_t loop = jit_label_undefined;
+	jit_label_t done = jit_label_undefined;
+	jit_label_t no_throw = jit_label_undefined;
+	jit_function_t thrower, catcher, func;
+	jit_value_t i, sum, x, args[1];
+
+	thrower = create_function(bench);
+	x = jit_value_get_param(thrower, 0);
+	jit_insn_branch_if(thrower, jit_insn_and(thrower, x, constant(thrower, 7)), &no_throw);
+	jit_insn_throw(thrower, jit_value_create_nint_constant(thrower, jit_type_void_ptr,
+							       (jit_nint) &thrown));
+	jit_insn_label(thrower, &no_throw);
+	jit_insn_return(thrower, jit_insn_mul(thrower, x, constant(thrower, 3)));
+
+	catcher = create_function(bench);
+	jit_insn_uses_catcher(catcher);
+	args[0] = jit_value_get_param(catcher, 0);
+	jit_insn_return(catcher, jit_insn_call(catcher, "thrower", thrower, 0, args, 1, 0));
+	jit_insn_start_catcher(catcher);
+	jit_insn_return(catcher, constant(catcher, 1));
+
+	func = create_function(bench);
+	loop_start(func, &i, &sum, &loop, &done);
+	args[0] = i;
+	jit_insn_store(func, sum, jit_insn_add(func, sum, jit_insn_call(func, "catcher", catcher,
+									0, args, 1, 0)));
+	loop_end(func, i, sum, &loop, &done);
+	return func;
+}
+
+static jit_nuint
+compute_except(jit_nuint n)
+{
+	jit_nuint sum = 0;
+	jit_nuint i;
+
+	for(i = 0; i < n; i++)
+	{
+		sum += (i & 7) ? i * 3 : 1;
+	}
+	return sum;
+}
+
+static jit_function_t
+build_float(bench_t *bench)
+{
+	jit_label_t loop = jit_label_undefined;
+	jit_label_t done = jit_label_undefined;
+	jit_function_t func;
+	jit_value_t i, sum, fsum, t, p;
+
+	func = create_function(bench);
+	fsum = jit_value_create(func, jit_type_float64);
+	jit_insn_store(func, fsum, jit_value_create_float64_constant(func, jit_type_float64, 0));
+	loop_start(func, &i, &sum, &loop, &done);
+	t = jit_insn_mul(func, jit_insn_convert(func, i, jit_type_float64, 0),
+			 jit_value_create_float64_constant(func, jit_type_float64, 1.0 / 1024));
+	p = jit_insn_mul(func, t, jit_value_create_float64_constant(func, jit_type_float64, 0.125));
+	p = jit_insn_add(func, p, jit_value_create_float64_constant(func, jit_type_float64, -1.5));
+	p = jit_insn_mul(func, p, t);
+	p = jit_insn_add(func, p, jit_value_create_float64_constant(func, jit_type_float64, 3.0));
+	p = jit_insn_mul(func, p, t);
+	p = jit_insn_add(func, p, jit_value_create_float64_constant(func, jit_type_float64, 0.25));
+	jit_insn_store(func, fsum, jit_insn_add(func, fsum, p));
+	jit_insn_store(func, sum, jit_insn_convert(func, fsum, jit_type_nuint, 0));
+	loop_end(func, i, sum, &loop, &done);
+	return func;
+}
+
+static jit_nuint
+compute_float(jit_nuint n)
+{
+	jit_float64 fsum = 0;
+	jit_float64 t, p;
+	jit_nuint sum = 0;
+	jit_nuint i;
+
+	for(i = 0; i < n; i++)
+	{
+		t = (jit_float64) i * (1.0 / 1024);
+		p = t * 0.125;
+		p = p + -1.5;
+		p = p * t;
+		p = p + 3.0;
+		p = p * t;
+		p = p + 0.25;
+		fsum = fsum + p;
+		sum = (jit_nuint) fsum;
+	}
+	return sum;
+}
+
+static jit_function_t
+build_large(bench_t *bench)
+{
+	jit_label_t loop = jit_label_undefined;
+	jit_label_t done = jit_label_undefined;
+	jit_function_t func;
+	jit_value_t vars[NUM_VARS];
+	jit_value_t i, sum, temp;
+	unsigned int seed;
+	int index;
+
+	func = create_function(bench);
+	for(index = 0; index < NUM_VARS; index++)
+	{
+		vars[index] = jit_value_create(func, jit_type_nuint);
+		jit_insn_store(func, vars[index], constant(func, index + 1));
+	}
+	loop_start(func, &i, &sum, &loop, &done);
+	seed = 1;
+	for(index = 0; index < NUM_STATEMENTS; index++)
+	{
+		seed = seed * 1103515245 + 12345;
+		large_ops[index][0] = (seed >> 16) % NUM_VARS;
+		seed = seed * 1103515245 + 12345;
+		large_ops[index][1] = (seed >> 16) % NUM_VARS;
+		seed = seed * 1103515245 + 12345;
+		large_ops[index][2] = (seed >> 16) % NUM_VARS;
+		temp = jit_insn_add(func, vars[large_ops[index][0]], vars[large_ops[index][1]]);
+		temp = jit_insn_xor(func, temp, vars[large_ops[index][2]]);
+		jit_insn_store(func, vars[large_ops[index][2]], temp);
+	}
+	jit_insn_store(func, sum, jit_insn_add(func, sum, vars[0]));
+	loop_end(func, i, sum, &loop, &done);
+	return func;
+}
+
+static jit_nuint
+compute_large(jit_nuint n)
+{
+	jit_nuint vals[NUM_VARS];
+	jit_nuint sum = 0;
+	jit_nuint i;
+	int index;
+
+	for(index = 0; index < NUM_VARS; index++)
+	{
+		vals[index] = index + 1;
+	}
+	for(i = 0; i < n; i++)
+	{
+		for(index = 0; index < NUM_STATEMENTS; index++)
+		{
+			vals[large_ops[index][2]] = (vals[large_ops[index][0]]
+						     + vals[large_ops[index][1]])
+				^ vals[large_ops[index][2]];
+		}
+		sum += vals[0];
+	}
+	return sum;
+}
+
+static kernel_entry kernels[] = {
+	{"loop", build_loop, compute_loop, 1000000},
+	{"calls", build_calls, compute_calls, 1000000},
+	{"switch", build_switch, compute_switch, 1000000},
+	{"struct", build_struct, compute_struct, 1000000},
+	{"except", build_except, compute_except, 100000},
+	{"float", build_float, compute_float, 1000000},
+	{"large", build_large, compute_large, 100},
+};
+#define NUM_KERNELS	(sizeof(kernels) / sizeof(kernels[0]))
+
+/*
+ * Count the instructions in the function.
+ */
+static long
+count_insns(jit_function_t func)
+{
+	jit_block_t block;
+	jit_insn_iter_t iter;
+	long count;
+
+	count = 0;
+	block = 0;
+	while((block = jit_block_next(func, block)) != 0)
+	{
+		jit_insn_iter_init(&iter, block);
+		while(jit_insn_iter_next(&iter) != 0)
+		{
+			++count;
+		}
+	}
+	return count;
+}
+
+static int
+run(kernel_entry *kernel, int level, int repeat)
+{
+	bench_t bench;
+	jit_function_t func;
+	jit_nuint n, result, expected;
+	jit_ulong code_bytes;
+	void *args[1];
+	double start, compile_time, run_time;
+	const char *status;
+	long count;
+	int index, ok;
+
+	bench.context = jit_context_create();
+	bench.level = level;
+	bench.num_functions = 0;
+
+	jit_context_build_start(bench.context);
+	func = kernel->build(&bench);
+	count = 0;
+	for(index = 0; index < bench.num_functions; index++)
+	{
+		count += count_insns(bench.functions[index]);
+	}
+	code_bytes = jit_context_get_stat(bench.context, JIT_STAT_CODE_BYTES);
+	start = now();
+	ok = 1;
+	for(index = 0; index < bench.num_functions; index++)
+	{
+		if(!jit_function_compile(bench.functions[index]))
+		{
+			ok = 0;
+		}
+	}
+	compile_time = now() - start;
+	code_bytes = jit_context_get_stat(bench.context, JIT_STAT_CODE_BYTES) - code_bytes;
+	jit_context_build_end(bench.context);
+
+	n = kernel->iterations;
+	result = 0;
+	expected = 1;
+	run_time = 0;
+	status = "FAILED";
+	if(ok)
+	{
+		args[0] = &n;
+		expected = kernel->compute(n);
+		jit_function_apply(func, args, &result);
+		status = (result == expected) ? "ok" : "WRONG";
+
+		start = now();
+		for(index = 0; index < repeat; index++)
+		{
+			jit_function_apply(func, args, &result);
+		}
+		run_time = now() - start;
+	}
+
+	printf("kernel=%s backend=%s level=%d insns=%ld compile_ns_per_insn=%.1f"
+	       " code_bytes=%lu run_ns_per_iter=%.3f status=%s\n",
+	       kernel->name, jit_uses_interpreter() ? "interp" : "native", level,
+	       count, compile_time * 1e9 / count, (unsigned long) code_bytes,
+	       run_time * 1e9 / ((double) n * repeat), status);
+
+	jit_context_destroy(bench.context);
+	return ok && result == expected;
+}
+
+int
+main(int argc, char *argv[])
+{
+	const char *name;
+	int level, repeat, index, status;
+
+	jit_init();
+
+	for(index = 0; index < NUM_STRUCTS; index++)
+	{
+		struct_source[index].a = index;
+		struct_source[index].b = index * 1000 + 1;
+		struct_source[index].c = index * 7;
+	}
+
+	level = jit_function_get_max_optimization_level();
+	repeat = 5;
+	name = 0;
+	for(index = 1; index < argc; index++)
+	{
+		if(!strcmp(argv[index], "-O") && index + 1 < argc)
+		{
+			level = atoi(argv[++index]);
+		}
+		else if(!strcmp(argv[index], "-r") && index + 1 < argc)
+		{
+			repeat = atoi(argv[++index]);
+		}
+		else if(!strcmp(argv[index], "-k") && index + 1 < argc)
+		{
+			name = argv[++index];
+		}
+	}
+
+	status = 0;
+	for(index = 0; index < (int) NUM_KERNELS; index++)
+	{
+		if(name && strcmp(name, kernels[index].name) != 0)
+		{
+			continue;
+		}
+		if(!run(&kernels[index], level, repeat))
+		{
+			status = 1;
+		}
+	}
+	return status;
+}
@@ -0,0 +1,318 @@
+/*
+ * large-func.c - Compile time of very large generated functions.
+ *
+ * Copyright (C) 2026  Free Software Foundation, Inc.
+ *
+ * This file is part of the libjit library.
+ *
+ * The libjit library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * The libjit library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the libjit library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Usage: large-func [-O level] [-b usec] [-l insns] [-s shape] [size ...]
+ *
+ * Build a single function of roughly the given number of instructions
+ * (by default 10000, 100000 and 1000000) for each of the shapes below,
+ * compile it, run it, and check the result against the same computation
+ * done in C.  Prints one line per function with the number of the IR
+ * instructions, the build and compile time and the compile time per
+ * instruction.  The compile time per instruction should stay about the
+ * same as the function size grows.  The -b and -l options set the
+ * compilation time budget and the optimization size limit.
+ *
+ *   straight	stack machine style code in a single block
+ *   branchy	if-then-else diamonds
+ *   chain	straight-line code split by jumps to the next instruction
+ *   loops	many small counted loops
+ */
+
+#include <jit/jit.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#define NUM_VARS	64
+
+static const char *shapes[] = { "straight", "branchy", "chain", "loops" };
+#define NUM_SHAPES	(sizeof(shapes) / sizeof(shapes[0]))
+
+static unsigned int seed;
+static unsigned int budget;
+static unsigned int size_limit;
+
+static int
+next_random(int limit)
+{
+	seed = seed * 1103515245 + 12345;
+	return (int) ((seed >> 16) % limit);
+}
+
+static double
+now(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static jit_value_t
+constant(jit_function_t func, jit_nint value)
+{
+	return jit_value_create_nint_constant(func, jit_type_int, value);
+}
+
+/*
+ * Emit one statement of the given shape and perform the same
+ * computation on the "vals" array.
+ */
+static void
+emit_statement(jit_function_t func, int shape, jit_value_t *vars, unsigned int *vals)
+{
+	jit_label_t label1 = jit_label_undefined;
+	jit_label_t label2 = jit_label_undefined;
+	jit_value_t temp1, temp2, counter;
+	int a, b, c, i;
+
+	a = next_random(NUM_VARS);
+	b = next_random(NUM_VARS);
+	c = next_random(NUM_VARS);
+
+	switch(shape)
+	{
+	case 0:
+		temp1 = jit_insn_load(func, vars[a]);
+		temp2 = jit_insn_load(func, vars[b]);
+		temp1 = jit_insn_add(func, temp1, temp2);
+		temp2 = jit_insn_load(func, vars[c]);
+		temp1 = jit_insn_xor(func, temp1, temp2);
+		jit_insn_store(func, vars[c], temp1);
+		vals[c] = (vals[a] + vals[b]) ^ vals[c];
+		break;
+
+	case 1:
+		temp1 = jit_insn_lt(func, vars[a], vars[b]);
+		jit_insn_branch_if_not(func, temp1, &label1);
+		jit_insn_store(func, vars[c], jit_insn_sub(func, vars[a], vars[b]));
+		jit_insn_branch(func, &label2);
+		jit_insn_label(func, &label1);
+		jit_insn_store(func, vars[c], jit_insn_add(func, vars[c], constant(func, a)));
+		jit_insn_label(func, &label2);
+		if((int) vals[a] < (int) vals[b])
+		{
+			vals[c] = vals[a] - vals[b];
+		}
+		else
+		{
+			vals[c] = vals[c] + a;
+		}
+		break;
+
+	case 2:
+		jit_insn_store(func, vars[c], jit_insn_add(func, vars[a], vars[b]));
+		jit_insn_branch(func, &label1);
+		jit_insn_label(func, &label1);
+		vals[c] = vals[a] + vals[b];
+		break;
+
+	case 3:
+		counter = jit_value_create(func, jit_type_int);
+		jit_insn_store(func, counter, constant(func, 0));
+		jit_insn_label(func, &label1);
+		jit_insn_store(func, vars[c], jit_insn_add(func, vars[c], vars[a]));
+		jit_insn_store(func, counter, jit_insn_add(func, counter, constant(func, 1)));
+		temp1 = jit_insn_lt(func, counter, constant(func, 4));
+		jit_insn_branch_if(func, temp1, &label1);
+		for(i = 0; i < 4; i++)
+		{
+			vals[c] = vals[c] + vals[a];
+		}
+		break;
+	}
+}
+
+/*
+ * Count the instructions in the function.
+ */
+static long
+count_insns(jit_function_t func)
+{
+	jit_block_t block;
+	jit_insn_iter_t iter;
+	long count;
+
+	count = 0;
+	block = 0;
+	while((block = jit_block_next(func, block)) != 0)
+	{
+		jit_insn_iter_init(&iter, block);
+		while(jit_insn_iter_next(&iter) != 0)
+		{
+			++count;
+		}
+	}
+	return count;
+}
+
+static int
+run(int shape, long size, int level)
+{
+	jit_context_t context;
+	jit_type_t params[1];
+	jit_type_t signature;
+	jit_function_t func;
+	jit_value_t vars[NUM_VARS];
+	unsigned int vals[NUM_VARS];
+	jit_value_t result;
+	jit_int arg, value;
+	void *args[1];
+	unsigned int expected;
+	double start, built, compiled;
+	long count;
+	int i, ok;
+
+	context = jit_context_create();
+	jit_context_set_meta_numeric(context, JIT_OPTION_OPTIMIZE_SIZE_LIMIT, size_limit);
+	jit_context_build_start(context);
+
+	params[0] = jit_type_int;
+	signature = jit_type_create_signature(jit_abi_cdecl, jit_type_int, params, 1, 1);
+	func = jit_function_create(context, signature);
+	jit_type_free(signature);
+	jit_function_set_optimization_level(func, level);
+	jit_function_set_compile_budget(func, budget);
+
+	start = now();
+
+	arg = 7;
+	for(i = 0; i < NUM_VARS; i++)
+	{
+		vars[i] = jit_value_create(func, jit_type_int);
+		jit_insn_store(func, vars[i],
+			       jit_insn_mul(func, jit_value_get_param(func, 0),
+					    constant(func, i + 1)));
+		vals[i] = arg * (i + 1);
+	}
+
+	/* Each statement is about five instructions long */
+	seed = 1;
+	count = 0;
+	while(count < size)
+	{
+		emit_statement(func, shape, vars, vals);
+		count += 5;
+	}
+
+	result = vars[0];
+	expected = vals[0];
+	for(i = 1; i < NUM_VARS; i++)
+	{
+		result = jit_insn_add(func, result, vars[i]);
+		expected += vals[i];
+	}
+	jit_insn_return(func, result);
+
+	built = now();
+	count = count_insns(func);
+	ok = jit_function_compile(func);
+	compiled = now();
+	jit_context_build_end(context);
+
+	value = 0;
+	if(ok)
+	{
+		args[0] = &arg;
+		jit_function_apply(func, args, &value);
+	}
+
+	printf("%-8s %8ld insns  build %8.3f s  compile %8.3f s  %8.1f ns/insn  %s\n",
+	       shapes[shape], count, built - start, compiled - built,
+	       (compiled - built) * 1e9 / count,
+	       !ok ? "FAILED" : (unsigned int) value != expected ? "WRONG" : "ok");
+
+	jit_context_destroy(context);
+	return ok && (unsigned int) value == expected;
+}
+
+int
+main(int argc, char *argv[])
+{
+	static long default_sizes[] = { 10000, 100000, 1000000 };
+	long sizes[16];
+	int num_sizes, size_index, shape, level, index, status;
+
+	jit_init();
+
+	num_sizes = 0;
+	shape = -1;
+	level = jit_function_get_max_optimization_level();
+	for(index = 1; index < argc; index++)
+	{
+		if(!strcmp(argv[index], "-O") && index + 1 < argc)
+		{
+			level = atoi(argv[++index]);
+		}
+		else if(!strcmp(argv[index], "-b") && index + 1 < argc)
+		{
+			budget = atoi(argv[++index]);
+		}
+		else if(!strcmp(argv[index], "-l") && index + 1 < argc)
+		{
+			size_limit = atoi(argv[++index]);
+		}
+		else if(!strcmp(argv[index], "-s") && index + 1 < argc)
+		{
+			++index;
+			for(shape = 0; shape < (int) NUM_SHAPES; shape++)
+			{
+				if(!strcmp(argv[index], shapes[shape]))
+				{
+					break;
+				}
+			}
+			if(shape == (int) NUM_SHAPES)
+			{
+				fprintf(stderr, "unknown shape: %s\n", argv[index]);
+				return 1;
+			}
+		}
+		else if(num_sizes < 16)
+		{
+			sizes[num_sizes++] = atol(argv[index]);
+		}
+	}
+	if(num_sizes == 0)
+	{
+		memcpy(sizes, default_sizes, sizeof(default_sizes));
+		num_sizes = sizeof(default_sizes) / sizeof(default_sizes[0]);
+	}
+
+	status = 0;
+	for(index = 0; index < (int) NUM_SHAPES; index++)
+	{
+		if(shape >= 0 && index != shape)
+		{
+			continue;
+		}
+		for(size_index = 0; size_index < num_sizes; size_index++)
+		{
+			if(!run(index, sizes[size_index], level))
+			{
+				status = 1;
+			}
+		}
+	}
+	return status;
+}
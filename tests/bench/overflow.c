@@ -0,0 +1,375 @@
+/*
+ * overflow.c - Cost of the overflow checked arithmetic.
+ *
+ * Copyright (C) 2026  Free Software Foundation, Inc.
+ *
+ * This file is part of the libjit library.
+ *
+ * The libjit library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * The libjit library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the libjit library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Usage: overflow [-O level] [-n count] [-r repeat]
+ *
+ * Compile a few array kernels in three versions and print the run time
+ * of each version in nanoseconds per array element.  The "plain" version
+ * uses the unchecked arithmetic, the "checked" version uses the overflow
+ * checked instructions as the back end lowers them, and the "intrinsic"
+ * version calls the intrinsic functions that implement the checks out of
+ * line.  The last one is what the checked instructions compile to on back
+ * ends that have no rules for them.  The program also checks that all the
+ * versions compute the same results as the C code.
+ */
+
+#include <jit/jit.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#define PLAIN		0
+#define CHECKED		1
+#define INTRINSIC	2
+#define NUM_VERSIONS	3
+
+typedef struct
+{
+	const char *name;
+	jit_value_t (*build)(jit_function_t func, int version, jit_value_t x,
+			     jit_value_t y, jit_value_t sum);
+	jit_long (*compute)(const jit_int *a, const jit_int *b, int n);
+
+} kernel_entry;
+
+static const char *version_names[NUM_VERSIONS] = {
+	"plain", "checked", "intrinsic"
+};
+
+static jit_intrinsic_descr_t int_descr;
+static jit_intrinsic_descr_t long_descr;
+static jit_intrinsic_descr_t convert_descr;
+
+static double
+now(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static jit_value_t
+add_int(jit_function_t func, int version, jit_value_t x, jit_value_t y)
+{
+	switch(version)
+	{
+	case CHECKED:
+		return jit_insn_add_ovf(func, x, y);
+	case INTRINSIC:
+		return jit_insn_call_intrinsic(func, "jit_int_add_ovf",
+					       (void *) jit_int_add_ovf,
+					       &int_descr, x, y);
+	}
+	return jit_insn_add(func, x, y);
+}
+
+static jit_value_t
+mul_int(jit_function_t func, int version, jit_value_t x, jit_value_t y)
+{
+	switch(version)
+	{
+	case CHECKED:
+		return jit_insn_mul_ovf(func, x, y);
+	case INTRINSIC:
+		return jit_insn_call_intrinsic(func, "jit_int_mul_ovf",
+					       (void *) jit_int_mul_ovf,
+					       &int_descr, x, y);
+	}
+	return jit_insn_mul(func, x, y);
+}
+
+static jit_value_t
+add_long(jit_function_t func, int version, jit_value_t x, jit_value_t y)
+{
+	x = jit_insn_convert(func, x, jit_type_long, 0);
+	y = jit_insn_convert(func, y, jit_type_long, 0);
+	switch(version)
+	{
+	case CHECKED:
+		return jit_insn_add_ovf(func, x, y);
+	case INTRINSIC:
+		return jit_insn_call_intrinsic(func, "jit_long_add_ovf",
+					       (void *) jit_long_add_ovf,
+					       &long_descr, x, y);
+	}
+	return jit_insn_add(func, x, y);
+}
+
+static jit_value_t
+to_short(jit_function_t func, int version, jit_value_t x)
+{
+	switch(version)
+	{
+	case CHECKED:
+		return jit_insn_convert(func, x, jit_type_short, 1);
+	case INTRINSIC:
+		return jit_insn_call_intrinsic(func, "jit_int_to_short_ovf",
+					       (void *) jit_int_to_short_ovf,
+					       &convert_descr, x, 0);
+	}
+	return jit_insn_convert(func, x, jit_type_short, 0);
+}
+
+/*
+ * Sum of the elements.
+ */
+static jit_value_t
+build_sums(jit_function_t func, int version, jit_value_t x, jit_value_t y,
+	   jit_value_t sum)
+{
+	return add_long(func, version, sum, add_int(func, version, x, y));
+}
+
+static jit_long
+compute_sums(const jit_int *a, const jit_int *b, int n)
+{
+	jit_long sum = 0;
+	int i;
+
+	for(i = 0; i < n; i++)
+	{
+		sum += a[i] + b[i];
+	}
+	return sum;
+}
+
+/*
+ * Dot product.
+ */
+static jit_value_t
+build_products(jit_function_t func, int version, jit_value_t x, jit_value_t y,
+	       jit_value_t sum)
+{
+	return add_long(func, version, sum, mul_int(func, version, x, y));
+}
+
+static jit_long
+compute_products(const jit_int *a, const jit_int *b, int n)
+{
+	jit_long sum = 0;
+	int i;
+
+	for(i = 0; i < n; i++)
+	{
+		sum += a[i] * b[i];
+	}
+	return sum;
+}
+
+/*
+ * Sum of the elements narrowed to shorts.
+ */
+static jit_value_t
+build_narrowing(jit_function_t func, int version, jit_value_t x, jit_value_t y,
+		jit_value_t sum)
+{
+	return add_long(func, version, sum,
+			add_int(func, version, to_short(func, version, x),
+				to_short(func, version, y)));
+}
+
+static jit_long
+compute_narrowing(const jit_int *a, const jit_int *b, int n)
+{
+	jit_long sum = 0;
+	int i;
+
+	for(i = 0; i < n; i++)
+	{
+		sum += (jit_short) a[i] + (jit_short) b[i];
+	}
+	return sum;
+}
+
+static kernel_entry kernels[] = {
+	{"sums", build_sums, compute_sums},
+	{"products", build_products, compute_products},
+	{"narrowing", build_narrowing, compute_narrowing},
+};
+#define NUM_KERNELS	(sizeof(kernels) / sizeof(kernels[0]))
+
+/*
+ * Build the kernel loop: for(i = 0; i < n; i++) { sum = body; }.
+ */
+static jit_function_t
+build_kernel(jit_context_t context, kernel_entry *entry, int level, int version)
+{
+	jit_type_t params[3];
+	jit_type_t signature;
+	jit_function_t func;
+	jit_label_t loop = jit_label_undefined;
+	jit_label_t done = jit_label_undefined;
+	jit_value_t a, b, n, i, sum, x, y;
+
+	params[0] = jit_type_void_ptr;
+	params[1] = jit_type_void_ptr;
+	params[2] = jit_type_nint;
+	jit_context_build_start(context);
+	signature = jit_type_create_signature(jit_abi_cdecl, jit_type_long, params, 3, 1);
+	func = jit_function_create(context, signature);
+	jit_type_free(signature);
+	jit_function_set_optimization_level(func, level);
+
+	a = jit_value_get_param(func, 0);
+	b = jit_value_get_param(func, 1);
+	n = jit_value_get_param(func, 2);
+	i = jit_value_create(func, jit_type_nint);
+	sum = jit_value_create(func, jit_type_long);
+	jit_insn_store(func, i, jit_value_create_nint_constant(func, jit_type_nint, 0));
+	jit_insn_store(func, sum, jit_value_create_long_constant(func, jit_type_long, 0));
+	jit_insn_branch_if_not(func, jit_insn_lt(func, i, n), &done);
+	jit_insn_label(func, &loop);
+	x = jit_insn_load_elem(func, a, i, jit_type_int);
+	y = jit_insn_load_elem(func, b, i, jit_type_int);
+	jit_insn_store(func, sum, entry->build(func, version, x, y, sum));
+	jit_insn_store(func, i, jit_insn_add(func, i,
+		jit_value_create_nint_constant(func, jit_type_nint, 1)));
+	jit_insn_branch_if(func, jit_insn_lt(func, i, n), &loop);
+	jit_insn_label(func, &done);
+	jit_insn_return(func, sum);
+
+	if(!jit_function_compile(func))
+	{
+		func = 0;
+	}
+	jit_context_build_end(context);
+	return func;
+}
+
+/*
+ * Run the kernel the given number of times and return the time per
+ * array element in nanoseconds or a negative value if the result is
+ * wrong.
+ */
+static double
+run_kernel(jit_function_t func, jit_int *a, jit_int *b, jit_nint n,
+	   int repeat, jit_long expected)
+{
+	void *args[3];
+	jit_long result;
+	double start;
+	int index;
+
+	if(!func)
+	{
+		return -1;
+	}
+	args[0] = &a;
+	args[1] = &b;
+	args[2] = &n;
+	start = now();
+	for(index = 0; index < repeat; index++)
+	{
+		if(!jit_function_apply(func, args, &result) || result != expected)
+		{
+			return -1;
+		}
+	}
+	return (now() - start) * 1e9 / ((double) n * repeat);
+}
+
+int
+main(int argc, char *argv[])
+{
+	jit_context_t context;
+	jit_int *a, *b;
+	jit_long expected;
+	double times[NUM_VERSIONS];
+	int level, count, repeat, index, version, wrong, status;
+
+	jit_init();
+
+	int_descr.return_type = jit_type_int;
+	int_descr.ptr_result_type = jit_type_int;
+	int_descr.arg1_type = jit_type_int;
+	int_descr.arg2_type = jit_type_int;
+	long_descr.return_type = jit_type_int;
+	long_descr.ptr_result_type = jit_type_long;
+	long_descr.arg1_type = jit_type_long;
+	long_descr.arg2_type = jit_type_long;
+	convert_descr.return_type = jit_type_int;
+	convert_descr.ptr_result_type = jit_type_int;
+	convert_descr.arg1_type = jit_type_int;
+	convert_descr.arg2_type = 0;
+
+	level = jit_function_get_max_optimization_level();
+	count = 4096;
+	repeat = 2000;
+	for(index = 1; index < argc; index++)
+	{
+		if(!strcmp(argv[index], "-O") && index + 1 < argc)
+		{
+			level = atoi(argv[++index]);
+		}
+		else if(!strcmp(argv[index], "-n") && index + 1 < argc)
+		{
+			count = atoi(argv[++index]);
+		}
+		else if(!strcmp(argv[index], "-r") && index + 1 < argc)
+		{
+			repeat = atoi(argv[++index]);
+		}
+	}
+
+	a = (jit_int *) malloc(count * sizeof(jit_int));
+	b = (jit_int *) malloc(count * sizeof(jit_int));
+	if(!a || !b)
+	{
+		return 1;
+	}
+	for(index = 0; index < count; index++)
+	{
+		a[index] = (jit_int) ((index * 2654435761u) >> 16) % 20000 - 10000;
+		b[index] = (index % 61) * 37 - 1000;
+	}
+
+	context = jit_context_create();
+	printf("%-12s %10s %10s %10s\n", "kernel",
+	       version_names[PLAIN], version_names[CHECKED], version_names[INTRINSIC]);
+	status = 0;
+	for(index = 0; index < (int) NUM_KERNELS; index++)
+	{
+		expected = kernels[index].compute(a, b, count);
+		wrong = 0;
+		for(version = 0; version < NUM_VERSIONS; version++)
+		{
+			times[version] = run_kernel(build_kernel(context, &kernels[index],
+								 level, version),
+						    a, b, count, repeat, expected);
+			if(times[version] < 0)
+			{
+				wrong = 1;
+			}
+		}
+		printf("%-12s %10.3f %10.3f %10.3f  %s\n", kernels[index].name,
+		       times[PLAIN], times[CHECKED], times[INTRINSIC],
+		       wrong ? "WRONG" : "ok");
+		status |= wrong;
+	}
+
+	jit_context_destroy(context);
+	free(a);
+	free(b);
+	return status;
+}
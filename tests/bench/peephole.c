@@ -0,0 +1,390 @@
+/*
+ * peephole.c - Effect of the peephole optimization on the machine code.
+ *
+ * Copyright (C) 2026  Free Software Foundation, Inc.
+ *
+ * This file is part of the libjit library.
+ *
+ * The libjit library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * The libjit library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the libjit library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Usage: peephole [-O level]
+ *
+ * Compile a small corpus of functions twice, with and without the
+ * peephole optimization, check that both versions compute the same
+ * results as the C code, and print the size of the machine code and
+ * the number of instructions and bytes changed by the peephole pass
+ * for each function.  The corpus covers the patterns the pass looks
+ * for: tests of a value that an arithmetic instruction has just set
+ * the flags for, reloads of values that have just been stored, and
+ * jumps to the next instruction.
+ */
+
+#include <jit/jit.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+	const char *name;
+	void (*build)(jit_function_t func, jit_type_t type);
+	jit_long (*compute)(jit_long n);
+	int is_long;
+
+} corpus_entry;
+
+static jit_value_t
+constant(jit_function_t func, jit_type_t type, jit_long value)
+{
+	if(type == jit_type_long)
+	{
+		return jit_value_create_long_constant(func, type, value);
+	}
+	return jit_value_create_nint_constant(func, type, (jit_nint) value);
+}
+
+/*
+ * Sum of n, n - 1, ..., 1 with the loop counter tested after the
+ * decrement.
+ */
+static void
+build_countdown(jit_function_t func, jit_type_t type)
+{
+	jit_label_t loop = jit_label_undefined;
+	jit_label_t done = jit_label_undefined;
+	jit_value_t i, sum;
+
+	i = jit_value_create(func, type);
+	sum = jit_value_create(func, type);
+	jit_insn_store(func, i, jit_value_get_param(func, 0));
+	jit_insn_store(func, sum, constant(func, type, 0));
+	jit_insn_branch_if_not(func, i, &done);
+	jit_insn_label(func, &loop);
+	jit_insn_store(func, sum, jit_insn_add(func, sum, i));
+	jit_insn_store(func, i, jit_insn_sub(func, i, constant(func, type, 1)));
+	jit_insn_branch_if(func, i, &loop);
+	jit_insn_label(func, &done);
+	jit_insn_return(func, sum);
+}
+
+static jit_long
+compute_countdown(jit_long n)
+{
+	jit_long sum = 0;
+	for(; n > 0; n--)
+	{
+		sum += n;
+	}
+	return sum;
+}
+
+/*
+ * Population count by clearing the lowest set bit until the value
+ * becomes zero.
+ */
+static void
+build_popcount(jit_function_t func, jit_type_t type)
+{
+	jit_label_t loop = jit_label_undefined;
+	jit_label_t done = jit_label_undefined;
+	jit_value_t x, count;
+
+	x = jit_value_create(func, type);
+	count = jit_value_create(func, type);
+	jit_insn_store(func, x, jit_value_get_param(func, 0));
+	jit_insn_store(func, count, constant(func, type, 0));
+	jit_insn_branch_if_not(func, x, &done);
+	jit_insn_label(func, &loop);
+	jit_insn_store(func, count, jit_insn_add(func, count, constant(func, type, 1)));
+	jit_insn_store(func, x, jit_insn_and(func, x,
+					     jit_insn_sub(func, x, constant(func, type, 1))));
+	jit_insn_branch_if(func, jit_insn_ne(func, x, constant(func, type, 0)), &loop);
+	jit_insn_label(func, &done);
+	jit_insn_return(func, count);
+}
+
+static jit_long
+compute_popcount(jit_long n)
+{
+	jit_long count = 0;
+	while(n != 0)
+	{
+		n &= n - 1;
+		count++;
+	}
+	return count;
+}
+
+/*
+ * A chain of additions and exclusive ors each followed by a test of
+ * the result.
+ */
+static void
+build_tests(jit_function_t func, jit_type_t type)
+{
+	jit_value_t x, y;
+	int i;
+
+	x = jit_value_create(func, type);
+	y = jit_value_create(func, type);
+	jit_insn_store(func, x, jit_value_get_param(func, 0));
+	jit_insn_store(func, y, constant(func, type, 0));
+	for(i = 0; i < 8; i++)
+	{
+		jit_label_t label = jit_label_undefined;
+
+		jit_insn_store(func, x, jit_insn_xor(func, x, constant(func, type, i * 3)));
+		jit_insn_store(func, x, jit_insn_sub(func, x, constant(func, type, i)));
+		jit_insn_branch_if(func, jit_insn_eq(func, x, constant(func, type, 0)), &label);
+		jit_insn_store(func, y, jit_insn_add(func, y, constant(func, type, i + 1)));
+		jit_insn_label(func, &label);
+	}
+	jit_insn_return(func, jit_insn_add(func, x, y));
+}
+
+static jit_long
+compute_tests(jit_long n)
+{
+	jit_long x = n, y = 0;
+	int i;
+
+	for(i = 0; i < 8; i++)
+	{
+		x = (x ^ (i * 3)) - i;
+		if(x != 0)
+		{
+			y += i + 1;
+		}
+	}
+	return x + y;
+}
+
+/*
+ * Straight-line code split into blocks by jumps to the next
+ * instruction, as produced by naive front ends.
+ */
+static void
+build_jumps(jit_function_t func, jit_type_t type)
+{
+	jit_value_t x;
+	int i;
+
+	x = jit_value_create(func, type);
+	jit_insn_store(func, x, jit_value_get_param(func, 0));
+	for(i = 0; i < 16; i++)
+	{
+		jit_label_t label = jit_label_undefined;
+
+		jit_insn_store(func, x, jit_insn_add(func, x, constant(func, type, i)));
+		jit_insn_branch(func, &label);
+		jit_insn_label(func, &label);
+	}
+	jit_insn_return(func, x);
+}
+
+static jit_long
+compute_jumps(jit_long n)
+{
+	int i;
+
+	for(i = 0; i < 16; i++)
+	{
+		n += i;
+	}
+	return n;
+}
+
+/*
+ * More live values than registers so that they are stored to the
+ * frame and loaded back.
+ */
+static void
+build_spills(jit_function_t func, jit_type_t type)
+{
+	jit_value_t vars[24];
+	jit_value_t sum;
+	int i;
+
+	for(i = 0; i < 24; i++)
+	{
+		vars[i] = jit_value_create(func, type);
+		jit_insn_store(func, vars[i],
+			       jit_insn_add(func, jit_value_get_param(func, 0),
+					    constant(func, type, i * i)));
+	}
+	for(i = 0; i < 24; i++)
+	{
+		jit_insn_store(func, vars[i],
+			       jit_insn_sub(func, vars[i], vars[(i + 7) % 24]));
+	}
+	sum = vars[0];
+	for(i = 1; i < 24; i++)
+	{
+		sum = jit_insn_add(func, sum, vars[i]);
+	}
+	jit_insn_return(func, sum);
+}
+
+static jit_long
+compute_spills(jit_long n)
+{
+	jit_long vars[24];
+	jit_long sum;
+	int i;
+
+	for(i = 0; i < 24; i++)
+	{
+		vars[i] = n + i * i;
+	}
+	for(i = 0; i < 24; i++)
+	{
+		vars[i] = vars[i] - vars[(i + 7) % 24];
+	}
+	sum = vars[0];
+	for(i = 1; i < 24; i++)
+	{
+		sum += vars[i];
+	}
+	return sum;
+}
+
+static corpus_entry corpus[] = {
+	{"countdown", build_countdown, compute_countdown, 0},
+	{"popcount", build_popcount, compute_popcount, 0},
+	{"tests", build_tests, compute_tests, 0},
+	{"jumps", build_jumps, compute_jumps, 0},
+	{"spills", build_spills, compute_spills, 0},
+	{"lcountdown", build_countdown, compute_countdown, 1},
+	{"lpopcount", build_popcount, compute_popcount, 1},
+	{"ltests", build_tests, compute_tests, 1},
+	{"lspills", build_spills, compute_spills, 1},
+};
+#define NUM_CORPUS	(sizeof(corpus) / sizeof(corpus[0]))
+
+static jit_long args[] = {0, 1, 5, 100, 255, 65535};
+#define NUM_ARGS	(sizeof(args) / sizeof(args[0]))
+
+/*
+ * Compile the corpus entry in the context and check the results.
+ */
+static int
+compile_entry(jit_context_t context, corpus_entry *entry, int level)
+{
+	jit_type_t type;
+	jit_type_t signature;
+	jit_function_t func;
+	jit_long arg, value, expected;
+	jit_int int_arg, int_value;
+	void *arg_ptr[1];
+	int index, ok;
+
+	type = entry->is_long ? jit_type_long : jit_type_int;
+
+	jit_context_build_start(context);
+	signature = jit_type_create_signature(jit_abi_cdecl, type, &type, 1, 1);
+	func = jit_function_create(context, signature);
+	jit_type_free(signature);
+	jit_function_set_optimization_level(func, level);
+	entry->build(func, type);
+	ok = jit_function_compile(func);
+	jit_context_build_end(context);
+	if(!ok)
+	{
+		return 0;
+	}
+
+	for(index = 0; index < (int) NUM_ARGS; index++)
+	{
+		if(entry->is_long)
+		{
+			arg = args[index];
+			arg_ptr[0] = &arg;
+			jit_function_apply(func, arg_ptr, &value);
+			expected = entry->compute(arg);
+		}
+		else
+		{
+			int_arg = (jit_int) args[index];
+			arg_ptr[0] = &int_arg;
+			jit_function_apply(func, arg_ptr, &int_value);
+			value = int_value;
+			expected = (jit_int) entry->compute(int_arg);
+		}
+		if(value != expected)
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+int
+main(int argc, char *argv[])
+{
+	jit_context_t plain, optimized;
+	jit_ulong plain_bytes, bytes, insns, saved;
+	int level, index, ok, status;
+
+	jit_init();
+
+	level = jit_function_get_max_optimization_level();
+	for(index = 1; index < argc; index++)
+	{
+		if(!strcmp(argv[index], "-O") && index + 1 < argc)
+		{
+			level = atoi(argv[++index]);
+		}
+	}
+
+	plain = jit_context_create();
+	jit_context_set_meta_numeric(plain, JIT_OPTION_NO_PEEPHOLE, 1);
+	optimized = jit_context_create();
+
+	printf("%-12s %10s %10s %8s %8s\n", "function", "plain", "peephole", "insns", "bytes");
+	status = 0;
+	for(index = 0; index < (int) NUM_CORPUS; index++)
+	{
+		plain_bytes = jit_context_get_stat(plain, JIT_STAT_CODE_BYTES);
+		bytes = jit_context_get_stat(optimized, JIT_STAT_CODE_BYTES);
+		insns = jit_context_get_stat(optimized, JIT_STAT_PEEPHOLE_INSNS);
+		saved = jit_context_get_stat(optimized, JIT_STAT_PEEPHOLE_BYTES);
+
+		ok = compile_entry(plain, &corpus[index], level);
+		ok = compile_entry(optimized, &corpus[index], level) && ok;
+
+		printf("%-12s %10lu %10lu %8lu %8lu  %s\n", corpus[index].name,
+		       (unsigned long) (jit_context_get_stat(plain, JIT_STAT_CODE_BYTES) - plain_bytes),
+		       (unsigned long) (jit_context_get_stat(optimized, JIT_STAT_CODE_BYTES) - bytes),
+		       (unsigned long) (jit_context_get_stat(optimized, JIT_STAT_PEEPHOLE_INSNS) - insns),
+		       (unsigned long) (jit_context_get_stat(optimized, JIT_STAT_PEEPHOLE_BYTES) - saved),
+		       ok ? "ok" : "WRONG");
+		if(!ok)
+		{
+			status = 1;
+		}
+	}
+
+	printf("%-12s %10lu %10lu %8lu %8lu\n", "total",
+	       (unsigned long) jit_context_get_stat(plain, JIT_STAT_CODE_BYTES),
+	       (unsigned long) jit_context_get_stat(optimized, JIT_STAT_CODE_BYTES),
+	       (unsigned long) jit_context_get_stat(optimized, JIT_STAT_PEEPHOLE_INSNS),
+	       (unsigned long) jit_context_get_stat(optimized, JIT_STAT_PEEPHOLE_BYTES));
+
+	jit_context_destroy(plain);
+	jit_context_destroy(optimized);
+	return status;
+}
@@ -0,0 +1,326 @@
+/*
+ * schedule.c - Effect of the instruction scheduling on run time.
+ *
+ * Copyright (C) 2026  Free Software Foundation, Inc.
+ *
+ * This file is part of the libjit library.
+ *
+ * The libjit library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * The libjit library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the libjit library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Usage: schedule [-O level] [-n count] [-r repeat]
+ *
+ * Compile a few array kernels twice, with and without the instruction
+ * scheduling, check that both versions compute the same results as the
+ * C code, and print the run time of each version in nanoseconds per
+ * array element.  The kernels are unrolled loops whose bodies load the
+ * elements and feed them to multiplications and divisions, so that the
+ * scheduler has independent work to put between the long latency
+ * instructions and the uses of their results.
+ */
+
+#include <jit/jit.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#define UNROLL		4
+
+typedef struct
+{
+	const char *name;
+	jit_value_t (*build)(jit_function_t func, jit_value_t a, jit_value_t b,
+			     jit_value_t i, jit_value_t sum);
+	jit_long (*compute)(const jit_int *a, const jit_int *b, int n);
+
+} kernel_entry;
+
+static double
+now(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static jit_value_t
+constant(jit_function_t func, jit_nint value)
+{
+	return jit_value_create_nint_constant(func, jit_type_nint, value);
+}
+
+static jit_value_t
+element(jit_function_t func, jit_value_t base, jit_value_t i, int offset)
+{
+	jit_value_t index = jit_insn_add(func, i, constant(func, offset));
+	return jit_insn_convert(func, jit_insn_load_elem(func, base, index, jit_type_int),
+				jit_type_long, 0);
+}
+
+/*
+ * Sum of the quotients of the elements.
+ */
+static jit_value_t
+build_quotients(jit_function_t func, jit_value_t a, jit_value_t b,
+		jit_value_t i, jit_value_t sum)
+{
+	int k;
+
+	for(k = 0; k < UNROLL; k++)
+	{
+		jit_value_t x = element(func, a, i, k);
+		jit_value_t y = element(func, b, i, k);
+		sum = jit_insn_add(func, sum, jit_insn_div(func, x, y));
+	}
+	return sum;
+}
+
+static jit_long
+compute_quotients(const jit_int *a, const jit_int *b, int n)
+{
+	jit_long sum = 0;
+	int i;
+
+	for(i = 0; i < n; i++)
+	{
+		sum += (jit_long) a[i] / (jit_long) b[i];
+	}
+	return sum;
+}
+
+/*
+ * Dot product with the products of neighbouring elements mixed in.
+ */
+static jit_value_t
+build_products(jit_function_t func, jit_value_t a, jit_value_t b,
+	       jit_value_t i, jit_value_t sum)
+{
+	int k;
+
+	for(k = 0; k < UNROLL; k++)
+	{
+		jit_value_t x = element(func, a, i, k);
+		jit_value_t y = element(func, b, i, k);
+		jit_value_t z = element(func, b, i, (k + 1) % UNROLL);
+		sum = jit_insn_add(func, sum,
+				   jit_insn_mul(func, jit_insn_mul(func, x, y), z));
+	}
+	return sum;
+}
+
+static jit_long
+compute_products(const jit_int *a, const jit_int *b, int n)
+{
+	jit_long sum = 0;
+	int i, k;
+
+	for(i = 0; i < n; i += UNROLL)
+	{
+		for(k = 0; k < UNROLL; k++)
+		{
+			sum += (jit_long) a[i + k] * b[i + k] * b[i + (k + 1) % UNROLL];
+		}
+	}
+	return sum;
+}
+
+/*
+ * Horner's rule over the elements with a remainder at every step.
+ */
+static jit_value_t
+build_remainders(jit_function_t func, jit_value_t a, jit_value_t b,
+		 jit_value_t i, jit_value_t sum)
+{
+	int k;
+
+	for(k = 0; k < UNROLL; k++)
+	{
+		jit_value_t x = element(func, a, i, k);
+		jit_value_t y = element(func, b, i, k);
+		sum = jit_insn_add(func, jit_insn_mul(func, sum, constant(func, 31)),
+				   jit_insn_rem(func, x, y));
+	}
+	return sum;
+}
+
+static jit_long
+compute_remainders(const jit_int *a, const jit_int *b, int n)
+{
+	jit_ulong sum = 0;
+	int i;
+
+	for(i = 0; i < n; i++)
+	{
+		sum = sum * 31 + (jit_ulong) ((jit_long) a[i] % (jit_long) b[i]);
+	}
+	return (jit_long) sum;
+}
+
+static kernel_entry kernels[] = {
+	{"quotients", build_quotients, compute_quotients},
+	{"products", build_products, compute_products},
+	{"remainders", build_remainders, compute_remainders},
+};
+#define NUM_KERNELS	(sizeof(kernels) / sizeof(kernels[0]))
+
+/*
+ * Build the kernel loop: for(i = 0; i < n; i += UNROLL) { body }.
+ */
+static jit_function_t
+build_kernel(jit_context_t context, kernel_entry *entry, int level, int schedule)
+{
+	jit_type_t params[3];
+	jit_type_t signature;
+	jit_function_t func;
+	jit_label_t loop = jit_label_undefined;
+	jit_label_t done = jit_label_undefined;
+	jit_value_t a, b, n, i, sum;
+
+	params[0] = jit_type_void_ptr;
+	params[1] = jit_type_void_ptr;
+	params[2] = jit_type_nint;
+	jit_context_build_start(context);
+	signature = jit_type_create_signature(jit_abi_cdecl, jit_type_long, params, 3, 1);
+	func = jit_function_create(context, signature);
+	jit_type_free(signature);
+	jit_function_set_optimization_level(func, level);
+	jit_function_set_scheduling(func, schedule);
+
+	a = jit_value_get_param(func, 0);
+	b = jit_value_get_param(func, 1);
+	n = jit_value_get_param(func, 2);
+	i = jit_value_create(func, jit_type_nint);
+	sum = jit_value_create(func, jit_type_long);
+	jit_insn_store(func, i, constant(func, 0));
+	jit_insn_store(func, sum, jit_value_create_long_constant(func, jit_type_long, 0));
+	jit_insn_branch_if_not(func, jit_insn_lt(func, i, n), &done);
+	jit_insn_label(func, &loop);
+	jit_insn_store(func, sum, entry->build(func, a, b, i, sum));
+	jit_insn_store(func, i, jit_insn_add(func, i, constant(func, UNROLL)));
+	jit_insn_branch_if(func, jit_insn_lt(func, i, n), &loop);
+	jit_insn_label(func, &done);
+	jit_insn_return(func, sum);
+
+	if(!jit_function_compile(func))
+	{
+		func = 0;
+	}
+	jit_context_build_end(context);
+	return func;
+}
+
+/*
+ * Run the kernel the given number of times and return the time per
+ * array element in nanoseconds or a negative value if the result is
+ * wrong.
+ */
+static double
+run_kernel(jit_function_t func, jit_int *a, jit_int *b, jit_nint n,
+	   int repeat, jit_long expected)
+{
+	void *args[3];
+	jit_long result;
+	double start;
+	int index;
+
+	if(!func)
+	{
+		return -1;
+	}
+	args[0] = &a;
+	args[1] = &b;
+	args[2] = &n;
+	start = now();
+	for(index = 0; index < repeat; index++)
+	{
+		jit_function_apply(func, args, &result);
+		if(result != expected)
+		{
+			return -1;
+		}
+	}
+	return (now() - start) * 1e9 / ((double) n * repeat);
+}
+
+int
+main(int argc, char *argv[])
+{
+	jit_context_t context;
+	jit_function_t plain, scheduled;
+	jit_int *a, *b;
+	jit_long expected;
+	double plain_time, scheduled_time;
+	int level, count, repeat, index, status;
+
+	jit_init();
+
+	level = jit_function_get_max_optimization_level();
+	count = 4096;
+	repeat = 2000;
+	for(index = 1; index < argc; index++)
+	{
+		if(!strcmp(argv[index], "-O") && index + 1 < argc)
+		{
+			level = atoi(argv[++index]);
+		}
+		else if(!strcmp(argv[index], "-n") && index + 1 < argc)
+		{
+			count = atoi(argv[++index]);
+		}
+		else if(!strcmp(argv[index], "-r") && index + 1 < argc)
+		{
+			repeat = atoi(argv[++index]);
+		}
+	}
+	count = (count + UNROLL - 1) / UNROLL * UNROLL;
+
+	a = (jit_int *) malloc(count * sizeof(jit_int));
+	b = (jit_int *) malloc(count * sizeof(jit_int));
+	if(!a || !b)
+	{
+		return 1;
+	}
+	for(index = 0; index < count; index++)
+	{
+		a[index] = (jit_int) (index * 2654435761u >> 4) - 100000;
+		b[index] = (index % 61) + 3;
+	}
+
+	context = jit_context_create();
+	printf("%-12s %10s %10s\n", "kernel", "plain", "scheduled");
+	status = 0;
+	for(index = 0; index < (int) NUM_KERNELS; index++)
+	{
+		expected = kernels[index].compute(a, b, count);
+		plain = build_kernel(context, &kernels[index], level, 0);
+		scheduled = build_kernel(context, &kernels[index], level, 1);
+		plain_time = run_kernel(plain, a, b, count, repeat, expected);
+		scheduled_time = run_kernel(scheduled, a, b, count, repeat, expected);
+		printf("%-12s %10.3f %10.3f  %s\n", kernels[index].name,
+		       plain_time, scheduled_time,
+		       (plain_time >= 0 && scheduled_time >= 0) ? "ok" : "WRONG");
+		if(plain_time < 0 || scheduled_time < 0)
+		{
+			status = 1;
+		}
+	}
+
+	jit_context_destroy(context);
+	free(a);
+	free(b);
+	return status;
+}
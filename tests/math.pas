@@ -276,6 +276,15 @@ begin
 	runi("math_i_mod_m9_3", -9 mod 3, 0, 0);
 	runi("math_i_mod_m9_m2", -9 mod (-2), -1, 0);
 	runi("math_i_mod_m9_m3", -9 mod (-3), 0, 0);
+	i1 := 1000;
+	runi("math_i_div_1000_7", i1 / 7, 142, 0);
+	runi("math_i_div_1000_m7", i1 / (-7), -142, 0);
+	runi("math_i_mod_1000_7", i1 mod 7, 6, 0);
+	i1 := -1000;
+	runi("math_i_div_m1000_7", i1 / 7, -142, 0);
+	runi("math_i_div_m1000_m7", i1 / (-7), 142, 0);
+	runi("math_i_mod_m1000_7", i1 mod 7, -6, 0);
+	runi("math_i_mod_m1000_m7", i1 mod (-7), -6, 0);
 	i1 := 6;
 	runi("math_i_abs_6", Abs(i1), 6, 0);
 	i1 := -6;
@@ -342,6 +351,12 @@ begin
 	runl("math_l_mod_m9_3", l1 mod 3, 0, 0);
 	runl("math_l_mod_m9_m2", l1 mod (-2), -1, 0);
 	runl("math_l_mod_m9_m3", l1 mod (-3), 0, 0);
+	l1 := 100000000000h;
+	runl("math_l_div_big_7", l1 / 7, 024924924924h, 0);
+	runl("math_l_mod_big_7", l1 mod 7, 4, 0);
+	l1 := -100000000000h;
+	runl("math_l_div_mbig_7", l1 / 7, -024924924924h, 0);
+	runl("math_l_mod_mbig_m7", l1 mod (-7), -4, 0);
 	l1 := 6;
 	runl("math_l_abs_6", Abs(l1), 6, 0);
 	l1 := -6;
@@ -21,8 +21,32 @@
  */
 
 #include <jit/jit.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <string.h>
 #include "unit-tests.h"
 
+/* Create a context for a test, which destroys it again when done.  */
+
+static jit_context_t test_context(void)
+{
+	jit_init ();
+	return jit_context_create ();
+}
+
+/* Create a function with the given result and parameter types in
+   "ctx".  The function keeps its own reference to the signature.  */
+
+static jit_function_t test_function(jit_context_t ctx, jit_type_t result,
+				    jit_type_t *params, unsigned int num_params)
+{
+	jit_type_t sig = jit_type_create_signature (jit_abi_cdecl, result,
+						    params, num_params, 1);
+	jit_function_t func = jit_function_create (ctx, sig);
+	jit_type_free (sig);
+	return func;
+}
+
 /* Make a block like
 
    x = INCOMING
@@ -38,18 +62,14 @@
 
 static void test_block_removal(void)
 {
-	jit_init();
-	jit_context_t ctx = jit_context_create ();
+	jit_context_t ctx = test_context ();
 
 	jit_type_t params[1] = { jit_type_sys_int };
-	jit_type_t sig = jit_type_create_signature (jit_abi_cdecl,
-						    jit_type_sys_int,
-						    params, 1, 1);
 
 	jit_label_t l0 = jit_label_undefined;
 	jit_label_t l1 = jit_label_undefined;
 
-	jit_function_t func = jit_function_create (ctx, sig);
+	jit_function_t func = test_function (ctx, jit_type_sys_int, params, 1);
 	jit_value_t incoming = jit_value_get_param (func, 0);
 
 	jit_value_t x = jit_value_create (func, jit_type_int);
@@ -96,11 +116,2155 @@ static void test_block_removal(void)
 	arg = 72;
 	CHECK (jit_function_apply (func, args, &result));
 	CHECK (result == 23);
+
+	jit_context_destroy (ctx);
+}
+
+/* Make a function like
+
+   x = INCOMING
+   if x != 0 then goto .L0
+   x = 100			(marked as cold)
+   .L0:
+   return x + 1
+
+   Then, check that the optimizer moves the cold block to the end
+   of the function, inverting the condition.  */
+
+static void test_cold_layout(void)
+{
+	jit_context_t ctx = test_context ();
+
+	jit_type_t params[1] = { jit_type_sys_int };
+
+	jit_label_t l0 = jit_label_undefined;
+
+	jit_function_t func = test_function (ctx, jit_type_sys_int, params, 1);
+	jit_value_t incoming = jit_value_get_param (func, 0);
+
+	jit_value_t x = jit_value_create (func, jit_type_int);
+	jit_insn_store (func, x, incoming);
+
+	jit_value_t zero = jit_value_create_nint_constant (func,
+							   jit_type_sys_int,
+							   0);
+	jit_value_t compare = jit_insn_ne (func, x, zero);
+	jit_block_t saved_block = jit_function_get_current (func);
+	jit_insn_branch_if (func, compare, &l0);
+
+	jit_block_t cold_block = jit_function_get_current (func);
+	jit_block_set_cold (cold_block, 1);
+	jit_value_t hundred
+	  = jit_value_create_nint_constant (func, jit_type_sys_int, 100);
+	jit_insn_store (func, x, hundred);
+
+	jit_insn_label (func, &l0);
+	jit_value_t one
+	  = jit_value_create_nint_constant (func, jit_type_sys_int, 1);
+	jit_insn_return (func, jit_insn_add (func, x, one));
+
+	unsigned max = jit_function_get_max_optimization_level ();
+	jit_function_set_optimization_level (func, max);
+	CHECK (jit_optimize (func) == JIT_RESULT_OK);
+
+	/* The cold block is the last one but the empty exit block.  */
+	CHECK (jit_block_is_cold (cold_block));
+	CHECK (jit_block_next (func, cold_block)
+	       == jit_block_previous (func, NULL));
+	CHECK (jit_block_next (func, saved_block) != cold_block);
+
+	/* The branch over the cold block now goes to it.  */
+	jit_insn_iter_t iter;
+	jit_insn_iter_init_last (&iter, saved_block);
+	jit_insn_t insn = jit_insn_iter_previous (&iter);
+	CHECK (insn != NULL);
+	CHECK (jit_insn_get_opcode (insn) == JIT_OP_BR_IEQ);
+
+	/* Test that the result is still correct.  */
+	CHECK (jit_function_compile (func));
+	int result = -1;
+	int arg = 0;
+	void *args[] = { &arg };
+	CHECK (jit_function_apply (func, args, &result));
+	CHECK (result == 101);
+
+	arg = 72;
+	CHECK (jit_function_apply (func, args, &result));
+	CHECK (result == 73);
+
+	/* The same with a branch on a long truth value.  */
+	jit_type_t lparams[1] = { jit_type_long };
+	jit_label_t l1 = jit_label_undefined;
+	jit_function_t lfunc = test_function (ctx, jit_type_long, lparams, 1);
+	jit_value_t lx = jit_value_create (lfunc, jit_type_long);
+	jit_insn_store (lfunc, lx, jit_value_get_param (lfunc, 0));
+	jit_insn_branch_if (lfunc, lx, &l1);
+	jit_block_set_cold (jit_function_get_current (lfunc), 1);
+	jit_insn_store (lfunc, lx,
+			jit_value_create_long_constant (lfunc, jit_type_long, 100));
+	jit_insn_label (lfunc, &l1);
+	jit_insn_return (lfunc, jit_insn_add (lfunc, lx,
+		jit_value_create_long_constant (lfunc, jit_type_long, 1)));
+	jit_function_set_optimization_level (lfunc, max);
+	CHECK (jit_function_compile (lfunc));
+	jit_long lresult = -1;
+	jit_long larg = 0;
+	void *largs[] = { &larg };
+	CHECK (jit_function_apply (lfunc, largs, &lresult));
+	CHECK (lresult == 101);
+	larg = 72;
+	CHECK (jit_function_apply (lfunc, largs, &lresult));
+	CHECK (lresult == 73);
+
+	jit_context_destroy (ctx);
+}
+
+/* Make a function like
+
+   sum = 0
+   i = 0
+   .L0:
+   if i >= INCOMING then goto .L1
+   sum = sum + INCOMING * INCOMING + i * 12 + INCOMING
+   i = i + 1
+   goto .L0
+   .L1:
+   return sum
+
+   Then, check that the optimizer moves the loop invariant product out
+   of the loop and replaces the multiplication of the loop counter with
+   an addition.  */
+
+static void test_loop_optimization(void)
+{
+	jit_context_t ctx = test_context ();
+
+	jit_type_t params[1] = { jit_type_sys_int };
+
+	jit_label_t l0 = jit_label_undefined;
+	jit_label_t l1 = jit_label_undefined;
+
+	jit_function_t func = test_function (ctx, jit_type_sys_int, params, 1);
+	jit_value_t incoming = jit_value_get_param (func, 0);
+
+	jit_value_t zero = jit_value_create_nint_constant (func,
+							   jit_type_sys_int,
+							   0);
+	jit_value_t one
+	  = jit_value_create_nint_constant (func, jit_type_sys_int, 1);
+	jit_value_t twelve
+	  = jit_value_create_nint_constant (func, jit_type_sys_int, 12);
+
+	jit_value_t sum = jit_value_create (func, jit_type_int);
+	jit_value_t i = jit_value_create (func, jit_type_int);
+	jit_insn_store (func, sum, zero);
+	jit_insn_store (func, i, zero);
+
+	jit_insn_label (func, &l0);
+	jit_insn_branch_if (func, jit_insn_ge (func, i, incoming), &l1);
+
+	jit_block_t body_block = jit_function_get_current (func);
+	jit_value_t square = jit_insn_mul (func, incoming, incoming);
+	jit_value_t scaled = jit_insn_add (func, jit_insn_mul (func, i, twelve),
+					   incoming);
+	jit_insn_store (func, sum, jit_insn_add (func, sum, square));
+	jit_insn_store (func, sum, jit_insn_add (func, sum, scaled));
+	jit_insn_store (func, i, jit_insn_add (func, i, one));
+	jit_insn_branch (func, &l0);
+
+	jit_insn_label (func, &l1);
+	jit_insn_return (func, sum);
+
+	unsigned max = jit_function_get_max_optimization_level ();
+	jit_function_set_optimization_level (func, max);
+	CHECK (jit_optimize (func) == JIT_RESULT_OK);
+
+	/* There are no multiplications left in the loop body.  */
+	jit_insn_iter_t iter;
+	jit_insn_t insn;
+	jit_insn_iter_init (&iter, body_block);
+	while ((insn = jit_insn_iter_next (&iter)) != NULL)
+	  CHECK (jit_insn_get_opcode (insn) != JIT_OP_IMUL);
+
+	/* Test that the result is still correct.  */
+	CHECK (jit_function_compile (func));
+	int result = -1;
+	int arg = 0;
+	void *args[] = { &arg };
+	CHECK (jit_function_apply (func, args, &result));
+	CHECK (result == 0);
+
+	arg = 10;
+	CHECK (jit_function_apply (func, args, &result));
+	CHECK (result == 10 * (100 + 10) + 12 * 45);
+
+	jit_context_destroy (ctx);
+}
+
+/* Make functions like
+
+   sum = 0
+   for (k = 0; k < 5; k++) { sum += (long) i * 8; i++; }
+   return sum
+
+   and the same with "i < n" in place of "k < 5".  The first one must
+   not reduce the widened multiplication, as i may wrap around, and the
+   second one can.  */
+
+static jit_function_t widened_function (jit_context_t ctx, int bounded,
+					jit_block_t *body_block)
+{
+	jit_type_t params[2] = { jit_type_int, jit_type_int };
+
+	jit_label_t l0 = jit_label_undefined;
+	jit_label_t l1 = jit_label_undefined;
+
+	jit_function_t func = test_function (ctx, jit_type_long, params, 2);
+
+	jit_value_t zero = jit_value_create_nint_constant (func, jit_type_int, 0);
+	jit_value_t one = jit_value_create_nint_constant (func, jit_type_int, 1);
+	jit_value_t five = jit_value_create_nint_constant (func, jit_type_int, 5);
+	jit_value_t eight
+	  = jit_value_create_long_constant (func, jit_type_long, 8);
+
+	jit_value_t sum = jit_value_create (func, jit_type_long);
+	jit_value_t i = jit_value_create (func, jit_type_int);
+	jit_value_t k = jit_value_create (func, jit_type_int);
+	jit_insn_store (func, sum,
+			jit_value_create_long_constant (func, jit_type_long, 0));
+	jit_insn_store (func, i, jit_value_get_param (func, 0));
+	jit_insn_store (func, k, zero);
+
+	jit_insn_label (func, &l0);
+	if (bounded)
+	  jit_insn_branch_if (func, jit_insn_ge (func, i,
+						 jit_value_get_param (func, 1)),
+			      &l1);
+	else
+	  jit_insn_branch_if (func, jit_insn_ge (func, k, five), &l1);
+
+	*body_block = jit_function_get_current (func);
+	jit_value_t wide = jit_insn_convert (func, i, jit_type_long, 0);
+	jit_insn_store (func, sum, jit_insn_add (func, sum,
+						 jit_insn_mul (func, wide, eight)));
+	jit_insn_store (func, i, jit_insn_add (func, i, one));
+	jit_insn_store (func, k, jit_insn_add (func, k, one));
+	jit_insn_branch (func, &l0);
+
+	jit_insn_label (func, &l1);
+	jit_insn_return (func, sum);
+
+	unsigned max = jit_function_get_max_optimization_level ();
+	jit_function_set_optimization_level (func, max);
+	CHECK (jit_optimize (func) == JIT_RESULT_OK);
+	CHECK (jit_function_compile (func));
+	return func;
+}
+
+static int has_opcode (jit_block_t block, int opcode)
+{
+	jit_insn_iter_t iter;
+	jit_insn_t insn;
+	jit_insn_iter_init (&iter, block);
+	while ((insn = jit_insn_iter_next (&iter)) != NULL)
+	  if (jit_insn_get_opcode (insn) == opcode)
+	    return 1;
+	return 0;
+}
+
+static void test_widened_induction(void)
+{
+	jit_context_t ctx = test_context ();
+
+	jit_block_t body_block;
+	jit_function_t func = widened_function (ctx, 0, &body_block);
+	CHECK (has_opcode (body_block, JIT_OP_LMUL));
+
+	jit_int start = 0x7ffffffd;
+	jit_int limit = 0;
+	void *args[] = { &start, &limit };
+	jit_long result = -1;
+	CHECK (jit_function_apply (func, args, &result));
+	/* i wraps around to INT_MIN after 3 steps */
+	CHECK (result == (jit_long) 17179869144LL);
+
+	func = widened_function (ctx, 1, &body_block);
+	CHECK (!has_opcode (body_block, JIT_OP_LMUL));
+
+	start = 0x7ffffffb;
+	limit = 0x7fffffff;
+	CHECK (jit_function_apply (func, args, &result));
+	CHECK (result == 8 * ((jit_long) 0x7ffffffb * 4 + 6));
+
+	jit_context_destroy (ctx);
+}
+
+static void test_bounds_elimination(void)
+{
+	jit_context_t ctx = test_context ();
+
+	jit_type_t params[2] = { jit_type_void_ptr, jit_type_sys_int };
+
+	jit_label_t l0 = jit_label_undefined;
+	jit_label_t l1 = jit_label_undefined;
+
+	jit_function_t func = test_function (ctx, jit_type_sys_int, params, 2);
+	jit_value_t array = jit_value_get_param (func, 0);
+	jit_value_t length = jit_value_get_param (func, 1);
+
+	jit_value_t zero = jit_value_create_nint_constant (func,
+							   jit_type_sys_int,
+							   0);
+	jit_value_t one
+	  = jit_value_create_nint_constant (func, jit_type_sys_int, 1);
+
+	jit_value_t sum = jit_value_create (func, jit_type_int);
+	jit_value_t i = jit_value_create (func, jit_type_int);
+	jit_insn_store (func, sum, zero);
+	jit_insn_store (func, i, zero);
+
+	/* for (i = 0; i < length; i++) sum += array[i] * array[i];  */
+	jit_insn_label (func, &l0);
+	jit_insn_branch_if (func, jit_insn_ge (func, i, length), &l1);
+
+	CHECK (jit_insn_check_bounds (func, i, length));
+	jit_value_t elem = jit_insn_load_elem (func, array, i, jit_type_int);
+	CHECK (jit_insn_check_bounds (func, i, length));
+	jit_value_t again = jit_insn_load_elem (func, array, i, jit_type_int);
+	jit_insn_store (func, sum,
+			jit_insn_add (func, sum, jit_insn_mul (func, elem, again)));
+	jit_insn_store (func, i, jit_insn_add (func, i, one));
+	jit_insn_branch (func, &l0);
+
+	jit_insn_label (func, &l1);
+	jit_insn_return (func, sum);
+
+	unsigned max = jit_function_get_max_optimization_level ();
+	jit_function_set_optimization_level (func, max);
+	CHECK (jit_optimize (func) == JIT_RESULT_OK);
+
+	/* The loop condition keeps the index within the bounds.  */
+	jit_block_t block = NULL;
+	while ((block = jit_block_next (func, block)) != NULL)
+	  {
+	    jit_insn_iter_t iter;
+	    jit_insn_t insn;
+	    jit_insn_iter_init (&iter, block);
+	    while ((insn = jit_insn_iter_next (&iter)) != NULL)
+	      CHECK (jit_insn_get_opcode (insn) != JIT_OP_CHECK_BOUNDS);
+	  }
+
+	/* Test that the result is still correct.  */
+	CHECK (jit_function_compile (func));
+	int values[] = { 1, 2, 3, 4, 5 };
+	void *ptr = values;
+	int result = -1;
+	int arg = 0;
+	void *args[] = { &ptr, &arg };
+	CHECK (jit_function_apply (func, args, &result));
+	CHECK (result == 0);
+
+	arg = 5;
+	CHECK (jit_function_apply (func, args, &result));
+	CHECK (result == 1 + 4 + 9 + 16 + 25);
+
+	jit_context_destroy (ctx);
+}
+
+static void test_alias_optimization(void)
+{
+	jit_context_t ctx = test_context ();
+
+	jit_type_t params[1] = { jit_type_void_ptr };
+
+	jit_function_t func = test_function (ctx, jit_type_sys_int, params, 1);
+	jit_value_t ptr = jit_value_get_param (func, 0);
+
+	jit_value_t five
+	  = jit_value_create_nint_constant (func, jit_type_sys_int, 5);
+	jit_value_t one
+	  = jit_value_create_nint_constant (func, jit_type_sys_int, 1);
+	jit_value_t two
+	  = jit_value_create_nint_constant (func, jit_type_sys_int, 2);
+
+	/* ptr[0] = 5; x = ptr[0]; ptr[1] = x + 1; ptr[1] = x + 2;
+	   return ptr[1] + x;  */
+	jit_insn_store_relative (func, ptr, 0, five);
+	jit_value_t x = jit_insn_load_relative (func, ptr, 0, jit_type_int);
+	jit_insn_store_relative (func, ptr, 4, jit_insn_add (func, x, one));
+	jit_insn_store_relative (func, ptr, 4, jit_insn_add (func, x, two));
+	jit_value_t y = jit_insn_load_relative (func, ptr, 4, jit_type_int);
+	jit_insn_return (func, jit_insn_add (func, y, x));
+
+	unsigned max = jit_function_get_max_optimization_level ();
+	jit_function_set_optimization_level (func, max);
+	CHECK (jit_optimize (func) == JIT_RESULT_OK);
+
+	/* Both loads are forwarded and the first store to ptr[1] is dead.  */
+	int loads = 0;
+	int stores = 0;
+	jit_block_t block = NULL;
+	while ((block = jit_block_next (func, block)) != NULL)
+	  {
+	    jit_insn_iter_t iter;
+	    jit_insn_t insn;
+	    jit_insn_iter_init (&iter, block);
+	    while ((insn = jit_insn_iter_next (&iter)) != NULL)
+	      {
+		if (jit_insn_get_opcode (insn) == JIT_OP_LOAD_RELATIVE_INT)
+		  loads++;
+		if (jit_insn_get_opcode (insn) == JIT_OP_STORE_RELATIVE_INT)
+		  stores++;
+	      }
+	  }
+	CHECK (loads == 0);
+	CHECK (stores == 2);
+
+	/* Test that the result is still correct.  */
+	CHECK (jit_function_compile (func));
+	int values[2] = { 0, 0 };
+	void *arg = values;
+	void *args[] = { &arg };
+	int result = -1;
+	CHECK (jit_function_apply (func, args, &result));
+	CHECK (result == 7 + 5);
+	CHECK (values[0] == 5 && values[1] == 7);
+
+	jit_context_destroy (ctx);
+}
+
+static void test_scalar_replacement(void)
+{
+	jit_context_t ctx = test_context ();
+
+	jit_type_t fields[2] = { jit_type_int, jit_type_int };
+	jit_type_t pair = jit_type_create_struct (fields, 2, 1);
+	jit_nint a = jit_type_get_offset (pair, 0);
+	jit_nint b = jit_type_get_offset (pair, 1);
+
+	jit_type_t params[1] = { jit_type_sys_int };
+
+	jit_function_t func = test_function (ctx, jit_type_sys_int, params, 1);
+	jit_value_t x = jit_value_get_param (func, 0);
+	jit_value_t s = jit_value_create (func, pair);
+
+	jit_value_t zero
+	  = jit_value_create_nint_constant (func, jit_type_sys_int, 0);
+	jit_value_t one
+	  = jit_value_create_nint_constant (func, jit_type_sys_int, 1);
+	jit_value_t ten
+	  = jit_value_create_nint_constant (func, jit_type_sys_int, 10);
+
+	/* s.a = x; s.b = x + 1; if x < 0 then goto .L0; s.a = s.b + 10;
+	   .L0: return s.a + s.b;  */
+	jit_label_t label = jit_label_undefined;
+	jit_value_t p = jit_insn_address_of (func, s);
+	jit_insn_store_relative (func, p, a, x);
+	jit_insn_store_relative (func, p, b, jit_insn_add (func, x, one));
+	jit_insn_branch_if (func, jit_insn_lt (func, x, zero), &label);
+	p = jit_insn_address_of (func, s);
+	jit_value_t y = jit_insn_load_relative (func, p, b, jit_type_int);
+	jit_insn_store_relative (func, p, a, jit_insn_add (func, y, ten));
+	jit_insn_label (func, &label);
+	p = jit_insn_address_of (func, s);
+	jit_insn_return (func, jit_insn_add (func,
+		jit_insn_load_relative (func, p, a, jit_type_int),
+		jit_insn_load_relative (func, p, b, jit_type_int)));
+
+	unsigned max = jit_function_get_max_optimization_level ();
+	jit_function_set_optimization_level (func, max);
+	CHECK (jit_optimize (func) == JIT_RESULT_OK);
+
+	/* The fields live in scalar variables, not in the memory.  */
+	int memory = 0;
+	jit_block_t block = NULL;
+	while ((block = jit_block_next (func, block)) != NULL)
+	  {
+	    jit_insn_iter_t iter;
+	    jit_insn_t insn;
+	    jit_insn_iter_init (&iter, block);
+	    while ((insn = jit_insn_iter_next (&iter)) != NULL)
+	      {
+		int opcode = jit_insn_get_opcode (insn);
+		if (opcode == JIT_OP_ADDRESS_OF
+		    || opcode == JIT_OP_LOAD_RELATIVE_INT
+		    || opcode == JIT_OP_STORE_RELATIVE_INT)
+		  memory++;
+	      }
+	  }
+	CHECK (memory == 0);
+
+	/* Test that the result is still correct.  */
+	CHECK (jit_function_compile (func));
+	int arg = 5;
+	void *args[] = { &arg };
+	int result = -1;
+	CHECK (jit_function_apply (func, args, &result));
+	CHECK (result == 16 + 6);
+
+	arg = -3;
+	CHECK (jit_function_apply (func, args, &result));
+	CHECK (result == -3 + -2);
+
+	jit_type_free (pair);
+	jit_context_destroy (ctx);
+}
+
+static void test_address_selection(void)
+{
+	jit_context_t ctx = test_context ();
+
+	jit_type_t params[2] = { jit_type_void_ptr, jit_type_nint };
+
+	jit_function_t func = test_function (ctx, jit_type_sys_int, params, 2);
+	jit_value_t p = jit_value_get_param (func, 0);
+	jit_value_t i = jit_value_get_param (func, 1);
+
+	jit_value_t one
+	  = jit_value_create_nint_constant (func, jit_type_sys_int, 1);
+	jit_value_t four
+	  = jit_value_create_nint_constant (func, jit_type_nint, 4);
+	jit_value_t eight
+	  = jit_value_create_nint_constant (func, jit_type_nint, 8);
+
+	/* x = *(int *) (p + i * 4); *(int *) (p + 8) = x + 1; return x;  */
+	jit_value_t q = jit_insn_add (func, p, jit_insn_mul (func, i, four));
+	jit_value_t x = jit_insn_load_relative (func, q, 0, jit_type_int);
+	q = jit_insn_add (func, p, eight);
+	jit_insn_store_relative (func, q, 0, jit_insn_add (func, x, one));
+	jit_insn_return (func, x);
+
+	unsigned max = jit_function_get_max_optimization_level ();
+	jit_function_set_optimization_level (func, max);
+	CHECK (jit_optimize (func) == JIT_RESULT_OK);
+
+	/* The load indexes the array and the store has the constant in
+	   its offset.  */
+	int elements = 0;
+	int offset = -1;
+	jit_block_t block = NULL;
+	while ((block = jit_block_next (func, block)) != NULL)
+	  {
+	    jit_insn_iter_t iter;
+	    jit_insn_t insn;
+	    jit_insn_iter_init (&iter, block);
+	    while ((insn = jit_insn_iter_next (&iter)) != NULL)
+	      {
+		int opcode = jit_insn_get_opcode (insn);
+		if (opcode == JIT_OP_LOAD_ELEMENT_INT)
+		  elements++;
+		else if (opcode == JIT_OP_STORE_RELATIVE_INT)
+		  offset = jit_value_get_nint_constant (jit_insn_get_value2 (insn));
+	      }
+	  }
+	CHECK (elements == 1);
+	CHECK (offset == 8);
+
+	/* Test that the result is still correct.  */
+	CHECK (jit_function_compile (func));
+	int array[4] = { 3, 5, 7, 9 };
+	void *ptr = array;
+	jit_nint index = 3;
+	void *args[] = { &ptr, &index };
+	int result = -1;
+	CHECK (jit_function_apply (func, args, &result));
+	CHECK (result == 9);
+	CHECK (array[2] == 10);
+
+	jit_context_destroy (ctx);
+}
+
+/* Make a long chain of v[c] = v[a] + v[b] over many int or long
+   variables, with a jump to the next instruction after each add, and
+   check the result against the same computation in C.  This keeps
+   most of the variables live in registers across the blocks.  */
+
+#define CHAIN_VARS	64
+#define CHAIN_LENGTH	2000
+
+static unsigned int chain_seed;
+
+static int chain_random (int limit)
+{
+	chain_seed = chain_seed * 1103515245 + 12345;
+	return (int) ((chain_seed >> 16) % limit);
+}
+
+static void test_add_chain(void)
+{
+	jit_context_t ctx = test_context ();
+
+	jit_type_t types[2] = { jit_type_int, jit_type_long };
+	for (int t = 0; t < 2; t++)
+	  for (unsigned int seed = 1; seed <= 6; seed++)
+	    {
+		jit_type_t params[1] = { types[t] };
+		jit_function_t func = test_function (ctx, types[t], params, 1);
+
+		jit_value_t vars[CHAIN_VARS];
+		jit_ulong vals[CHAIN_VARS];
+		jit_long arg = 7;
+		for (int i = 0; i < CHAIN_VARS; i++)
+		  {
+			jit_value_t n = jit_value_create_nint_constant
+				(func, types[t], i + 1);
+			vars[i] = jit_value_create (func, types[t]);
+			jit_insn_store (func, vars[i],
+					jit_insn_mul (func,
+						jit_value_get_param (func, 0), n));
+			vals[i] = arg * (i + 1);
+		  }
+
+		chain_seed = seed;
+		for (int i = 0; i < CHAIN_LENGTH; i++)
+		  {
+			jit_label_t label = jit_label_undefined;
+			int a = chain_random (CHAIN_VARS);
+			int b = chain_random (CHAIN_VARS);
+			int c = chain_random (CHAIN_VARS);
+			jit_insn_store (func, vars[c],
+					jit_insn_add (func, vars[a], vars[b]));
+			jit_insn_branch (func, &label);
+			jit_insn_label (func, &label);
+			vals[c] = vals[a] + vals[b];
+		  }
+
+		jit_value_t sum = vars[0];
+		jit_ulong expected = vals[0];
+		for (int i = 1; i < CHAIN_VARS; i++)
+		  {
+			sum = jit_insn_add (func, sum, vars[i]);
+			expected += vals[i];
+		  }
+		jit_insn_return (func, sum);
+
+		unsigned max = jit_function_get_max_optimization_level ();
+		jit_function_set_optimization_level (func, max);
+		CHECK (jit_function_compile (func));
+
+		if (t == 0)
+		  {
+			jit_int iarg = arg;
+			jit_int result = 0;
+			void *args[] = { &iarg };
+			CHECK (jit_function_apply (func, args, &result));
+			CHECK ((jit_uint) result == (jit_uint) expected);
+		  }
+		else
+		  {
+			jit_long result = 0;
+			void *args[] = { &arg };
+			CHECK (jit_function_apply (func, args, &result));
+			CHECK ((jit_ulong) result == expected);
+		  }
+	    }
+
+	jit_context_destroy (ctx);
+}
+
+/* Make functions like
+
+	a = x; if (a) {} b = a; c = a + b; d = a + c; if (a) {}
+	return d * 1000 + b + f;
+
+	a = x; if (a) {} b = a; a = b + a; d = a + b; if (a) {}
+	return d * 1000 + a + f;
+
+   The copy leaves "a" and "b" in the same register, so an add that
+   overwrites it or replaces "a" must not keep "a" there.  The sum "f"
+   of a few more often used variables keeps "a" and "b" out of the
+   global registers.  */
+
+#define SHARED_FILLERS	6
+
+static void test_shared_register(void)
+{
+	jit_context_t ctx = test_context ();
+
+	for (int replace = 0; replace < 2; replace++)
+	  {
+		jit_type_t params[1] = { jit_type_long };
+		jit_function_t func = test_function (ctx, jit_type_long,
+						     params, 1);
+
+		jit_value_t x = jit_value_get_param (func, 0);
+		jit_value_t fillers[SHARED_FILLERS];
+		for (int i = 0; i < SHARED_FILLERS; i++)
+		  {
+			fillers[i] = jit_value_create (func, jit_type_long);
+			jit_insn_store (func, fillers[i], x);
+			for (int j = 0; j < 8; j++)
+				jit_insn_store (func, fillers[i],
+						jit_insn_add (func, fillers[i],
+							      fillers[i]));
+		  }
+
+		jit_value_t a = jit_value_create (func, jit_type_long);
+		jit_value_t b = jit_value_create (func, jit_type_long);
+		jit_label_t label1 = jit_label_undefined;
+		jit_label_t label2 = jit_label_undefined;
+		jit_insn_store (func, a, x);
+		jit_insn_branch_if_not (func, a, &label1);
+		jit_insn_label (func, &label1);
+		jit_insn_store (func, b, a);
+		jit_value_t d, last;
+		if (replace)
+		  {
+			jit_insn_store (func, a, jit_insn_add (func, b, a));
+			d = jit_insn_add (func, a, b);
+			last = a;
+		  }
+		else
+		  {
+			jit_value_t c = jit_insn_add (func, a, b);
+			d = jit_insn_add (func, a, c);
+			last = b;
+		  }
+		jit_insn_branch_if_not (func, a, &label2);
+		jit_insn_label (func, &label2);
+
+		jit_value_t k = jit_value_create_long_constant
+			(func, jit_type_long, 1000);
+		jit_value_t sum = jit_insn_add (func, jit_insn_mul (func, d, k),
+						last);
+		for (int i = 0; i < SHARED_FILLERS; i++)
+			sum = jit_insn_add (func, sum, fillers[i]);
+		jit_insn_return (func, sum);
+
+		jit_function_set_optimization_level (func, 0);
+		CHECK (jit_function_compile (func));
+
+		jit_long arg = 32;
+		jit_long result = 0;
+		void *args[] = { &arg };
+		CHECK (jit_function_apply (func, args, &result));
+		jit_long expected = (replace ? 96064 : 96032)
+			+ SHARED_FILLERS * 32 * 256;
+		CHECK (result == expected);
+	  }
+
+	jit_context_destroy (ctx);
+}
+
+static void test_instruction_scheduling(void)
+{
+	jit_context_t ctx = test_context ();
+
+	jit_type_t params[2] = { jit_type_void_ptr, jit_type_sys_int };
+
+	jit_function_t func = test_function (ctx, jit_type_sys_int, params, 2);
+	jit_value_t p = jit_value_get_param (func, 0);
+	jit_value_t x = jit_value_get_param (func, 1);
+
+	CHECK (!jit_function_get_scheduling (func));
+	jit_function_set_scheduling (func, 1);
+	CHECK (jit_function_get_scheduling (func));
+
+	/* y = p[0] / x; p[1] = y + p[2]; return y * p[1] - p[3];  */
+	jit_value_t y = jit_insn_div (func,
+		jit_insn_load_relative (func, p, 0, jit_type_int), x);
+	jit_insn_store_relative (func, p, 4, jit_insn_add (func, y,
+		jit_insn_load_relative (func, p, 8, jit_type_int)));
+	jit_insn_return (func, jit_insn_sub (func,
+		jit_insn_mul (func, y,
+			      jit_insn_load_relative (func, p, 4, jit_type_int)),
+		jit_insn_load_relative (func, p, 12, jit_type_int)));
+
+	unsigned max = jit_function_get_max_optimization_level ();
+	jit_function_set_optimization_level (func, max);
+	CHECK (jit_function_compile (func));
+
+	/* Test that the reordered code computes the same result.  */
+	int array[4] = { 100, 0, 7, 9 };
+	void *ptr = array;
+	int arg = 3;
+	void *args[] = { &ptr, &arg };
+	int result = -1;
+	CHECK (jit_function_apply (func, args, &result));
+	CHECK (array[1] == 33 + 7);
+	CHECK (result == 33 * 40 - 9);
+
+	jit_context_destroy (ctx);
+}
+
+/* Build a switch with a dense run of cases, a run of cases that go to
+   two labels and a few scattered cases.  Check that the dense run uses
+   a jump table and that every value reaches the right label.  */
+
+static const jit_long switch_values[] =
+  { 3, 0, 1, 2, 5, 6, 40, 44, 53, 60, -1000, 1000000, 2 };
+static const int switch_targets[] =
+  { 3, 0, 1, 2, 4, 5, 6, 7, 6, 7, 8, 9, 0 };
+
+static int switch_reference(int x)
+{
+	unsigned index;
+	for (index = 0; index < 12; index++)
+	  if (switch_values[index] == x)
+	    return 100 + switch_targets[index];
+	return -1;
+}
+
+static void test_switch_lowering(void)
+{
+	jit_context_t ctx = test_context ();
+
+	jit_type_t params[1] = { jit_type_sys_int };
+
+	jit_function_t func = test_function (ctx, jit_type_sys_int, params, 1);
+	jit_value_t x = jit_value_get_param (func, 0);
+
+	jit_label_t targets[10];
+	jit_label_t labels[13];
+	unsigned index;
+	for (index = 0; index < 10; index++)
+	  targets[index] = jit_function_reserve_label (func);
+	for (index = 0; index < 13; index++)
+	  labels[index] = targets[switch_targets[index]];
+
+	CHECK (jit_insn_switch (func, x, switch_values, labels, 13));
+	jit_insn_return (func,
+		jit_value_create_nint_constant (func, jit_type_sys_int, -1));
+	for (index = 0; index < 10; index++)
+	  {
+	    jit_insn_label (func, &targets[index]);
+	    jit_insn_return (func,
+		jit_value_create_nint_constant (func, jit_type_sys_int,
+						100 + index));
+	  }
+
+	int tables = 0;
+	jit_block_t block = NULL;
+	while ((block = jit_block_next (func, block)) != NULL)
+	  {
+	    jit_insn_iter_t iter;
+	    jit_insn_t insn;
+	    jit_insn_iter_init (&iter, block);
+	    while ((insn = jit_insn_iter_next (&iter)) != NULL)
+	      if (jit_insn_get_opcode (insn) == JIT_OP_JUMP_TABLE)
+		tables++;
+	  }
+	CHECK (tables == 1);
+
+	CHECK (jit_function_compile (func));
+	int arg;
+	for (arg = -1002; arg <= 1000002; arg++)
+	  {
+	    if (arg == 100)
+	      arg = 999998;
+	    void *args[] = { &arg };
+	    int result = 0;
+	    CHECK (jit_function_apply (func, args, &result));
+	    CHECK (result == switch_reference (arg));
+	  }
+
+	jit_context_destroy (ctx);
+}
+
+/* Build two functions with different signatures that tail call each
+   other with the arguments in swapped order:
+
+   even(int n, int acc) : int = n == 0 ? acc : odd(acc ^ n, n - 1)
+   odd(int acc, long n) : int = n == 0 ? -acc : even(n - 1, acc + 1)
+
+   Check that they run a long chain of calls in constant stack space and
+   that a tail call to a function that returns another type fails.  */
+
+static void test_tail_calls(void)
+{
+	jit_context_t ctx = test_context ();
+
+	jit_type_t even_params[2] = { jit_type_int, jit_type_int };
+	jit_type_t odd_params[2] = { jit_type_int, jit_type_long };
+
+	jit_function_t even = test_function (ctx, jit_type_int, even_params, 2);
+	jit_function_t odd = test_function (ctx, jit_type_int, odd_params, 2);
+	jit_function_t other = test_function (ctx, jit_type_long, odd_params, 2);
+
+	jit_value_t n = jit_value_get_param (even, 0);
+	jit_value_t acc = jit_value_get_param (even, 1);
+	jit_label_t label = jit_label_undefined;
+	jit_insn_branch_if (even, jit_insn_to_bool (even, n), &label);
+	jit_insn_return (even, acc);
+	jit_insn_label (even, &label);
+	jit_value_t even_args[2] = {
+		jit_insn_xor (even, acc, n),
+		jit_insn_sub (even, n,
+			jit_value_create_nint_constant (even, jit_type_int, 1))
+	};
+	CHECK (jit_insn_call (even, "odd", odd, 0, even_args, 2, JIT_CALL_TAIL));
+
+	acc = jit_value_get_param (odd, 0);
+	n = jit_value_get_param (odd, 1);
+	label = jit_label_undefined;
+	jit_insn_branch_if (odd, jit_insn_to_bool (odd, n), &label);
+	jit_insn_return (odd, jit_insn_neg (odd, acc));
+	jit_insn_label (odd, &label);
+	jit_value_t odd_args[2] = {
+		jit_insn_sub (odd, n,
+			jit_value_create_long_constant (odd, jit_type_long, 1)),
+		jit_insn_add (odd, acc,
+			jit_value_create_nint_constant (odd, jit_type_int, 1))
+	};
+	CHECK (jit_insn_call (odd, "even", even, 0, odd_args, 2, JIT_CALL_TAIL));
+
+	/* The return types differ, so the tail call is refused.  */
+	CHECK (!jit_insn_call (other, "odd", odd, 0, odd_args, 2, JIT_CALL_TAIL));
+
+	unsigned max = jit_function_get_max_optimization_level ();
+	jit_function_set_optimization_level (even, max);
+	jit_function_set_optimization_level (odd, max);
+	CHECK (jit_function_compile (even));
+	CHECK (jit_function_compile (odd));
+
+	jit_int count = 3000001;
+	jit_int expected = 0;
+	jit_int k;
+	for (k = count; k > 0; k -= 2)
+	  {
+	    expected ^= k;
+	    if (k == 1)
+	      expected = -expected;
+	    else
+	      expected++;
+	  }
+
+	jit_int start = 0;
+	void *args[] = { &count, &start };
+	jit_int result = 0;
+	CHECK (jit_function_apply (even, args, &result));
+	CHECK (result == expected);
+
+	jit_context_destroy (ctx);
+}
+
+/* Build the overflow checked additions, subtractions and multiplications
+   of all the integer types and the checked conversions between them and
+   check them against the C arithmetic at the boundary values, where a
+   failed check raises an exception that makes jit_function_apply
+   return zero.  */
+
+static jit_long overflow_values[] = {
+	0, 1, 2, -1, -2, 3, 100, -100, 0x7f, 0x80, 0xff, 0x100, 0x7fff,
+	0x8000, 0xffff, 0x10000, 0x7fffffff, -0x7fffffff - 1, 0x80000000LL,
+	0xffffffffLL, 0x100000000LL, 0x7fffffffffffffffLL,
+	-0x7fffffffffffffffLL - 1, 0x10000000LL, 0x40000000LL, -0x40000000LL
+};
+#define NUM_OVERFLOW_VALUES \
+	(sizeof (overflow_values) / sizeof (overflow_values[0]))
+
+/* Compute the expected result of a checked operation, or return zero if
+   it overflows.  */
+
+static int overflow_reference (int op, jit_type_t type, jit_long x,
+			       jit_long y, jit_long *result)
+{
+	if (type == jit_type_int)
+	  {
+	    jit_int r, a = (jit_int) x, b = (jit_int) y;
+	    int ovf = op == 0 ? __builtin_add_overflow (a, b, &r)
+		    : op == 1 ? __builtin_sub_overflow (a, b, &r)
+		    : __builtin_mul_overflow (a, b, &r);
+	    *result = r;
+	    return !ovf;
+	  }
+	if (type == jit_type_uint)
+	  {
+	    jit_uint r, a = (jit_uint) x, b = (jit_uint) y;
+	    int ovf = op == 0 ? __builtin_add_overflow (a, b, &r)
+		    : op == 1 ? __builtin_sub_overflow (a, b, &r)
+		    : __builtin_mul_overflow (a, b, &r);
+	    *result = r;
+	    return !ovf;
+	  }
+	if (type == jit_type_long)
+	  {
+	    jit_long r;
+	    int ovf = op == 0 ? __builtin_add_overflow (x, y, &r)
+		    : op == 1 ? __builtin_sub_overflow (x, y, &r)
+		    : __builtin_mul_overflow (x, y, &r);
+	    *result = r;
+	    return !ovf;
+	  }
+	jit_ulong r, a = (jit_ulong) x, b = (jit_ulong) y;
+	int ovf = op == 0 ? __builtin_add_overflow (a, b, &r)
+		: op == 1 ? __builtin_sub_overflow (a, b, &r)
+		: __builtin_mul_overflow (a, b, &r);
+	*result = (jit_long) r;
+	return !ovf;
+}
+
+/* Convert a value to the given type and back to jit_long.  */
+
+static jit_long overflow_truncate (jit_type_t type, jit_long x)
+{
+	if (type == jit_type_sbyte)
+	  return (jit_sbyte) x;
+	if (type == jit_type_ubyte)
+	  return (jit_ubyte) x;
+	if (type == jit_type_short)
+	  return (jit_short) x;
+	if (type == jit_type_ushort)
+	  return (jit_ushort) x;
+	if (type == jit_type_int)
+	  return (jit_int) x;
+	if (type == jit_type_uint)
+	  return (jit_uint) x;
+	return x;
+}
+
+/* Check if the value of the source type fits in the target type.  */
+
+static int overflow_fits (jit_type_t from, jit_type_t to, jit_long x)
+{
+	if (from == jit_type_ulong && x < 0)
+	  return to == jit_type_ulong;
+	if (to == jit_type_ulong)
+	  return x >= 0;
+	return overflow_truncate (to, x) == x;
+}
+
+static int overflow_object;
+
+static void *overflow_handler (int exception_type)
+{
+	return &overflow_object;
+}
+
+static void test_overflow_checks(void)
+{
+	static jit_type_t types[4];
+	static jit_type_t targets[8];
+	types[0] = jit_type_int;
+	types[1] = jit_type_uint;
+	types[2] = jit_type_long;
+	types[3] = jit_type_ulong;
+	targets[0] = jit_type_sbyte;
+	targets[1] = jit_type_ubyte;
+	targets[2] = jit_type_short;
+	targets[3] = jit_type_ushort;
+	targets[4] = jit_type_int;
+	targets[5] = jit_type_uint;
+	targets[6] = jit_type_long;
+	targets[7] = jit_type_ulong;
+
+	jit_context_t ctx = test_context ();
+	jit_exception_func previous = jit_exception_set_handler (overflow_handler);
+	unsigned max = jit_function_get_max_optimization_level ();
+	unsigned t, op, i, j;
+
+	for (t = 0; t < 4; t++)
+	  {
+	    jit_type_t type = types[t];
+	    jit_type_t params[2] = { type, type };
+	    jit_type_t sig = jit_type_create_signature (jit_abi_cdecl, type,
+							params, 2, 1);
+	    for (op = 0; op < 3; op++)
+	      {
+		jit_function_t func = jit_function_create (ctx, sig);
+		jit_value_t x = jit_value_get_param (func, 0);
+		jit_value_t y = jit_value_get_param (func, 1);
+		jit_value_t r = op == 0 ? jit_insn_add_ovf (func, x, y)
+			      : op == 1 ? jit_insn_sub_ovf (func, x, y)
+			      : jit_insn_mul_ovf (func, x, y);
+		jit_insn_return (func, r);
+		jit_function_set_optimization_level (func, max);
+		CHECK (jit_function_compile (func));
+
+		for (i = 0; i < NUM_OVERFLOW_VALUES; i++)
+		  for (j = 0; j < NUM_OVERFLOW_VALUES; j++)
+		    {
+		      jit_long a = overflow_truncate (type, overflow_values[i]);
+		      jit_long b = overflow_truncate (type, overflow_values[j]);
+		      jit_long expected = 0;
+		      int ok = overflow_reference (op, type, a, b, &expected);
+		      union { jit_int i; jit_uint ui; jit_long l; } va, vb, vr;
+		      if (t < 2)
+			{
+			  va.i = (jit_int) a;
+			  vb.i = (jit_int) b;
+			}
+		      else
+			{
+			  va.l = a;
+			  vb.l = b;
+			}
+		      void *args[] = { &va, &vb };
+		      vr.l = 0;
+		      CHECK (jit_function_apply (func, args, &vr) == ok);
+		      if (ok)
+			CHECK ((t == 0 ? vr.i : t == 1 ? (jit_long) vr.ui : vr.l)
+			       == expected);
+		    }
+	      }
+	    jit_type_free (sig);
+	  }
+
+	for (t = 0; t < 4; t++)
+	  for (op = 0; op < 8; op++)
+	    {
+	      jit_type_t from = types[t];
+	      jit_type_t to = targets[op];
+	      jit_type_t params[1] = { from };
+	      jit_function_t func = test_function (ctx, jit_type_long, params, 1);
+	      jit_value_t x = jit_value_get_param (func, 0);
+	      jit_value_t r = jit_insn_convert (func, x, to, 1);
+	      jit_insn_return (func, jit_insn_convert (func, r, jit_type_long, 0));
+	      jit_function_set_optimization_level (func, max);
+	      CHECK (jit_function_compile (func));
+
+	      for (i = 0; i < NUM_OVERFLOW_VALUES; i++)
+		{
+		  jit_long a = overflow_truncate (from, overflow_values[i]);
+		  int ok = overflow_fits (from, to, a);
+		  union { jit_int i; jit_long l; } va;
+		  if (t < 2)
+		    va.i = (jit_int) a;
+		  else
+		    va.l = a;
+		  void *args[] = { &va };
+		  jit_long result = 0;
+		  CHECK (jit_function_apply (func, args, &result) == ok);
+		  if (ok)
+		    CHECK (result == overflow_truncate (to, a));
+		}
+	    }
+
+	jit_exception_set_handler (previous);
+
+	jit_context_destroy (ctx);
+}
+
+/* Check the results of the atomic instructions in one thread and then
+   run a compiled loop updating shared counters with them in several
+   threads at once, where a lost update shows in the final counts.  */
+
+#define ATOMIC_THREADS 4
+#define ATOMIC_ITERATIONS 100001
+
+struct atomic_counters
+{
+	jit_int add_int;
+	jit_long add_long;
+	jit_int cas_int;
+	jit_long cas_long;
+	jit_int xor_int;
+	jit_long bits;
+	jit_long exchanged;
+	jit_long flag;
+};
+
+static struct atomic_counters atomic_counters;
+static jit_function_t atomic_worker;
+
+static void *atomic_thread (void *arg)
+{
+	jit_int id = (jit_int) (jit_nint) arg;
+	jit_int count = ATOMIC_ITERATIONS;
+	void *counters = &atomic_counters;
+	void *args[] = { &counters, &id, &count };
+	jit_int result = 0;
+	if (!jit_function_apply (atomic_worker, args, &result))
+	  result = 0;
+	return (void *) (jit_nint) result;
+}
+
+static jit_value_t atomic_field (jit_function_t func, jit_value_t base,
+				 size_t offset)
+{
+	return jit_insn_add_relative (func, base, (jit_nint) offset);
+}
+
+static jit_value_t atomic_op (jit_function_t func, int op, jit_value_t ptr,
+			      jit_value_t x, jit_value_t y)
+{
+	switch (op)
+	  {
+	  case 0: return jit_insn_atomic_fetch_add (func, ptr, x);
+	  case 1: return jit_insn_atomic_fetch_and (func, ptr, x);
+	  case 2: return jit_insn_atomic_fetch_or (func, ptr, x);
+	  case 3: return jit_insn_atomic_fetch_xor (func, ptr, x);
+	  case 4: return jit_insn_atomic_exchange (func, ptr, x);
+	  case 5: return jit_insn_atomic_compare_exchange (func, ptr, x, y);
+	  case 6: return jit_insn_atomic_load (func, ptr, jit_value_get_type (x),
+					       JIT_MEMORY_ORDER_ACQUIRE);
+	  }
+	jit_insn_atomic_store (func, ptr, x, op == 7 ? JIT_MEMORY_ORDER_RELEASE
+			       : JIT_MEMORY_ORDER_SEQ_CST);
+	return jit_insn_load_relative (func, ptr, 0, jit_value_get_type (x));
+}
+
+static jit_long atomic_reference (int op, jit_long *mem, jit_long x, jit_long y)
+{
+	jit_long old = *mem;
+	switch (op)
+	  {
+	  case 0: *mem = (jit_long) ((jit_ulong) old + (jit_ulong) x); break;
+	  case 1: *mem = old & x; break;
+	  case 2: *mem = old | x; break;
+	  case 3: *mem = old ^ x; break;
+	  case 4: *mem = x; break;
+	  case 5: if (old == x) *mem = y; break;
+	  case 6: break;
+	  default: *mem = x; return x;
+	  }
+	return old;
+}
+
+static void test_atomic_operations(void)
+{
+	static const jit_long values[] = {
+		0, 1, -1, 0x5a5a5a5a, 0x7fffffff, -0x7fffffffffffffffLL - 1,
+		0x123456789abcdefLL
+	};
+	const unsigned num_values = sizeof (values) / sizeof (values[0]);
+
+	jit_context_t ctx = test_context ();
+	unsigned max = jit_function_get_max_optimization_level ();
+	unsigned t, op, i, j;
+
+	/* The memory orders are checked.  */
+	jit_function_t func = test_function (ctx, jit_type_void, 0, 0);
+	jit_value_t ptr = jit_value_create_nint_constant (func, jit_type_void_ptr,
+							  (jit_nint) &atomic_counters);
+	CHECK (!jit_insn_atomic_load (func, ptr, jit_type_int,
+				      JIT_MEMORY_ORDER_RELEASE));
+	CHECK (!jit_insn_atomic_store (func, ptr, ptr, JIT_MEMORY_ORDER_ACQUIRE));
+	CHECK (!jit_insn_atomic_load (func, ptr, jit_type_short,
+				      JIT_MEMORY_ORDER_RELAXED));
+	CHECK (!jit_insn_fence (func, 5));
+	jit_function_abandon (func);
+
+	/* The single threaded results for every operation and type.  */
+	for (t = 0; t < 2; t++)
+	  {
+	    jit_type_t type = t == 0 ? jit_type_int : jit_type_long;
+	    jit_type_t params[3] = { jit_type_void_ptr, type, type };
+	    jit_type_t sig = jit_type_create_signature (jit_abi_cdecl, type,
+							params, 3, 1);
+	    for (op = 0; op < 9; op++)
+	      {
+		func = jit_function_create (ctx, sig);
+		jit_value_t r = atomic_op (func, op, jit_value_get_param (func, 0),
+					   jit_value_get_param (func, 1),
+					   jit_value_get_param (func, 2));
+		CHECK (r);
+		CHECK (jit_insn_fence (func, JIT_MEMORY_ORDER_SEQ_CST));
+		jit_insn_return (func, r);
+		jit_function_set_optimization_level (func, max);
+		CHECK (jit_function_compile (func));
+
+		for (i = 0; i < num_values; i++)
+		  for (j = 0; j < num_values; j++)
+		    {
+		      union { jit_int i; jit_long l; } mem, vx, vy, vr;
+		      jit_long expected_mem = values[i];
+		      jit_long x = values[j];
+		      jit_long y = values[num_values - 1 - j];
+		      if (op == 5 && (i + j) % 2 == 0)
+			x = values[i];
+		      if (t == 0)
+			{
+			  expected_mem = (jit_int) expected_mem;
+			  x = (jit_int) x;
+			  y = (jit_int) y;
+			  mem.i = (jit_int) expected_mem;
+			  vx.i = (jit_int) x;
+			  vy.i = (jit_int) y;
+			}
+		      else
+			{
+			  mem.l = expected_mem;
+			  vx.l = x;
+			  vy.l = y;
+			}
+		      jit_long expected = atomic_reference (op, &expected_mem, x, y);
+		      void *pmem = &mem;
+		      void *args[] = { &pmem, &vx, &vy };
+		      vr.l = 0;
+		      CHECK (jit_function_apply (func, args, &vr));
+		      if (t == 0)
+			{
+			  CHECK (vr.i == (jit_int) expected);
+			  CHECK (mem.i == (jit_int) expected_mem);
+			}
+		      else
+			{
+			  CHECK (vr.l == expected);
+			  CHECK (mem.l == expected_mem);
+			}
+		    }
+	      }
+	    jit_type_free (sig);
+	  }
+
+	/* The worker does in each iteration:
+
+	   fetch_add (&add_int, 1)
+	   fetch_add (&add_long, 3)
+	   do old = load (&cas_int) until cas (&cas_int, old, old + 1) == old
+	   do old = load (&cas_long) until cas (&cas_long, old, old + id) == old
+	   fetch_xor (&xor_int, 1 << id)
+	   fetch_or (&bits, 1 << (32 + id)), fetch_and (&bits, ~(1 << id))
+	   exchanged += exchange (&flag, 1) == 0 ? 1 : 0 ... store (&flag, 0)
+
+	   The last one is a spin lock and "exchanged" is updated under it with
+	   plain loads and stores.  */
+	jit_type_t params[3] = { jit_type_void_ptr, jit_type_int, jit_type_int };
+	func = test_function (ctx, jit_type_int, params, 3);
+	jit_value_t base = jit_value_get_param (func, 0);
+	jit_value_t id = jit_value_get_param (func, 1);
+	jit_value_t count = jit_value_get_param (func, 2);
+	jit_value_t i_value = jit_value_create (func, jit_type_int);
+	jit_value_t old = jit_value_create (func, jit_type_int);
+	jit_value_t old_long = jit_value_create (func, jit_type_long);
+	jit_value_t one = jit_value_create_nint_constant (func, jit_type_int, 1);
+	jit_value_t one_long = jit_value_create_long_constant (func, jit_type_long, 1);
+	jit_value_t zero_long = jit_value_create_long_constant (func, jit_type_long, 0);
+	jit_value_t id_long = jit_insn_convert (func, id, jit_type_long, 0);
+	jit_value_t mask = jit_insn_shl (func, one, id);
+	jit_value_t high = jit_insn_shl (func, one_long,
+		jit_insn_add (func, id,
+			jit_value_create_nint_constant (func, jit_type_int, 32)));
+	jit_value_t low = jit_insn_not (func, jit_insn_shl (func, one_long, id));
+	jit_label_t loop = jit_label_undefined;
+	jit_label_t retry_int = jit_label_undefined;
+	jit_label_t retry_long = jit_label_undefined;
+	jit_label_t spin = jit_label_undefined;
+	jit_label_t done = jit_label_undefined;
+
+	jit_insn_store (func, i_value,
+		jit_value_create_nint_constant (func, jit_type_int, 0));
+	jit_insn_label (func, &loop);
+	jit_insn_branch_if_not (func, jit_insn_lt (func, i_value, count), &done);
+
+	ptr = atomic_field (func, base, offsetof (struct atomic_counters, add_int));
+	jit_insn_atomic_fetch_add (func, ptr, one);
+	ptr = atomic_field (func, base, offsetof (struct atomic_counters, add_long));
+	jit_insn_atomic_fetch_add (func, ptr,
+		jit_value_create_long_constant (func, jit_type_long, 3));
+
+	ptr = atomic_field (func, base, offsetof (struct atomic_counters, cas_int));
+	jit_insn_store (func, old, jit_insn_atomic_load (func, ptr, jit_type_int,
+							 JIT_MEMORY_ORDER_RELAXED));
+	jit_insn_label (func, &retry_int);
+	jit_value_t prev = jit_insn_atomic_compare_exchange (func, ptr, old,
+		jit_insn_add (func, old, one));
+	jit_value_t failed = jit_insn_ne (func, prev, old);
+	jit_insn_store (func, old, prev);
+	jit_insn_branch_if (func, failed, &retry_int);
+
+	ptr = atomic_field (func, base, offsetof (struct atomic_counters, cas_long));
+	jit_insn_store (func, old_long, jit_insn_atomic_load (func, ptr, jit_type_long,
+							      JIT_MEMORY_ORDER_SEQ_CST));
+	jit_insn_label (func, &retry_long);
+	prev = jit_insn_atomic_compare_exchange (func, ptr, old_long,
+		jit_insn_add (func, old_long, id_long));
+	failed = jit_insn_ne (func, prev, old_long);
+	jit_insn_store (func, old_long, prev);
+	jit_insn_branch_if (func, failed, &retry_long);
+
+	ptr = atomic_field (func, base, offsetof (struct atomic_counters, xor_int));
+	jit_insn_atomic_fetch_xor (func, ptr, mask);
+	ptr = atomic_field (func, base, offsetof (struct atomic_counters, bits));
+	jit_insn_atomic_fetch_or (func, ptr, high);
+	jit_insn_atomic_fetch_and (func, ptr, low);
+
+	ptr = atomic_field (func, base, offsetof (struct atomic_counters, flag));
+	jit_insn_label (func, &spin);
+	jit_insn_branch_if (func, jit_insn_atomic_exchange (func, ptr, one_long), &spin);
+	jit_value_t exchanged = atomic_field (func, base,
+		offsetof (struct atomic_counters, exchanged));
+	jit_insn_store_relative (func, exchanged, 0, jit_insn_add (func,
+		jit_insn_load_relative (func, exchanged, 0, jit_type_long), one_long));
+	jit_insn_atomic_store (func, ptr, zero_long, JIT_MEMORY_ORDER_RELEASE);
+	jit_insn_fence (func, JIT_MEMORY_ORDER_SEQ_CST);
+
+	jit_insn_store (func, i_value, jit_insn_add (func, i_value, one));
+	jit_insn_branch (func, &loop);
+	jit_insn_label (func, &done);
+	jit_insn_return (func, one);
+	jit_function_set_optimization_level (func, max);
+	CHECK (jit_function_compile (func));
+	atomic_worker = func;
+
+	atomic_counters.bits = 0xffffffffLL;
+	pthread_t threads[ATOMIC_THREADS];
+	for (i = 0; i < ATOMIC_THREADS; i++)
+	  CHECK (pthread_create (&threads[i], 0, atomic_thread,
+				 (void *) (jit_nint) i) == 0);
+	jit_long id_sum = 0;
+	for (i = 0; i < ATOMIC_THREADS; i++)
+	  {
+	    void *result = 0;
+	    CHECK (pthread_join (threads[i], &result) == 0);
+	    CHECK (result == (void *) 1);
+	    id_sum += i;
+	  }
+
+	jit_long n = ATOMIC_ITERATIONS;
+	CHECK (atomic_counters.add_int == ATOMIC_THREADS * n);
+	CHECK (atomic_counters.add_long == 3 * ATOMIC_THREADS * n);
+	CHECK (atomic_counters.cas_int == ATOMIC_THREADS * n);
+	CHECK (atomic_counters.cas_long == id_sum * n);
+	CHECK (atomic_counters.xor_int == (1 << ATOMIC_THREADS) - 1);
+	CHECK (atomic_counters.bits
+	       == ((((jit_long) 1 << ATOMIC_THREADS) - 1) << 32
+		   | (0xffffffffLL & ~(((jit_long) 1 << ATOMIC_THREADS) - 1))));
+	CHECK (atomic_counters.exchanged == ATOMIC_THREADS * n);
+	CHECK (atomic_counters.flag == 0);
+
+	jit_context_destroy (ctx);
+}
+
+/* Build the bit counts, byte swaps and rotates of all the integer types
+   with the rotate count in a register and as a constant and check them
+   against the C code, and check that the builders fold the constant
+   operands.  */
+
+static jit_value_t bit_op (jit_function_t func, int op, jit_value_t x,
+			   jit_value_t y)
+{
+	switch (op)
+	  {
+	  case 0: return jit_insn_popcount (func, x);
+	  case 1: return jit_insn_clz (func, x);
+	  case 2: return jit_insn_ctz (func, x);
+	  case 3: return jit_insn_bswap (func, x);
+	  case 4: return jit_insn_rol (func, x, y);
+	  default: return jit_insn_ror (func, x, y);
+	  }
+}
+
+static jit_long bit_reference (int op, jit_type_t type, jit_long value,
+			       unsigned count)
+{
+	int wide = (type == jit_type_long || type == jit_type_ulong);
+	unsigned width = wide ? 64 : 32;
+	jit_ulong x = wide ? (jit_ulong) value : (jit_uint) value;
+	jit_ulong mask = wide ? ~(jit_ulong) 0 : 0xffffffffULL;
+	jit_ulong r;
+
+	count %= width;
+	switch (op)
+	  {
+	  case 0:
+	    return __builtin_popcountll (x);
+	  case 1:
+	    return x == 0 ? width : __builtin_clzll (x) - (64 - width);
+	  case 2:
+	    return x == 0 ? width : __builtin_ctzll (x);
+	  case 3:
+	    r = wide ? __builtin_bswap64 (x) : __builtin_bswap32 ((jit_uint) x);
+	    break;
+	  case 4:
+	    r = count == 0 ? x : ((x << count) | (x >> (width - count))) & mask;
+	    break;
+	  default:
+	    r = count == 0 ? x : ((x >> count) | (x << (width - count))) & mask;
+	    break;
+	  }
+	if (type == jit_type_int)
+	  return (jit_int) r;
+	if (type == jit_type_uint)
+	  return (jit_uint) r;
+	return (jit_long) r;
+}
+
+static void test_bit_operations(void)
+{
+	static const jit_long values[] = {
+		0, 1, -1, 2, 0xf0, 0x7fffffff, 0x80000000LL, 0x12345678,
+		0x100000000LL, 0x0123456789abcdefLL, -0x7fffffffffffffffLL - 1
+	};
+	static const jit_int counts[] = { 0, 1, 7, 31, 32, 33, 63, 64, 100 };
+	const unsigned num_values = sizeof (values) / sizeof (values[0]);
+	const unsigned num_counts = sizeof (counts) / sizeof (counts[0]);
+	static jit_type_t types[4];
+	types[0] = jit_type_int;
+	types[1] = jit_type_uint;
+	types[2] = jit_type_long;
+	types[3] = jit_type_ulong;
+
+	jit_context_t ctx = test_context ();
+	unsigned max = jit_function_get_max_optimization_level ();
+	unsigned t, op, i, j;
+
+	for (t = 0; t < 4; t++)
+	  {
+	    jit_type_t type = types[t];
+	    jit_type_t params[2] = { type, jit_type_int };
+	    jit_type_t sig = jit_type_create_signature (jit_abi_cdecl,
+							jit_type_long,
+							params, 2, 1);
+	    for (op = 0; op < 8; op++)
+	      {
+		/* Ops 6 and 7 rotate by a constant count.  */
+		jit_int constant = op == 6 ? 5 : 37;
+		jit_function_t func = jit_function_create (ctx, sig);
+		jit_value_t x = jit_value_get_param (func, 0);
+		jit_value_t y = op < 6 ? jit_value_get_param (func, 1)
+			: jit_value_create_nint_constant (func, jit_type_int,
+							  constant);
+		jit_value_t r = bit_op (func, op < 6 ? op : op - 2, x, y);
+		CHECK (r);
+		CHECK (jit_type_normalize (jit_value_get_type (r))
+		       == (op < 3 ? jit_type_int : type));
+		/* Keep the operand live past the operation.  */
+		r = jit_insn_xor (func, jit_insn_convert (func, r, jit_type_long, 0),
+				  jit_insn_convert (func, x, jit_type_long, 0));
+		jit_insn_return (func, r);
+		jit_function_set_optimization_level (func, max);
+		CHECK (jit_function_compile (func));
+
+		for (i = 0; i < num_values; i++)
+		  for (j = 0; j < num_counts; j++)
+		    {
+		      union { jit_int i; jit_long l; } vx;
+		      jit_int count = op < 6 ? counts[j] : constant;
+		      if (t < 2)
+			vx.i = (jit_int) values[i];
+		      else
+			vx.l = values[i];
+		      void *args[] = { &vx, &count };
+		      jit_long result = 0;
+		      CHECK (jit_function_apply (func, args, &result));
+		      jit_long expected = bit_reference (op < 6 ? op : op - 2, type,
+							 values[i], count);
+		      jit_long operand = t == 0 ? (jit_int) values[i]
+			: t == 1 ? (jit_uint) values[i] : values[i];
+		      CHECK (result == (expected ^ operand));
+		    }
+
+		/* The same operation on constants is folded.  */
+		for (i = 0; i < num_values; i++)
+		  {
+		    jit_value_t cx = t < 2
+		      ? jit_value_create_nint_constant (func, type, (jit_int) values[i])
+		      : jit_value_create_long_constant (func, type, values[i]);
+		    jit_value_t cy = jit_value_create_nint_constant (func, jit_type_int,
+								     counts[i % num_counts]);
+		    r = bit_op (func, op < 6 ? op : op - 2, cx, cy);
+		    CHECK (r && jit_value_is_constant (r));
+		    jit_type_t rtype = jit_type_normalize (jit_value_get_type (r));
+		    jit_long folded = rtype == jit_type_int
+		      ? (jit_int) jit_value_get_nint_constant (r)
+		      : rtype == jit_type_uint
+		      ? (jit_uint) jit_value_get_nint_constant (r)
+		      : jit_value_get_long_constant (r);
+		    CHECK (folded == bit_reference (op < 6 ? op : op - 2, type,
+						    values[i],
+						    counts[i % num_counts]));
+		  }
+	      }
+	    jit_type_free (sig);
+	  }
+
+	jit_context_destroy (ctx);
+}
+
+/* Build the rounding operations of the float32 and float64 types and
+   check them against the intrinsic functions on values that include the
+   halfway cases, the signed zeroes, the infinities and NaN.  Then check
+   the fused multiply-add both compiled and folded.  */
+
+static jit_value_t round_op (jit_function_t func, int op, jit_value_t x)
+{
+	switch (op)
+	  {
+	  case 0: return jit_insn_floor (func, x);
+	  case 1: return jit_insn_ceil (func, x);
+	  case 2: return jit_insn_rint (func, x);
+	  case 3: return jit_insn_round (func, x);
+	  default: return jit_insn_trunc (func, x);
+	  }
+}
+
+static jit_float64 round_reference (int op, jit_type_t type, jit_float64 x)
+{
+	if (type == jit_type_float32)
+	  {
+	    jit_float32 f = (jit_float32) x;
+	    switch (op)
+	      {
+	      case 0: return jit_float32_floor (f);
+	      case 1: return jit_float32_ceil (f);
+	      case 2: return jit_float32_rint (f);
+	      case 3: return jit_float32_round (f);
+	      default: return jit_float32_trunc (f);
+	      }
+	  }
+	switch (op)
+	  {
+	  case 0: return jit_float64_floor (x);
+	  case 1: return jit_float64_ceil (x);
+	  case 2: return jit_float64_rint (x);
+	  case 3: return jit_float64_round (x);
+	  default: return jit_float64_trunc (x);
+	  }
+}
+
+/* Compare two results bit by bit, so that the sign of zero counts, but
+   let any NaN match any other.  */
+
+static int same_float64 (jit_float64 x, jit_float64 y)
+{
+	if (jit_float64_is_nan (x) || jit_float64_is_nan (y))
+	  return jit_float64_is_nan (x) && jit_float64_is_nan (y);
+	return memcmp (&x, &y, sizeof (x)) == 0;
+}
+
+static void test_rounding_operations(void)
+{
+	static const jit_float64 values[] = {
+		0.0, -0.0, 0.25, 0.5, -0.5, 1.5, 2.5, -2.5, 3.7, -3.7,
+		0.49999997, 0.49999999999999994, -0.49999999999999994,
+		8388607.5, -8388608.5, 4503599627370495.5, 4503599627370497.0,
+		1e300, -1e300
+	};
+	const unsigned num_values = sizeof (values) / sizeof (values[0]);
+	volatile jit_float64 huge = 1e300;
+	jit_float64 inf = huge * huge;
+	jit_type_t types[2];
+	types[0] = jit_type_float32;
+	types[1] = jit_type_float64;
+
+	jit_context_t ctx = test_context ();
+	unsigned max = jit_function_get_max_optimization_level ();
+	unsigned t, op, i;
+
+	for (t = 0; t < 2; t++)
+	  {
+	    jit_type_t type = types[t];
+	    jit_type_t sig = jit_type_create_signature (jit_abi_cdecl,
+							jit_type_float64,
+							&type, 1, 1);
+	    for (op = 0; op < 5; op++)
+	      {
+		jit_function_t func = jit_function_create (ctx, sig);
+		jit_value_t x = jit_value_get_param (func, 0);
+		jit_value_t r = round_op (func, op, x);
+		CHECK (r);
+		CHECK (jit_value_get_type (r) == type);
+		jit_insn_return (func, jit_insn_convert (func, r,
+							 jit_type_float64, 0));
+		jit_function_set_optimization_level (func, max);
+		CHECK (jit_function_compile (func));
+
+		for (i = 0; i < num_values + 3; i++)
+		  {
+		    jit_float64 value = i < num_values ? values[i]
+		      : i == num_values ? inf
+		      : i == num_values + 1 ? -inf
+		      : inf - inf;
+		    union { jit_float32 f; jit_float64 d; } vx;
+		    if (t == 0)
+		      vx.f = (jit_float32) value;
+		    else
+		      vx.d = value;
+		    void *args[] = { &vx };
+		    jit_float64 result = 0;
+		    CHECK (jit_function_apply (func, args, &result));
+		    CHECK (same_float64 (result, round_reference (op, type, value)));
+		  }
+	      }
+	    jit_type_free (sig);
+	  }
+
+	/* Multiply-add with a product that needs more than the precision
+	   of the type.  */
+	jit_type_t params[3] = { jit_type_float64, jit_type_float64,
+				 jit_type_float64 };
+	jit_function_t func = test_function (ctx, jit_type_float64, params, 3);
+	jit_value_t r = jit_insn_fma (func, jit_value_get_param (func, 0),
+				      jit_value_get_param (func, 1),
+				      jit_value_get_param (func, 2));
+	CHECK (r);
+	CHECK (jit_value_get_type (r) == jit_type_float64);
+	jit_insn_return (func, r);
+	jit_function_set_optimization_level (func, max);
+	CHECK (jit_function_compile (func));
+
+	jit_float64 a = 1.0 + 1.0 / 134217728.0;
+	jit_float64 c = -(1.0 + 1.0 / 67108864.0);
+	jit_float64 result = 0;
+	void *args[] = { &a, &a, &c };
+	CHECK (jit_function_apply (func, args, &result));
+	CHECK (same_float64 (result, jit_float64_fma (a, a, c)));
+
+	/* Mixed operand types are converted to the wider type and constant
+	   operands are folded.  */
+	func = test_function (ctx, jit_type_float64, 0, 0);
+	r = jit_insn_fma (func,
+			  jit_value_create_float32_constant (func, jit_type_float32,
+							     1.5f),
+			  jit_value_create_float64_constant (func, jit_type_float64,
+							     a),
+			  jit_value_create_nint_constant (func, jit_type_int, -1));
+	CHECK (r && jit_value_is_constant (r));
+	CHECK (jit_value_get_type (r) == jit_type_float64);
+	CHECK (same_float64 (jit_value_get_float64_constant (r),
+			     jit_float64_fma (1.5, a, -1.0)));
+
+	jit_context_destroy (ctx);
+}
+
+/* Build the same nfloat computations with and without the
+   JIT_OPTION_NFLOAT_AS_FLOAT64 option and check that the arithmetic
+   becomes float64 with it, while the results agree within the
+   precision of float64.  The nfloat locals keep their type, so their
+   address can still be passed around as a pointer to a jit_nfloat.  */
+
+static jit_value_t nfloat_expr (jit_function_t func, int op, jit_value_t x)
+{
+	jit_value_t t = jit_value_create (func, jit_type_nfloat);
+	jit_value_t c = jit_value_create_nfloat_constant (func, jit_type_nfloat,
+							  (jit_nfloat) 0.75);
+	switch (op)
+	  {
+	  case 0:
+	    jit_insn_store (func, t, jit_insn_mul (func, x, x));
+	    return jit_insn_add (func, jit_insn_sub (func, t, c),
+				 jit_insn_div (func, x, c));
+	  case 1:
+	    jit_insn_store (func, t, jit_insn_sqrt (func, jit_insn_abs (func, x)));
+	    return jit_insn_add (func, jit_insn_sin (func, t),
+				 jit_insn_floor (func, jit_insn_neg (func, t)));
+	  case 2:
+	    /* Mixed with integer and float32 operands.  */
+	    jit_insn_store (func, t, jit_insn_mul (func, x,
+		jit_value_create_nint_constant (func, jit_type_int, 3)));
+	    return jit_insn_sub (func, t, jit_insn_convert
+				 (func, x, jit_type_float32, 0));
+	  default:
+	    {
+	      /* Sum a series in a loop.  */
+	      jit_value_t i = jit_value_create (func, jit_type_int);
+	      jit_label_t loop = jit_label_undefined;
+	      jit_insn_store (func, t, c);
+	      jit_insn_store (func, i, jit_value_create_nint_constant
+			      (func, jit_type_int, 1));
+	      jit_insn_label (func, &loop);
+	      jit_insn_store (func, t, jit_insn_add
+			      (func, t, jit_insn_div (func, x, i)));
+	      jit_insn_store (func, i, jit_insn_add
+			      (func, i, jit_value_create_nint_constant
+			       (func, jit_type_int, 1)));
+	      jit_insn_branch_if (func, jit_insn_le
+				  (func, i, jit_value_create_nint_constant
+				   (func, jit_type_int, 100)), &loop);
+	      CHECK (jit_value_get_type (t) == jit_type_nfloat);
+	      return jit_insn_mul (func, t, c);
+	    }
+	  }
+}
+
+static void nfloat_bump (jit_nfloat *x)
+{
+	*x = *x * 3 + (jit_nfloat) 0.25;
+}
+
+static void test_nfloat_as_float64(void)
+{
+	static const jit_float64 values[] = {
+		0.0, 1.0, -2.5, 3.14159, 1e-8, 123456.789, -1e10
+	};
+	const unsigned num_values = sizeof (values) / sizeof (values[0]);
+	jit_context_t ctx[2];
+	unsigned mode, op, i;
+
+	ctx[0] = test_context ();
+	ctx[1] = test_context ();
+	jit_context_set_meta_numeric (ctx[1], JIT_OPTION_NFLOAT_AS_FLOAT64, 1);
+
+	jit_type_t param = jit_type_nfloat;
+	jit_type_t sig = jit_type_create_signature (jit_abi_cdecl, jit_type_nfloat,
+						    &param, 1, 1);
+	unsigned max = jit_function_get_max_optimization_level ();
+
+	for (op = 0; op < 4; op++)
+	  {
+	    jit_function_t func[2];
+	    for (mode = 0; mode < 2; mode++)
+	      {
+		func[mode] = jit_function_create (ctx[mode], sig);
+		jit_value_t x = jit_value_get_param (func[mode], 0);
+		CHECK (jit_value_get_type (x) == jit_type_nfloat);
+		jit_value_t r = nfloat_expr (func[mode], op, x);
+		CHECK (r);
+		CHECK (jit_value_get_type (r)
+		       == (mode ? jit_type_float64 : jit_type_nfloat));
+		jit_insn_return (func[mode], r);
+		jit_function_set_optimization_level (func[mode], max);
+		CHECK (jit_function_compile (func[mode]));
+	      }
+
+	    for (i = 0; i < num_values; i++)
+	      {
+		jit_nfloat arg = values[i];
+		jit_nfloat expected = 0, result = 0;
+		void *args[] = { &arg };
+		CHECK (jit_function_apply (func[0], args, &expected));
+		CHECK (jit_function_apply (func[1], args, &result));
+		jit_nfloat scale = jit_nfloat_abs (expected) > 1
+		  ? jit_nfloat_abs (expected) : 1;
+		CHECK (jit_nfloat_abs (result - expected) <= scale * 1e-13);
+	      }
+	  }
+	jit_type_free (sig);
+
+	/* An nfloat local between two long locals has its address passed
+	   to a native function.  */
+	jit_type_t ptr_type = jit_type_create_pointer (jit_type_nfloat, 1);
+	jit_type_t bump_sig = jit_type_create_signature (jit_abi_cdecl,
+							 jit_type_void,
+							 &ptr_type, 1, 1);
+	sig = jit_type_create_signature (jit_abi_cdecl, jit_type_nfloat,
+					 0, 0, 1);
+	for (mode = 0; mode < 2; mode++)
+	  {
+		jit_function_t func = jit_function_create (ctx[mode], sig);
+		jit_value_t a = jit_value_create (func, jit_type_long);
+		jit_value_t x = jit_value_create (func, jit_type_nfloat);
+		jit_value_t b = jit_value_create (func, jit_type_long);
+		CHECK (jit_value_get_type (x) == jit_type_nfloat);
+		jit_insn_store (func, a, jit_value_create_long_constant
+				(func, jit_type_long, 1000));
+		jit_insn_store (func, x, jit_value_create_nfloat_constant
+				(func, jit_type_nfloat, (jit_nfloat) 3.5));
+		jit_insn_store (func, b, jit_value_create_long_constant
+				(func, jit_type_long, 2000));
+		jit_value_t ptr = jit_insn_address_of (func, x);
+		jit_insn_call_native (func, "nfloat_bump", (void *) nfloat_bump,
+				      bump_sig, &ptr, 1, JIT_CALL_NOTHROW);
+		jit_insn_return (func, jit_insn_add
+				 (func, jit_insn_add (func, a, x), b));
+		CHECK (jit_function_compile (func));
+
+		jit_nfloat result = 0;
+		CHECK (jit_function_apply (func, 0, &result));
+		CHECK (result == (jit_nfloat) 3010.75);
+	  }
+	jit_type_free (sig);
+	jit_type_free (bump_sig);
+	jit_type_free (ptr_type);
+
+	jit_context_destroy (ctx[0]);
+	jit_context_destroy (ctx[1]);
+}
+
+/* Compile the shifts by a variable count and the float arithmetic at
+   every target feature level and check that the three operand forms
+   used at the higher levels compute the same results as the baseline
+   instructions and the C code.  */
+
+static jit_value_t level_op (jit_function_t func, int op, jit_value_t x,
+			     jit_value_t y)
+{
+	switch (op)
+	  {
+	  case 0: return jit_insn_shl (func, x, y);
+	  case 1: return jit_insn_shr (func, x, y);
+	  case 2: return jit_insn_add (func, x, y);
+	  case 3: return jit_insn_sub (func, x, y);
+	  case 4: return jit_insn_mul (func, x, y);
+	  case 5: return jit_insn_div (func, x, y);
+	  case 6: return jit_insn_min (func, x, y);
+	  default: return jit_insn_max (func, x, y);
+	  }
+}
+
+static jit_float64 level_reference (int op, jit_type_t type, jit_float64 x,
+				    jit_float64 y)
+{
+	if (type == jit_type_float32)
+	  {
+	    jit_float32 a = (jit_float32) x, b = (jit_float32) y;
+	    switch (op)
+	      {
+	      case 2: return (jit_float32) (a + b);
+	      case 3: return (jit_float32) (a - b);
+	      case 4: return (jit_float32) (a * b);
+	      case 5: return (jit_float32) (a / b);
+	      case 6: return a < b ? a : b;
+	      default: return a > b ? a : b;
+	      }
+	  }
+	switch (op)
+	  {
+	  case 2: return x + y;
+	  case 3: return x - y;
+	  case 4: return x * y;
+	  case 5: return x / y;
+	  case 6: return x < y ? x : y;
+	  default: return x > y ? x : y;
+	  }
+}
+
+static void test_feature_levels(void)
+{
+	static const jit_long values[] = {
+		1, -1, 0x7fffffff, 0x80000000LL, 0x0123456789abcdefLL,
+		-0x7fffffffffffffffLL - 1
+	};
+	static const jit_int counts[] = { 0, 1, 31, 32, 63, 100 };
+	static const jit_float64 fvalues[] = { 1.5, -2.25, 3.0e10, 1.0 / 3.0 };
+	const unsigned num_values = sizeof (values) / sizeof (values[0]);
+	const unsigned num_counts = sizeof (counts) / sizeof (counts[0]);
+	const unsigned num_fvalues = sizeof (fvalues) / sizeof (fvalues[0]);
+	jit_type_t types[6];
+	unsigned level, t, op, i, j;
+
+	types[0] = jit_type_int;
+	types[1] = jit_type_uint;
+	types[2] = jit_type_long;
+	types[3] = jit_type_ulong;
+	types[4] = jit_type_float32;
+	types[5] = jit_type_float64;
+
+	for (level = 0; level < 4; level++)
+	  {
+	    jit_context_t ctx = test_context ();
+	    jit_context_set_meta_numeric (ctx, JIT_OPTION_TARGET_FEATURE_LEVEL,
+					  level);
+	    for (t = 0; t < 6; t++)
+	      for (op = (t < 4 ? 0 : 2); op < (t < 4 ? 2 : 8); op++)
+		{
+		  jit_type_t params[2];
+		  params[0] = types[t];
+		  params[1] = t < 4 ? jit_type_int : types[t];
+		  jit_function_t func = test_function (ctx, types[t], params, 2);
+		  jit_value_t r = level_op (func, op,
+					    jit_value_get_param (func, 0),
+					    jit_value_get_param (func, 1));
+		  jit_insn_return (func, r);
+		  CHECK (jit_function_compile (func));
+
+		  if (t < 4)
+		    {
+		      int wide = (t >= 2);
+		      for (i = 0; i < num_values; i++)
+			for (j = 0; j < num_counts; j++)
+			  {
+			    jit_long x = values[i], result = 0, expected;
+			    jit_int count = counts[j];
+			    unsigned c = count % (wide ? 64 : 32);
+			    jit_int ix = (jit_int) x;
+			    void *args[] = { wide ? (void *) &x : (void *) &ix,
+					     &count };
+			    if (wide)
+			      {
+				CHECK (jit_function_apply (func, args, &result));
+				if (op == 0)
+				  expected = (jit_long) ((jit_ulong) x << c);
+				else if (t == 2)
+				  expected = x >> c;
+				else
+				  expected = (jit_long) ((jit_ulong) x >> c);
+			      }
+			    else
+			      {
+				jit_int iresult = 0;
+				CHECK (jit_function_apply (func, args, &iresult));
+				result = iresult;
+				if (op == 0)
+				  expected = (jit_int) ((jit_uint) ix << c);
+				else if (t == 0)
+				  expected = ix >> c;
+				else
+				  expected = (jit_int) ((jit_uint) ix >> c);
+			      }
+			    CHECK (result == expected);
+			  }
+		    }
+		  else
+		    {
+		      for (i = 0; i < num_fvalues; i++)
+			for (j = 0; j < num_fvalues; j++)
+			  {
+			    jit_float64 x = fvalues[i], y = fvalues[j];
+			    jit_float64 expected
+			      = level_reference (op, types[t], x, y);
+			    if (t == 4)
+			      {
+				jit_float32 fx = (jit_float32) x;
+				jit_float32 fy = (jit_float32) y;
+				jit_float32 result = 0;
+				void *args[] = { &fx, &fy };
+				CHECK (jit_function_apply (func, args, &result));
+				CHECK (result == (jit_float32) expected);
+			      }
+			    else
+			      {
+				jit_float64 result = 0;
+				void *args[] = { &x, &y };
+				CHECK (jit_function_apply (func, args, &result));
+				CHECK (result == expected);
+			      }
+			  }
+		    }
+		}
+
+	    /* Multiply-add with a product that needs more than the
+	       precision of the type, so that only a single rounding gives
+	       the reference result.  Without the FMA extension the C
+	       library is called instead of the instruction.  */
+	    for (t = 4; t < 6; t++)
+	      {
+		jit_type_t params[3];
+		params[0] = params[1] = params[2] = types[t];
+		jit_function_t func = test_function (ctx, types[t], params, 3);
+		jit_value_t r = jit_insn_fma (func, jit_value_get_param (func, 0),
+					      jit_value_get_param (func, 1),
+					      jit_value_get_param (func, 2));
+		CHECK (r && jit_value_get_type (r) == types[t]);
+		jit_insn_return (func, r);
+		if (level == 1)
+		  {
+		    CHECK (!has_opcode (jit_function_get_current (func),
+					JIT_OP_FFMA));
+		    CHECK (!has_opcode (jit_function_get_current (func),
+					JIT_OP_DFMA));
+		  }
+		CHECK (jit_function_compile (func));
+
+		if (t == 4)
+		  {
+		    jit_float32 a = 1.0f + 1.0f / 4096.0f;
+		    jit_float32 c = -(1.0f + 1.0f / 2048.0f);
+		    jit_float32 result = 0;
+		    void *args[] = { &a, &a, &c };
+		    CHECK (jit_function_apply (func, args, &result));
+		    CHECK (result == jit_float32_fma (a, a, c));
+		  }
+		else
+		  {
+		    jit_float64 a = 1.0 + 1.0 / 134217728.0;
+		    jit_float64 c = -(1.0 + 1.0 / 67108864.0);
+		    jit_float64 result = 0;
+		    void *args[] = { &a, &a, &c };
+		    CHECK (jit_function_apply (func, args, &result));
+		    CHECK (result == jit_float64_fma (a, a, c));
+		  }
+	      }
+	    jit_context_destroy (ctx);
+	  }
+}
+
+/* Copy, move and fill blocks of all the sizes up to past the inline
+   size classes and a few sizes around the limit of the inline loops,
+   with the size in a register and as a constant, and
+   with the moves overlapping in both directions.  The function returns
+   its arguments after the operation to check that the registers that
+   the operation uses keep the values that are still live.  */
+
+static jit_function_t block_function (jit_context_t ctx, int op,
+				      jit_nint size)
+{
+	jit_type_t params[3];
+	params[0] = jit_type_void_ptr;
+	params[1] = op == 2 ? jit_type_int : jit_type_void_ptr;
+	params[2] = jit_type_nint;
+	jit_function_t func = test_function (ctx, jit_type_nint, params, 3);
+
+	jit_value_t d = jit_value_get_param (func, 0);
+	jit_value_t s = jit_value_get_param (func, 1);
+	jit_value_t n = jit_value_get_param (func, 2);
+	if (size >= 0)
+	  n = jit_value_create_nint_constant (func, jit_type_nint, size);
+	switch (op)
+	  {
+	  case 0: CHECK (jit_insn_memcpy (func, d, s, n)); break;
+	  case 1: CHECK (jit_insn_memmove (func, d, s, n)); break;
+	  default: CHECK (jit_insn_memset (func, d, s, n)); break;
+	  }
+	jit_value_t r = jit_insn_add (func, jit_insn_convert (func, d, jit_type_nint, 0),
+				      jit_insn_convert (func, s, jit_type_nint, 0));
+	jit_insn_return (func, jit_insn_add (func, r, n));
+	CHECK (jit_function_compile (func));
+	return func;
+}
+
+static void test_block_operations(void)
+{
+	static const int shifts[] = { 0, -1, 1, -7, 9, -40, 33, 100 };
+	static const jit_nint large_sizes[] = { 255, 256, 257, 1000, 3001 };
+	const unsigned num_shifts = sizeof (shifts) / sizeof (shifts[0]);
+	const unsigned num_large = sizeof (large_sizes) / sizeof (large_sizes[0]);
+	static unsigned char buf[8192], expected[8192];
+	jit_context_t ctx;
+	jit_nint size;
+	unsigned op, i, k;
+	int constant;
+
+	ctx = test_context ();
+	jit_function_t variable[3];
+	for (op = 0; op < 3; op++)
+	  variable[op] = block_function (ctx, op, -1);
+
+	for (k = 0; k <= 160 + num_large; k++)
+	  for (constant = 0; constant < 2; constant++)
+	    for (op = 0; op < 3; op++)
+	      {
+		size = k <= 160 ? (jit_nint) k : large_sizes[k - 161];
+		jit_function_t func = constant
+		  ? block_function (ctx, op, size) : variable[op];
+		for (i = 0; i < (op == 1 ? num_shifts : 1); i++)
+		  {
+		    unsigned j;
+		    for (j = 0; j < sizeof (buf); j++)
+		      buf[j] = expected[j] = (unsigned char) (j * 7 + 3);
+
+		    unsigned char *d = buf + 150;
+		    unsigned char *s = op == 1 ? d + shifts[i] : buf + 4000;
+		    jit_int value = 0x1a5;
+		    jit_nint n = size, result = 0;
+		    void *args[3];
+		    args[0] = &d;
+		    args[1] = op == 2 ? (void *) &value : (void *) &s;
+		    args[2] = &n;
+		    CHECK (jit_function_apply (func, args, &result));
+
+		    if (op == 2)
+		      {
+			memset (expected + 150, value, size);
+			CHECK (result == (jit_nint) d + value + size);
+		      }
+		    else
+		      {
+			memmove (expected + 150,
+				 expected + (s - buf), size);
+			CHECK (result == (jit_nint) d + (jit_nint) s + size);
+		      }
+		    CHECK (memcmp (buf, expected, sizeof (buf)) == 0);
+		  }
+	      }
+
+	jit_context_destroy (ctx);
 }
 
 int main()
 {
 	test_block_removal ();
+	test_cold_layout ();
+	test_loop_optimization ();
+	test_widened_induction ();
+	test_bounds_elimination ();
+	test_alias_optimization ();
+	test_scalar_replacement ();
+	test_address_selection ();
+	test_add_chain ();
+	test_shared_register ();
+	test_instruction_scheduling ();
+	test_switch_lowering ();
+	test_tail_calls ();
+	test_overflow_checks ();
+	test_atomic_operations ();
+	test_bit_operations ();
+	test_rounding_operations ();
+	test_nfloat_as_float64 ();
+	test_feature_levels ();
+	test_block_operations ();
 
 	return 0;
 }
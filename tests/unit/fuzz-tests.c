@@ -0,0 +1,1280 @@
+/*
+ * fuzz-tests.c - Differential tests with random programs
+ *
+ * Copyright (C) 2026  Free Software Foundation, Inc.
+ *
+ * This file is part of the libjit library.
+ *
+ * The libjit library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * The libjit library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the libjit library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/* Usage: fuzz-tests [-m mode] [-s seed] [-n count] [-v]
+
+   Generate random programs, build each of them as libjit functions,
+   compile them at the lowest and the highest optimization level and
+   compare the results for a few inputs with a reference evaluation of
+   the same program in C.  The back end is chosen when libjit is
+   configured, so the same seeds test the interpreter in a build with
+   --enable-interpreter and the native back end otherwise; both are
+   checked against the same reference results.
+
+   A program is a "main" function of three parameters with a number of
+   local variables of types int, long and float64, and a few helper
+   functions that it calls.  The statements assign random expressions
+   to the variables, branch, loop a few times, call the helpers with
+   many arguments, call helpers that return structures and call helpers
+   that throw exceptions to the catcher of "main".  The result is a
+   checksum of all the variables.
+
+   The modes stress different areas:
+
+     mixed	a bit of everything
+     pressure	many live variables and deep expressions, no calls
+     calls	calls with up to 16 arguments of mixed types
+     struct	calls that return structures
+     except	calls that throw exceptions
+     addchain	long chains of int and long additions over many live
+		variables, with frequent branches
+
+   Without -m all the modes are run, each for the seeds 1 to 1000
+   unless -s and -n say otherwise.  On a mismatch the mode, the seed,
+   the optimization level and the input are printed, and -v also dumps
+   the function.
+
+   There are no known failures for the seeds 1 to 40000 of any mode.
+   These seeds failed once and are run by the fuzz-seeds test:
+
+     addchain 1122, 2141, 2369, 2552, 5682, 7960, 14995, calls 1280,
+     mixed 21482
+		the register allocator left a value bound to a register
+		that an input shared with it, when the instruction
+		clobbered the register or replaced the value
+     calls 35072, and any seed now and then
+		the global register allocator counted the uses of stale
+		values in a recycled block of the value pool
+     mixed 25261, calls 31335
+		failed only in long sweeps, not when run alone, like
+		calls 35072 before the value pool fix  */
+
+#include <jit/jit.h>
+#include <math.h>
+#include <string.h>
+#include "unit-tests.h"
+
+#define MAX_VARS	64
+#define MAX_ARGS	16
+#define MAX_HELPERS	6
+#define MAX_EXPRS	20000
+#define MAX_STMTS	4000
+#define NUM_INPUTS	4
+#define NUM_ACCUMULATORS	12
+
+/* The value types */
+#define T_INT		0
+#define T_LONG		1
+#define T_FLOAT		2
+#define NUM_TYPES	3
+
+/* The structure types returned by the helpers */
+#define NUM_STRUCTS	3
+#define MAX_FIELDS	3
+
+/* The expression kinds */
+#define E_CONST		0
+#define E_VAR		1
+#define E_BINARY	2
+#define E_SHIFT		3
+#define E_DIVIDE	4
+#define E_UNARY		5
+#define E_COMPARE	6
+#define E_CONVERT	7
+
+/* The operators */
+#define O_ADD		0
+#define O_SUB		1
+#define O_MUL		2
+#define O_AND		3
+#define O_OR		4
+#define O_XOR		5
+#define O_MIN		6
+#define O_MAX		7
+#define O_DIV		8
+#define O_REM		9
+#define O_SHL		10
+#define O_SHR		11
+#define O_USHR		12
+#define O_NEG		13
+#define O_NOT		14
+#define O_ABS		15
+#define O_LT		16
+#define O_LE		17
+#define O_GT		18
+#define O_GE		19
+#define O_EQ		20
+#define O_NE		21
+
+/* The statement kinds */
+#define S_ASSIGN	0
+#define S_IF		1
+#define S_LOOP		2
+#define S_CALL		3
+#define S_STRUCT_CALL	4
+#define S_THROW_CALL	5
+
+typedef struct expr expr_t;
+struct expr
+{
+  int kind;
+  int op;
+  int type;
+  int var;
+  jit_long ival;
+  jit_float64 fval;
+  expr_t *a;
+  expr_t *b;
+};
+
+typedef struct stmt stmt_t;
+struct stmt
+{
+  int kind;
+  int var;
+  int helper;
+  int field;
+  int count;
+  expr_t *expr;
+  expr_t *args[MAX_ARGS];
+  stmt_t *body;
+  stmt_t *other;
+  stmt_t *next;
+};
+
+/* A function: the parameters are the first variables.  The helpers
+   return a value of "type" or the structure "struct_index" if it is
+   not negative, and may throw if "throws" is set.  */
+typedef struct
+{
+  int num_params;
+  int num_vars;
+  int types[MAX_VARS];
+  int type;
+  int struct_index;
+  int throws;
+  stmt_t *body;
+  expr_t *result[MAX_FIELDS];
+} fn_t;
+
+typedef struct
+{
+  fn_t main;
+  fn_t helpers[MAX_HELPERS];
+  int num_helpers;
+} program_t;
+
+typedef struct
+{
+  const char *name;
+  int num_vars;
+  int num_stmts;
+  int depth;
+  int num_helpers;
+  int max_args;
+  int p_if;
+  int p_loop;
+  int p_call;
+  int p_struct;
+  int p_throw;
+  int num_types;
+  int max_body;
+  int p_chain;
+} fuzz_mode_t;
+
+typedef struct
+{
+  jit_long i;
+  jit_float64 f;
+} val_t;
+
+static const fuzz_mode_t modes[] = {
+  /* name	vars stmts depth helpers args  if loop call struct throw types body chain */
+  { "mixed",	  8,  12,    3,      4,   6,  15,  10,  10,    10,     5,    3,   3,    0 },
+  { "pressure",	 48,  40,    4,      0,   0,  10,   5,   0,     0,     0,    3,   3,    0 },
+  { "calls",	 12,  16,    2,      4,  16,  10,   5,  40,     0,     0,    3,   3,    0 },
+  { "struct",	  8,  16,    2,      4,   6,  10,   5,   0,    40,     0,    3,   3,    0 },
+  { "except",	  8,  16,    2,      3,   4,  15,  10,   5,     0,    30,    3,   3,    0 },
+  { "addchain",	 40,  60,    1,      0,   0,  25,   0,   0,     0,     0,    2,  15,   80 },
+};
+#define NUM_MODES	(sizeof (modes) / sizeof (modes[0]))
+
+/* The fields of the structure types */
+static const int struct_fields[NUM_STRUCTS][MAX_FIELDS + 1] = {
+  { T_LONG, T_INT, T_FLOAT, -1 },
+  { T_INT, T_INT, -1 },
+  { T_FLOAT, T_LONG, -1 },
+};
+
+static const jit_long int_constants[] = {
+  0, 1, -1, 2, 3, 7, 31, 32, 63, 64, 255, 0x7fff, 0xffff, -65536,
+  0x7fffffff, -0x7fffffffLL - 1, 0x123456789LL, -0x7fffffffffffffffLL - 1,
+  0x7fffffffffffffffLL
+};
+
+static const int float_ops[] = { O_ADD, O_SUB, O_MUL, O_DIV };
+
+static const jit_float64 float_constants[] = {
+  0.0, -0.0, 1.0, -1.0, 0.5, 0.1, 3.25, -7.75, 1e10, 1e300, -1e-300
+};
+
+static expr_t expr_pool[MAX_EXPRS];
+static stmt_t stmt_pool[MAX_STMTS];
+static int num_exprs;
+static int num_stmts;
+static unsigned int seed;
+static int thrown;
+static int verbose;
+
+static jit_type_t jit_types[NUM_TYPES];
+static jit_type_t struct_types[NUM_STRUCTS];
+
+static unsigned int next_random (unsigned int limit)
+{
+  seed = seed * 1103515245 + 12345;
+  return (seed >> 8) % limit;
+}
+
+static int chance (int percent)
+{
+  return (int) next_random (100) < percent;
+}
+
+static int num_fields (int index)
+{
+  int count = 0;
+  while (struct_fields[index][count] >= 0)
+    count++;
+  return count;
+}
+
+/* Generation.  */
+
+static expr_t *new_expr (int kind, int type)
+{
+  expr_t *e = &expr_pool[num_exprs++];
+  memset (e, 0, sizeof (expr_t));
+  e->kind = kind;
+  e->type = type;
+  return e;
+}
+
+static stmt_t *new_stmt (int kind)
+{
+  stmt_t *s = &stmt_pool[num_stmts++];
+  memset (s, 0, sizeof (stmt_t));
+  s->kind = kind;
+  return s;
+}
+
+/* Pick a variable of the type or return -1 if there is none.  */
+static int pick_var (fn_t *fn, int type)
+{
+  int vars[MAX_VARS];
+  int count = 0;
+  int index;
+
+  for (index = 0; index < fn->num_vars; index++)
+    if (fn->types[index] == type)
+      vars[count++] = index;
+  return count ? vars[next_random (count)] : -1;
+}
+
+static expr_t *gen_leaf (fn_t *fn, int type)
+{
+  expr_t *e;
+  int var = pick_var (fn, type);
+
+  if (var >= 0 && chance (75))
+    {
+      e = new_expr (E_VAR, type);
+      e->var = var;
+      return e;
+    }
+  e = new_expr (E_CONST, type);
+  if (type == T_FLOAT)
+    e->fval = chance (70)
+      ? float_constants[next_random (sizeof (float_constants)
+				     / sizeof (float_constants[0]))]
+      : (jit_float64) next_random (2000) / 16 - 50;
+  else
+    {
+      e->ival = chance (70)
+	? int_constants[next_random (sizeof (int_constants)
+				     / sizeof (int_constants[0]))]
+	: (jit_long) next_random (2000) - 1000;
+      if (type == T_INT)
+	e->ival = (jit_int) (jit_uint) e->ival;
+    }
+  return e;
+}
+
+static expr_t *gen_expr (fn_t *fn, int type, int depth)
+{
+  expr_t *e;
+  int choice;
+
+  if (depth <= 0 || num_exprs > MAX_EXPRS - 64 || chance (25))
+    return gen_leaf (fn, type);
+
+  choice = next_random (type == T_FLOAT ? 4 : 7);
+  switch (choice)
+    {
+    case 0:
+      e = new_expr (E_BINARY, type);
+      e->op = type == T_FLOAT
+	? float_ops[next_random (4)] : (int) next_random (O_MAX + 1);
+      e->a = gen_expr (fn, type, depth - 1);
+      e->b = gen_expr (fn, type, depth - 1);
+      break;
+
+    case 1:
+      e = new_expr (E_UNARY, type);
+      e->op = type == T_FLOAT
+	? (chance (50) ? O_NEG : O_ABS) : O_NEG + (int) next_random (3);
+      e->a = gen_expr (fn, type, depth - 1);
+      break;
+
+    case 2:
+      e = new_expr (E_CONVERT, type);
+      if (type == T_FLOAT)
+	e->a = gen_expr (fn, chance (50) ? T_INT : T_LONG, depth - 1);
+      else
+	e->a = gen_expr (fn, type == T_INT ? T_LONG : T_INT, depth - 1);
+      break;
+
+    case 3:
+      if (type == T_FLOAT)
+	{
+	  e = gen_leaf (fn, type);
+	  break;
+	}
+      e = new_expr (E_SHIFT, type);
+      e->op = O_SHL + (int) next_random (3);
+      e->ival = next_random (type == T_INT ? 32 : 64);
+      e->a = gen_expr (fn, type, depth - 1);
+      break;
+
+    case 4:
+      e = new_expr (E_DIVIDE, type);
+      e->op = chance (50) ? O_DIV : O_REM;
+      e->ival = chance (50) ? 1 + next_random (16) : 1 << next_random (10);
+      e->a = gen_expr (fn, type, depth - 1);
+      break;
+
+    case 5:
+      if (type != T_INT)
+	{
+	  e = gen_leaf (fn, type);
+	  break;
+	}
+      e = new_expr (E_COMPARE, type);
+      e->op = O_LT + (int) next_random (6);
+      choice = next_random (NUM_TYPES);
+      e->a = gen_expr (fn, choice, depth - 1);
+      e->b = gen_expr (fn, choice, depth - 1);
+      break;
+
+    default:
+      e = gen_leaf (fn, type);
+      break;
+    }
+  return e;
+}
+
+/* Generate a sum of 2 to 5 leaves for the variable "var", nesting each
+   addition on the left or the right at random.  Most of the sums also
+   add the variable itself, so that the destination of an addition is
+   often one of its operands.  */
+static expr_t *gen_chain (fn_t *fn, int var)
+{
+  int type = fn->types[var];
+  expr_t *e, *leaf, *sum;
+  int count = 1 + next_random (4);
+  int self = chance (75) ? (int) next_random (count + 1) : -1;
+
+  e = gen_leaf (fn, type);
+  if (self == count)
+    e->kind = E_VAR, e->var = var;
+  while (count-- > 0 && num_exprs < MAX_EXPRS - 64)
+    {
+      leaf = gen_leaf (fn, type);
+      if (self == count)
+	leaf->kind = E_VAR, leaf->var = var;
+      sum = new_expr (E_BINARY, type);
+      sum->op = O_ADD;
+      if (chance (50))
+	{
+	  sum->a = e;
+	  sum->b = leaf;
+	}
+      else
+	{
+	  sum->a = leaf;
+	  sum->b = e;
+	}
+      e = sum;
+    }
+  return e;
+}
+
+static stmt_t *gen_stmts (program_t *prog, fn_t *fn, const fuzz_mode_t *mode,
+			  int count, int depth);
+
+static stmt_t *gen_call (program_t *prog, fn_t *fn, const fuzz_mode_t *mode,
+			 int kind)
+{
+  stmt_t *s;
+  fn_t *callee;
+  int candidates[MAX_HELPERS];
+  int num_candidates = 0;
+  int index, field;
+
+  for (index = 0; index < prog->num_helpers; index++)
+    {
+      callee = &prog->helpers[index];
+      if ((kind == S_CALL && callee->struct_index < 0 && !callee->throws)
+	  || (kind == S_STRUCT_CALL && callee->struct_index >= 0)
+	  || (kind == S_THROW_CALL && callee->throws))
+	candidates[num_candidates++] = index;
+    }
+  if (!num_candidates)
+    return 0;
+
+  s = new_stmt (kind);
+  s->helper = candidates[next_random (num_candidates)];
+  callee = &prog->helpers[s->helper];
+  if (kind == S_STRUCT_CALL)
+    {
+      field = next_random (num_fields (callee->struct_index));
+      s->field = field;
+      s->var = pick_var (fn, struct_fields[callee->struct_index][field]);
+    }
+  else
+    s->var = pick_var (fn, callee->type);
+  if (s->var < 0)
+    {
+      s->kind = S_ASSIGN;
+      s->var = next_random (fn->num_vars);
+      s->expr = gen_expr (fn, fn->types[s->var], mode->depth);
+      return s;
+    }
+  for (index = 0; index < callee->num_params; index++)
+    s->args[index] = gen_expr (fn, callee->types[index], 1);
+  return s;
+}
+
+static stmt_t *gen_stmt (program_t *prog, fn_t *fn, const fuzz_mode_t *mode,
+			 int depth)
+{
+  stmt_t *s = 0;
+  int choice = next_random (100);
+  int is_main = fn == &prog->main;
+
+  if (depth > 0 && num_stmts < MAX_STMTS - 64)
+    {
+      if (choice < mode->p_if)
+	{
+	  s = new_stmt (S_IF);
+	  s->expr = gen_expr (fn, T_INT, 2);
+	  s->body = gen_stmts (prog, fn, mode, 1 + next_random (mode->max_body),
+			       depth - 1);
+	  if (chance (50))
+	    s->other = gen_stmts (prog, fn, mode,
+				  1 + next_random (mode->max_body), depth - 1);
+	  return s;
+	}
+      choice -= mode->p_if;
+      if (choice < mode->p_loop)
+	{
+	  s = new_stmt (S_LOOP);
+	  s->count = 1 + next_random (4);
+	  s->body = gen_stmts (prog, fn, mode, 1 + next_random (mode->max_body),
+			       depth - 1);
+	  return s;
+	}
+      choice -= mode->p_loop;
+    }
+  else
+    choice = 100;
+
+  if (is_main)
+    {
+      if (choice < mode->p_call)
+	s = gen_call (prog, fn, mode, S_CALL);
+      else if (choice < mode->p_call + mode->p_struct)
+	s = gen_call (prog, fn, mode, S_STRUCT_CALL);
+      else if (choice < mode->p_call + mode->p_struct + mode->p_throw)
+	s = gen_call (prog, fn, mode, S_THROW_CALL);
+      if (s)
+	return s;
+    }
+
+  s = new_stmt (S_ASSIGN);
+  s->var = next_random (fn->num_vars);
+  if (chance (mode->p_chain))
+    {
+      /* Most of the chains add to a few accumulators, so that their
+	 values stay live across many statements */
+      if (chance (75) && fn->num_vars - fn->num_params > NUM_ACCUMULATORS)
+	s->var = fn->num_params + next_random (NUM_ACCUMULATORS);
+      if (fn->types[s->var] != T_FLOAT)
+	{
+	  s->expr = gen_chain (fn, s->var);
+	  return s;
+	}
+    }
+  s->expr = gen_expr (fn, fn->types[s->var], mode->depth);
+  return s;
+}
+
+static stmt_t *gen_stmts (program_t *prog, fn_t *fn, const fuzz_mode_t *mode,
+			  int count, int depth)
+{
+  stmt_t *first = 0, *last = 0, *s;
+
+  while (count-- > 0)
+    {
+      s = gen_stmt (prog, fn, mode, depth);
+      if (last)
+	last->next = s;
+      else
+	first = s;
+      last = s;
+    }
+  return first;
+}
+
+static void gen_vars (fn_t *fn, int num_params, int num_vars, int num_types)
+{
+  int index;
+
+  fn->num_params = num_params;
+  fn->num_vars = num_params + num_vars;
+  for (index = 0; index < fn->num_vars; index++)
+    fn->types[index] = next_random (num_types);
+}
+
+static void gen_program (program_t *prog, const fuzz_mode_t *mode)
+{
+  fn_t *fn;
+  int index, field;
+
+  num_exprs = 0;
+  num_stmts = 0;
+  memset (prog, 0, sizeof (program_t));
+
+  prog->num_helpers = mode->num_helpers;
+  for (index = 0; index < prog->num_helpers; index++)
+    {
+      fn = &prog->helpers[index];
+      gen_vars (fn, 1 + next_random (mode->max_args), 1 + next_random (3),
+		mode->num_types);
+      fn->struct_index = -1;
+      fn->type = next_random (NUM_TYPES);
+      if (mode->p_struct && chance (50))
+	fn->struct_index = next_random (NUM_STRUCTS);
+      else if (mode->p_throw && chance (50))
+	{
+	  /* The helper throws if the first argument is a multiple of 4 */
+	  fn->throws = 1;
+	  fn->types[0] = T_LONG;
+	}
+      fn->body = gen_stmts (prog, fn, mode, 1 + next_random (4), 1);
+      if (fn->struct_index >= 0)
+	for (field = 0; field < num_fields (fn->struct_index); field++)
+	  fn->result[field]
+	    = gen_expr (fn, struct_fields[fn->struct_index][field], 2);
+      else
+	fn->result[0] = gen_expr (fn, fn->type, 2);
+    }
+
+  fn = &prog->main;
+  gen_vars (fn, 3, mode->num_vars, mode->num_types);
+  fn->types[0] = T_LONG;
+  fn->types[1] = T_INT;
+  fn->types[2] = T_FLOAT;
+  fn->struct_index = -1;
+  fn->type = T_LONG;
+  fn->body = gen_stmts (prog, fn, mode, mode->num_stmts, 2);
+
+  /* Start the add chains from values that are not constant, so that
+     the additions are not folded and all the variables are live */
+  if (mode->p_chain)
+    for (index = fn->num_vars - 1; index >= fn->num_params; index--)
+      {
+	stmt_t *s = new_stmt (S_ASSIGN);
+	s->var = index;
+	s->expr = new_expr (E_BINARY, fn->types[index]);
+	s->expr->op = O_ADD;
+	s->expr->a = new_expr (E_VAR, fn->types[index]);
+	s->expr->a->var = fn->types[index] == T_INT ? 1 : 0;
+	s->expr->b = new_expr (E_CONST, fn->types[index]);
+	s->expr->b->ival = index;
+	s->next = fn->body;
+	fn->body = s;
+      }
+}
+
+/* Reference evaluation.  */
+
+static jit_long normalize (int type, jit_long value)
+{
+  return type == T_INT ? (jit_long) (jit_int) (jit_uint) value : value;
+}
+
+static int compare (int op, int type, val_t a, val_t b)
+{
+  if (type == T_FLOAT)
+    switch (op)
+      {
+      case O_LT: return a.f < b.f;
+      case O_LE: return a.f <= b.f;
+      case O_GT: return a.f > b.f;
+      case O_GE: return a.f >= b.f;
+      case O_EQ: return a.f == b.f;
+      default:   return a.f != b.f;
+      }
+  switch (op)
+    {
+    case O_LT: return a.i < b.i;
+    case O_LE: return a.i <= b.i;
+    case O_GT: return a.i > b.i;
+    case O_GE: return a.i >= b.i;
+    case O_EQ: return a.i == b.i;
+    default:   return a.i != b.i;
+    }
+}
+
+static val_t eval_expr (expr_t *e, val_t *env)
+{
+  val_t r, a, b;
+  jit_ulong x, y;
+
+  r.i = 0;
+  r.f = 0;
+  switch (e->kind)
+    {
+    case E_CONST:
+      r.i = e->ival;
+      r.f = e->fval;
+      return r;
+
+    case E_VAR:
+      return env[e->var];
+
+    case E_BINARY:
+      a = eval_expr (e->a, env);
+      b = eval_expr (e->b, env);
+      if (e->type == T_FLOAT)
+	{
+	  switch (e->op)
+	    {
+	    case O_ADD: r.f = a.f + b.f; break;
+	    case O_SUB: r.f = a.f - b.f; break;
+	    case O_MUL: r.f = a.f * b.f; break;
+	    default:    r.f = a.f / b.f; break;
+	    }
+	  return r;
+	}
+      x = (jit_ulong) a.i;
+      y = (jit_ulong) b.i;
+      switch (e->op)
+	{
+	case O_ADD: x = x + y; break;
+	case O_SUB: x = x - y; break;
+	case O_MUL: x = x * y; break;
+	case O_AND: x = x & y; break;
+	case O_OR:  x = x | y; break;
+	case O_XOR: x = x ^ y; break;
+	case O_MIN: x = a.i < b.i ? x : y; break;
+	default:    x = a.i > b.i ? x : y; break;
+	}
+      r.i = normalize (e->type, (jit_long) x);
+      return r;
+
+    case E_SHIFT:
+      a = eval_expr (e->a, env);
+      if (e->op == O_SHL)
+	r.i = (jit_long) ((jit_ulong) a.i << e->ival);
+      else if (e->op == O_SHR)
+	r.i = a.i >> e->ival;
+      else if (e->type == T_INT)
+	r.i = (jit_long) ((jit_uint) a.i >> e->ival);
+      else
+	r.i = (jit_long) ((jit_ulong) a.i >> e->ival);
+      r.i = normalize (e->type, r.i);
+      return r;
+
+    case E_DIVIDE:
+      a = eval_expr (e->a, env);
+      r.i = e->op == O_DIV ? a.i / e->ival : a.i % e->ival;
+      return r;
+
+    case E_UNARY:
+      a = eval_expr (e->a, env);
+      if (e->type == T_FLOAT)
+	r.f = e->op == O_NEG ? -a.f : fabs (a.f);
+      else if (e->op == O_NOT)
+	r.i = normalize (e->type, ~a.i);
+      else if (e->op == O_NEG || a.i < 0)
+	r.i = normalize (e->type, (jit_long) (0 - (jit_ulong) a.i));
+      else
+	r.i = a.i;
+      return r;
+
+    case E_COMPARE:
+      r.i = compare (e->op, e->a->type, eval_expr (e->a, env),
+		     eval_expr (e->b, env));
+      return r;
+
+    default:
+      a = eval_expr (e->a, env);
+      if (e->type == T_FLOAT)
+	r.f = (jit_float64) a.i;
+      else
+	r.i = normalize (e->type, a.i);
+      return r;
+    }
+}
+
+/* Combine the variables into a checksum.  NaNs are all the same.  */
+static jit_long checksum (fn_t *fn, val_t *env)
+{
+  jit_ulong sum = 0;
+  jit_long bits;
+  int index;
+
+  for (index = 0; index < fn->num_vars; index++)
+    {
+      if (fn->types[index] != T_FLOAT)
+	bits = env[index].i;
+      else if (env[index].f != env[index].f)
+	bits = 12345;
+      else
+	memcpy (&bits, &env[index].f, sizeof (bits));
+      sum = sum * 1000003 + (jit_ulong) bits;
+    }
+  return (jit_long) sum;
+}
+
+static void eval_fn (program_t *prog, fn_t *fn, val_t *args, val_t *results,
+		     int *throws);
+
+/* Execute the statements and return zero if an exception was thrown.  */
+static int eval_stmts (program_t *prog, stmt_t *s, val_t *env)
+{
+  val_t args[MAX_ARGS];
+  val_t results[MAX_FIELDS];
+  fn_t *callee;
+  int index, throws;
+
+  for (; s; s = s->next)
+    switch (s->kind)
+      {
+      case S_ASSIGN:
+	env[s->var] = eval_expr (s->expr, env);
+	break;
+
+      case S_IF:
+	if (eval_expr (s->expr, env).i)
+	  {
+	    if (!eval_stmts (prog, s->body, env))
+	      return 0;
+	  }
+	else if (!eval_stmts (prog, s->other, env))
+	  return 0;
+	break;
+
+      case S_LOOP:
+	for (index = 0; index < s->count; index++)
+	  if (!eval_stmts (prog, s->body, env))
+	    return 0;
+	break;
+
+      default:
+	callee = &prog->helpers[s->helper];
+	for (index = 0; index < callee->num_params; index++)
+	  args[index] = eval_expr (s->args[index], env);
+	eval_fn (prog, callee, args, results, &throws);
+	if (throws)
+	  return 0;
+	env[s->var] = results[s->kind == S_STRUCT_CALL ? s->field : 0];
+	break;
+      }
+  return 1;
+}
+
+static void eval_fn (program_t *prog, fn_t *fn, val_t *args, val_t *results,
+		     int *throws)
+{
+  val_t env[MAX_VARS];
+  int index;
+
+  memset (env, 0, sizeof (env));
+  for (index = 0; index < fn->num_params; index++)
+    env[index] = args[index];
+  *throws = fn->throws && (env[0].i & 3) == 0;
+  if (*throws)
+    return;
+  eval_stmts (prog, fn->body, env);
+  if (fn->struct_index >= 0)
+    for (index = 0; index < num_fields (fn->struct_index); index++)
+      results[index] = eval_expr (fn->result[index], env);
+  else
+    results[0] = eval_expr (fn->result[0], env);
+}
+
+/* Evaluate "main".  An exception thrown to it makes it return the
+   checksum of the variables at that point with the low bit flipped.  */
+static jit_long eval_main (program_t *prog, val_t *args)
+{
+  val_t env[MAX_VARS];
+  fn_t *fn = &prog->main;
+  int index;
+
+  memset (env, 0, sizeof (env));
+  for (index = 0; index < fn->num_params; index++)
+    env[index] = args[index];
+  if (!eval_stmts (prog, fn->body, env))
+    return checksum (fn, env) ^ 1;
+  return checksum (fn, env);
+}
+
+/* Building the functions.  */
+
+typedef struct
+{
+  program_t *prog;
+  jit_function_t func;
+  jit_function_t helpers[MAX_HELPERS];
+  jit_value_t vars[MAX_VARS];
+} builder_t;
+
+static jit_value_t build_expr (builder_t *b, expr_t *e)
+{
+  jit_function_t func = b->func;
+  jit_type_t type = jit_types[e->type];
+  jit_value_t x, y;
+
+  switch (e->kind)
+    {
+    case E_CONST:
+      if (e->type == T_FLOAT)
+	return jit_value_create_float64_constant (func, type, e->fval);
+      if (e->type == T_INT)
+	return jit_value_create_nint_constant (func, type, e->ival);
+      return jit_value_create_long_constant (func, type, e->ival);
+
+    case E_VAR:
+      return b->vars[e->var];
+
+    case E_BINARY:
+      x = build_expr (b, e->a);
+      y = build_expr (b, e->b);
+      switch (e->op)
+	{
+	case O_ADD: return jit_insn_add (func, x, y);
+	case O_SUB: return jit_insn_sub (func, x, y);
+	case O_MUL: return jit_insn_mul (func, x, y);
+	case O_AND: return jit_insn_and (func, x, y);
+	case O_OR:  return jit_insn_or (func, x, y);
+	case O_XOR: return jit_insn_xor (func, x, y);
+	case O_MIN: return jit_insn_min (func, x, y);
+	case O_MAX: return jit_insn_max (func, x, y);
+	default:    return jit_insn_div (func, x, y);
+	}
+
+    case E_SHIFT:
+      x = build_expr (b, e->a);
+      y = jit_value_create_nint_constant (func, jit_type_int, e->ival);
+      if (e->op == O_SHL)
+	return jit_insn_shl (func, x, y);
+      if (e->op == O_SHR)
+	return jit_insn_sshr (func, x, y);
+      return jit_insn_ushr (func, x, y);
+
+    case E_DIVIDE:
+      x = build_expr (b, e->a);
+      if (e->type == T_INT)
+	y = jit_value_create_nint_constant (func, type, e->ival);
+      else
+	y = jit_value_create_long_constant (func, type, e->ival);
+      if (e->op == O_DIV)
+	return jit_insn_div (func, x, y);
+      return jit_insn_rem (func, x, y);
+
+    case E_UNARY:
+      x = build_expr (b, e->a);
+      if (e->op == O_NEG)
+	return jit_insn_neg (func, x);
+      if (e->op == O_NOT)
+	return jit_insn_not (func, x);
+      return jit_insn_abs (func, x);
+
+    case E_COMPARE:
+      x = build_expr (b, e->a);
+      y = build_expr (b, e->b);
+      switch (e->op)
+	{
+	case O_LT: return jit_insn_lt (func, x, y);
+	case O_LE: return jit_insn_le (func, x, y);
+	case O_GT: return jit_insn_gt (func, x, y);
+	case O_GE: return jit_insn_ge (func, x, y);
+	case O_EQ: return jit_insn_eq (func, x, y);
+	default:   return jit_insn_ne (func, x, y);
+	}
+
+    default:
+      return jit_insn_convert (func, build_expr (b, e->a), type, 0);
+    }
+}
+
+static void build_stmts (builder_t *b, stmt_t *s)
+{
+  jit_function_t func = b->func;
+  jit_value_t args[MAX_ARGS];
+  jit_value_t value, counter;
+  jit_label_t label1, label2;
+  fn_t *callee;
+  jit_type_t type;
+  int index;
+
+  for (; s; s = s->next)
+    switch (s->kind)
+      {
+      case S_ASSIGN:
+	jit_insn_store (func, b->vars[s->var], build_expr (b, s->expr));
+	break;
+
+      case S_IF:
+	label1 = jit_label_undefined;
+	label2 = jit_label_undefined;
+	jit_insn_branch_if_not (func, build_expr (b, s->expr), &label1);
+	build_stmts (b, s->body);
+	jit_insn_branch (func, &label2);
+	jit_insn_label (func, &label1);
+	build_stmts (b, s->other);
+	jit_insn_label (func, &label2);
+	break;
+
+      case S_LOOP:
+	label1 = jit_label_undefined;
+	counter = jit_value_create (func, jit_type_int);
+	jit_insn_store (func, counter,
+			jit_value_create_nint_constant (func, jit_type_int, 0));
+	jit_insn_label (func, &label1);
+	build_stmts (b, s->body);
+	jit_insn_store (func, counter, jit_insn_add (func, counter,
+		jit_value_create_nint_constant (func, jit_type_int, 1)));
+	jit_insn_branch_if (func, jit_insn_lt (func, counter,
+		jit_value_create_nint_constant (func, jit_type_int, s->count)),
+			    &label1);
+	break;
+
+      default:
+	callee = &b->prog->helpers[s->helper];
+	for (index = 0; index < callee->num_params; index++)
+	  args[index] = build_expr (b, s->args[index]);
+	value = jit_insn_call (func, 0, b->helpers[s->helper], 0, args,
+			       callee->num_params,
+			       callee->throws ? 0 : JIT_CALL_NOTHROW);
+	if (s->kind == S_STRUCT_CALL)
+	  {
+	    type = struct_types[callee->struct_index];
+	    value = jit_insn_load_relative
+	      (func, jit_insn_address_of (func, value),
+	       jit_type_get_offset (type, s->field),
+	       jit_type_get_field (type, s->field));
+	  }
+	jit_insn_store (func, b->vars[s->var], value);
+	break;
+      }
+}
+
+/* Emit the computation of the checksum and return it.  */
+static void build_return_checksum (builder_t *b, fn_t *fn, int flip)
+{
+  jit_function_t func = b->func;
+  jit_value_t sum, bits, temp;
+  jit_label_t label;
+  int index;
+
+  sum = jit_value_create (func, jit_type_ulong);
+  bits = jit_value_create (func, jit_type_ulong);
+  jit_insn_store (func, sum,
+		  jit_value_create_long_constant (func, jit_type_ulong, 0));
+  for (index = 0; index < fn->num_vars; index++)
+    {
+      if (fn->types[index] != T_FLOAT)
+	jit_insn_store (func, bits, jit_insn_convert (func, b->vars[index],
+						      jit_type_ulong, 0));
+      else
+	{
+	  label = jit_label_undefined;
+	  jit_insn_store (func, bits, jit_value_create_long_constant
+			  (func, jit_type_ulong, 12345));
+	  temp = jit_insn_ne (func, b->vars[index], b->vars[index]);
+	  jit_insn_branch_if (func, temp, &label);
+	  /* Copy the value to keep the variable out of memory */
+	  temp = jit_value_create (func, jit_type_float64);
+	  jit_insn_store (func, temp, b->vars[index]);
+	  temp = jit_insn_address_of (func, temp);
+	  jit_insn_store (func, bits,
+			  jit_insn_load_relative (func, temp, 0, jit_type_ulong));
+	  jit_insn_label (func, &label);
+	}
+      jit_insn_store (func, sum, jit_insn_add (func, jit_insn_mul
+		(func, sum, jit_value_create_long_constant
+		 (func, jit_type_ulong, 1000003)), bits));
+    }
+  if (flip)
+    jit_insn_store (func, sum, jit_insn_xor (func, sum,
+		jit_value_create_long_constant (func, jit_type_ulong, 1)));
+  jit_insn_return (func, sum);
+}
+
+static jit_function_t create_fn (jit_context_t ctx, fn_t *fn, int level)
+{
+  jit_type_t params[MAX_ARGS];
+  jit_type_t sig, ret;
+  jit_function_t func;
+  int index;
+
+  for (index = 0; index < fn->num_params; index++)
+    params[index] = jit_types[fn->types[index]];
+  ret = fn->struct_index >= 0
+    ? struct_types[fn->struct_index] : jit_types[fn->type];
+  sig = jit_type_create_signature (jit_abi_cdecl, ret, params,
+				   fn->num_params, 1);
+  func = jit_function_create (ctx, sig);
+  jit_type_free (sig);
+  jit_function_set_optimization_level (func, level);
+  return func;
+}
+
+static void build_fn (builder_t *b, fn_t *fn, int is_main)
+{
+  jit_function_t func = b->func;
+  jit_label_t label;
+  jit_value_t value, ptr;
+  jit_type_t type;
+  int index;
+
+  for (index = 0; index < fn->num_vars; index++)
+    {
+      b->vars[index] = jit_value_create (func, jit_types[fn->types[index]]);
+      if (index < fn->num_params)
+	value = jit_value_get_param (func, index);
+      else if (fn->types[index] == T_FLOAT)
+	value = jit_value_create_float64_constant (func, jit_type_float64, 0);
+      else
+	value = jit_value_create_nint_constant
+	  (func, jit_types[fn->types[index]], 0);
+      jit_insn_store (func, b->vars[index], value);
+    }
+
+  if (is_main)
+    {
+      /* The catcher keeps the variables out of the global registers,
+	 so it is only set up if a helper may throw */
+      for (index = 0; index < b->prog->num_helpers; index++)
+	if (b->prog->helpers[index].throws)
+	  break;
+      if (index < b->prog->num_helpers)
+	jit_insn_uses_catcher (func);
+      build_stmts (b, fn->body);
+      build_return_checksum (b, fn, 0);
+      if (index < b->prog->num_helpers)
+	{
+	  jit_insn_start_catcher (func);
+	  build_return_checksum (b, fn, 1);
+	}
+      return;
+    }
+
+  if (fn->throws)
+    {
+      label = jit_label_undefined;
+      value = jit_insn_and (func, b->vars[0], jit_value_create_long_constant
+			    (func, jit_type_long, 3));
+      jit_insn_branch_if (func, value, &label);
+      jit_insn_throw (func, jit_value_create_nint_constant
+		      (func, jit_type_void_ptr, (jit_nint) &thrown));
+      jit_insn_label (func, &label);
+    }
+  build_stmts (b, fn->body);
+  if (fn->struct_index >= 0)
+    {
+      type = struct_types[fn->struct_index];
+      value = jit_value_create (func, type);
+      ptr = jit_insn_address_of (func, value);
+      for (index = 0; index < num_fields (fn->struct_index); index++)
+	jit_insn_store_relative (func, ptr, jit_type_get_offset (type, index),
+				 build_expr (b, fn->result[index]));
+      jit_insn_return (func, value);
+    }
+  else
+    jit_insn_return (func, build_expr (b, fn->result[0]));
+}
+
+/* Build and compile the program, and return "main" or NULL.  */
+static jit_function_t build_program (jit_context_t ctx, program_t *prog,
+				     int level)
+{
+  builder_t b;
+  int index;
+
+  b.prog = prog;
+  jit_context_build_start (ctx);
+  for (index = 0; index < prog->num_helpers; index++)
+    {
+      b.helpers[index] = create_fn (ctx, &prog->helpers[index], level);
+      b.func = b.helpers[index];
+      build_fn (&b, &prog->helpers[index], 0);
+    }
+  b.func = create_fn (ctx, &prog->main, level);
+  build_fn (&b, &prog->main, 1);
+  jit_context_build_end (ctx);
+
+  for (index = 0; index < prog->num_helpers; index++)
+    if (!jit_function_compile (b.helpers[index]))
+      return 0;
+  if (!jit_function_compile (b.func))
+    return 0;
+  return b.func;
+}
+
+/* Get the inputs of "main".  The first argument of the first two is a
+   multiple of 4 to make the throwing helpers throw if they get it.  */
+static void get_input (int index, val_t *args)
+{
+  static const jit_long longs[NUM_INPUTS] = { 0, -8, 13, 0x7fffffffffffLL };
+  static const jit_long ints[NUM_INPUTS] = { 0, -1, 7, 0x7fffffff };
+  static const jit_float64 floats[NUM_INPUTS] = { 0.0, -2.5, 1e20, 0.1 };
+
+  memset (args, 0, 3 * sizeof (val_t));
+  args[0].i = longs[index];
+  args[1].i = ints[index];
+  args[2].f = floats[index];
+}
+
+static int run_program (const fuzz_mode_t *mode, unsigned int program_seed)
+{
+  program_t prog;
+  jit_context_t ctx;
+  jit_function_t func;
+  jit_long expected, result;
+  jit_int int_arg;
+  val_t args[3];
+  void *apply_args[3];
+  int levels[2], level, index, ok = 1;
+
+  seed = program_seed;
+  gen_program (&prog, mode);
+
+  levels[0] = 0;
+  levels[1] = jit_function_get_max_optimization_level ();
+  for (level = 0; level < 2; level++)
+    {
+      ctx = jit_context_create ();
+      func = build_program (ctx, &prog, levels[level]);
+      if (!func)
+	{
+	  fprintf (stderr, "fuzz-tests: mode %s seed %u level %d: "
+		   "compile failed\n", mode->name, program_seed,
+		   levels[level]);
+	  jit_context_destroy (ctx);
+	  return 0;
+	}
+      for (index = 0; index < NUM_INPUTS; index++)
+	{
+	  get_input (index, args);
+	  expected = eval_main (&prog, args);
+	  int_arg = (jit_int) args[1].i;
+	  apply_args[0] = &args[0].i;
+	  apply_args[1] = &int_arg;
+	  apply_args[2] = &args[2].f;
+	  result = 0;
+	  jit_function_apply (func, apply_args, &result);
+	  if (result != expected)
+	    {
+	      fprintf (stderr, "fuzz-tests: mode %s seed %u level %d "
+		       "input %d: expected %lld, got %lld\n",
+		       mode->name, program_seed, levels[level], index,
+		       (long long) expected, (long long) result);
+	      if (verbose)
+		jit_dump_function (stderr, func, "main");
+	      ok = 0;
+	      break;
+	    }
+	}
+      jit_context_destroy (ctx);
+    }
+  return ok;
+}
+
+int main (int argc, char *argv[])
+{
+  jit_type_t fields[MAX_FIELDS];
+  const char *mode_name = 0;
+  unsigned int first_seed = 1;
+  unsigned int count = 1000;
+  unsigned int index, program;
+  int field, failures = 0;
+
+  for (index = 1; index < (unsigned int) argc; index++)
+    {
+      if (!strcmp (argv[index], "-m") && index + 1 < (unsigned int) argc)
+	mode_name = argv[++index];
+      else if (!strcmp (argv[index], "-s") && index + 1 < (unsigned int) argc)
+	first_seed = strtoul (argv[++index], 0, 0);
+      else if (!strcmp (argv[index], "-n") && index + 1 < (unsigned int) argc)
+	count = strtoul (argv[++index], 0, 0);
+      else if (!strcmp (argv[index], "-v"))
+	verbose = 1;
+    }
+
+  jit_init ();
+  jit_types[T_INT] = jit_type_int;
+  jit_types[T_LONG] = jit_type_long;
+  jit_types[T_FLOAT] = jit_type_float64;
+  for (index = 0; index < NUM_STRUCTS; index++)
+    {
+      for (field = 0; field < num_fields (index); field++)
+	fields[field] = jit_types[struct_fields[index][field]];
+      struct_types[index] = jit_type_create_struct (fields, field, 1);
+    }
+
+  for (index = 0; index < NUM_MODES; index++)
+    {
+      if (mode_name && strcmp (mode_name, modes[index].name) != 0)
+	continue;
+      for (program = 0; program < count; program++)
+	if (!run_program (&modes[index], first_seed + program))
+	  failures++;
+    }
+
+  for (index = 0; index < NUM_STRUCTS; index++)
+    jit_type_free (struct_types[index]);
+  return failures != 0;
+}
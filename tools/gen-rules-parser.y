@@ -1228,6 +1228,10 @@ static void gensel_output_clauses(gensel_clause_t clauses, gensel_option_t optio
 			{
 				seen_option = 1;
 				printf("_JIT_REGS_TERNARY");
+				if(free_dest)
+				{
+					printf(" | _JIT_REGS_UPDATE_DEST");
+				}
 			}
 			else if(free_dest)
 			{